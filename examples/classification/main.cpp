@@ -45,6 +45,7 @@
 #include "configuration.h"
 #include "avg_fps_window.h"
 #include "imgutil.h"
+#include "postproc.h"
 
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
@@ -702,30 +703,8 @@ int tf_postprocess(uchar *in, int out_size, int size, int roi_idx,
   // reporting classified object from 1000 categories
   int background_offset = out_size == 1001 ? 1 : 0;
 
-  typedef std::pair<uchar, int> val_index;
-  auto cmp = [](val_index &left, val_index &right) { return left.first > right.first; };
-  std::priority_queue<val_index, std::vector<val_index>, decltype(cmp)> queue(cmp);
-  // initialize priority queue with smallest value on top
-  for (int i = 0; i < k; i++) {
-    queue.push(val_index(in[i], i));
-  }
-  // for rest input, if larger than current minimum, pop mininum, push new val
-  for (int i = k; i < size; i++)
-  {
-    if (in[i] > queue.top().first)
-    {
-      queue.pop();
-      queue.push(val_index(in[i], i));
-    }
-  }
-
-  // output top k values in reverse order: largest val first
-  std::vector<val_index> sorted;
-  while (! queue.empty())
-   {
-    sorted.push_back(queue.top());
-    queue.pop();
-  }
+  std::vector<postproc::ScoreIndex> sorted;
+  postproc::TopK(in, size, k, sorted);
 
   for (int i = 0; i < k; i++)
   {
@@ -81,3 +81,36 @@ const ObjectClass& ObjectClasses::At(unsigned int index)
     else                        return classes_m[num_classes_m];
 }
 
+void ObjectClasses::CreateMask(const unsigned char *classes, unsigned char *mb,
+                               unsigned char *mg, unsigned char *mr,
+                               int channel_size)
+{
+    tidl::postproc::ColorizeClasses(classes, channel_size, GetColors(),
+                                    GetUnknownColor(), mb, mg, mr);
+}
+
+void ObjectClasses::CreateOverlay(const unsigned char *classes,
+                                  const unsigned char *frame, bool planar,
+                                  int width, int height, float alpha,
+                                  int factor, unsigned char *overlay)
+{
+    tidl::postproc::BlendClasses(classes, width, height, frame, planar,
+                                 GetColors(), GetUnknownColor(), alpha,
+                                 factor, overlay);
+}
+
+std::vector<tidl::postproc::Color> ObjectClasses::GetColors() const
+{
+    std::vector<tidl::postproc::Color> colors;
+    for (unsigned int i = 0; i < num_classes_m; i++)
+        colors.push_back({ classes_m[i].color.blue, classes_m[i].color.green,
+                           classes_m[i].color.red });
+    return colors;
+}
+
+// The entry after the classes has the color of unknown class indices
+tidl::postproc::Color ObjectClasses::GetUnknownColor() const
+{
+    const ObjectClass& unknown = classes_m[num_classes_m];
+    return { unknown.color.blue, unknown.color.green, unknown.color.red };
+}
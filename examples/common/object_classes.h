@@ -31,6 +31,7 @@
 
 #include <string>
 #include <vector>
+#include "postproc.h"
 
 struct ObjectClass {
     std::string       label;
@@ -49,10 +50,25 @@ class ObjectClasses {
     ObjectClasses(const std::string& json_file);
     const ObjectClass& At(unsigned int index);
 
+    // Create overlay mask for pixel-level segmentation, one color plane
+    // per channel
+    void CreateMask(const unsigned char *classes, unsigned char *mb,
+                    unsigned char *mg, unsigned char *mr, int channel_size);
+
+    // Blend the class colors over a BGR frame of width x height, planar or
+    // interleaved, into an interleaved overlay downscaled by factor
+    void CreateOverlay(const unsigned char *classes,
+                       const unsigned char *frame, bool planar, int width,
+                       int height, float alpha, int factor,
+                       unsigned char *overlay);
+
     unsigned int       GetNumClasses()  { return num_classes_m; }
     const std::string& GetNetworkName() { return network_name_m; }
 
   private:
+    std::vector<tidl::postproc::Color> GetColors() const;
+    tidl::postproc::Color              GetUnknownColor() const;
+
     unsigned int              num_classes_m;
     std::string               network_name_m;
     std::vector<ObjectClass>  classes_m;
@@ -30,6 +30,7 @@
 #include <cstring>
 
 #include "utils.h"
+#include "buffer_pool.h"
 
 using namespace tidl;
 
@@ -172,59 +173,41 @@ const char* ReadReferenceOutput(const string& name)
     return buffer;
 }
 
+// Input and output buffers are allocated in CMEM, from a pool shared by
+// all EOs and EOPs of the application
+static BufferPool& GetBufferPool()
+{
+    static BufferPool pool;
+    return pool;
+}
+
 // Allocate input and output memory for each EO
 void AllocateMemory(const vector<ExecutionObject *>& eos)
 {
-    // Allocate input and output buffers for each execution object
     for (auto eo : eos)
-    {
-        size_t in_size  = eo->GetInputBufferSizeInBytes();
-        size_t out_size = eo->GetOutputBufferSizeInBytes();
-        void*  in_ptr   = malloc(in_size);
-        void*  out_ptr  = malloc(out_size);
-        assert(in_ptr != nullptr && out_ptr != nullptr);
-
-        ArgInfo in  = { ArgInfo(in_ptr,  in_size)};
-        ArgInfo out = { ArgInfo(out_ptr, out_size)};
-        eo->SetInputOutputBuffer(in, out);
-    }
+        GetBufferPool().AllocateBuffers(eo);
 }
 
 // Free the input and output memory associated with each EO
 void FreeMemory(const vector<ExecutionObject *>& eos)
 {
     for (auto eo : eos)
-    {
-        free(eo->GetInputBufferPtr());
-        free(eo->GetOutputBufferPtr());
-    }
+        GetBufferPool().ReleaseBuffers(eo);
+    GetBufferPool().Trim();
 }
 
-// Allocate input and output memory for each EOP
+// Allocate input and output memory for each slot of each EOP
 void AllocateMemory(const vector<ExecutionObjectPipeline *>& eops)
 {
-    // Allocate input and output buffers for each execution object
     for (auto eop : eops)
-    {
-        size_t in_size  = eop->GetInputBufferSizeInBytes();
-        size_t out_size = eop->GetOutputBufferSizeInBytes();
-        void*  in_ptr   = malloc(in_size);
-        void*  out_ptr  = malloc(out_size);
-        assert(in_ptr != nullptr && out_ptr != nullptr);
-
-        ArgInfo in  = { ArgInfo(in_ptr,  in_size)};
-        ArgInfo out = { ArgInfo(out_ptr, out_size)};
-        eop->SetInputOutputBuffer(in, out);
-    }
+        GetBufferPool().AllocateBuffers(eop);
 }
 
 // Free the input and output memory associated with each EOP
 void FreeMemory(const vector<ExecutionObjectPipeline *>& eops)
 {
     for (auto eop : eops)
-    {
-        free(eop->GetInputBufferPtr());
-        free(eop->GetOutputBufferPtr());
-    }
+        GetBufferPool().ReleaseBuffers(eop);
+    GetBufferPool().Trim();
 }
 
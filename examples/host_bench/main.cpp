@@ -0,0 +1,321 @@
+/******************************************************************************
+ * Copyright (c) 2018, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+// Microbenchmarks for the host side per-frame processing: copies between
+// host and padded device buffers, image preprocessing and the output
+// processing used by the examples. Runs on synthetic data of the network
+// shapes used by the examples, does not require a DSP or EVE.
+
+#include <getopt.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+#include "executor.h"
+#include "execution_object.h"
+#include "configuration.h"
+#include "imgutil.h"
+#include "../common/object_classes.h"
+#include "postproc.h"
+
+#include "opencv2/core.hpp"
+
+using namespace std;
+using namespace tidl;
+
+#define DEFAULT_ITERATIONS 200
+#define NUM_TRIALS         5
+// Padding around each plane of a device buffer
+#define PAD                4
+#define DEFAULT_OBJECT_CLASSES_LIST_FILE "../segmentation/jseg21_objects.json"
+
+typedef struct result_t_ {
+  std::string name;
+  std::string shape;
+  double      ns_per_frame;
+} result_t;
+
+static std::vector<result_t> results;
+static uint32_t iterations = DEFAULT_ITERATIONS;
+
+// Run f iterations times per trial, record the median ns per call
+static void Bench(const std::string& name, const std::string& shape,
+                  const std::function<void()>& f)
+{
+    f();  // warmup, first touch of the buffers
+
+    std::vector<double> trials;
+    for (int t = 0; t < NUM_TRIALS; t++)
+    {
+        auto t0 = chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+            f();
+        auto t1 = chrono::steady_clock::now();
+        chrono::duration<double, std::nano> elapsed = t1 - t0;
+        trials.push_back(elapsed.count() / iterations);
+    }
+    std::sort(trials.begin(), trials.end());
+
+    result_t r = { name, shape, trials[NUM_TRIALS / 2] };
+    results.push_back(r);
+    cout << setw(20) << left << name << setw(16) << shape
+         << setw(14) << right << fixed << setprecision(0)
+         << r.ns_per_frame << " ns/frame" << endl;
+}
+
+static std::string Shape(int c, int h, int w)
+{
+    return std::to_string(c) + "x" + std::to_string(h) + "x" +
+           std::to_string(w);
+}
+
+static void Randomize(std::vector<char>& v, int modulo = 256)
+{
+    for (auto& x : v)
+        x = (char) (rand() % modulo);
+}
+
+// Padded planes as allocated on the device for a network input or output
+struct PaddedBuffer
+{
+    PaddedBuffer(int c, int h, int w) :
+        pitch(w + 2 * PAD), stride((h + 2 * PAD) * pitch),
+        storage(c * stride),
+        view(storage.data() + PAD * pitch + PAD, 1, c, h, w, pitch, stride)
+    {}
+
+    size_t            pitch;
+    size_t            stride;
+    std::vector<char> storage;
+    DeviceBufferView  view;
+};
+
+// Host to device copy of a network input (readDataS8)
+static void BenchCopyIn(int c, int h, int w)
+{
+    std::vector<char> src(c * h * w);
+    Randomize(src);
+    DeviceBufferView packed(src.data(), 1, c, h, w, w, h * w);
+    PaddedBuffer     device(c, h, w);
+
+    Bench("copy_in", Shape(c, h, w),
+          [&]() { packed.CopyTo(device.view); });
+}
+
+// Device to host copy of a network output (writeDataS8)
+static void BenchCopyOut(int c, int h, int w)
+{
+    PaddedBuffer device(c, h, w);
+    Randomize(device.storage);
+    LayerOutputView output(0, 0, 0, 0, 0, 0, device.view);
+    std::vector<char> dst(output.Size());
+
+    Bench("copy_out", Shape(c, h, w),
+          [&]() { output.CopyTo(dst.data(), dst.size()); });
+}
+
+// imgutil::PreprocessImage from a VGA frame
+static void BenchPreprocess(int preproc_type, int h, int w)
+{
+    cv::Mat frame(480, 640, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    Configuration c;
+    c.inNumChannels = 3;
+    c.inHeight      = h;
+    c.inWidth       = w;
+    c.preProcType   = preproc_type;
+    std::vector<char> dst(3 * h * w);
+
+    // PreprocessImage replaces the image header, the pixel data of frame
+    // is only converted in place (BGR<->RGB)
+    Bench("preprocess_" + std::to_string(preproc_type), Shape(3, h, w),
+          [&]() { cv::Mat image = frame;
+                  imgutil::PreprocessImage(image, dst.data(), c); });
+}
+
+// Top 5 of a classification output
+static void BenchTopK(int size)
+{
+    std::vector<char> out(size);
+    Randomize(out);
+    std::vector<postproc::ScoreIndex> sorted;
+
+    Bench("top5", Shape(1, 1, size),
+          [&]() { postproc::TopK((const uint8_t *) out.data(), size, 5,
+                                 sorted); });
+}
+
+// SSD detection output with num_objects valid objects
+static void BenchDecodeBoxes(int max_objects, int num_objects)
+{
+    std::vector<float> out(max_objects * 7);
+    for (int i = 0; i < max_objects; i++)
+    {
+        float *o = &out[i * 7];
+        o[0] = i < num_objects ? 0 : -1;
+        o[1] = rand() % 20;
+        o[2] = (rand() % 100) / 100.0f;
+        o[3] = (rand() % 50) / 100.0f;
+        o[4] = (rand() % 50) / 100.0f;
+        o[5] = o[3] + 0.5f;
+        o[6] = o[4] + 0.5f;
+    }
+    std::vector<postproc::DetectedObject> objects;
+
+    Bench("decode_boxes", Shape(1, max_objects, 7),
+          [&]() { postproc::DecodeBoxes(out.data(), out.size(), 768, 320,
+                                        25, objects); });
+}
+
+// Non-maximum suppression of num_objects boxes over 20 labels
+static void BenchSuppressOverlaps(int num_objects)
+{
+    std::vector<postproc::DetectedObject> boxes(num_objects);
+    for (auto& b : boxes)
+    {
+        b.label = rand() % 20;
+        b.score = (rand() % 100) / 100.0f;
+        b.xmin  = rand() % 700;
+        b.ymin  = rand() % 300;
+        b.xmax  = b.xmin + rand() % 200;
+        b.ymax  = b.ymin + rand() % 100;
+    }
+    std::vector<postproc::DetectedObject> objects;
+
+    Bench("suppress_overlaps", Shape(1, num_objects, 1),
+          [&]() { objects = boxes;
+                  postproc::SuppressOverlaps(objects, 0.45f); });
+}
+
+// Segmentation overlay mask of a per-pixel class output
+static void BenchCreateMask(ObjectClasses& object_classes, int h, int w)
+{
+    int channel_size = h * w;
+    std::vector<char> classes(channel_size);
+    Randomize(classes, std::max(1u, object_classes.GetNumClasses()));
+    std::vector<unsigned char> mb(channel_size), mg(channel_size),
+                               mr(channel_size);
+
+    Bench("create_mask", Shape(1, h, w),
+          [&]() { object_classes.CreateMask(
+                        (const unsigned char *) classes.data(),
+                        mb.data(), mg.data(), mr.data(), channel_size); });
+}
+
+// Segmentation overlay blended over an interleaved frame, downscaled by
+// factor
+static void BenchCreateOverlay(ObjectClasses& object_classes, int h, int w,
+                               int factor)
+{
+    std::vector<char> classes(h * w), frame(3 * h * w);
+    Randomize(classes, std::max(1u, object_classes.GetNumClasses()));
+    Randomize(frame);
+    std::vector<unsigned char> overlay(3 * (h / factor) * (w / factor));
+
+    Bench("create_overlay_" + std::to_string(factor), Shape(3, h, w),
+          [&]() { object_classes.CreateOverlay(
+                        (const unsigned char *) classes.data(),
+                        (const unsigned char *) frame.data(), false, w, h,
+                        0.3f, factor, overlay.data()); });
+}
+
+static void DisplayHelp()
+{
+    std::cout <<
+    "Usage: host_bench\n"
+    "  Benchmarks the host side per-frame processing on synthetic data.\n"
+    "Optional arguments:\n"
+    " -n <number>          Iterations per trial, default "
+                           << DEFAULT_ITERATIONS << "\n"
+    " -l <objects_list>    Object classes used by create_mask\n"
+    " -o <file>            Write the results to a CSV file\n"
+    " -h                   Help\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::string classes_file = DEFAULT_OBJECT_CLASSES_LIST_FILE;
+    std::string output_file;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:l:o:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'n': iterations = std::max(1, atoi(optarg));
+                      break;
+            case 'l': classes_file = optarg;
+                      break;
+            case 'o': output_file = optarg;
+                      break;
+            case 'h':
+            default:  DisplayHelp();
+                      return EXIT_SUCCESS;
+        }
+    }
+
+    srand(1);
+    ObjectClasses object_classes(classes_file);
+
+    BenchCopyIn(3, 224, 224);      // j11, mobileNet, inceptionNet
+    BenchCopyIn(3, 320, 768);      // jdetnet
+    BenchCopyIn(3, 512, 1024);     // jseg21
+    BenchCopyOut(1, 1, 1001);      // mobileNet classification
+    BenchCopyOut(1, 512, 1024);    // jseg21 per-pixel classes
+    BenchPreprocess(0, 224, 224);  // j11
+    BenchPreprocess(1, 227, 227);  // squeezeNet
+    BenchPreprocess(2, 224, 224);  // mobileNet, inceptionNet
+    BenchTopK(1001);
+    BenchDecodeBoxes(100, 20);
+    BenchSuppressOverlaps(200);
+    BenchCreateMask(object_classes, 512, 1024);
+    BenchCreateOverlay(object_classes, 512, 1024, 1);
+    BenchCreateOverlay(object_classes, 512, 1024, 2);
+
+    if (!output_file.empty())
+    {
+        ofstream ofs(output_file);
+        ofs << "name,shape,ns_per_frame\n";
+        for (const auto& r : results)
+            ofs << r.name << "," << r.shape << "," << r.ns_per_frame << "\n";
+        if (!ofs.good())
+        {
+            cerr << "Failed to write " << output_file << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
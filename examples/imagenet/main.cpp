@@ -39,12 +39,17 @@
 #include <queue>
 #include <vector>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "executor.h"
 #include "execution_object.h"
 #include "execution_object_pipeline.h"
+#include "input_stage.h"
 #include "configuration.h"
 #include "../common/object_classes.h"
+#include "postproc.h"
 #include "imgutil.h"
 #include "../common/video_utils.h"
 
@@ -69,11 +74,20 @@ const char *default_inputs[NUM_DEFAULT_INPUTS] =
 std::unique_ptr<ObjectClasses> object_classes;
 
 
+// Serializes camera/video capture from the input stage workers, in frame
+// index order
+struct OrderedCapture
+{
+    std::mutex              mutex;
+    std::condition_variable cv;
+    uint32_t                next_frame_idx = 0;
+};
+
 Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c);
 bool RunConfiguration(cmdline_opts_t& opts);
-bool ReadFrame(ExecutionObjectPipeline& eop,
-               uint32_t frame_idx, const Configuration& c,
-               const cmdline_opts_t& opts, VideoCapture &cap);
+bool ReadFrame(uint32_t frame_idx, char* frame_buffer, const Configuration& c,
+               const cmdline_opts_t& opts, VideoCapture &cap,
+               OrderedCapture& capture);
 bool WriteFrameOutput(const ExecutionObjectPipeline &eop,
                       const cmdline_opts_t& opts);
 void DisplayHelp();
@@ -197,6 +211,20 @@ bool RunConfiguration(cmdline_opts_t& opts)
         // Allocate input and output buffers for each EOP
         AllocateMemory(eops);
 
+        // Read and preprocess frames on worker threads, ahead of the
+        // dispatch loop. Each EOP holds one frame from the input stage,
+        // the remaining buffers are read ahead.
+        uint32_t num_workers = max(1u, thread::hardware_concurrency());
+        size_t   in_size     = eops[0]->GetInputBufferSizeInBytes();
+        OrderedCapture capture;
+        InputStage input([&](uint32_t idx, char* buffer, size_t size)
+                         { return ReadFrame(idx, buffer, c, opts, cap,
+                                            capture); },
+                         in_size, num_workers, num_eops + num_workers);
+        vector<char*> eop_inputs, frames(num_eops, nullptr);
+        for (auto eop : eops)
+            eop_inputs.push_back(eop->GetInputBufferPtr());
+
         chrono::time_point<chrono::steady_clock> tloop0, tloop1;
         tloop0 = chrono::steady_clock::now();
 
@@ -205,17 +233,29 @@ bool RunConfiguration(cmdline_opts_t& opts)
         for (uint32_t frame_idx = 0;
              frame_idx < opts.num_frames + num_eops; frame_idx++)
         {
-            ExecutionObjectPipeline* eop = eops[frame_idx % num_eops];
+            uint32_t k = frame_idx % num_eops;
+            ExecutionObjectPipeline* eop = eops[k];
 
             // Wait for previous frame on the same eop to finish processing
             if (eop->ProcessFrameWait())
             {
                 WriteFrameOutput(*eop, opts);
             }
-
-            // Read a frame and start processing it with current eop
-            if (ReadFrame(*eop, frame_idx, c, opts, cap))
+            input.ReleaseFrame(frames[k]);
+            frames[k] = nullptr;
+
+            // Start processing the next frame read by the input stage with
+            // current eop, using the frame buffer as eop input in place
+            uint32_t idx;
+            if (frame_idx < opts.num_frames &&
+                (frames[k] = input.GetNextFrame(idx)) != nullptr)
+            {
+                eop->SetFrameIndex(idx);
+                eop->SetInputOutputBuffer(ArgInfo(frames[k], in_size),
+                            ArgInfo(eop->GetOutputBufferPtr(),
+                                    eop->GetOutputBufferSizeInBytes()));
                 eop->ProcessFrameStartAsync();
+            }
         }
 
         tloop1 = chrono::steady_clock::now();
@@ -224,6 +264,11 @@ bool RunConfiguration(cmdline_opts_t& opts)
                   << setw(6) << setprecision(4)
                   << (elapsed.count() * 1000) << "ms" << endl;
 
+        // Restore the buffers allocated for each EOP before freeing them
+        for (uint32_t k = 0; k < num_eops; k++)
+            eops[k]->SetInputOutputBuffer(ArgInfo(eop_inputs[k], in_size),
+                            ArgInfo(eops[k]->GetOutputBufferPtr(),
+                                    eops[k]->GetOutputBufferSizeInBytes()));
         FreeMemory(eops);
         for (auto eop : eops)  delete eop;
         delete e_eve;
@@ -250,16 +295,14 @@ Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c)
     return new Executor(dt, ids, c);
 }
 
-bool ReadFrame(ExecutionObjectPipeline &eop,
-               uint32_t frame_idx, const Configuration& c,
-               const cmdline_opts_t& opts, VideoCapture &cap)
+// Called concurrently from the input stage workers
+bool ReadFrame(uint32_t frame_idx, char* frame_buffer, const Configuration& c,
+               const cmdline_opts_t& opts, VideoCapture &cap,
+               OrderedCapture& capture)
 {
     if (frame_idx >= opts.num_frames)
         return false;
 
-    eop.SetFrameIndex(frame_idx);
-
-    char*  frame_buffer = eop.GetInputBufferPtr();
     assert (frame_buffer != nullptr);
 
     Mat image;
@@ -278,6 +321,13 @@ bool ReadFrame(ExecutionObjectPipeline &eop,
     }
     else
     {
+        // Capture and display in frame order, preprocess in parallel
+        unique_lock<mutex> lock(capture.mutex);
+        capture.cv.wait(lock, [&]
+                        { return capture.next_frame_idx == frame_idx; });
+        capture.next_frame_idx++;
+        capture.cv.notify_all();
+
         Mat v_image;
         if (! cap.grab())  return false;
         if (! cap.retrieve(v_image)) return false;
@@ -311,32 +361,9 @@ bool WriteFrameOutput(const ExecutionObjectPipeline &eop,
     // reporting classified object from 1000 categories
     int background_offset = out_size == 1001 ? 1 : 0;
 
-    // sort and get k largest values and corresponding indices
-    typedef pair<unsigned char, int> val_index;
-    auto cmp = [](val_index &left, val_index &right)
-                         { return left.first > right.first; };
-    priority_queue<val_index, vector<val_index>, decltype(cmp)> queue(cmp);
-    // initialize priority queue with smallest value on top
-    for (int i = 0; i < k; i++)
-        queue.push(val_index(out[i], i));
-
-    // for rest output, if larger than current min, pop min, push new val
-    for (int i = k; i < out_size; i++)
-    {
-        if (out[i] > queue.top().first)
-        {
-          queue.pop();
-          queue.push(val_index(out[i], i));
-        }
-    }
-
-    // output top k values in reverse order: largest val first
-    vector<val_index> sorted;
-    while (! queue.empty())
-    {
-      sorted.push_back(queue.top());
-      queue.pop();
-    }
+    // get k largest values and corresponding indices, largest last
+    vector<postproc::ScoreIndex> sorted;
+    postproc::TopK(out, out_size, k, sorted);
 
     unsigned int min_prob_255 = opts.output_prob_threshold * 255;
     for (int i = k - 1; i >= 0; i--)
@@ -0,0 +1,297 @@
+/******************************************************************************
+ * Copyright (c) 2018, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+// Inference daemon. The server process owns the EVE and DSP devices and
+// processes frames for any number of client processes, which submit
+// frames through rings of shared CMEM buffers. By default the example
+// forks client processes and runs the server until they are done; run
+// "inference_server -S" as a daemon and "inference_server -C" from other
+// processes to share the devices between independent applications.
+
+#include <signal.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "executor.h"
+#include "configuration.h"
+#include "frame_source.h"
+#include "inference_server.h"
+
+using namespace std;
+using namespace tidl;
+
+#define DEFAULT_CONFIG "../test/testvecs/config/infer/tidl_config_j11_v2.txt"
+#define DEFAULT_SOCKET "/tmp/tidl_server.sock"
+
+typedef struct server_opts_t_ {
+  std::string config;
+  std::string socket_path;
+  bool        server_only;
+  bool        client_only;
+  uint32_t    num_clients;
+  uint32_t    frames_per_client;
+  uint32_t    num_frames;
+} server_opts_t;
+
+bool ProcessArgs(int argc, char *argv[], server_opts_t& opts);
+bool RunServer(const Configuration& c, const server_opts_t& opts,
+               const std::vector<pid_t>& clients);
+bool RunClient(const Configuration& c, const server_opts_t& opts);
+static void DisplayHelp();
+
+static InferenceServer* server_ptr = nullptr;
+
+static void StopServer(int)
+{
+    if (server_ptr)
+        server_ptr->Stop();
+}
+
+int main(int argc, char *argv[])
+{
+    server_opts_t opts;
+    if (!ProcessArgs(argc, argv, opts))
+    {
+        DisplayHelp();
+        exit(EXIT_SUCCESS);
+    }
+
+    Configuration c;
+    if (!c.ReadFromFile(opts.config))
+        return EXIT_FAILURE;
+
+    if (opts.client_only)
+        return RunClient(c, opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // Fork the clients before the server opens the devices
+    std::vector<pid_t> clients;
+    for (uint32_t i = 0; !opts.server_only && i < opts.num_clients; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+            return RunClient(c, opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+        if (pid > 0)
+            clients.push_back(pid);
+    }
+
+    return RunServer(c, opts, clients) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool RunServer(const Configuration& c, const server_opts_t& opts,
+               const std::vector<pid_t>& clients)
+{
+    bool status = true;
+    try
+    {
+        InferenceServer server(c, opts.socket_path, opts.frames_per_client,
+                               std::max<uint32_t>(opts.num_clients, 8));
+        server_ptr = &server;
+        signal(SIGTERM, StopServer);
+        signal(SIGINT, StopServer);
+
+        // Stop once the forked clients have exited
+        std::thread waiter;
+        if (!clients.empty())
+            waiter = std::thread([&server, &clients, &status]()
+                     {
+                         for (pid_t pid : clients)
+                         {
+                             int wstatus;
+                             if (waitpid(pid, &wstatus, 0) != pid ||
+                                 !WIFEXITED(wstatus) ||
+                                 WEXITSTATUS(wstatus) != EXIT_SUCCESS)
+                                 status = false;
+                         }
+                         server.Stop();
+                     });
+
+        cout << "Listening on " << opts.socket_path << endl;
+        try
+        {
+            server.Run();
+        }
+        catch (...)
+        {
+            for (pid_t pid : clients)
+                kill(pid, SIGTERM);
+            if (waiter.joinable())
+                waiter.join();
+            throw;
+        }
+        if (waiter.joinable())
+            waiter.join();
+        server_ptr = nullptr;
+
+        cout << "Server: " << server.GetNumFramesCompleted()
+             << " frames processed, " << server.GetNumFramesFailed()
+             << " failed" << endl;
+    }
+    catch (tidl::Exception &e)
+    {
+        cerr << e.what() << endl;
+        for (pid_t pid : clients)
+            kill(pid, SIGTERM);
+        status = false;
+    }
+
+    return status;
+}
+
+bool RunClient(const Configuration& c, const server_opts_t& opts)
+{
+    try
+    {
+        // Wait for the server to listen
+        std::unique_ptr<InferenceClient> client;
+        for (int retry = 0; !client; retry++)
+        {
+            try
+            {
+                client.reset(new InferenceClient(opts.socket_path));
+            }
+            catch (tidl::Exception &e)
+            {
+                if (retry == 100)
+                    throw;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+
+        size_t input_size = client->GetInputBufferSizeInBytes();
+        FrameSource source(c.inData, input_size);
+
+        auto t0 = chrono::steady_clock::now();
+
+        // Fill every slot, then resubmit each slot as it is returned
+        uint32_t num_submitted = 0, num_completed = 0, num_failed = 0;
+        for (uint32_t s = 0; s < client->GetNumSlots() &&
+                             num_submitted < opts.num_frames; s++)
+        {
+            source.CopyFrame(num_submitted,
+                        static_cast<char *>(client->GetInputBufferPtr(s)),
+                        input_size);
+            if (!client->Submit(s, num_submitted++))
+                return false;
+        }
+
+        while (num_completed < num_submitted)
+        {
+            uint32_t slot;
+            int      frame_idx;
+            bool     ok;
+            if (!client->Wait(slot, frame_idx, ok))
+                return false;
+
+            num_completed++;
+            if (!ok)  num_failed++;
+
+            if (num_submitted < opts.num_frames)
+            {
+                source.CopyFrame(num_submitted,
+                        static_cast<char *>(client->GetInputBufferPtr(slot)),
+                        input_size);
+                if (!client->Submit(slot, num_submitted++))
+                    return false;
+            }
+        }
+
+        chrono::duration<float> elapsed = chrono::steady_clock::now() - t0;
+        cout << "Client " << getpid() << ": " << num_completed
+             << " frames, " << num_failed << " failed, "
+             << num_completed / elapsed.count() << " fps" << endl;
+        return num_failed == 0;
+    }
+    catch (tidl::Exception &e)
+    {
+        cerr << e.what() << endl;
+        return false;
+    }
+}
+
+bool ProcessArgs(int argc, char *argv[], server_opts_t& opts)
+{
+    opts.config            = DEFAULT_CONFIG;
+    opts.socket_path       = DEFAULT_SOCKET;
+    opts.server_only       = false;
+    opts.client_only       = false;
+    opts.num_clients       = 2;
+    opts.frames_per_client = 2;
+    opts.num_frames        = 100;
+
+    int c;
+    while ((c = getopt(argc, argv, "c:p:SCn:b:f:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'c': opts.config = optarg;
+                      break;
+            case 'p': opts.socket_path = optarg;
+                      break;
+            case 'S': opts.server_only = true;
+                      break;
+            case 'C': opts.client_only = true;
+                      break;
+            case 'n': opts.num_clients = atoi(optarg);
+                      break;
+            case 'b': opts.frames_per_client = std::max(1, atoi(optarg));
+                      break;
+            case 'f': opts.num_frames = atoi(optarg);
+                      break;
+            case 'h':
+            default:  return false;
+        }
+    }
+
+    return !(opts.server_only && opts.client_only);
+}
+
+void DisplayHelp()
+{
+    std::cout <<
+    "Usage: inference_server\n"
+    "  Runs a server owning the EVE and DSP cores, and client processes\n"
+    "  submitting frames to it through shared CMEM buffers.\n"
+    "  Default forks 2 clients processing jacintonet11v2 frames.\n"
+    "Optional arguments:\n"
+    " -c <config>          Valid configs: ../test/testvecs/config/infer/... \n"
+    "                      The topology of the config selects the cores\n"
+    " -p <path>            Socket of the server. Default is "
+                           DEFAULT_SOCKET "\n"
+    " -S                   Run the server until SIGTERM or SIGINT\n"
+    " -C                   Run a client of a server started with -S\n"
+    " -n <number>          Client processes forked. Default is 2\n"
+    " -b <number>          Frames in flight per client. Default is 2\n"
+    " -f <number>          Frames submitted by each client. Default is 100\n"
+    " -h                   Help\n";
+}
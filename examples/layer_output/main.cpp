@@ -35,6 +35,7 @@
 #include "executor.h"
 #include "execution_object.h"
 #include "configuration.h"
+#include "layer_output_writer.h"
 #include "utils.h"
 
 using namespace tidl;
@@ -156,6 +157,8 @@ bool RunConfiguration(const std::string& config_file, int num_devices,
 // 1. ExecutionObject::WriteLayerOutputsToFile
 // 2. ExecutionObject::GetOutputsFromAllLayers
 // 3. ExecutionObject::GetOutputFromLayer
+// 4. ExecutionObject::GetLayerOutputViews
+// 5. LayerOutputWriter
 void ProcessTrace(const ExecutionObject* eo, const Configuration& c)
 {
     if (!c.enableOutputTrace)
@@ -199,4 +202,30 @@ void ProcessTrace(const ExecutionObject* eo, const Configuration& c)
           << std::endl;
 
     delete lo;
+
+    // 4. Get views of the layer outputs in device memory. No host memory is
+    // allocated for the layer data. Re-use views and buffer across frames.
+    LayerOutputViews views;
+    std::vector<char> buffer;
+    eo->GetLayerOutputViews(views);
+
+    for (const LayerOutputView& lv : views)
+    {
+        if (buffer.size() < lv.Size())
+            buffer.resize(lv.Size());
+        lv.CopyTo(buffer.data(), buffer.size());
+
+        std::cout << "Layer index: " << lv.LayerIndex()
+              << " Shape: " << lv.NumberOfChannels() << " x "
+              << lv.Width() << " x " << lv.Height()
+              << " Pitch: " << lv.Buffer().Pitch()
+              << " Size in bytes: " << lv.Size()
+              << std::endl;
+    }
+
+    // 5. Write the outputs from all layers to a single container file from
+    // a background thread. Capture only copies the outputs, file I/O does
+    // not block the caller.
+    LayerOutputWriter writer("trace_dump.tidl");
+    writer.Capture(*eo, eo->GetFrameIndex());
 }
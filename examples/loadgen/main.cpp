@@ -0,0 +1,592 @@
+/******************************************************************************
+ * Copyright (c) 2018, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+// Open-loop load generator. Frames arrive at a configured rate or at the
+// times of a recorded trace, independently of how fast they are processed,
+// like frames from a camera. Arriving frames are queued for the first idle
+// EOP, frames that arrive to a full queue are dropped. Reports latency
+// percentiles, measured from the arrival of a frame, and the drop rate for
+// each offered load.
+
+#include <signal.h>
+#include <getopt.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
+#include "executor.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "configuration.h"
+#include "dispatcher.h"
+#include "frame_source.h"
+#include "imgutil.h"
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+using namespace std;
+using namespace tidl;
+using namespace cv;
+
+typedef chrono::steady_clock Clock;
+
+#define DEFAULT_CONFIG "../test/testvecs/config/infer/tidl_config_j11_v2.txt"
+#define DEFAULT_RATES      "10,20"
+#define DEFAULT_NUM_FRAMES 100
+
+typedef struct loadgen_opts_t_ {
+  std::string           config;
+  uint32_t              num_eves;
+  uint32_t              num_dsps;
+  uint32_t              depth;
+  uint32_t              queue_depth;
+  std::vector<float>    rates;
+  bool                  poisson;
+  std::string           trace_file;
+  uint32_t              num_frames;
+  std::string           input_file;
+  bool                  synthetic;
+  std::string           record_file;
+  std::string           record_source;
+  std::string           output_file;
+} loadgen_opts_t;
+
+// Measured for one offered load
+typedef struct run_result_t_ {
+  std::string load;
+  float       offered_fps;
+  uint32_t    num_arrived;
+  uint32_t    num_completed;
+  uint32_t    num_dropped;
+  float       achieved_fps;
+  float       latency_p50_ms;
+  float       latency_p95_ms;
+  float       latency_p99_ms;
+  float       latency_max_ms;
+} run_result_t;
+
+// Preprocessed input frames, replayed in a loop
+class Frames
+{
+    public:
+        virtual ~Frames() {}
+        virtual const char* Get(uint32_t frame_idx) const = 0;
+};
+
+class FileFrames : public Frames
+{
+    public:
+        FileFrames(const std::string& file, size_t frame_size) :
+            source_m(file, frame_size) {}
+        const char* Get(uint32_t frame_idx) const override
+            { return source_m.GetFrame(frame_idx); }
+    private:
+        FrameSource source_m;
+};
+
+class SyntheticFrames : public Frames
+{
+    public:
+        SyntheticFrames(size_t frame_size, uint32_t num_frames) :
+            frame_size_m(frame_size), data_m(frame_size * num_frames),
+            num_frames_m(num_frames)
+        {
+            std::mt19937 gen(1);
+            for (auto& x : data_m)
+                x = (char) gen();
+        }
+        const char* Get(uint32_t frame_idx) const override
+            { return &data_m[(frame_idx % num_frames_m) * frame_size_m]; }
+    private:
+        size_t            frame_size_m;
+        std::vector<char> data_m;
+        uint32_t          num_frames_m;
+};
+
+// Output buffers of the frames in flight, returned when a frame completes
+class OutputPool
+{
+    public:
+        OutputPool(size_t size, uint32_t count) :
+            buffers_m(count, std::vector<char>(size))
+        {
+            for (auto& b : buffers_m)
+                free_m.push_back(b.data());
+        }
+        char* Acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex_m);
+            if (free_m.empty())  return nullptr;
+            char* b = free_m.back();
+            free_m.pop_back();
+            return b;
+        }
+        void Release(char* b)
+        {
+            std::lock_guard<std::mutex> lock(mutex_m);
+            free_m.push_back(b);
+        }
+    private:
+        std::vector<std::vector<char>> buffers_m;
+        std::vector<char*>             free_m;
+        std::mutex                     mutex_m;
+};
+
+bool ProcessArgs(int argc, char *argv[], loadgen_opts_t& opts);
+bool RecordFrames(const loadgen_opts_t& opts, const Configuration& c);
+bool RunLoad(const std::vector<double>& arrivals_ms, const std::string& load,
+             const Frames& frames, std::vector<ExecutionObjectPipeline*>& eops,
+             const loadgen_opts_t& opts, run_result_t& result);
+std::vector<double> RateArrivals(float fps, uint32_t num_frames, bool poisson);
+bool ReadTrace(const std::string& file, std::vector<double>& arrivals_ms);
+bool WriteResults(const std::vector<run_result_t>& results,
+                  const std::string& file);
+static void DisplayHelp();
+
+
+int main(int argc, char *argv[])
+{
+    // Catch ctrl-c to ensure a clean exit
+    signal(SIGABRT, exit);
+    signal(SIGTERM, exit);
+
+    loadgen_opts_t opts;
+    if (!ProcessArgs(argc, argv, opts))
+    {
+        DisplayHelp();
+        exit(EXIT_SUCCESS);
+    }
+
+    Configuration c;
+    if (!c.ReadFromFile(opts.config))
+        return EXIT_FAILURE;
+
+    if (!opts.record_file.empty())
+        return RecordFrames(opts, c) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // If there are no devices capable of offloading TIDL on the SoC, exit
+    if (Executor::GetNumDevices(DeviceType::EVE) == 0 &&
+        Executor::GetNumDevices(DeviceType::DSP) == 0)
+    {
+        cout << "loadgen requires EVE and/or DSP for execution." << endl;
+        return EXIT_SUCCESS;
+    }
+
+    // Each EOP in flight uses a context of its EO
+    c.numContexts = std::max<int>(c.numContexts,
+                                  std::min<uint32_t>(opts.depth, 4));
+    c.runFullNet  = true;
+
+    size_t frame_size = c.inNumChannels * c.inWidth * c.inHeight;
+    std::vector<run_result_t> results;
+    bool status = true;
+
+    try
+    {
+        std::unique_ptr<Frames> frames;
+        if (opts.synthetic)
+            frames.reset(new SyntheticFrames(frame_size, 16));
+        else
+            frames.reset(new FileFrames(opts.input_file.empty() ?
+                                        c.inData : opts.input_file,
+                                        frame_size));
+
+        DeviceIds ids_eve, ids_dsp;
+        for (uint32_t i = 0; i < opts.num_eves; i++)
+            ids_eve.insert(static_cast<DeviceId>(i));
+        for (uint32_t i = 0; i < opts.num_dsps; i++)
+            ids_dsp.insert(static_cast<DeviceId>(i));
+
+        std::unique_ptr<Executor> e_eve(opts.num_eves == 0 ? nullptr :
+                            new Executor(DeviceType::EVE, ids_eve, c));
+        std::unique_ptr<Executor> e_dsp(opts.num_dsps == 0 ? nullptr :
+                            new Executor(DeviceType::DSP, ids_dsp, c));
+
+        // depth EOPs per core, each with a single EO running the network
+        std::vector<ExecutionObjectPipeline*> eops;
+        for (uint32_t j = 0; j < opts.depth; j++)
+        {
+            for (uint32_t i = 0; i < opts.num_eves; i++)
+                eops.push_back(new ExecutionObjectPipeline({(*e_eve)[i]}));
+            for (uint32_t i = 0; i < opts.num_dsps; i++)
+                eops.push_back(new ExecutionObjectPipeline({(*e_dsp)[i]}));
+        }
+
+        if (!opts.trace_file.empty())
+        {
+            std::vector<double> arrivals_ms;
+            run_result_t result;
+            status = ReadTrace(opts.trace_file, arrivals_ms) &&
+                     RunLoad(arrivals_ms, opts.trace_file, *frames, eops,
+                             opts, result);
+            results.push_back(result);
+        }
+        else
+        {
+            for (float fps : opts.rates)
+            {
+                run_result_t result;
+                std::stringstream load;
+                load << fps << "fps" << (opts.poisson ? " poisson" : "");
+                status &= RunLoad(RateArrivals(fps, opts.num_frames,
+                                               opts.poisson),
+                                  load.str(), *frames, eops, opts, result);
+                results.push_back(result);
+            }
+        }
+
+        for (auto eop : eops)
+            delete eop;
+    }
+    catch (tidl::Exception &e)
+    {
+        cerr << e.what() << endl;
+        status = false;
+    }
+
+    if (status && !opts.output_file.empty())
+        status = WriteResults(results, opts.output_file);
+
+    if (!status)
+    {
+        cout << "loadgen FAILED" << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "loadgen PASSED" << endl;
+    return EXIT_SUCCESS;
+}
+
+// Nearest rank percentile of sorted values
+static float Percentile(const std::vector<float>& sorted, uint32_t p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = (p * sorted.size() + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+// Arrival times of num_frames frames at fps, evenly spaced or with
+// exponentially distributed gaps
+std::vector<double> RateArrivals(float fps, uint32_t num_frames, bool poisson)
+{
+    std::vector<double> arrivals_ms;
+    std::mt19937 gen(1);
+    std::exponential_distribution<double> gap(fps / 1000.0);
+
+    double t = 0;
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        arrivals_ms.push_back(t);
+        t += poisson ? gap(gen) : 1000.0 / fps;
+    }
+    return arrivals_ms;
+}
+
+// Arrival times in milliseconds, one per line, e.g. written by -R
+bool ReadTrace(const std::string& file, std::vector<double>& arrivals_ms)
+{
+    ifstream ifs(file);
+    double t;
+    while (ifs >> t)
+        arrivals_ms.push_back(t);
+
+    if (arrivals_ms.empty())
+    {
+        cerr << "No arrival times in " << file << endl;
+        return false;
+    }
+
+    // Replay relative to the first arrival
+    double t0 = arrivals_ms.front();
+    for (auto& a : arrivals_ms)
+        a -= t0;
+    return true;
+}
+
+// Submit frames at their arrival times, without waiting for earlier frames
+// to complete. Latency is measured from the scheduled arrival, so a
+// submission that falls behind schedule is counted against the run.
+bool RunLoad(const std::vector<double>& arrivals_ms, const std::string& load,
+             const Frames& frames, std::vector<ExecutionObjectPipeline*>& eops,
+             const loadgen_opts_t& opts, run_result_t& result)
+{
+    uint32_t num_frames  = arrivals_ms.size();
+    uint32_t queue_depth = opts.queue_depth != 0 ? opts.queue_depth
+                                                 : eops.size();
+
+    // One output buffer per frame that can be queued or in flight
+    OutputPool outputs(eops[0]->GetOutputBufferSizeInBytes(),
+                       queue_depth + eops.size());
+
+    std::vector<Clock::time_point> arrival(num_frames);
+    std::vector<float> latencies;
+    Clock::time_point  last_completion;
+    uint32_t num_failed = 0;
+    std::mutex mutex;
+
+    Dispatcher d(eops,
+                 [&](const FrameDescriptor& f,
+                     ExecutionObjectInternalInterface& eop, bool status)
+                 {
+                     Clock::time_point now = Clock::now();
+                     chrono::duration<float, std::milli> latency =
+                                        now - arrival[f.GetFrameIndex()];
+                     outputs.Release((char *) f.GetOutput().ptr());
+
+                     std::lock_guard<std::mutex> lock(mutex);
+                     if (!status)
+                         num_failed++;
+                     latencies.push_back(latency.count());
+                     last_completion = now;
+                 },
+                 queue_depth);
+
+    uint32_t num_dropped = 0;
+    size_t   frame_size  = eops[0]->GetInputBufferSizeInBytes();
+    Clock::time_point t0 = Clock::now();
+    for (uint32_t i = 0; i < num_frames; i++)
+    {
+        arrival[i] = t0 + chrono::duration_cast<Clock::duration>(
+                          chrono::duration<double, std::milli>(arrivals_ms[i]));
+        std::this_thread::sleep_until(arrival[i]);
+
+        char* out = outputs.Acquire();
+        FrameDescriptor f(ArgInfo((void *) frames.Get(i), frame_size),
+                          ArgInfo(out, eops[0]->GetOutputBufferSizeInBytes()),
+                          i);
+        if (out == nullptr || !d.TrySubmit(f))
+        {
+            if (out != nullptr)
+                outputs.Release(out);
+            num_dropped++;
+        }
+    }
+    d.Drain();
+
+    std::sort(latencies.begin(), latencies.end());
+    chrono::duration<float> elapsed = last_completion - t0;
+    float duration_s = num_frames > 1 ? (arrivals_ms.back() / 1000) : 0;
+
+    result.load           = load;
+    result.offered_fps    = duration_s > 0 ? (num_frames - 1) / duration_s : 0;
+    result.num_arrived    = num_frames;
+    result.num_completed  = latencies.size();
+    result.num_dropped    = num_dropped;
+    result.achieved_fps   = elapsed.count() > 0 ?
+                            latencies.size() / elapsed.count() : 0;
+    result.latency_p50_ms = Percentile(latencies, 50);
+    result.latency_p95_ms = Percentile(latencies, 95);
+    result.latency_p99_ms = Percentile(latencies, 99);
+    result.latency_max_ms = latencies.empty() ? 0 : latencies.back();
+
+    cout << "Load " << load << ": offered " << result.offered_fps
+         << "fps, achieved " << result.achieved_fps << "fps, dropped "
+         << num_dropped << "/" << num_frames << " ("
+         << setprecision(3) << 100.0f * num_dropped / num_frames << "%)"
+         << ", latency p50/p95/p99/max " << result.latency_p50_ms << "/"
+         << result.latency_p95_ms << "/" << result.latency_p99_ms << "/"
+         << result.latency_max_ms << "ms" << endl;
+
+    return num_failed == 0;
+}
+
+// Capture frames from a camera or video file, preprocess them for the
+// network and write them with their arrival times, to be replayed with
+// -i <file> -t <file>.trace
+bool RecordFrames(const loadgen_opts_t& opts, const Configuration& c)
+{
+    VideoCapture cap;
+    const std::string& src = opts.record_source;
+    if (!src.empty() && std::all_of(src.begin(), src.end(), ::isdigit))
+        cap.open(std::stoi(src));
+    else
+        cap.open(src.empty() ? std::string("/dev/video1") : src);
+    if (!cap.isOpened())
+    {
+        cerr << "Cannot open video input " << src << endl;
+        return false;
+    }
+
+    ofstream frames(opts.record_file, ios::binary);
+    ofstream trace(opts.record_file + ".trace");
+    std::vector<char> buffer(c.inNumChannels * c.inWidth * c.inHeight);
+
+    Clock::time_point t0 = Clock::now();
+    uint32_t num_recorded = 0;
+    Mat image;
+    while (num_recorded < opts.num_frames && cap.read(image))
+    {
+        chrono::duration<double, std::milli> t = Clock::now() - t0;
+        if (!imgutil::PreprocessImage(image, buffer.data(), c))
+            return false;
+
+        frames.write(buffer.data(), buffer.size());
+        trace << fixed << setprecision(3) << t.count() << "\n";
+        num_recorded++;
+    }
+
+    cout << "Recorded " << num_recorded << " frames to " << opts.record_file
+         << ", arrival times to " << opts.record_file << ".trace" << endl;
+    return frames.good() && trace.good() && num_recorded > 0;
+}
+
+bool WriteResults(const std::vector<run_result_t>& results,
+                  const std::string& file)
+{
+    ofstream ofs(file);
+    ofs << "load,offered_fps,arrived,completed,dropped,achieved_fps,"
+           "latency_p50_ms,latency_p95_ms,latency_p99_ms,latency_max_ms\n";
+    for (const auto& r : results)
+        ofs << r.load << "," << r.offered_fps << "," << r.num_arrived << ","
+            << r.num_completed << "," << r.num_dropped << ","
+            << r.achieved_fps << "," << r.latency_p50_ms << ","
+            << r.latency_p95_ms << "," << r.latency_p99_ms << ","
+            << r.latency_max_ms << "\n";
+
+    cout << "Results: " << file << endl;
+    return ofs.good();
+}
+
+static std::vector<std::string> SplitList(const char *arg)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+bool ProcessArgs(int argc, char *argv[], loadgen_opts_t& opts)
+{
+    opts.config      = DEFAULT_CONFIG;
+    opts.num_eves    = 0;
+    opts.num_dsps    = Executor::GetNumDevices(DeviceType::DSP);
+    opts.depth       = 2;
+    opts.queue_depth = 0;
+    opts.poisson     = false;
+    opts.num_frames  = DEFAULT_NUM_FRAMES;
+    opts.synthetic   = false;
+    for (const auto& r : SplitList(DEFAULT_RATES))
+        opts.rates.push_back(std::stof(r));
+
+    int c;
+    while ((c = getopt(argc, argv, "c:d:e:b:q:r:Pt:f:i:sR:C:o:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'c': opts.config = optarg;
+                      break;
+            case 'd': opts.num_dsps = atoi(optarg);
+                      break;
+            case 'e': opts.num_eves = atoi(optarg);
+                      break;
+            case 'b': opts.depth = std::max(1, atoi(optarg));
+                      break;
+            case 'q': opts.queue_depth = atoi(optarg);
+                      break;
+            case 'r': opts.rates.clear();
+                      for (const auto& r : SplitList(optarg))
+                          opts.rates.push_back(std::stof(r));
+                      break;
+            case 'P': opts.poisson = true;
+                      break;
+            case 't': opts.trace_file = optarg;
+                      break;
+            case 'f': opts.num_frames = atoi(optarg);
+                      break;
+            case 'i': opts.input_file = optarg;
+                      break;
+            case 's': opts.synthetic = true;
+                      break;
+            case 'R': opts.record_file = optarg;
+                      break;
+            case 'C': opts.record_source = optarg;
+                      break;
+            case 'o': opts.output_file = optarg;
+                      break;
+            case 'h':
+            default:  return false;
+        }
+    }
+
+    for (float r : opts.rates)
+        if (r <= 0)
+        {
+            cerr << "Rates must be > 0" << endl;
+            return false;
+        }
+
+    if (opts.num_eves + opts.num_dsps == 0 && opts.record_file.empty())
+    {
+        cerr << "Specify at least one EVE or DSP" << endl;
+        return false;
+    }
+
+    return opts.num_frames > 0;
+}
+
+void DisplayHelp()
+{
+    std::cout <<
+    "Usage: loadgen\n"
+    "  Offers frames to EVE and/or DSP cores at a fixed rate or at the\n"
+    "  times of a trace, without waiting for earlier frames, and reports\n"
+    "  latency percentiles and the drop rate for each load.\n"
+    "  Default is jacintonet11v2 on all DSPs at " DEFAULT_RATES " fps.\n"
+    "Optional arguments:\n"
+    " -c <config>          Valid configs: ../test/testvecs/config/infer/... \n"
+    " -d <number>          Number of DSP cores to use\n"
+    " -e <number>          Number of EVE cores to use\n"
+    " -b <number>          EOPs per core. Default is 2\n"
+    " -q <number>          Frames queued for an idle EOP before frames are\n"
+    "                      dropped. Default is the number of EOPs\n"
+    " -r <fps>[,...]       Offered loads, one run per load\n"
+    " -P                   Poisson arrivals at the offered loads\n"
+    " -t <trace>           Replay the arrival times (ms) of a trace file\n"
+    " -f <number>          Frames per load. Default is "
+                           << DEFAULT_NUM_FRAMES << "\n"
+    " -i <file>            Preprocessed input frames. Default is inData\n"
+    " -s                   Synthetic input frames\n"
+    " -R <file>            Record -f frames from -C to <file> and their\n"
+    "                      arrival times to <file>.trace\n"
+    " -C <camera|video>    Source recorded by -R, camera index or video\n"
+    "                      file. Default is /dev/video1\n"
+    " -o <file>            Write results to a CSV file\n"
+    " -h                   Help\n";
+}
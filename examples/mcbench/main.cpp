@@ -26,10 +26,13 @@
  *   THE POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
 #include <signal.h>
+#include <getopt.h>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <functional>
 #include <algorithm>
@@ -45,30 +48,73 @@
 #include "execution_object.h"
 #include "execution_object_pipeline.h"
 #include "configuration.h"
+#include "frame_source.h"
 #include "../common/utils.h"
-#include "../common/video_utils.h"
 
 using namespace std;
 using namespace tidl;
-using namespace cv;
 
 
 #define NUM_VIDEO_FRAMES  100
+#define NUM_WARMUP_FRAMES 10
 #define DEFAULT_CONFIG    "../test/testvecs/config/infer/tidl_config_j11_v2.txt"
 
-bool RunConfiguration(const cmdline_opts_t& opts);
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id);
+// Each list option is swept, mcbench runs every combination of
+// configuration, EVE count, DSP count, layers groups and pipeline depth
+typedef struct bench_opts_t_ {
+  std::vector<std::string> configs;
+  std::vector<std::string> input_files;
+  std::vector<uint32_t>    num_eves;
+  std::vector<uint32_t>    num_dsps;
+  std::vector<uint32_t>    num_layers_groups;
+  std::vector<uint32_t>    depths;
+  uint32_t                 num_frames;
+  uint32_t                 num_warmup_frames;
+  std::string              output_file;
+  std::string              output_format;
+  bool                     verbose;
+} bench_opts_t;
+
+// One combination of the swept parameters
+typedef struct run_params_t_ {
+  std::string config;
+  std::string input_file;
+  uint32_t    num_eves;
+  uint32_t    num_dsps;
+  uint32_t    num_layers_groups;
+  uint32_t    depth;
+} run_params_t;
+
+// Measured over the frames after the warmup frames. Latency and the
+// device/host split are computed from the per-frame FrameTiming.
+typedef struct run_result_t_ {
+  run_params_t params;
+  bool         status;
+  uint32_t     num_frames;
+  float        elapsed_ms;
+  float        fps;
+  float        latency_p50_ms;
+  float        latency_p95_ms;
+  float        latency_p99_ms;
+  float        device_ms;
+  float        host_ms;
+} run_result_t;
+
+bool ProcessBenchArgs(int argc, char *argv[], bench_opts_t& opts);
+bool RunConfiguration(const run_params_t& params, const bench_opts_t& opts,
+                      run_result_t& result);
 bool CreateExecutionObjectPipelines(uint32_t num_eves, uint32_t num_dsps,
                                     Configuration& configuration,
                                     uint32_t num_layers_groups,
+                                    uint32_t buffer_factor,
                                     Executor*& e_eve, Executor*& e_dsp,
                                   std::vector<ExecutionObjectPipeline*>& eops);
 
-void AllocateMemory(const std::vector<ExecutionObjectPipeline*>& eops);
-
 bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
-               const Configuration& c, const cmdline_opts_t& opts, char *input_frames_buffer);
+               uint32_t num_frames, const Configuration& c,
+               const FrameSource& source);
+bool WriteResults(const std::vector<run_result_t>& results,
+                  const bench_opts_t& opts);
 static void DisplayHelp();
 
 
@@ -92,22 +138,54 @@ int main(int argc, char *argv[])
     cout << endl;
 
     // Process arguments
-    cmdline_opts_t opts;
-    opts.config = DEFAULT_CONFIG;
-    opts.num_eves = 0;
-    opts.num_dsps = 2;
-    if (! ProcessArgs(argc, argv, opts))
+    bench_opts_t opts;
+    if (! ProcessBenchArgs(argc, argv, opts))
     {
         DisplayHelp();
         exit(EXIT_SUCCESS);
     }
-    assert((opts.num_dsps + opts.num_eves) != 0);
 
-    if (opts.num_frames == 0)
-        opts.num_frames = NUM_VIDEO_FRAMES;
+    // Enumerate the combinations to run, skip the ones that cannot run on
+    // this SoC
+    std::vector<run_params_t> runs;
+    for (uint32_t c = 0; c < opts.configs.size(); c++)
+    for (uint32_t g : opts.num_layers_groups)
+    for (uint32_t e : opts.num_eves)
+    for (uint32_t d : opts.num_dsps)
+    for (uint32_t b : opts.depths)
+    {
+        if (e > num_eves || d > num_dsps || (e + d) == 0 ||
+            (g == 2 && (e == 0 || d == 0)))
+        {
+            cout << "Skipping -g " << g << " -e " << e << " -d " << d
+                 << " -c " << opts.configs[c] << endl;
+            continue;
+        }
+
+        run_params_t params;
+        params.config            = opts.configs[c];
+        params.input_file        = opts.input_files.empty() ? "" :
+                                   opts.input_files.size() == 1 ?
+                                   opts.input_files[0] : opts.input_files[c];
+        params.num_eves          = e;
+        params.num_dsps          = d;
+        params.num_layers_groups = g;
+        params.depth             = b;
+        runs.push_back(params);
+    }
 
     // Run network
-    bool status = RunConfiguration(opts);
+    bool status = true;
+    std::vector<run_result_t> results;
+    for (const auto& params : runs)
+    {
+        run_result_t result;
+        status &= RunConfiguration(params, opts, result);
+        results.push_back(result);
+    }
+
+    if (!opts.output_file.empty())
+        status &= WriteResults(results, opts);
 
     if (!status)
     {
@@ -119,69 +197,102 @@ int main(int argc, char *argv[])
     return EXIT_SUCCESS;
 }
 
-bool RunConfiguration(const cmdline_opts_t& opts)
+// Nearest rank percentile of sorted values
+static float Percentile(const std::vector<float>& sorted, uint32_t p)
 {
+    if (sorted.empty()) return 0;
+    size_t rank = (p * sorted.size() + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+bool RunConfiguration(const run_params_t& params, const bench_opts_t& opts,
+                      run_result_t& result)
+{
+    result = run_result_t();
+    result.params = params;
+    result.status = false;
+
+    cout << "Run: -g " << params.num_layers_groups << " -e " << params.num_eves
+         << " -d " << params.num_dsps << " -b " << params.depth
+         << " -c " << params.config << endl;
+
     // Read the TI DL configuration file
     Configuration c;
-    if (!c.ReadFromFile(opts.config))
+    if (!c.ReadFromFile(params.config))
         return false;
 
     c.enableApiTrace = opts.verbose;
-    if(opts.num_layers_groups == 1)
+    if(params.num_layers_groups == 1)
        c.runFullNet = true; //Force all layers to be in the same group
 
     std::string inputFile;
-    if (opts.input_file.empty())
+    if (params.input_file.empty())
         inputFile   = c.inData;
     else
-        inputFile = opts.input_file;
+        inputFile = params.input_file;
 
     int frame_size = c.inNumChannels * c.inWidth * c.inHeight;
 
-    c.numFrames = GetBinaryFileSize (inputFile) / frame_size;
-
-    cout << "Input: " << inputFile << " frames:" << c.numFrames << endl;
-
-    // Read input file into memory buffer
-    char *input_frame_buffer = new char[c.numFrames * frame_size]();
-    ifstream ifs(inputFile, ios::binary);
-    ifs.read(input_frame_buffer, c.numFrames * frame_size);
-    if(!ifs.good()) {
-       std::cout << "Invalid File input:" << inputFile << std::endl;
-       return false;
-    }
-
     bool status = true;
     try
     {
+        // Map the input file, frames are read in place from the mapping
+        FrameSource source(inputFile, frame_size);
+        c.numFrames = source.GetNumFrames();
+        cout << "Input: " << inputFile << " frames:" << c.numFrames << endl;
+
         Executor *e_eve = NULL;
         Executor *e_dsp = NULL;
         std::vector<ExecutionObjectPipeline *> eops;
-        if (! CreateExecutionObjectPipelines(opts.num_eves, opts.num_dsps, c,
-                                             opts.num_layers_groups,
+        if (! CreateExecutionObjectPipelines(params.num_eves, params.num_dsps,
+                                             c, params.num_layers_groups,
+                                             params.depth,
                                              e_eve, e_dsp, eops))
+        {
             return false;
+        }
 
         // Allocate input/output memory for each EOP
         AllocateMemory(eops);
 
+        std::vector<float> latencies;
+        float device_ms = 0;
+        float host_ms   = 0;
+
         chrono::time_point<chrono::steady_clock> tloop0, tloop1;
         tloop0 = chrono::steady_clock::now();
 
         // Process frames with available eops in a pipelined manner
         // additional num_eops iterations to flush pipeline (epilogue)
-        uint32_t num_eops = eops.size();
+        // Frames before num_warmup_frames are not measured
+        uint32_t num_eops   = eops.size();
+        uint32_t num_frames = opts.num_warmup_frames + opts.num_frames;
         for (uint32_t frame_idx = 0;
-             frame_idx < opts.num_frames + num_eops; frame_idx++)
+             frame_idx < num_frames + num_eops; frame_idx++)
         {
             ExecutionObjectPipeline* eop = eops[frame_idx % num_eops];
 
+            if (frame_idx == opts.num_warmup_frames)
+                tloop0 = chrono::steady_clock::now();
+
             // Wait for previous frame on the same eop to finish processing
-            if (eop->ProcessFrameWait())
-                ;
+            if (eop->ProcessFrameWait() &&
+                eop->GetFrameIndex() >= (int)opts.num_warmup_frames)
+            {
+                float latency = 0;
+                for (const auto& stage : eop->GetFrameTiming())
+                {
+                    float host = stage.queueWaitMs + stage.copyInMs +
+                                 stage.copyOutMs;
+                    latency   += host + stage.deviceMs;
+                    device_ms += stage.deviceMs;
+                    host_ms   += host;
+                }
+                latencies.push_back(latency);
+            }
 
             // Read a frame and start processing it with current eo
-            if (ReadFrame(*eop, frame_idx, c, opts, input_frame_buffer))
+            if (ReadFrame(*eop, frame_idx, num_frames, c, source))
                 eop->ProcessFrameStartAsync();
         }
 
@@ -192,6 +303,23 @@ bool RunConfiguration(const cmdline_opts_t& opts)
                   << (elapsed.count() * 1000) << "ms" << endl;
         cout << "FPS:" << opts.num_frames / elapsed.count() << endl;
 
+        std::sort(latencies.begin(), latencies.end());
+        result.num_frames     = latencies.size();
+        result.elapsed_ms     = elapsed.count() * 1000;
+        result.fps            = opts.num_frames / elapsed.count();
+        result.latency_p50_ms = Percentile(latencies, 50);
+        result.latency_p95_ms = Percentile(latencies, 95);
+        result.latency_p99_ms = Percentile(latencies, 99);
+        if (!latencies.empty())
+        {
+            result.device_ms  = device_ms / latencies.size();
+            result.host_ms    = host_ms / latencies.size();
+        }
+        cout << "Latency p50/p95/p99: " << result.latency_p50_ms << "/"
+             << result.latency_p95_ms << "/" << result.latency_p99_ms
+             << "ms, device " << result.device_ms << "ms, host "
+             << result.host_ms << "ms" << endl;
+
         FreeMemory(eops);
 
         for (auto eop : eops)
@@ -206,26 +334,14 @@ bool RunConfiguration(const cmdline_opts_t& opts)
         status = false;
     }
 
-    delete [] input_frame_buffer;
+    result.status = status;
     return status;
 }
 
-// Create an Executor with the specified type and number of EOs
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id)
-{
-    if (num == 0) return nullptr;
-
-    DeviceIds ids;
-    for (uint32_t i = 0; i < num; i++)
-        ids.insert(static_cast<DeviceId>(i));
-
-    return new Executor(dt, ids, c, layers_group_id);
-}
-
 bool CreateExecutionObjectPipelines(uint32_t num_eves, uint32_t num_dsps,
                                     Configuration& configuration,
                                     uint32_t num_layers_groups,
+                                    uint32_t buffer_factor,
                                     Executor*& e_eve, Executor*& e_dsp,
                                     std::vector<ExecutionObjectPipeline*>& eops)
 {
@@ -265,7 +381,11 @@ bool CreateExecutionObjectPipelines(uint32_t num_eves, uint32_t num_dsps,
     //    eop1:     [RF]     [eve0...][dsp0]
     //    eop0:                    [RF][eve0...][dsp0]
     //    eop1:                             [RF][eve0...][dsp0]
-    const uint32_t buffer_factor = 2;
+    // Each EOP in flight uses a context of each of its EOs, a deeper
+    // pipeline needs more contexts (up to 4, see Configuration::numContexts)
+    int num_contexts = std::min<int>(buffer_factor, 4);
+    if (configuration.numContexts < num_contexts)
+        configuration.numContexts = num_contexts;
 
     switch(num_layers_groups)
     {
@@ -336,10 +456,10 @@ static void subtractMeanValue(unsigned char *frame_buffer, int channel_size,
 }
 
 bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
-               const Configuration& c, const cmdline_opts_t& opts,
-               char *input_frames_buffer)
+               uint32_t num_frames, const Configuration& c,
+               const FrameSource& source)
 {
-    if (frame_idx >= opts.num_frames)
+    if (frame_idx >= num_frames)
         return false;
 
     eop.SetFrameIndex(frame_idx);
@@ -350,8 +470,7 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
     assert (c.inNumChannels == 3);
 
     int channel_size = c.inWidth * c.inHeight;
-    char *bgr_frames_input = input_frames_buffer + (frame_idx % c.numFrames) *
-                             channel_size * c.inNumChannels;
+    const char *bgr_frames_input = source.GetFrame(frame_idx);
 
     memcpy(frame_buffer,                bgr_frames_input + 0, channel_size);
     if(c.preProcType == 1)
@@ -376,22 +495,239 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
     return true;
 }
 
+// Split a comma separated list
+static std::vector<std::string> SplitList(const char *arg)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static std::vector<uint32_t> SplitNumbers(const char *arg)
+{
+    std::vector<uint32_t> numbers;
+    for (const auto& item : SplitList(arg))
+        numbers.push_back(std::stoul(item));
+    return numbers;
+}
+
+bool ProcessBenchArgs(int argc, char *argv[], bench_opts_t& opts)
+{
+    opts.configs           = { DEFAULT_CONFIG };
+    opts.num_eves          = { 0 };
+    opts.num_dsps          = { 2 };
+    opts.num_layers_groups = { 1 };
+    opts.depths            = { 2 };
+    opts.num_frames        = NUM_VIDEO_FRAMES;
+    opts.num_warmup_frames = NUM_WARMUP_FRAMES;
+    opts.output_format     = "csv";
+    opts.verbose           = false;
+
+    const struct option long_options[] =
+    {
+        {"config",            required_argument, 0, 'c'},
+        {"num_dsps",          required_argument, 0, 'd'},
+        {"num_eves",          required_argument, 0, 'e'},
+        {"num_layers_groups", required_argument, 0, 'g'},
+        {"depth",             required_argument, 0, 'b'},
+        {"num_frames",        required_argument, 0, 'f'},
+        {"num_warmup_frames", required_argument, 0, 'w'},
+        {"input_file",        required_argument, 0, 'i'},
+        {"output_file",       required_argument, 0, 'o'},
+        {"output_format",     required_argument, 0, 'F'},
+        {"help",              no_argument,       0, 'h'},
+        {"verbose",           no_argument,       0, 'v'},
+        {0, 0, 0, 0}
+    };
+
+    int option_index = 0;
+
+    while (true)
+    {
+        int c = getopt_long(argc, argv, "c:d:e:g:b:f:w:i:o:F:hv",
+                            long_options, &option_index);
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'c': opts.configs = SplitList(optarg);
+                      break;
+
+            case 'd': opts.num_dsps = SplitNumbers(optarg);
+                      break;
+
+            case 'e': opts.num_eves = SplitNumbers(optarg);
+                      break;
+
+            case 'g': opts.num_layers_groups = SplitNumbers(optarg);
+                      for (uint32_t g : opts.num_layers_groups)
+                          if (g != 1 && g != 2)
+                          {
+                              cerr << "Layers groups must be 1 or 2" << endl;
+                              return false;
+                          }
+                      break;
+
+            case 'b': opts.depths = SplitNumbers(optarg);
+                      for (uint32_t b : opts.depths)
+                          if (b == 0)
+                          {
+                              cerr << "Pipeline depth must be > 0" << endl;
+                              return false;
+                          }
+                      break;
+
+            case 'f': opts.num_frames = atoi(optarg);
+                      assert (opts.num_frames > 0);
+                      break;
+
+            case 'w': opts.num_warmup_frames = atoi(optarg);
+                      break;
+
+            case 'i': opts.input_files = SplitList(optarg);
+                      break;
+
+            case 'o': opts.output_file = optarg;
+                      break;
+
+            case 'F': opts.output_format = optarg;
+                      if (opts.output_format != "csv" &&
+                          opts.output_format != "json")
+                      {
+                          cerr << "Output format must be csv or json" << endl;
+                          return false;
+                      }
+                      break;
+
+            case 'v': opts.verbose = true;
+                      break;
+
+            case 'h': return false;
+                      break;
+
+            case '?': // Error in getopt_long
+                      exit(EXIT_FAILURE);
+                      break;
+
+            default:
+                      cerr << "Unsupported option: " << c << endl;
+                      return false;
+                      break;
+        }
+    }
+
+    if (opts.configs.empty() || opts.num_eves.empty() ||
+        opts.num_dsps.empty() || opts.num_layers_groups.empty() ||
+        opts.depths.empty())
+    {
+        cerr << "Empty list argument" << endl;
+        return false;
+    }
+
+    if (opts.input_files.size() > 1 &&
+        opts.input_files.size() != opts.configs.size())
+    {
+        cerr << "Specify one input file, or one per configuration" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+static std::string JsonString(const std::string& s)
+{
+    std::string out = "\"";
+    for (char ch : s)
+    {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out + "\"";
+}
+
+bool WriteResults(const std::vector<run_result_t>& results,
+                  const bench_opts_t& opts)
+{
+    ofstream ofs(opts.output_file);
+    if (!ofs.good())
+    {
+        cerr << "Cannot open output file: " << opts.output_file << endl;
+        return false;
+    }
+
+    if (opts.output_format == "json")
+    {
+        ofs << "{\n  \"api_version\": "
+            << JsonString(Executor::GetAPIVersion())
+            << ",\n  \"warmup_frames\": " << opts.num_warmup_frames
+            << ",\n  \"runs\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const run_result_t& r = results[i];
+            ofs << (i ? "," : "") << "\n    {"
+                << "\"config\": " << JsonString(r.params.config)
+                << ", \"num_eves\": " << r.params.num_eves
+                << ", \"num_dsps\": " << r.params.num_dsps
+                << ", \"num_layers_groups\": " << r.params.num_layers_groups
+                << ", \"depth\": " << r.params.depth
+                << ", \"status\": " << (r.status ? "true" : "false")
+                << ", \"frames\": " << r.num_frames
+                << ", \"elapsed_ms\": " << r.elapsed_ms
+                << ", \"fps\": " << r.fps
+                << ", \"latency_p50_ms\": " << r.latency_p50_ms
+                << ", \"latency_p95_ms\": " << r.latency_p95_ms
+                << ", \"latency_p99_ms\": " << r.latency_p99_ms
+                << ", \"device_ms\": " << r.device_ms
+                << ", \"host_ms\": " << r.host_ms << "}";
+        }
+        ofs << "\n  ]\n}\n";
+    }
+    else
+    {
+        ofs << "config,num_eves,num_dsps,num_layers_groups,depth,status,"
+               "frames,elapsed_ms,fps,latency_p50_ms,latency_p95_ms,"
+               "latency_p99_ms,device_ms,host_ms\n";
+        for (const auto& r : results)
+            ofs << r.params.config << "," << r.params.num_eves << ","
+                << r.params.num_dsps << "," << r.params.num_layers_groups
+                << "," << r.params.depth << "," << (r.status ? 1 : 0) << ","
+                << r.num_frames << "," << r.elapsed_ms << "," << r.fps << ","
+                << r.latency_p50_ms << "," << r.latency_p95_ms << ","
+                << r.latency_p99_ms << "," << r.device_ms << ","
+                << r.host_ms << "\n";
+    }
+
+    cout << "Results: " << opts.output_file << endl;
+    return ofs.good();
+}
+
 void DisplayHelp()
 {
     std::cout <<
     "Usage: mcbench\n"
-    "  Runs partitioned network to perform multi-object detection\n"
-    "  and classification. First part of network (layersGroupId 1) runs on\n"
+    "  Benchmarks a network on EVE and/or DSP cores. If a list is\n"
+    "  specified for -c, -e, -d, -g or -b, every combination is run.\n"
+    "  With -g 2, the first part of network (layersGroupId 1) runs on\n"
     "  EVE, second part (layersGroupId 2) runs on DSP.\n"
-    "  Use -c to run a different segmentation network.  Default is jdetnet.\n"
+    "  Default is jdetnet.\n"
     "Optional arguments:\n"
-    " -c <config>          Valid configs: ../test/testvecs/config/infer/... \n"
-    " -d <number>          Number of DSP cores to use\n"
-    " -e <number>          Number of EVE cores to use\n"
-    " -g <1|2>             Number of layer groups\n"
-    " -f <number>          Number of frames to process\n"
-    " -i <image>           Path to the input image file\n"
+    " -c <config>[,...]    Valid configs: ../test/testvecs/config/infer/... \n"
+    " -d <number>[,...]    Number of DSP cores to use\n"
+    " -e <number>[,...]    Number of EVE cores to use\n"
+    " -g <1|2>[,...]       Number of layer groups\n"
+    " -b <number>[,...]    Pipeline depth, EOPs per set of cores\n"
+    " -f <number>          Number of frames to measure\n"
+    " -w <number>          Number of warmup frames, not measured\n"
+    " -i <image>[,...]     Path to the input image file, one for all\n"
+    "                      configs or one per config\n"
+    " -o <file>            Write results to the file\n"
+    " -F <csv|json>        Format of the results file. Default is csv\n"
     " -v                   Verbose output during execution\n"
     " -h                   Help\n";
 }
-
@@ -1,7 +1,6 @@
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_mobileNet1.txt -f 50 -i ../test/testvecs/input/preproc_0_224x224_multi.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_squeeze1_1.txt -f 50 -i ../test/testvecs/input/preproc_1_227x227_multi.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_inceptionNetv1.txt -f 50 -i ../test/testvecs/input/preproc_0_224x224_multi.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_j11_v2.txt -f 50 -i ../test/testvecs/input/preproc_0_224x224_multi.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_j11_v2_dense.txt -f 50 -i ../test/testvecs/input/preproc_0_224x224_multi.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_jseg21_dense.txt -f 50 -i ../test/testvecs/input/000100_1024x512_bgr.y
-./mcbench -g 1 -d 2 -e 0 -c ../test/testvecs/config/infer/tidl_config_jseg21.txt -f 50 -i ../test/testvecs/input/000100_1024x512_bgr.y
+# Sweep all networks on 2 DSPs, write the results to mcbench_5728.csv
+C=../test/testvecs/config/infer
+I=../test/testvecs/input
+./mcbench -g 1 -d 2 -e 0 -f 50 -w 10 -o mcbench_5728.csv \
+    -c $C/tidl_config_mobileNet1.txt,$C/tidl_config_squeeze1_1.txt,$C/tidl_config_inceptionNetv1.txt,$C/tidl_config_j11_v2.txt,$C/tidl_config_j11_v2_dense.txt,$C/tidl_config_jseg21_dense.txt,$C/tidl_config_jseg21.txt \
+    -i $I/preproc_0_224x224_multi.y,$I/preproc_1_227x227_multi.y,$I/preproc_0_224x224_multi.y,$I/preproc_0_224x224_multi.y,$I/preproc_0_224x224_multi.y,$I/000100_1024x512_bgr.y,$I/000100_1024x512_bgr.y
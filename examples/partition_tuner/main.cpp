@@ -0,0 +1,142 @@
+/******************************************************************************
+ * Copyright (c) 2017-2018  Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//
+// Finds the EVE/DSP split (layerIndex2LayerGroupId) of a network that
+// balances the two pipeline stages for the available EVEs and DSPs, and
+// prints it in configuration file syntax.
+// For details, refer http://downloads.ti.com/mctools/esd/docs/tidl-api/
+//
+#include <signal.h>
+#include <unistd.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#include "executor.h"
+#include "configuration.h"
+#include "partition_tuner.h"
+
+using namespace tidl;
+using std::string;
+
+#define DEFAULT_CONFIG "../test/testvecs/config/infer/tidl_config_jdetnet.txt"
+
+static void DisplayHelp();
+
+int main(int argc, char *argv[])
+{
+    // Catch ctrl-c to ensure a clean exit
+    signal(SIGABRT, exit);
+    signal(SIGTERM, exit);
+
+    uint32_t num_eves = Executor::GetNumDevices(DeviceType::EVE);
+    uint32_t num_dsps = Executor::GetNumDevices(DeviceType::DSP);
+    if (num_eves == 0 || num_dsps == 0)
+    {
+        std::cout << "partition_tuner requires EVE and DSP." << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    string   config_file = DEFAULT_CONFIG;
+    string   output_file;
+    uint32_t num_frames  = 8;
+    bool     verbose     = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:e:d:f:o:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': config_file = optarg;                break;
+            case 'e': num_eves    = atoi(optarg);          break;
+            case 'd': num_dsps    = atoi(optarg);          break;
+            case 'f': num_frames  = atoi(optarg);          break;
+            case 'o': output_file = optarg;                break;
+            case 'v': verbose     = true;                  break;
+            case 'h':
+            default:  DisplayHelp(); return EXIT_SUCCESS;
+        }
+    }
+
+    Configuration c;
+    if (!c.ReadFromFile(config_file))
+        return EXIT_FAILURE;
+    c.enableApiTrace = verbose;
+
+    try
+    {
+        PartitionTuner tuner(c, num_eves, num_dsps, num_frames);
+        if (!tuner.Run())
+        {
+            std::cout << "Network does not have layers in both layersGroupIds 1"
+                      << " and 2, nothing to partition" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Partition layer   EVE (ms)   DSP (ms)" << std::endl;
+        for (const auto& item : tuner.GetStageTimes())
+            std::cout << std::setw(15) << item.first
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(11) << item.second.eve_ms
+                      << std::setw(11) << item.second.dsp_ms << std::endl;
+
+        tuner.WriteConfiguration(std::cout);
+        if (!output_file.empty())
+        {
+            std::ofstream ofs(output_file);
+            tuner.WriteConfiguration(ofs);
+        }
+    }
+    catch (tidl::Exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void DisplayHelp()
+{
+    std::cout <<
+    "Usage: partition_tuner\n"
+    "  Profiles the EVE (layersGroupId 1) and DSP (layersGroupId 2) stages\n"
+    "  of a network for candidate splits and prints the\n"
+    "  layerIndex2LayerGroupId entry that balances the stages.\n"
+    "Optional arguments:\n"
+    " -c <config>          Valid configs: ../test/testvecs/config/infer/... \n"
+    " -e <number>          Number of EVE cores the network will run on\n"
+    " -d <number>          Number of DSP cores the network will run on\n"
+    " -f <number>          Number of frames to time per candidate split\n"
+    " -o <file>            Also write the entry to file\n"
+    " -v                   Verbose output during execution\n"
+    " -h                   Help\n";
+}
@@ -28,7 +28,8 @@
 
 """ Layer output
 
-Illustrates writing the outputs of intermediate layers in the network to file.
+Illustrates writing the outputs of intermediate layers in the network to file
+and accessing them as NumPy arrays without copying.
 """
 
 import argparse
@@ -107,6 +108,7 @@ def run(device_type, num_devices, configuration):
 
             if execution_object.process_frame_wait():
                 execution_object.write_layer_outputs_to_file()
+                print_layer_outputs(execution_object)
 
             if read_frame(execution_object, frame_index, configuration, f_in):
                 execution_object.process_frame_start_async()
@@ -118,5 +120,15 @@ def run(device_type, num_devices, configuration):
         print(err)
 
 
+def print_layer_outputs(execution_object):
+    """ Print the shape and range of each layer output, viewed in place"""
+
+    for out in execution_object.get_layer_outputs():
+        print('layer {:3d} output {}: shape {} Q {} min {} max {} mean {:.2f}'
+              .format(out.layer_index, out.output_index, out.array.shape,
+                      out.data_q, out.min_value, out.max_value,
+                      out.array.mean()))
+
+
 if __name__ == '__main__':
     main()
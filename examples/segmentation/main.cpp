@@ -44,6 +44,7 @@
 #include "executor.h"
 #include "execution_object.h"
 #include "configuration.h"
+#include "output_sink.h"
 #include "../common/object_classes.h"
 #include "../common/utils.h"
 #include "../common/video_utils.h"
@@ -69,10 +70,18 @@ Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c);
 bool ReadFrame(ExecutionObjectPipeline& eop,
                uint32_t frame_idx, const Configuration& c,
                const cmdline_opts_t& opts, VideoCapture &cap);
-bool WriteFrameOutput(const ExecutionObjectPipeline &eop,
+bool WriteFrameOutput(const SinkFrame& frame,
                       const Configuration& c, const cmdline_opts_t& opts);
 void DisplayHelp();
 
+// The default input file holds preprocessed planes, images and video
+// frames are read as interleaved BGR
+static bool IsPlanarInput(const cmdline_opts_t& opts)
+{
+    return !opts.is_camera_input && !opts.is_video_input &&
+           opts.input_file.empty();
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -192,6 +201,16 @@ bool RunConfiguration(const cmdline_opts_t& opts)
         // Allocate input and output buffers for each EOP
         AllocateMemory(eops);
 
+        // Blend, encode and write or display frames on a worker thread
+        // ([WF] above runs there), so that slow storage or display does
+        // not hold back processing. A display skips frames the worker
+        // cannot keep up with, files are all written.
+        bool display = opts.is_camera_input || opts.is_video_input;
+        OutputSink sink([&c, &opts](const SinkFrame& frame)
+                        { return WriteFrameOutput(frame, c, opts); },
+                        4, 1, display ? OutputSink::Policy::DROP
+                                      : OutputSink::Policy::BLOCK);
+
         chrono::time_point<chrono::steady_clock> tloop0, tloop1;
         tloop0 = chrono::steady_clock::now();
 
@@ -204,9 +223,7 @@ bool RunConfiguration(const cmdline_opts_t& opts)
 
             // Wait for previous frame on the same eop to finish processing
             if (eop->ProcessFrameWait())
-            {
-                WriteFrameOutput(*eop, c, opts);
-            }
+                sink.Submit(*eop);
 
             // Read a frame and start processing it with current eop
             if (ReadFrame(*eop, frame_idx, c, opts, cap))
@@ -215,10 +232,17 @@ bool RunConfiguration(const cmdline_opts_t& opts)
 
         tloop1 = chrono::steady_clock::now();
         chrono::duration<float> elapsed = tloop1 - tloop0;
-        cout << "Loop total time (including read/write/opencv/print/etc): "
+        cout << "Loop total time (including read/opencv/print/etc): "
                   << setw(6) << setprecision(4)
                   << (elapsed.count() * 1000) << "ms" << endl;
 
+        status = sink.Flush();
+        OutputSink::Stats stats = sink.GetStats();
+        cout << "Output frames written: " << stats.framesCompleted
+             << ", dropped: " << stats.framesDropped
+             << ", loop blocked on output: " << stats.blockedMs << "ms"
+             << endl;
+
         FreeMemory(eops);
         for (auto eop : eops)  delete eop;
         delete e_eve;
@@ -265,6 +289,9 @@ bool ReadFrame(ExecutionObjectPipeline &eop,
             ifstream ifs(DEFAULT_INPUT, ios::binary);
             ifs.seekg((frame_idx % DEFAULT_INPUT_FRAMES) * channel_size * 3);
             ifs.read(frame_buffer, channel_size * 3);
+            eop.SetInputOutputBuffer(ArgInfo(frame_buffer, channel_size * 3),
+                                     ArgInfo(eop.GetOutputBufferPtr(),
+                                       eop.GetOutputBufferSizeInBytes()));
             bool ifs_status = ifs.good();
             ifs.close();
             orig_width  = c.inWidth;
@@ -303,64 +330,47 @@ bool ReadFrame(ExecutionObjectPipeline &eop,
       }
     }
 
-    // scale to network input size 1024 x 512
-    Mat s_image, bgr_frames[3];
+    // scale to network input size 1024 x 512, directly into frame_buffer.
+    // The input is interleaved BGR, the copy to the device splits it into
+    // planes.
+    Mat s_image(c.inHeight, c.inWidth, CV_8UC3, frame_buffer);
     orig_width  = image.cols;
     orig_height = image.rows;
     cv::resize(image, s_image, Size(c.inWidth, c.inHeight),
                0, 0, cv::INTER_AREA);
-    cv::split(s_image, bgr_frames);
-    memcpy(frame_buffer,                bgr_frames[0].ptr(), channel_size);
-    memcpy(frame_buffer+1*channel_size, bgr_frames[1].ptr(), channel_size);
-    memcpy(frame_buffer+2*channel_size, bgr_frames[2].ptr(), channel_size);
+    eop.SetInputOutputBuffer(
+            ArgInfo(frame_buffer, channel_size * 3,
+                    ArgInfo::Layout::INTERLEAVED),
+            ArgInfo(eop.GetOutputBufferPtr(),
+                    eop.GetOutputBufferSizeInBytes()));
     return true;
 }
 
-// Create Overlay mask for pixel-level segmentation
-void CreateMask(uchar *classes, uchar *mb, uchar *mg, uchar* mr,
-                int channel_size)
-{
-    for (int i = 0; i < channel_size; i++)
-    {
-        const ObjectClass& object_class = object_classes->At(classes[i]);
-        mb[i] = object_class.color.blue;
-        mg[i] = object_class.color.green;
-        mr[i] = object_class.color.red;
-    }
-}
-
-// Create frame overlayed with pixel-level segmentation
-bool WriteFrameOutput(const ExecutionObjectPipeline &eop,
+// Create frame overlayed with pixel-level segmentation. Runs on the
+// OutputSink worker, on a copy of the input (buffer 0) and output
+// (buffer 1) of the frame.
+bool WriteFrameOutput(const SinkFrame& sink_frame,
                       const Configuration& c,
                       const cmdline_opts_t& opts)
 {
-    unsigned char *out = (unsigned char *) eop.GetOutputBufferPtr();
+    unsigned char *out = (unsigned char *) sink_frame.GetBuffer(1).ptr();
     int width          = c.inWidth;
     int height         = c.inHeight;
     int channel_size   = width * height;
 
-    Mat mask, frame, blend, r_blend, bgr[3];
-    // Create overlay mask
-    bgr[0] = Mat(height, width, CV_8UC(1));
-    bgr[1] = Mat(height, width, CV_8UC(1));
-    bgr[2] = Mat(height, width, CV_8UC(1));
-    CreateMask(out, bgr[0].ptr(), bgr[1].ptr(), bgr[2].ptr(), channel_size);
-    cv::merge(bgr, 3, mask);
-
-    // Asseembly original frame
-    unsigned char *in = (unsigned char *) eop.GetInputBufferPtr();
-    bgr[0] = Mat(height, width, CV_8UC(1), in);
-    bgr[1] = Mat(height, width, CV_8UC(1), in + channel_size);
-    bgr[2] = Mat(height, width, CV_8UC(1), in + channel_size*2);
-    cv::merge(bgr, 3, frame);
-
-    // Create overlayed frame
-    cv::addWeighted(frame, 0.7, mask, 0.3, 0.0, blend);
-
-    // Resize to output width/height, keep aspect ratio
+    // Output width/height, keep aspect ratio
     uint32_t output_width = opts.output_width;
     if (output_width == 0)  output_width = orig_width;
     uint32_t output_height = (output_width*1.0f) / orig_width * orig_height;
+
+    // Blend the class colors over the frame in one pass, at the largest
+    // downscale that still covers the output width. The default input is
+    // preprocessed and planar, others are interleaved.
+    unsigned char *in = (unsigned char *) sink_frame.GetBuffer(0).ptr();
+    int factor = std::max(1, width / (int) output_width);
+    Mat blend(height / factor, width / factor, CV_8UC3), r_blend;
+    object_classes->CreateOverlay(out, in, IsPlanarInput(opts), width, height,
+                                  0.3f, factor, blend.ptr());
     cv::resize(blend, r_blend, Size(output_width, output_height));
 
     if (opts.is_camera_input || opts.is_video_input)
@@ -370,10 +380,16 @@ bool WriteFrameOutput(const ExecutionObjectPipeline &eop,
     }
     else
     {
-        int frame_index = eop.GetFrameIndex();
+        int frame_index = sink_frame.GetFrameIndex();
         char outfile_name[64];
         if (opts.input_file.empty())
         {
+            Mat frame, bgr[3];
+            bgr[0] = Mat(height, width, CV_8UC(1), in);
+            bgr[1] = Mat(height, width, CV_8UC(1), in + channel_size);
+            bgr[2] = Mat(height, width, CV_8UC(1), in + channel_size*2);
+            cv::merge(bgr, 3, frame);
+
             snprintf(outfile_name, 64, "frame_%d.png", frame_index);
             cv::imwrite(outfile_name, frame);
             printf("Saving frame %d to: %s\n", frame_index, outfile_name);
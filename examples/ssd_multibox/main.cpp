@@ -46,7 +46,13 @@
 #include "execution_object.h"
 #include "execution_object_pipeline.h"
 #include "configuration.h"
+#include "runtime.h"
+#include "imgutil.h"
+#include "latest_frame_source.h"
+#include "frame_source.h"
+#include "output_sink.h"
 #include "../common/object_classes.h"
+#include "postproc.h"
 #include "../common/utils.h"
 #include "../common/video_utils.h"
 
@@ -69,15 +75,21 @@ using namespace cv;
 std::unique_ptr<ObjectClasses> object_classes;
 uint32_t orig_width;
 uint32_t orig_height;
-uint32_t num_frames_file;
+
+// Preprocessed input: frames are read in place from the mapped file
+FrameSource* file_source = nullptr;
+
+// Camera input: frames are captured on a separate thread and the newest
+// frame is processed, so latency does not build up in the V4L2 buffers
+LatestFrameSource* camera_source = nullptr;
+uint32_t camera_width;
+uint32_t camera_height;
 
 bool RunConfiguration(const cmdline_opts_t& opts);
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id);
 bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
                const Configuration& c, const cmdline_opts_t& opts,
-               VideoCapture &cap, ifstream &ifs);
-bool WriteFrameOutput(const ExecutionObjectPipeline& eop,
+               VideoCapture &cap);
+bool WriteFrameOutput(const SinkFrame& frame,
                       const Configuration& c, const cmdline_opts_t& opts,
                       float confidence_value);
 static void DisplayHelp();
@@ -174,6 +186,24 @@ bool RunConfiguration(const cmdline_opts_t& opts)
     VideoCapture cap;
     if (! SetVideoInputOutput(cap, opts, "SSD_Multibox"))  return false;
 
+    // Destroyed before cap, stops the capture thread
+    std::unique_ptr<LatestFrameSource> camera;
+    if (opts.is_camera_input)
+    {
+        camera_width  = cap.get(CAP_PROP_FRAME_WIDTH);
+        camera_height = cap.get(CAP_PROP_FRAME_HEIGHT);
+        camera.reset(new LatestFrameSource(
+            [&cap](char* buffer, size_t size)
+            {
+                // Capture directly into the buffer, fail if the camera
+                // delivers frames of a different size or type
+                Mat frame(camera_height, camera_width, CV_8UC3, buffer);
+                return cap.read(frame) && frame.data == (uchar *) buffer;
+            },
+            camera_width * camera_height * 3));
+        camera_source = camera.get();
+    }
+
     if (opts.is_camera_input || opts.is_video_input)
     {
         std::string TrackbarName("Confidence(%):");
@@ -183,107 +213,66 @@ bool RunConfiguration(const cmdline_opts_t& opts)
     }
 
     // setup preprocessed input
-    ifstream ifs;
+    std::unique_ptr<FrameSource> file;
     if (opts.is_preprocessed_input)
     {
-        ifs.open(opts.input_file, ios::binary | ios::ate);
-        if (! ifs.good())
+        try
+        {
+            file.reset(new FrameSource(opts.input_file,
+                                   c.inWidth * c.inHeight * c.inNumChannels));
+        }
+        catch (tidl::Exception &e)
         {
-            cerr << "Cannot open " << opts.input_file << endl;
+            cerr << e.what() << endl;
             return false;
         }
-        num_frames_file = ((int) ifs.tellg()) /
-                          (c.inWidth * c.inHeight * c.inNumChannels);
+        file_source = file.get();
     }
 
     try
     {
-        // Create Executors with the approriate core type, number of cores
-        // and configuration specified
-        // EVE will run layersGroupId 1 in the network, while
-        // DSP will run layersGroupId 2 in the network
-        Executor* e_eve = CreateExecutor(DeviceType::EVE, opts.num_eves, c, 1);
-        Executor* e_dsp = CreateExecutor(DeviceType::DSP, opts.num_dsps, c, 2);
-        vector<ExecutionObjectPipeline *> eops;
-
-        if (e_eve != nullptr && e_dsp != nullptr)
+        // Create Executors and ExecutionObjectPipelines from the topology
+        // in the configuration file, or from the command line if the file
+        // does not specify one. EVE runs layersGroupId 1, DSP runs
+        // layersGroupId 2, each EOP chains one EVE and one DSP EO.
+        //
+        // topologyDepth duplicates the EOPs. With depth 2, frames of two
+        // EOPs are interleaved, one frame is read (RF) while the other is
+        // processed:
+        //    --------------------- time ------------------->
+        //    eop0: [RF][eve0...][dsp0]
+        //    eop1:     [RF]     [eve0...][dsp0]
+        //    eop0:                    [RF][eve0...][dsp0]
+        //    eop1:                             [RF][eve0...][dsp0]
+        // With only EVEs or only DSPs, the full network runs in one EO per
+        // EOP, and depth 2 double buffers the input/output of each EO.
+        if (c.topologyExecutors.empty())
         {
-            // Construct ExecutionObjectPipeline that utilizes multiple
-            // ExecutionObjects to process a single frame, each ExecutionObject
-            // processes one layerGroup of the network
-            //
-            // Pipeline depth can enable more optimized pipeline execution:
-            // Given one EVE and one DSP as an example, with different
-            //     pipeline_depth, we have different execution behavior:
-            // If pipeline_depth is set to 1,
-            //    we create one EOP: eop0 (eve0, dsp0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [eve0...][dsp0]
-            //    eop0:                [eve0...][dsp0]
-            //    eop0:                               [eve0...][dsp0]
-            //    eop0:                                              [eve0...][dsp0]
-            // If pipeline_depth is set to 2,
-            //    we create two EOPs: eop0 (eve0, dsp0), eop1(eve0, dsp0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [eve0...][dsp0]
-            //    eop1:          [eve0...][dsp0]
-            //    eop0:                   [eve0...][dsp0]
-            //    eop1:                            [eve0...][dsp0]
-            // Additional benefit of setting pipeline_depth to 2 is that
-            //    it can also overlap host ReadFrame() with device processing:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eve0...][dsp0]
-            //    eop1:     [RF]     [eve0...][dsp0]
-            //    eop0:                    [RF][eve0...][dsp0]
-            //    eop1:                             [RF][eve0...][dsp0]
-            uint32_t pipeline_depth = 2;  // 2 EOs in EOP -> depth 2
-            for (uint32_t j = 0; j < pipeline_depth; j++)
-                for (uint32_t i = 0; i < max(opts.num_eves, opts.num_dsps); i++)
-                    eops.push_back(new ExecutionObjectPipeline(
-                      {(*e_eve)[i%opts.num_eves], (*e_dsp)[i%opts.num_dsps]}));
-        }
-        else
-        {
-            // Construct ExecutionObjectPipeline that utilizes a
-            // ExecutionObject to process a single frame, each ExecutionObject
-            // processes the full network
-            //
-            // Use duplicate EOPs to do double buffering on frame input/output
-            //    because each EOP has its own set of input/output buffers,
-            //    so that host ReadFrame() can overlap device processing
-            // Use one EO as an example, with different buffer_factor,
-            //    we have different execution behavior:
-            // If buffer_factor is set to 1 -> single buffering
-            //    we create one EOP: eop0 (eo0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eo0.....][WF]
-            //    eop0:                   [RF][eo0.....][WF]
-            //    eop0:                                     [RF][eo0.....][WF]
-            // If buffer_factor is set to 2 -> double buffering
-            //    we create two EOPs: eop0 (eo0), eop1(eo0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eo0.....][WF]
-            //    eop1:     [RF]      [eo0.....][WF]
-            //    eop0:                   [RF]  [eo0.....][WF]
-            //    eop1:                             [RF]  [eo0.....][WF]
-            uint32_t buffer_factor = 2;  // set to 1 for single buffering
-            for (uint32_t j = 0; j < buffer_factor; j++)
-            {
-                for (uint32_t i = 0; i < opts.num_eves; i++)
-                    eops.push_back(new ExecutionObjectPipeline({(*e_eve)[i]}));
-                for (uint32_t i = 0; i < opts.num_dsps; i++)
-                    eops.push_back(new ExecutionObjectPipeline({(*e_dsp)[i]}));
-            }
+            if (opts.num_eves > 0)
+                c.topologyExecutors.push_back({ "EVE", opts.num_eves, 1 });
+            if (opts.num_dsps > 0)
+                c.topologyExecutors.push_back({ "DSP", opts.num_dsps, 2 });
+            c.topologyPipelined = opts.num_eves > 0 && opts.num_dsps > 0;
         }
+        Runtime runtime(c);
+        const vector<ExecutionObjectPipeline *>& eops =
+                                        runtime.GetExecutionObjectPipelines();
         uint32_t num_eops = eops.size();
 
         // Allocate input/output memory for each EOP
         AllocateMemory(eops);
 
+        // Draw, encode and write or display frames on a worker thread, so
+        // that slow storage or display does not hold back processing. A
+        // display skips frames the worker cannot keep up with, files are
+        // all written. imshow is only called from the worker.
+        bool display = opts.is_camera_input || opts.is_video_input;
+        OutputSink sink([&c, &opts, &prob_slider](const SinkFrame& frame)
+                        { return WriteFrameOutput(frame, c, opts,
+                                                  (float)prob_slider); },
+                        4, 1, display ? OutputSink::Policy::DROP
+                                      : OutputSink::Policy::BLOCK);
+
         chrono::time_point<chrono::steady_clock> tloop0, tloop1;
         tloop0 = chrono::steady_clock::now();
 
@@ -296,23 +285,33 @@ bool RunConfiguration(const cmdline_opts_t& opts)
 
             // Wait for previous frame on the same eop to finish processing
             if (eop->ProcessFrameWait())
-                WriteFrameOutput(*eop, c, opts, (float)prob_slider);
+                sink.Submit(*eop);
 
             // Read a frame and start processing it with current eo
-            if (ReadFrame(*eop, frame_idx, c, opts, cap, ifs))
+            if (ReadFrame(*eop, frame_idx, c, opts, cap))
                 eop->ProcessFrameStartAsync();
         }
 
         tloop1 = chrono::steady_clock::now();
         chrono::duration<float> elapsed = tloop1 - tloop0;
-        cout << "Loop total time (including read/write/opencv/print/etc): "
+        cout << "Loop total time (including read/opencv/print/etc): "
                   << setw(6) << setprecision(4)
                   << (elapsed.count() * 1000) << "ms" << endl;
 
+        status = sink.Flush();
+        OutputSink::Stats stats = sink.GetStats();
+        cout << "Output frames written: " << stats.framesCompleted
+             << ", dropped: " << stats.framesDropped
+             << ", loop blocked on output: " << stats.blockedMs << "ms"
+             << endl;
+        if (camera_source)
+        {
+            cout << "Camera frames dropped: "
+                 << camera_source->GetNumFramesDropped() << " of "
+                 << camera_source->GetNumFramesCaptured() << endl;
+        }
+
         FreeMemory(eops);
-        for (auto eop : eops)  delete eop;
-        delete e_eve;
-        delete e_dsp;
     }
     catch (tidl::Exception &e)
     {
@@ -323,24 +322,9 @@ bool RunConfiguration(const cmdline_opts_t& opts)
     return status;
 }
 
-// Create an Executor with the specified type and number of EOs
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id)
-{
-    if (num == 0) return nullptr;
-
-    DeviceIds ids;
-    for (uint32_t i = 0; i < num; i++)
-        ids.insert(static_cast<DeviceId>(i));
-
-    Executor* e = new Executor(dt, ids, c, layers_group_id);
-    assert(e != nullptr);
-    return e;
-}
-
 bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
                const Configuration& c, const cmdline_opts_t& opts,
-               VideoCapture &cap, ifstream &ifs)
+               VideoCapture &cap)
 {
     if ((uint32_t)frame_idx >= opts.num_frames)
         return false;
@@ -359,9 +343,11 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
         {
             orig_width  = c.inWidth;
             orig_height = c.inHeight;
-            ifs.seekg((frame_idx % num_frames_file) * frame_size);
-            ifs.read(frame_buffer, frame_size);
-            return ifs.good();
+            eop.SetInputOutputBuffer(ArgInfo(frame_buffer, frame_size),
+                                     ArgInfo(eop.GetOutputBufferPtr(),
+                                       eop.GetOutputBufferSizeInBytes()));
+            return file_source->CopyFrame(frame_idx, frame_buffer,
+                                          frame_size);
         }
         else
         {
@@ -377,8 +363,10 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
     {
         if(opts.is_camera_input)
         {
-           if (! cap.grab()) return false;
-           if (! cap.retrieve(image)) return false;
+           image.create(camera_height, camera_width, CV_8UC3);
+           if (! camera_source->GetLatestFrame((char *) image.data,
+                                         image.total() * image.elemSize()))
+               return false;
         }
         else
         { // Video clip
@@ -395,54 +383,17 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
         }
     }
 
-    // Scale to network input size:
-    Mat s_image, bgr_frames[3];
+    // Scale to network input size, directly into frame_buffer. Camera and
+    // video frames preserve the aspect ratio by central cropping, e.g.
+    // for 1920x1080->512x512 the central roi(420, 0, 1080, 1080) is
+    // resized to 512x512.
+    Mat s_image(c.inHeight, c.inWidth, CV_8UC3, frame_buffer);
     orig_width  = image.cols;
     orig_height = image.rows;
-    if (!opts.is_camera_input && !opts.is_video_input)
-    {
-        cv::resize(image, s_image, Size(c.inWidth, c.inHeight),
-                   0, 0, cv::INTER_AREA);
-    }
-    else
-    {
-        // Preserve aspect ratio, by doing central cropping
-        // Choose vertical or horizontal central cropping
-        // based on dimension reduction
-        if(orig_width > orig_height)
-        {
-            float change_width  = (float)c.inWidth / (float)orig_width;
-            float change_height = (float)c.inHeight / (float)orig_height;
-            if(change_width < change_height)
-            {
-                // E.g. for 1920x1080->512x512, we first crop central part
-                // roi(420, 0, 1080, 1080), then resize to (512x512)
-                int offset_x = (int)round(0.5 * ((float)orig_width -
-                  ((float)orig_height * (float)c.inWidth / (float)c.inHeight)));
-                cv::resize(image(Rect(offset_x, 0, orig_width - 2 * offset_x,
-                                      orig_height)), s_image,
-                           Size(c.inWidth, c.inHeight), 0, 0, cv::INTER_AREA);
-            } else {
-                // E.g. for 1920x1080->768x320, we first crop central part
-                // roi(0, 140, 1920, 800), then resize to (768x320)
-                int offset_y = (int)round(0.5 * ((float)orig_height -
-                  ((float)orig_width * (float)c.inHeight / (float)c.inWidth)));
-                cv::resize(image(Rect(0, offset_y, orig_width,
-                                      orig_height - 2 * offset_y)), s_image,
-                           Size(c.inWidth, c.inHeight), 0, 0, cv::INTER_AREA);
-            }
-        } else {
-          // E.g. for 540x960->512x512, we first crop central part
-          //      roi(0, 210, 540, 540), then resize to (512x512)
-          // E.g. for 540x960->768x320, we first crop central part
-          //      roi(0, 367, 540, 225), then resize to (768x320)
-          int offset_y = (int)round(0.5 * ((float)orig_height -
-              ((float)orig_width * (float)c.inHeight / (float)c.inWidth)));
-          cv::resize(image(Rect(0, offset_y, orig_width, orig_height -
-                                2 * offset_y)), s_image,
-                     Size(c.inWidth, c.inHeight), 0, 0, cv::INTER_AREA);
-        }
-    }
+    imgutil::ResizeMode mode = (opts.is_camera_input || opts.is_video_input)
+                               ? imgutil::ResizeMode::CENTER_CROP
+                               : imgutil::ResizeMode::STRETCH;
+    imgutil::ResizeImage(image, s_image, Size(c.inWidth, c.inHeight), mode);
 
     #ifdef DEBUG_FILES
     {
@@ -459,15 +410,19 @@ bool ReadFrame(ExecutionObjectPipeline& eop, uint32_t frame_idx,
     }
     #endif
 
-    cv::split(s_image, bgr_frames);
-    memcpy(frame_buffer,                bgr_frames[0].ptr(), channel_size);
-    memcpy(frame_buffer+1*channel_size, bgr_frames[1].ptr(), channel_size);
-    memcpy(frame_buffer+2*channel_size, bgr_frames[2].ptr(), channel_size);
+    // The input is interleaved BGR, the copy to the device splits it into
+    // planes
+    eop.SetInputOutputBuffer(
+            ArgInfo(frame_buffer, frame_size, ArgInfo::Layout::INTERLEAVED),
+            ArgInfo(eop.GetOutputBufferPtr(),
+                    eop.GetOutputBufferSizeInBytes()));
     return true;
 }
 
-// Create frame with boxes drawn around classified objects
-bool WriteFrameOutput(const ExecutionObjectPipeline& eop,
+// Create frame with boxes drawn around classified objects. Runs on the
+// OutputSink worker, on a copy of the input (buffer 0) and output
+// (buffer 1) of the frame.
+bool WriteFrameOutput(const SinkFrame& sink_frame,
                       const Configuration& c, const cmdline_opts_t& opts,
                       float confidence_value)
 {
@@ -477,13 +432,20 @@ bool WriteFrameOutput(const ExecutionObjectPipeline& eop,
     int channel_size = width * height;
     Mat frame, bgr[3];
 
-    unsigned char *in = (unsigned char *) eop.GetInputBufferPtr();
-    bgr[0] = Mat(height, width, CV_8UC(1), in);
-    bgr[1] = Mat(height, width, CV_8UC(1), in + channel_size);
-    bgr[2] = Mat(height, width, CV_8UC(1), in + channel_size*2);
-    cv::merge(bgr, 3, frame);
+    // Preprocessed input is planar, others are interleaved BGR. The frame
+    // is a copy, boxes are drawn directly into an interleaved input.
+    unsigned char *in = (unsigned char *) sink_frame.GetBuffer(0).ptr();
+    if (opts.is_preprocessed_input)
+    {
+        bgr[0] = Mat(height, width, CV_8UC(1), in);
+        bgr[1] = Mat(height, width, CV_8UC(1), in + channel_size);
+        bgr[2] = Mat(height, width, CV_8UC(1), in + channel_size*2);
+        cv::merge(bgr, 3, frame);
+    }
+    else
+        frame = Mat(height, width, CV_8UC3, in);
 
-    int frame_index = eop.GetFrameIndex();
+    int frame_index = sink_frame.GetFrameIndex();
     char outfile_name[64];
     if (opts.is_preprocessed_input)
     {
@@ -493,27 +455,26 @@ bool WriteFrameOutput(const ExecutionObjectPipeline& eop,
     }
 
     // Draw boxes around classified objects
-    float *out = (float *) eop.GetOutputBufferPtr();
-    int num_floats = eop.GetOutputBufferSizeInBytes() / sizeof(float);
-    for (int i = 0; i < num_floats / 7; i++)
+    float *out = (float *) sink_frame.GetBuffer(1).ptr();
+    int num_floats = sink_frame.GetBuffer(1).size() / sizeof(float);
+    std::vector<postproc::DetectedObject> objects;
+    postproc::DecodeBoxes(out, num_floats, width, height, confidence_value,
+                          objects);
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        int index = (int)    out[i * 7 + 0];
-        if (index < 0)  break;
-
-        float score =        out[i * 7 + 2];
-        if (score * 100 < confidence_value)  continue;
-
-        int   label = (int)  out[i * 7 + 1];
-        int   xmin  = (int) (out[i * 7 + 3] * width);
-        int   ymin  = (int) (out[i * 7 + 4] * height);
-        int   xmax  = (int) (out[i * 7 + 5] * width);
-        int   ymax  = (int) (out[i * 7 + 6] * height);
+        int   label = objects[i].label;
+        float score = objects[i].score;
+        int   xmin  = objects[i].xmin;
+        int   ymin  = objects[i].ymin;
+        int   xmax  = objects[i].xmax;
+        int   ymax  = objects[i].ymax;
 
         const ObjectClass& object_class = object_classes->At(label);
 
         if(opts.verbose) {
             printf("%2d: (%d, %d) -> (%d, %d): %s, score=%f\n",
-               i, xmin, ymin, xmax, ymax, object_class.label.c_str(), score);
+               (int) i, xmin, ymin, xmax, ymax, object_class.label.c_str(),
+               score);
         }
 
         if (xmin < 0)       xmin = 0;
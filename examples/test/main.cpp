@@ -31,7 +31,11 @@
 #include <fstream>
 #include <cassert>
 #include <string>
+#include <sstream>
 #include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
 
 #include "executor.h"
 #include "execution_object.h"
@@ -58,6 +62,10 @@ bool RunNetwork(DeviceType           device_type,
                 std::istream&        input,
                 std::ostream&        output);
 
+bool RunPerfConfigurations(const string& config_file,
+                           int32_t       num_devices,
+                           DeviceType    device_type);
+
 static void ProcessArgs(int argc, char *argv[],
                         string&     config_file,
                         int&        num_devices,
@@ -67,6 +75,15 @@ static void DisplayHelp();
 
 bool verbose = false;
 
+// Performance regression check, enabled by -p <baseline file>
+struct PerfOptions
+{
+    string   baseline_file;
+    int      num_frames = 100;
+    float    tolerance  = 10;     // Percent
+    bool     update     = false;  // Write measurements as the new baseline
+} perf;
+
 int main(int argc, char *argv[])
 {
     // Catch ctrl-c to ensure a clean exit
@@ -89,7 +106,22 @@ int main(int argc, char *argv[])
     ProcessArgs(argc, argv, config_file, num_devices, device_type);
 
     bool status = true;
-    if (!config_file.empty())
+    if (!perf.baseline_file.empty())
+    {
+        if (!config_file.empty())
+            status = RunPerfConfigurations(config_file, num_devices,
+                                           device_type);
+        else
+        {
+            if (num_eve > 0)
+                status = RunPerfConfigurations("", std::min(num_eve, 2u),
+                                               DeviceType::EVE);
+            if (num_dsp > 0)
+                status &= RunPerfConfigurations("", num_dsp,
+                                                DeviceType::DSP);
+        }
+    }
+    else if (!config_file.empty())
         status = RunConfiguration(config_file, num_devices, device_type);
     else
     {
@@ -228,18 +260,21 @@ extern bool CompareFrames(const std::string &F1, const std::string &F2,
                           int numFrames, int width, int height);
 }
 
-bool RunAllConfigurations(int32_t num_devices, DeviceType device_type)
+std::vector<std::string> GetConfigurations(DeviceType device_type)
 {
-    std::vector<std::string> configurations;
-
     if (device_type == DeviceType::EVE)
-        configurations = {"dense_1x1",  "j11_bn", "j11_cifar",
-                          "j11_controlLayers", "j11_prelu", "j11_v2",
-                          "jseg21", "jseg21_tiscapes", "smallRoi", "squeeze1_1"};
+        return {"dense_1x1",  "j11_bn", "j11_cifar",
+                "j11_controlLayers", "j11_prelu", "j11_v2",
+                "jseg21", "jseg21_tiscapes", "smallRoi", "squeeze1_1"};
     else
-        configurations = {"dense_1x1",  "j11_bn", "j11_cifar",
-                          "j11_controlLayers", "j11_v2",
-                          "jseg21", "jseg21_tiscapes", "smallRoi", "squeeze1_1"};
+        return {"dense_1x1",  "j11_bn", "j11_cifar",
+                "j11_controlLayers", "j11_v2",
+                "jseg21", "jseg21_tiscapes", "smallRoi", "squeeze1_1"};
+}
+
+bool RunAllConfigurations(int32_t num_devices, DeviceType device_type)
+{
+    std::vector<std::string> configurations = GetConfigurations(device_type);
 
     int errors = 0;
     for (auto config : configurations)
@@ -284,6 +319,262 @@ bool RunAllConfigurations(int32_t num_devices, DeviceType device_type)
     return true;
 }
 
+// Measured (or baseline) performance of a network, keyed in the baseline
+// file by "<config> <EVE|DSP> <num_devices>"
+struct PerfResult
+{
+    double fps       = 0;
+    double device_ms = 0;
+};
+
+typedef std::map<std::string, PerfResult> PerfBaseline;
+
+static std::string PerfKey(const std::string& config, DeviceType device_type,
+                           int num_devices)
+{
+    std::ostringstream key;
+    key << config << " " << ((device_type == DeviceType::EVE) ? "EVE" : "DSP")
+        << " " << num_devices;
+    return key.str();
+}
+
+// Baseline file: one "<config> <EVE|DSP> <num_devices> <fps> <device_ms>"
+// entry per line, '#' starts a comment
+static bool ReadPerfBaseline(const std::string& file, PerfBaseline& baseline)
+{
+    std::ifstream ifs(file);
+    if (!ifs.good()) return false;
+
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream iss(line);
+        std::string config, device;
+        int num_devices;
+        PerfResult r;
+        if (iss >> config >> device >> num_devices >> r.fps >> r.device_ms)
+        {
+            DeviceType t = (device == "EVE") ? DeviceType::EVE
+                                             : DeviceType::DSP;
+            baseline[PerfKey(config, t, num_devices)] = r;
+        }
+    }
+
+    return true;
+}
+
+static bool WritePerfBaseline(const std::string& file,
+                              const PerfBaseline& baseline)
+{
+    std::ofstream ofs(file);
+    if (!ofs.good()) return false;
+
+    ofs << "# config device num_devices fps device_ms_per_frame\n";
+    ofs.setf(std::ios::fixed);
+    ofs.precision(3);
+    for (const auto& b : baseline)
+        ofs << b.first << " " << b.second.fps << " "
+            << b.second.device_ms << "\n";
+
+    return ofs.good();
+}
+
+// Process perf.num_frames frames with all available execution objects,
+// cycling over the frames in the input file. The first num_eos frames fill
+// the pipeline and are not included in the measurement.
+static bool MeasurePerf(DeviceType device_type, const DeviceIds& ids,
+                        const Configuration& c, std::istream& input,
+                        PerfResult& result)
+{
+    bool status = true;
+
+    try
+    {
+        Executor E(device_type, ids, c);
+
+        std::vector<ExecutionObject *> EOs;
+        for (unsigned int i = 0; i < E.GetNumExecutionObjects(); i++)
+            EOs.push_back(E[i]);
+
+        int num_eos = EOs.size();
+
+        for (auto eo : EOs)
+        {
+            size_t in_size  = eo->GetInputBufferSizeInBytes();
+            size_t out_size = eo->GetOutputBufferSizeInBytes();
+            ArgInfo in  = { ArgInfo(malloc(in_size),  in_size)};
+            ArgInfo out = { ArgInfo(malloc(out_size), out_size)};
+            eo->SetInputOutputBuffer(in, out);
+        }
+
+        // Read the input frames once so that file I/O is not measured
+        size_t in_size = EOs[0]->GetInputBufferSizeInBytes();
+        std::vector<char> frames;
+        int num_input_frames = 0;
+        for (; num_input_frames < c.numFrames; num_input_frames++)
+        {
+            frames.resize((num_input_frames + 1) * in_size);
+            input.read(&frames[num_input_frames * in_size], in_size);
+            if (input.gcount() != (std::streamsize) in_size) break;
+        }
+        if (num_input_frames == 0)
+            throw Exception("No input frames in " + c.inData,
+                            __FILE__, __FUNCTION__, __LINE__);
+
+        int    warmup    = num_eos;
+        int    measured  = 0;
+        double device_ms = 0;
+        std::chrono::steady_clock::time_point start;
+
+        int total = perf.num_frames + warmup;
+        for (int frame_idx = 0; frame_idx < total + num_eos; frame_idx++)
+        {
+            ExecutionObject* eo = EOs[frame_idx % num_eos];
+
+            if (eo->ProcessFrameWait() && eo->GetFrameIndex() >= warmup)
+            {
+                device_ms += eo->GetProcessTimeInMilliSeconds();
+                measured++;
+            }
+
+            if (frame_idx == warmup)
+                start = std::chrono::steady_clock::now();
+
+            if (frame_idx < total)
+            {
+                memcpy(eo->GetInputBufferPtr(),
+                       &frames[(frame_idx % num_input_frames) * in_size],
+                       in_size);
+                eo->SetFrameIndex(frame_idx);
+                eo->ProcessFrameStartAsync();
+            }
+        }
+
+        std::chrono::duration<double> elapsed =
+                                     std::chrono::steady_clock::now() - start;
+
+        result.fps       = measured / elapsed.count();
+        result.device_ms = (measured > 0) ? device_ms / measured : 0;
+
+        for (auto eo : EOs)
+        {
+            free(eo->GetInputBufferPtr());
+            free(eo->GetOutputBufferPtr());
+        }
+    }
+    catch (tidl::Exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        status = false;
+    }
+
+    return status;
+}
+
+// Run each network (or only config_file if specified) for perf.num_frames
+// frames and compare frames per second and device time per frame against
+// the baseline. With perf.update, the measurements replace the baseline.
+bool RunPerfConfigurations(const string& config_file, int32_t num_devices,
+                           DeviceType device_type)
+{
+    std::vector<std::pair<std::string, std::string>> configurations;
+    if (!config_file.empty())
+    {
+        std::string name = config_file.substr(config_file.rfind('/') + 1);
+        name = name.substr(0, name.rfind('.'));
+        const std::string prefix = "tidl_config_";
+        if (name.compare(0, prefix.size(), prefix) == 0)
+            name = name.substr(prefix.size());
+        configurations.push_back({name, config_file});
+    }
+    else
+    {
+        for (auto config : GetConfigurations(device_type))
+        {
+            if (config.compare("smallRoi") == 0)  continue;
+            configurations.push_back({config,
+                    "testvecs/config/infer/tidl_config_" + config + ".txt"});
+        }
+    }
+
+    PerfBaseline baseline;
+    if (!ReadPerfBaseline(perf.baseline_file, baseline) && !perf.update)
+    {
+        std::cerr << "Unable to read performance baseline "
+                  << perf.baseline_file << std::endl;
+        return false;
+    }
+
+    DeviceIds ids;
+    for (int i = 0; i < num_devices; i++)
+        ids.insert(static_cast<DeviceId>(i));
+
+    const double tol = perf.tolerance / 100.0;
+    int errors = 0;
+    for (const auto& config : configurations)
+    {
+        std::string key = PerfKey(config.first, device_type, num_devices);
+
+        Configuration c;
+        if (!c.ReadFromFile(config.second)) { errors++; continue; }
+        if (verbose)                         c.enableApiTrace = true;
+
+        std::ifstream input_data_file(c.inData, std::ios::binary);
+        PerfResult r;
+        if (!input_data_file.good() ||
+            !MeasurePerf(device_type, ids, c, input_data_file, r))
+        {
+            std::cout << key << " : FAILED (unable to run)" << std::endl;
+            errors++;
+            continue;
+        }
+
+        std::cout.setf(std::ios::fixed);
+        std::cout.precision(2);
+        std::cout << key << " : " << r.fps << " fps, "
+                  << r.device_ms << " ms/frame";
+
+        if (perf.update)
+        {
+            baseline[key] = r;
+            std::cout << std::endl;
+            continue;
+        }
+
+        auto b = baseline.find(key);
+        if (b == baseline.end())
+        {
+            std::cout << " : no baseline, skipped" << std::endl;
+            continue;
+        }
+
+        const PerfResult& base = b->second;
+        bool fps_ok = r.fps >= base.fps * (1 - tol);
+        bool dev_ok = base.device_ms <= 0 ||
+                      r.device_ms <= base.device_ms * (1 + tol);
+
+        std::cout << " (baseline " << base.fps << " fps, "
+                  << base.device_ms << " ms/frame)";
+        if (fps_ok && dev_ok) std::cout << " : PASSED" << std::endl;
+        else
+        {
+            std::cout << " : FAILED, exceeds " << perf.tolerance
+                      << "% tolerance" << std::endl;
+            errors++;
+        }
+    }
+
+    if (perf.update && !WritePerfBaseline(perf.baseline_file, baseline))
+    {
+        std::cerr << "Unable to write performance baseline "
+                  << perf.baseline_file << std::endl;
+        errors++;
+    }
+
+    return errors == 0;
+}
+
 void ProcessArgs(int argc, char *argv[], std::string& config_file,
                  int& num_devices, DeviceType& device_type)
 {
@@ -294,6 +585,10 @@ void ProcessArgs(int argc, char *argv[], std::string& config_file,
         {"device_type", required_argument, 0, 't'},
         {"help",        no_argument,       0, 'h'},
         {"verbose",     no_argument,       0, 'v'},
+        {"perf",        required_argument, 0, 'p'},
+        {"num_frames",  required_argument, 0, 'f'},
+        {"tolerance",   required_argument, 0, 'T'},
+        {"update",      no_argument,       0, 'u'},
         {0, 0, 0, 0}
     };
 
@@ -301,7 +596,8 @@ void ProcessArgs(int argc, char *argv[], std::string& config_file,
 
     while (true)
     {
-        int c = getopt_long(argc, argv, "c:n:t:hv", long_options, &option_index);
+        int c = getopt_long(argc, argv, "c:n:t:hvp:f:T:u", long_options,
+                            &option_index);
 
         if (c == -1)
             break;
@@ -330,6 +626,20 @@ void ProcessArgs(int argc, char *argv[], std::string& config_file,
             case 'v': verbose = true;
                       break;
 
+            case 'p': perf.baseline_file = optarg;
+                      break;
+
+            case 'f': perf.num_frames = atoi(optarg);
+                      assert (perf.num_frames > 0);
+                      break;
+
+            case 'T': perf.tolerance = atof(optarg);
+                      assert (perf.tolerance >= 0);
+                      break;
+
+            case 'u': perf.update = true;
+                      break;
+
             case 'h': DisplayHelp();
                       exit(EXIT_SUCCESS);
                       break;
@@ -355,5 +665,16 @@ void DisplayHelp()
                  " -n <number of cores> Number of cores to use (1 - 4)\n"
                  " -t <d|e>             Type of core. d -> DSP, e -> EVE\n"
                  " -v                   Verbose output during execution\n"
+                 " -p <baseline file>   Performance mode: run each network"
+                 " and compare\n"
+                 "                      fps and device ms/frame against the"
+                 " baseline\n"
+                 " -f <frames>          Frames per network in performance"
+                 " mode (100)\n"
+                 " -T <percent>         Allowed regression in performance"
+                 " mode (10)\n"
+                 " -u                   Write measurements to the baseline"
+                 " file instead\n"
+                 "                      of comparing\n"
                  " -h                   Help\n";
 }
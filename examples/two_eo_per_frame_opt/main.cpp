@@ -121,39 +121,41 @@ bool Run(int num_eve, int num_dsp, const char* ref_output)
         unique_ptr<Executor> dsp(CreateExecutor(DeviceType::DSP,
                                                 num_dsp, c, DSP_LG));
 
-        // On AM5749, create a total of 4 pipelines (EOPs):
+        // On AM5749, create a total of 2 pipelines (EOPs), each with 2
+        // frames in flight (double buffering):
         // EOPs[0] : { EVE1, DSP1 }
-        // EOPs[1] : { EVE1, DSP1 } for double buffering
-        // EOPs[2] : { EVE2, DSP2 }
-        // EOPs[3] : { EVE2, DSP2 } for double buffering
+        // EOPs[1] : { EVE2, DSP2 }
 
         const uint32_t pipeline_depth = 2;  // 2 EOs in EOP => depth 2
         std::vector<EOP *> EOPs;
         uint32_t num_pipe = std::max(num_eve, num_dsp);
         for (uint32_t i = 0; i < num_pipe; i++)
-            for (uint32_t j = 0; j < pipeline_depth; j++)
-                EOPs.push_back(new EOP( { (*eve)[i % num_eve],
-                                          (*dsp)[i % num_dsp] } ));
+            EOPs.push_back(new EOP( { (*eve)[i % num_eve],
+                                      (*dsp)[i % num_dsp] },
+                                    pipeline_depth ));
 
         AllocateMemory(EOPs);
 
         // Process frames with EOs in a pipelined manner
-        // additional num_eos iterations to flush the pipeline (epilogue)
-        int num_eops = EOPs.size();
-        for (int frame_idx = 0; frame_idx < c.numFrames + num_eops; frame_idx++)
+        // additional num_slots iterations to flush the pipeline (epilogue)
+        int num_eops  = EOPs.size();
+        int num_slots = num_eops * pipeline_depth;
+        for (int frame_idx = 0; frame_idx < c.numFrames + num_slots;
+             frame_idx++)
         {
             EOP* eop = EOPs[frame_idx % num_eops];
 
-            // Wait for previous frame on the same EOP to finish processing
+            // Wait for previous frame in the current slot of the EOP to
+            // finish processing
             if (eop->ProcessFrameWait())
             {
                 // The reference output is valid only for the first frame
-                // processed on each EOP
-                if (frame_idx < num_eops && !CheckFrame(eop, ref_output))
+                // processed in each slot
+                if (frame_idx < num_slots && !CheckFrame(eop, ref_output))
                     status = false;
             }
 
-            // Read a frame and start processing it with current eo
+            // Read a frame and start processing it in the current slot
             if (ReadFrame(eop, frame_idx, c, input))
                 eop->ProcessFrameStartAsync();
         }
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file buffer_pool.h
+
+#pragma once
+
+#include <memory>
+#include <cstddef>
+
+namespace tidl {
+
+class ExecutionObject;
+class ExecutionObjectPipeline;
+
+/*! @class BufferPool
+ *  @brief Pool of DDR (CMEM) buffers for ExecutionObject and
+ *         ExecutionObjectPipeline input and output buffers.
+ *
+ *  Buffers are allocated with __malloc_ddr, so the device accesses them in
+ *  place (CL_MEM_USE_HOST_PTR) rather than through a copy. Requests are
+ *  rounded up to a size class (a multiple of SIZE_CLASS_GRANULE bytes) and
+ *  released buffers are recycled for later requests of the same class.
+ *  Memory is returned to CMEM by Trim() or when the pool is destroyed. E.g.
+ *  @code
+ *    BufferPool pool;
+ *    for (auto eop : eops)  pool.AllocateBuffers(eop);
+ *    ...
+ *    for (auto eop : eops)  pool.ReleaseBuffers(eop);
+ *  @endcode
+ *  The pool must outlive the use of its buffers. All methods are thread
+ *  safe.
+ */
+class BufferPool
+{
+    public:
+        //! Buffer sizes are rounded up to a multiple of this granule
+        static const size_t SIZE_CLASS_GRANULE = 4096;
+
+        BufferPool();
+
+        //! Frees all buffers, idle or not
+        ~BufferPool();
+
+        //! @return Size class used for a request of size bytes
+        static size_t GetSizeClass(size_t size);
+
+        //! @brief Get a buffer of at least size bytes. Re-uses an idle
+        //! buffer of the same size class if available, otherwise allocates
+        //! a new one.
+        //! @return Pointer to the buffer, throws if out of memory
+        char*  Acquire(size_t size);
+
+        //! Return a buffer obtained via Acquire to the pool. Throws if the
+        //! buffer was not obtained from this pool.
+        void   Release(void* buffer);
+
+        //! Acquire input and output buffers for eo and set them via
+        //! ExecutionObject::SetInputOutputBuffer
+        void   AllocateBuffers(ExecutionObject* eo);
+
+        //! Acquire input and output buffers for each frame slot of eop and
+        //! set them via ExecutionObjectPipeline::SetInputOutputBuffer
+        void   AllocateBuffers(ExecutionObjectPipeline* eop);
+
+        //! Release the input and output buffers set by AllocateBuffers
+        void   ReleaseBuffers(ExecutionObject* eo);
+
+        //! Release the input and output buffers of each frame slot set by
+        //! AllocateBuffers
+        void   ReleaseBuffers(ExecutionObjectPipeline* eop);
+
+        //! Free idle buffers, returning their memory to CMEM
+        void   Trim();
+
+        //! @return Number of buffers allocated, idle or in use
+        size_t GetNumBuffers() const;
+
+        //! @return Number of idle buffers
+        size_t GetNumIdleBuffers() const;
+
+        //! @return Number of bytes allocated, idle or in use
+        size_t GetBytesAllocated() const;
+
+        BufferPool(const BufferPool&)            = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
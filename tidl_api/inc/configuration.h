@@ -32,7 +32,10 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
 #include <iostream>
+#include <cstdint>
 
 namespace tidl {
 
@@ -74,6 +77,22 @@ class Configuration
     //! 4 -> JdetNet
     int     preProcType;
 
+    //! Values subtracted from each channel of the input frame by
+    //! imgutil::PreprocessImage, in network channel order. Empty uses the
+    //! mean of preProcType (104, 117, 123 for 1, 128 for 2, none for the
+    //! others). If preProcMean or preProcScale is set, the result is
+    //! rounded and saturated to int8.
+    std::vector<float> preProcMean;
+
+    //! Factors the mean-subtracted channels are multiplied by, in network
+    //! channel order. Empty does not scale.
+    std::vector<float> preProcScale;
+
+    //! Fraction of the frame width and height kept by a center crop before
+    //! the frame is resized to inWidth x inHeight. 0 uses the crop and
+    //! resize of preProcType (a crop factor of 0.875 for 2).
+    float   preProcCropFactor;
+
     //! Force to run all layers, regardless of layersGroupId partitioning
     bool    runFullNet;
 
@@ -88,6 +107,13 @@ class Configuration
     //! There is one parameter heap for each instance of ``Executor`` .
     size_t PARAM_HEAP_SIZE;
 
+    //! @brief Number of contexts (frames in flight) per ExecutionObject.
+    //! Each context has its own input and output buffers on the device,
+    //! allowing the host to write the next frame while the device processes
+    //! the current one. Valid values are 1 to 4, default is 2. More contexts
+    //! require a larger NETWORK_HEAP_SIZE.
+    int    numContexts;
+
     //! @brief Path to the input image file.
     //! This field is not used by the TIDL API itself. It can be used by
     //! applications to load an input image into a buffer. Can be empty if
@@ -102,6 +128,15 @@ class Configuration
     //! Refer examples/test/main.cpp for usage.
     std::string outData;
 
+    //! @brief Path to a parameter heap snapshot file. Optional.
+    //! If set, the parameter heap populated by the device during Executor
+    //! setup is saved to this file. Subsequent Executors created with the
+    //! same network, parameters, heap size and API version restore the heap
+    //! from the file and skip the setup step on the device, reducing startup
+    //! time. The snapshot is only used if the parameter heap is allocated at
+    //! the same address, otherwise setup runs and the file is rewritten.
+    std::string paramHeapCacheFile;
+
     //! Path to the TIDL network binary file.
     //! Used by the API, must be specified.
     std::string netBinFile;
@@ -118,14 +153,54 @@ class Configuration
     //! Enable tracing of output buffers associated with each layer
     bool enableOutputTrace;
 
-    //! Debug - Generates a trace of host and device function calls
+    //! @brief Indices of layers to trace when enableOutputTrace is set.
+    //! If empty, every layer is traced and the device allocates a separate
+    //! output buffer for each layer (no external memory optimization).
+    //! If not empty, only the specified layers are traced and the network
+    //! retains its external memory optimization. With the optimization in
+    //! effect, a later layer can re-use the output buffer of a traced layer.
+    //! Outputs of traced layers that were overwritten in this manner are
+    //! not reported.
+    std::set<int> outputTraceLayers;
+
+    //! Debug - Generates a trace of host and device function calls. Host
+    //! messages are recorded into a ring buffer and written to stdout by a
+    //! background thread. Building the API with API_TRACE=0 removes them.
     bool enableApiTrace;
 
     //! Debug - Shows total size of PARAM and NETWORK heaps. Also shows bytes
     //! available after all allocations. Can be used to adjust the heap
-    //! size.
+    //! size. The device prints the statistics to stdout, which the
+    //! Executor redirects while it initializes to read them: Executor
+    //! initializations that report heap statistics are serialized, and
+    //! output of other threads is held back until the redirection ends.
     bool showHeapStats;
 
+    //! @brief Debug - Report the work of the layers group with the timing
+    //! of each frame, see StageTiming::macs. The device reports the cycles
+    //! of a process call but not its cause. Comparing the MACs and bytes
+    //! per cycle of layer groups, or across TIDL_EXTMEM_ALLOC_OPT_*
+    //! settings, shows whether a group is limited by compute or by memory.
+    bool enableWorkCounters;
+
+    //! @brief Size PARAM_HEAP_SIZE and NETWORK_HEAP_SIZE automatically.
+    //! The Executor first initializes the network on one of its devices
+    //! with the configured heap sizes and measures the bytes requested
+    //! from each heap. It then allocates the heaps at the measured sizes.
+    //! The configured sizes must be large enough for the measurement pass,
+    //! which reads the heap statistics as with showHeapStats.
+    //! @see Executor::GetHeapUsage
+    bool autoSizeHeaps;
+
+    //! @brief Read only the parameters of layers in the Executor's layer
+    //! group from paramsBinFile, and release the buffer they are read into
+    //! after setup. When a network is split across EVE and DSP Executors,
+    //! each Executor then reads only its share of the weights. Combine with
+    //! autoSizeHeaps to size the PARAM heap to match. If the parameter
+    //! sizes computed from the network do not add up to the size of
+    //! paramsBinFile, the entire file is read.
+    bool loadGroupParamsOnly;
+
     //! Weight in percentage applied to previously processed input frame during
     //! application startup (first 10 frames of input).
     //!
@@ -145,6 +220,58 @@ class Configuration
     //! Margin added to the average in percentage.
     int quantMargin;
 
+    //! @brief An Executor created by Runtime, see topologyExecutors
+    struct TopologyExecutor
+    {
+        //! Core type of the Executor, "EVE" or "DSP"
+        std::string coreType;
+
+        //! Number of cores used by the Executor, 0 uses every core of the
+        //! type available on the device
+        uint32_t    numCores;
+
+        //! Layers group run by the Executor
+        int         layersGroupId;
+    };
+
+    //! @brief Executors created by Runtime, in pipeline order. In a
+    //! configuration file:
+    //! topologyExecutors = { {EVE, 0, 1}, {DSP, 2, 2} }
+    //! Empty runs the full network on every EVE and DSP, each
+    //! ExecutionObject in a pipeline of its own.
+    std::vector<TopologyExecutor> topologyExecutors;
+
+    //! @brief If true, each ExecutionObjectPipeline created by Runtime
+    //! chains one ExecutionObject of each of topologyExecutors, in order.
+    //! If false, each ExecutionObject is a pipeline of its own. Default is
+    //! true.
+    bool topologyPipelined;
+
+    //! @brief Number of ExecutionObjectPipelines created by Runtime for
+    //! each set of ExecutionObjects. 2 overlaps reading the next frame with
+    //! processing the current one. Default is 2.
+    int topologyDepth;
+
+    //! @brief Number of worker threads started by Runtime for the host
+    //! side work of frames completing on the devices, see
+    //! HostThreads::StartWorkers. 0 runs the work on the OpenCL runtime
+    //! threads. Default is 0.
+    uint32_t hostWorkers;
+
+    //! @brief Cores the host workers run on, e.g. hostWorkerCpus = { 1 }.
+    //! Empty for any core.
+    std::set<int> hostWorkerCpus;
+
+    //! @brief SCHED_FIFO priority of the host workers (1-99), 0 keeps the
+    //! default policy
+    int hostWorkerPriority;
+
+    //! @brief Time in microseconds a wait for a frame polls the device
+    //! before blocking. For small networks, the wake-up of a blocking
+    //! wait is a large part of the frame time, polling trades a host core
+    //! for that latency. Default is 0, block immediately.
+    uint32_t waitSpinUs;
+
     //! Default constructor.
     Configuration();
 
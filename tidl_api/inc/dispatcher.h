@@ -0,0 +1,158 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file dispatcher.h
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+
+namespace tidl {
+
+/*! @class Dispatcher
+    @brief Schedules frames onto the first idle ExecutionObject or
+    ExecutionObjectPipeline.
+
+    Frames are submitted to a bounded queue and assigned to whichever
+    ExecutionObject or ExecutionObjectPipeline becomes idle first, rather
+    than in round-robin order. A frame that takes longer to process only
+    delays the ExecutionObject/Pipeline processing it. The completion
+    callback is invoked once a frame has been processed and its output
+    buffer is ready. E.g.
+    @code
+      Dispatcher d(eops, [](const FrameDescriptor& f,
+                            ExecutionObjectInternalInterface& eop,
+                            bool status)
+                         { WriteFrameOutput(f.GetOutput()); });
+      for (int i = 0; i < num_frames; i++)
+          d.Submit(FrameDescriptor(ReadFrame(i), GetOutputBuffer(i), i));
+      d.Drain();
+    @endcode
+
+    With Policy::SERVICE_TIME, frames are assigned by the measured service
+    time of each ExecutionObject/Pipeline instead, e.g. when mixing EVE and
+    DSP pipelines that process the network at different speeds. An idle
+    ExecutionObject/Pipeline leaves a frame to a faster one that would
+    complete it earlier, if there are not enough queued frames for all.
+
+    The Dispatcher does not own the ExecutionObjects or
+    ExecutionObjectPipelines. They must not be used by the application
+    while the Dispatcher exists.
+*/
+class Dispatcher
+{
+    public:
+        //! @brief Called on completion of a frame, from a Dispatcher thread.
+        //! Calls for different frames can be concurrent.
+        //! @param frame Frame as submitted
+        //! @param eo ExecutionObject or ExecutionObjectPipeline used to
+        //!        process the frame. Can be used to query per-frame data,
+        //!        e.g. trace outputs, until the callback returns.
+        //! @param status false if processing the frame failed
+        typedef std::function<void(const FrameDescriptor& frame,
+                                   ExecutionObjectInternalInterface& eo,
+                                   bool status)> CompletionCallback;
+
+        //! Assignment of queued frames to ExecutionObjects/Pipelines
+        enum class Policy
+        {
+            //! The first idle ExecutionObject/Pipeline takes the next frame
+            FIRST_IDLE,
+
+            //! Frames go to the ExecutionObject/Pipeline expected to
+            //! complete them first, based on the device, copy in and copy
+            //! out time of the frames it processed
+            SERVICE_TIME
+        };
+
+        //! @brief Create a Dispatcher for a set of ExecutionObjects
+        //! @param eos ExecutionObjects used to process frames
+        //! @param on_complete Invoked after each frame is processed
+        //! @param queue_depth Maximum number of frames waiting to be
+        //!        assigned. Defaults to twice the number of ExecutionObjects.
+        //! @param policy Assignment of frames to ExecutionObjects
+        Dispatcher(const std::vector<ExecutionObject*>& eos,
+                   CompletionCallback on_complete,
+                   uint32_t queue_depth = 0,
+                   Policy policy = Policy::FIRST_IDLE);
+
+        //! @brief Create a Dispatcher for a set of ExecutionObjectPipelines
+        //! @param eops ExecutionObjectPipelines used to process frames
+        //! @param on_complete Invoked after each frame is processed
+        //! @param queue_depth Maximum number of frames waiting to be
+        //!        assigned. Defaults to twice the number of pipelines.
+        //! @param policy Assignment of frames to pipelines
+        Dispatcher(const std::vector<ExecutionObjectPipeline*>& eops,
+                   CompletionCallback on_complete,
+                   uint32_t queue_depth = 0,
+                   Policy policy = Policy::FIRST_IDLE);
+
+        //! Wait for all submitted frames to complete and tear down
+        ~Dispatcher();
+
+        //! @brief Submit a frame for processing. Blocks while the queue is
+        //! full. The frame's input and output buffers must remain valid
+        //! until its completion callback returns.
+        //! @param frame Input/output buffers and index of the frame
+        void Submit(const FrameDescriptor& frame);
+
+        //! @brief Submit a frame for processing if the queue is not full
+        //! @param frame Input/output buffers and index of the frame
+        //! @return false if the queue is full, the frame is not submitted
+        bool TrySubmit(const FrameDescriptor& frame);
+
+        //! Wait until all submitted frames have completed
+        void Drain();
+
+        //! @return Number of frames completed
+        uint32_t GetNumFramesCompleted() const;
+
+        //! @return Number of frames for which processing failed
+        uint32_t GetNumFramesFailed() const;
+
+        //! @return Average service time in milliseconds of frames processed
+        //! by ExecutionObject/Pipeline index, weighted towards recent
+        //! frames. 0 until it has completed a frame.
+        float GetServiceTimeMs(uint32_t index) const;
+
+        Dispatcher(const Dispatcher&)            = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
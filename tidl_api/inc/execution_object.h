@@ -31,7 +31,10 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <cstdint>
 #include "configuration.h"
+#include "metrics.h"
 #include "execution_object_internal.h"
 
 namespace tidl {
@@ -39,7 +42,57 @@ namespace tidl {
 class Kernel;
 class Device;
 class LayerOutput;
+class DeviceBufferView;
 class IODeviceArgInfo;
+class FrameDescriptor;
+class FrameBatch;
+
+typedef std::vector<DeviceBufferView> DeviceBufferViews;
+typedef std::vector<FrameDescriptor>  FrameDescriptors;
+
+/*! @class StageTiming
+    @brief Time spent by a frame in one ExecutionObject. Host times are
+    measured on the ARM, device time is computed from the cycles reported
+    by the device.
+*/
+struct StageTiming
+{
+    //! layersGroupId processed by the ExecutionObject
+    int   layersGroupId = 0;
+
+    //! Waiting for a free context of the ExecutionObject
+    float queueWaitMs   = 0;
+
+    //! Copying the input from the host buffer to device buffers
+    float copyInMs      = 0;
+
+    //! Processing the network on the device
+    float deviceMs      = 0;
+
+    //! Cycles reported by the device for the process call
+    uint64_t deviceCycles = 0;
+
+    //! Copying the output from device buffers to the host buffer
+    float copyOutMs     = 0;
+
+    //! MACs of the layers group for one frame. macs, paramBytes and
+    //! activationBytes are computed from the network when
+    //! Configuration::enableWorkCounters is set, 0 otherwise. Divided by
+    //! deviceCycles, they give the MAC rate and memory traffic per cycle
+    //! achieved by the frame.
+    uint64_t macs            = 0;
+
+    //! Parameter bytes read from the PARAM heap
+    uint64_t paramBytes      = 0;
+
+    //! Bytes of the padded outputs of the layers and of inputs from other
+    //! layer groups. Buffers placed in on-chip memory by the external
+    //! memory optimization do not reach DDR, this is an upper bound.
+    uint64_t activationBytes = 0;
+};
+
+//! Timing of a frame, one StageTiming per ExecutionObject that processed it
+typedef std::vector<StageTiming> FrameTiming;
 
 
 /*! @class ExecutionObject
@@ -78,6 +131,66 @@ class ExecutionObject : public ExecutionObjectInternalInterface
         //! Returns size of the output buffer
         size_t GetOutputBufferSizeInBytes() const override;
 
+        //! @brief Returns the Q factor of an output buffer of the last
+        //! frame, see tidl::postproc::Dequantize. Outputs of frames
+        //! completed via callback are better read as float, see
+        //! ArgInfo::OutputFormat.
+        //! @param buffer_idx Index of the network output buffer
+        int GetOutputDataQ(uint32_t buffer_idx=0) const override;
+
+        //! @brief Specify one input and one output buffer per ROI, instead
+        //! of a single buffer with all ROIs. Used to process several crops
+        //! of a frame, e.g. detected regions, with one network invocation.
+        //! Requires a network imported with GetNumROIs() > 1. Replaces the
+        //! buffers set via SetInputOutputBuffer, GetInputBufferPtr and
+        //! GetOutputBufferPtr return nullptr.
+        //! @param in GetNumROIs() buffers, each GetInputROISizeInBytes()
+        //! @param out GetNumOutputROIs() buffers, each
+        //!            GetOutputROISizeInBytes()
+        void SetInputOutputROIBuffers(const std::vector<ArgInfo>& in,
+                                      const std::vector<ArgInfo>& out);
+
+        //! Returns the number of ROIs in the network input
+        uint32_t GetNumROIs() const;
+
+        //! Returns the number of ROIs in the network output
+        uint32_t GetNumOutputROIs() const;
+
+        //! Returns size of the input of a single ROI
+        size_t   GetInputROISizeInBytes() const;
+
+        //! Returns size of the output of a single ROI
+        size_t   GetOutputROISizeInBytes() const;
+
+        //! @brief Specify the input buffer and one output buffer per network
+        //! output buffer, instead of a single buffer with all outputs. An
+        //! output is not copied if its buffer has a nullptr, e.g. to read
+        //! only the outputs of interest of a multi-output network. Replaces
+        //! the buffers set via SetInputOutputBuffer, GetOutputBufferPtr
+        //! returns nullptr.
+        //! @param in  Input buffer, GetInputBufferSizeInBytes()
+        //! @param out GetNumNetOutputs() buffers, each
+        //!            GetNetOutputSizeInBytes(i), or as many floats for a
+        //!            float ArgInfo::OutputFormat
+        void SetInputOutputBuffers(const ArgInfo& in,
+                                   const std::vector<ArgInfo>& out);
+
+        //! Returns the number of network output buffers
+        uint32_t GetNumNetOutputs() const;
+
+        //! Returns the size of network output buffer buffer_idx
+        size_t   GetNetOutputSizeInBytes(uint32_t buffer_idx) const;
+
+        //! @brief Select the network output buffers copied to the host when
+        //! a frame completes, bit i for output buffer i. Outputs not
+        //! selected are left untouched in the output buffer(s). Defaults
+        //! to all outputs. Set it when no frame is in flight on the EO.
+        //! @param mask Bit mask of the output buffers to copy
+        void     SetOutputMask(uint32_t mask);
+
+        //! Returns the mask set by SetOutputMask
+        uint32_t GetOutputMask() const;
+
         //! @brief Set the frame index of the frame currently processed by the
         //! ExecutionObject. Used for trace/debug messages
         //! @param idx index of the frame
@@ -90,17 +203,75 @@ class ExecutionObject : public ExecutionObjectInternalInterface
         //! returns immediately. Use ExecutionObject::ProcessFrameWait to wait
         bool ProcessFrameStartAsync() override;
 
-        //! Wait for the execution object to complete processing a frame
+        //! @brief Start processing a frame, using the buffers set via
+        //! SetInputOutputBuffer and the index set via SetFrameIndex. The
+        //! call is asynchronous and returns immediately. The callback is
+        //! invoked on an OpenCL runtime thread once the output has been
+        //! copied to the output buffer. Up to Configuration::numContexts
+        //! frames can be in flight, the call blocks if all contexts are
+        //! busy. Do not mix with ProcessFrameStartAsync()/ProcessFrameWait.
+        //! @param callback Invoked with the result of the frame. Must not
+        //! block on other frames processed by the ExecutionObject.
+        bool ProcessFrameStartAsync(FrameCallback callback) override;
+
+        //! @brief Wait for the execution object to complete processing a
+        //! frame. The output is copied to the output buffer as soon as the
+        //! device completes the frame (on a HostThreads worker, if any),
+        //! before ProcessFrameWait is called.
         //! @return false if ExecutionObject::ProcessFrameWait was called
         //! without a corresponding call to
         //! ExecutionObject::ProcessFrameStartAsync.
         bool ProcessFrameWait() override;
 
+        //! @brief Wait at most timeout for the frame started with
+        //! ProcessFrameStartAsync() to complete, e.g. to meet a deadline
+        //! per frame. If the frame completes, it is retired as by
+        //! ProcessFrameWait. Otherwise it stays in flight, call again or
+        //! call ProcessFrameWait later.
+        //! @return WaitStatus::PENDING if the frame has not completed
+        //! within timeout. Frames that fail on the device throw, as in
+        //! ProcessFrameWait.
+        WaitStatus ProcessFrameWaitFor(
+                                std::chrono::microseconds timeout) override;
+
+        //! Retire the frame if it has completed, without blocking
+        WaitStatus TryProcessFrameWait() override;
+
+        //! @brief Returns an eventfd that becomes readable when a frame
+        //! started with ProcessFrameStartAsync() completes, to multiplex
+        //! completions with other file descriptors, e.g. via epoll. The
+        //! eventfd is created by the first call, frames started before are
+        //! not signalled. Reading it returns the number of completions
+        //! since the last read; retire each frame with
+        //! TryProcessFrameWait(). The eventfd is owned by the
+        //! ExecutionObject, do not close it.
+        int GetCompletionFd();
+
         //! @brief return the number of milliseconds taken *on the device* to
-        //! execute the process call
+        //! execute the process call of the most recently completed frame
         //! @return Number of milliseconds to process a frame on the device.
         float GetProcessTimeInMilliSeconds() const;
 
+        //! @brief Returns the timing of the most recently completed frame.
+        //! Frames started with a callback also receive their timing in
+        //! FrameResult::GetTiming.
+        StageTiming GetFrameTiming() const;
+
+        //! @brief Returns a snapshot of the runtime metrics of the
+        //! ExecutionObject, across all frames it processed. Does not block
+        //! frame processing.
+        Metrics GetMetrics() const;
+
+        //! @brief Start processing a batch of frames. Frames are distributed
+        //! across the available contexts of the ExecutionObject and are
+        //! processed in order. The call is asynchronous and returns
+        //! immediately. Do not mix with ProcessFrameStartAsync while the
+        //! batch is in progress.
+        //! @param frames Input/output buffers and index of each frame
+        //! @return Handle used to wait for completion of the batch
+        std::unique_ptr<FrameBatch> ProcessFramesAsync(
+                                             const FrameDescriptors& frames);
+
         //! Returns the device name that the ExecutionObject runs on
         const std::string& GetDeviceName() const override;
 
@@ -121,30 +292,122 @@ class ExecutionObject : public ExecutionObjectInternalInterface
         //! Get output buffers from all layers
         const LayerOutputs* GetOutputsFromAllLayers() const override;
 
+        //! @brief Append views of the output buffers of all traced layers to
+        //! views. The views point into device memory and are valid until the
+        //! next frame is processed. Does not allocate or copy layer data.
+        //! Clear and re-use the same vector across frames to avoid
+        //! allocations.
+        //! @see LayerOutputView
+        //! @return Number of views appended
+        size_t GetLayerOutputViews(LayerOutputViews& views) const override;
+
+        //! @brief Select the network run by frames started on the
+        //! ExecutionObject, see Executor::AddNetwork. Network 0, the
+        //! network the Executor was created with, is selected by default.
+        //! Applies to ProcessFrameStartAsync, ProcessFrameWait and the
+        //! buffer sizes. Set the buffers of the selected network via
+        //! SetInputOutputBuffer before starting a frame. Select before
+        //! starting a frame and keep the selection until its
+        //! ProcessFrameWait. ExecutionObjectPipelines run network 0.
+        //! @param idx Network, from 0 to GetNumNetworks() - 1
+        void     SetNetworkIndex(uint32_t idx);
+
+        //! Returns the network selected via SetNetworkIndex
+        uint32_t GetNetworkIndex() const;
+
+        //! Returns the number of networks resident on the ExecutionObject
+        uint32_t GetNumNetworks() const;
+
         //! Returns the layersGrupId that the ExecutionObject is processing
         int   GetLayersGroupId() const;
 
+        //! Returns the number of frames that can be in flight on the
+        //! ExecutionObject, see Configuration::numContexts
+        uint32_t GetNumContexts() const;
+
+        //! @brief Returns views of the network input buffers in device
+        //! memory for a context. Pre-processing can write directly into
+        //! these buffers instead of the host input buffer. To skip the host
+        //! to device copy, set the input buffer to ArgInfo(nullptr, 0) via
+        //! SetInputOutputBuffer. Frames started with ProcessFrameStartAsync
+        //! use context 0.
+        //! @param context_idx Context to return buffer views for
+        DeviceBufferViews GetDeviceInputBuffers(uint32_t context_idx=0) const;
+
+        //! @brief Returns views of the network output buffers in device
+        //! memory for a context. Valid after ProcessFrameWait returns. To
+        //! skip the device to host copy, set the output buffer to
+        //! ArgInfo(nullptr, 0) via SetInputOutputBuffer.
+        //! @param context_idx Context to return buffer views for
+        DeviceBufferViews GetDeviceOutputBuffers(uint32_t context_idx=0) const;
+
         //! @private
         // Used by the Executor
         enum class CallType { INIT, PROCESS, CLEANUP };
         bool RunAsync(CallType ct);
         bool Wait    (CallType ct);
+        // Swap the network run by this EO with the one initialized on
+        // other, after the frames in flight complete
+        void SwapNetwork(ExecutionObject& other);
+        // Wait for the frames in flight to complete or fail and initialize
+        // the network again, see Executor::ResetExecutionObject
+        void Reset();
+        // Network heap of the EO, holds the state of the network on the
+        // device, including the quantization range history. Read and
+        // written while no frame is in flight.
+        size_t    GetNetworkHeapSize() const;
+        uintptr_t GetNetworkHeapAddress() const;
+        void      ReadNetworkHeap(char* heap);
+        void      WriteNetworkHeap(const char* heap);
+        // Make the network initialized on eo selectable per frame
+        void      AddNetwork(ExecutionObject* eo);
 
         //! @private
         // Used by the ExecutionObjectPipeline
-        bool AddCallback(CallType ct, void *user_data, uint32_t context_idx);
+        bool AddCallback(CallType ct, std::function<void()> callback,
+                         uint32_t context_idx);
+        // pipeline_id identifies the EOP in the time stamp log
         bool AcquireAndRunContext(uint32_t& context_idx,
                                   int frame_idx,
                                   const IODeviceArgInfo& in,
-                                  const IODeviceArgInfo& out);
-
-        bool WaitAndReleaseContext(uint32_t  context_idx);
+                                  const IODeviceArgInfo& out,
+                                  uint32_t pipeline_id=0);
+
+        bool WaitAndReleaseContext(uint32_t  context_idx,
+                                   StageTiming* timing=nullptr);
+
+        // Timing of the frame in a context, valid after WaitContext and
+        // until the context is released
+        StageTiming GetContextTiming(uint32_t context_idx) const;
+
+        // Split phases of AcquireAndRunContext/WaitAndReleaseContext, used
+        // to copy between device buffers of two EOs while both contexts
+        // are held
+        void AcquireContext(uint32_t& context_idx,
+                            int frame_idx,
+                            const IODeviceArgInfo& in,
+                            const IODeviceArgInfo& out,
+                            uint32_t pipeline_id=0);
+        // Non-blocking AcquireContext. Returns false if all contexts are
+        // busy, on_release is then invoked when a context is released.
+        bool TryAcquireContext(uint32_t& context_idx,
+                               int frame_idx,
+                               const IODeviceArgInfo& in,
+                               const IODeviceArgInfo& out,
+                               uint32_t pipeline_id,
+                               std::function<void()> on_release);
+        bool RunContext    (uint32_t  context_idx);
+        bool WaitContext   (uint32_t  context_idx);
+        void ReleaseContext(uint32_t  context_idx);
 
         ExecutionObject()                                  = delete;
         ExecutionObject(const ExecutionObject&)            = delete;
         ExecutionObject& operator=(const ExecutionObject&) = delete;
 
     private:
+        ExecutionObject* GetNetwork() const;
+        ExecutionObject* StartOnNetwork();
+
         class Impl;
         std::unique_ptr<Impl> pimpl_m;
 };
@@ -202,4 +465,250 @@ class LayerOutput
 };
 
 
+/*! @class FrameResult
+    @brief Result of a frame started with a completion callback, see
+    ExecutionObject::ProcessFrameStartAsync(FrameCallback) and
+    ExecutionObjectPipeline::ProcessFrameStartAsync(FrameCallback)
+*/
+class FrameResult
+{
+    public:
+        //! @private
+        //! Constructor called within API, not by the user
+        FrameResult(int frame_idx, bool status, const ArgInfo& out,
+                    ExecutionObjectInternalInterface& eo,
+                    const FrameTiming& timing):
+            frame_idx_m(frame_idx), status_m(status), out_m(out), eo_m(eo),
+            timing_m(timing) {}
+
+        //! @return Index of the frame, as set via SetFrameIndex
+        int            GetFrameIndex() const { return frame_idx_m; }
+
+        //! @return false if processing the frame failed
+        bool           GetStatus()     const { return status_m; }
+
+        //! @return Output buffer of the frame
+        const ArgInfo& GetOutput()     const { return out_m; }
+
+        //! @return ExecutionObject or ExecutionObjectPipeline that
+        //! processed the frame
+        ExecutionObjectInternalInterface& GetExecutionObject() const
+                                             { return eo_m; }
+
+        //! @return Time spent by the frame in each ExecutionObject. Times
+        //! of stages not completed because the frame failed are 0. Valid
+        //! until the callback returns, copy it to keep it.
+        const FrameTiming& GetTiming() const { return timing_m; }
+
+    private:
+        int                               frame_idx_m;
+        bool                              status_m;
+        ArgInfo                           out_m;
+        ExecutionObjectInternalInterface& eo_m;
+        const FrameTiming&                timing_m;
+};
+
+/*! @class FrameDescriptor
+    @brief Describes a frame submitted as part of a batch, see
+    ExecutionObject::ProcessFramesAsync and
+    ExecutionObjectPipeline::ProcessFramesAsync
+*/
+class FrameDescriptor
+{
+    public:
+        //! @param in Input buffer for the frame
+        //! @param out Output buffer for the frame
+        //! @param frame_idx Index of the frame, used for trace/debug messages
+        FrameDescriptor(const ArgInfo& in, const ArgInfo& out,
+                        int frame_idx):
+            in_m(in), out_m(out), frame_idx_m(frame_idx) {}
+
+        //! @return Input buffer for the frame
+        const ArgInfo& GetInput()      const { return in_m; }
+
+        //! @return Output buffer for the frame
+        const ArgInfo& GetOutput()     const { return out_m; }
+
+        //! @return Index of the frame
+        int            GetFrameIndex() const { return frame_idx_m; }
+
+    private:
+        ArgInfo in_m;
+        ArgInfo out_m;
+        int     frame_idx_m;
+};
+
+/*! @class FrameBatch
+    @brief Completion handle for a batch of frames started with
+    ProcessFramesAsync. Destroying the handle waits for the batch.
+*/
+class FrameBatch
+{
+    public:
+        //! @private
+        class Impl;
+
+        //! @private
+        //! Constructor called within API, not by the user
+        explicit FrameBatch(Impl* impl);
+
+        ~FrameBatch();
+
+        //! Wait for all frames in the batch to complete processing
+        //! @return false if processing any of the frames failed
+        bool     Wait();
+
+        //! @return true if all frames in the batch have been processed
+        bool     IsComplete() const;
+
+        //! @return Number of frames in the batch
+        uint32_t GetNumFrames() const;
+
+        //! @return Number of frames processed so far
+        uint32_t GetNumFramesCompleted() const;
+
+        FrameBatch(const FrameBatch&)            = delete;
+        FrameBatch& operator=(const FrameBatch&) = delete;
+
+    private:
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+/*! @class DeviceBufferView
+    @brief Describes a network input or output buffer in device memory.
+    Buffers are stored as padded planes: each row of a channel is Pitch()
+    bytes apart, each channel ChannelStride() bytes apart and each ROI
+    ROIStride() bytes apart. Data() points to the first valid element,
+    past the padding. The view does not own the memory.
+*/
+class DeviceBufferView
+{
+    public:
+        //! @private
+        //! Constructor called within API, not by the user
+        DeviceBufferView(char* data, int num_rois, int num_channels,
+                         size_t height, size_t width, size_t pitch,
+                         size_t channel_stride):
+            data_m(data), num_rois_m(num_rois), num_channels_m(num_channels),
+            height_m(height), width_m(width), pitch_m(pitch),
+            channel_stride_m(channel_stride) {}
+
+        //! @return Pointer to the first valid element of the buffer
+        char*  Data()             const { return data_m; }
+
+        //! @return The number of ROIs in the buffer
+        int    NumberOfROIs()     const { return num_rois_m; }
+
+        //! @return The number of channels per ROI
+        int    NumberOfChannels() const { return num_channels_m; }
+
+        //! @return The number of valid rows in a channel
+        size_t Height()           const { return height_m; }
+
+        //! @return The number of valid bytes in a row
+        size_t Width()            const { return width_m; }
+
+        //! @return Distance in bytes between the start of consecutive rows
+        size_t Pitch()            const { return pitch_m; }
+
+        //! @return Distance in bytes between consecutive channels
+        size_t ChannelStride()    const { return channel_stride_m; }
+
+        //! @return Distance in bytes between consecutive ROIs
+        size_t ROIStride()        const { return channel_stride_m *
+                                                 num_channels_m; }
+
+        //! @return Pointer to the first element of a row
+        char*  Row(int roi, int channel, size_t row) const
+                    { return data_m + roi * ROIStride() +
+                             channel * channel_stride_m + row * pitch_m; }
+
+        //! @brief Copy the valid elements of this buffer into the padded
+        //! planes of dst. Padding in dst is not modified.
+        //! @return false if dst does not have the same number of ROIs,
+        //! channels, height and width
+        bool   CopyTo(const DeviceBufferView& dst) const;
+
+    private:
+        char*  data_m;
+        int    num_rois_m;
+        int    num_channels_m;
+        size_t height_m;
+        size_t width_m;
+        size_t pitch_m;
+        size_t channel_stride_m;
+};
+
+/*! @class LayerOutputView
+    @brief Describes the output of a traced layer in device memory. Unlike
+    LayerOutput, the view does not own or copy the data. Use Buffer() to
+    access the padded planes directly, or CopyTo() to pack the output into
+    a caller supplied buffer that can be re-used across frames.
+*/
+class LayerOutputView
+{
+    public:
+        //! @private
+        //! Constructor called within API, not by the user
+        LayerOutputView(int layer_index, int output_index, int buffer_id,
+                        int data_q, int min_value, int max_value,
+                        const DeviceBufferView& buffer):
+            layer_index_m(layer_index), output_index_m(output_index),
+            buffer_id_m(buffer_id), data_q_m(data_q),
+            min_value_m(min_value), max_value_m(max_value),
+            buffer_m(buffer) {}
+
+        //! @return The index of a layer
+        int    LayerIndex()       const { return layer_index_m; }
+
+        //! @return The output index of the buffer for the layer
+        int    OutputIndex()      const { return output_index_m; }
+
+        //! @return Id of the buffer, used in WriteLayerOutputsToFile names
+        int    BufferId()         const { return buffer_id_m; }
+
+        //! @return Q format of the output data
+        int    DataQ()            const { return data_q_m; }
+
+        //! @return Minimum value in the output, as reported by the device
+        int    MinValue()         const { return min_value_m; }
+
+        //! @return Maximum value in the output, as reported by the device
+        int    MaxValue()         const { return max_value_m; }
+
+        //! @return The number of channels associated with an output
+        int    NumberOfChannels() const { return buffer_m.NumberOfChannels(); }
+
+        //! @return The height of the output. Can be 1 for 1D outputs
+        size_t Height()           const { return buffer_m.Height(); }
+
+        //! @return The width of the output
+        size_t Width()            const { return buffer_m.Width(); }
+
+        //! @return Size of the packed output in bytes, same as
+        //! LayerOutput::Size()
+        size_t Size()             const { return Height() * Width() *
+                                                 NumberOfChannels(); }
+
+        //! @return Layout of the output in device memory
+        const DeviceBufferView& Buffer() const { return buffer_m; }
+
+        //! @brief Copy the output, without padding, into dst. The layout
+        //! matches LayerOutput::Data().
+        //! @param dst Destination buffer
+        //! @param size Size of dst in bytes, must be at least Size()
+        //! @return Number of bytes copied, 0 if dst is too small
+        size_t CopyTo(char* dst, size_t size) const;
+
+    private:
+        int              layer_index_m;
+        int              output_index_m;
+        int              buffer_id_m;
+        int              data_q_m;
+        int              min_value_m;
+        int              max_value_m;
+        DeviceBufferView buffer_m;
+};
+
+
 } // namespace tidl
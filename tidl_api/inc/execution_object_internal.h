@@ -30,11 +30,27 @@
 
 #pragma once
 
+#include <functional>
+#include <chrono>
+
 namespace tidl {
 
 class LayerOutput;
+class LayerOutputView;
+class FrameResult;
 
 typedef std::vector<std::unique_ptr<const LayerOutput>> LayerOutputs;
+typedef std::vector<LayerOutputView> LayerOutputViews;
+typedef std::function<void(FrameResult&)> FrameCallback;
+
+//! Result of waiting on a frame with a timeout
+enum class WaitStatus
+{
+    COMPLETED,  //!< The frame completed, as ProcessFrameWait returning true
+    FAILED,     //!< The frame completed with an error
+    PENDING,    //!< The frame is still in flight, wait again later
+    NO_FRAME    //!< No frame was started, or it was already waited on
+};
 
 /*! @cond HIDDEN_SYMBOLS
     @class ExecutionObjectInternalInterface
@@ -65,6 +81,12 @@ class ExecutionObjectInternalInterface
         //! Returns size of the output buffer
         virtual size_t GetOutputBufferSizeInBytes() const =0;
 
+        //! @brief Returns the Q factor of an output buffer of the last
+        //! frame, 0 if not known. 8-bit outputs are fixed point,
+        //! float = value * 256 / Q.
+        //! @param buffer_idx Index of the network output buffer
+        virtual int GetOutputDataQ(uint32_t buffer_idx=0) const =0;
+
         //! @brief Set the frame index of the frame currently processed by the
         //! ExecutionObject. Used for trace/debug messages
         //! @param idx index of the frame
@@ -77,12 +99,29 @@ class ExecutionObjectInternalInterface
         //! immediately. Use ExecutionObject::ProcessFrameWait to wait
         virtual bool ProcessFrameStartAsync() =0;
 
+        //! @brief Start processing a frame. The callback is invoked once the
+        //! frame's output is available in the output buffer, there is no
+        //! need to call ProcessFrameWait.
+        //! @param callback Invoked with the result of the frame
+        virtual bool ProcessFrameStartAsync(FrameCallback callback) =0;
+
         //! Wait for the execution object to complete processing a frame
         //! @return false if ExecutionObject::ProcessFrameWait was called
         //! without a corresponding call to
         //! ExecutionObject::ProcessFrameStartAsync.
         virtual bool ProcessFrameWait() =0;
 
+        //! @brief Wait at most timeout for the frame to complete. If the
+        //! frame completes, it is retired as by ProcessFrameWait. Otherwise
+        //! the frame stays in flight and may be waited on again.
+        //! @param timeout Upper bound on the time spent waiting
+        virtual WaitStatus ProcessFrameWaitFor(
+                                    std::chrono::microseconds timeout) =0;
+
+        //! @brief Retire the frame if it has completed, without blocking.
+        //! Same as ProcessFrameWaitFor with a timeout of 0.
+        virtual WaitStatus TryProcessFrameWait() =0;
+
         //! Returns the device name that the ExecutionObject runs on
         virtual const std::string& GetDeviceName() const =0;
 
@@ -102,6 +141,13 @@ class ExecutionObjectInternalInterface
 
         //! Get output buffers from all layers
         virtual const LayerOutputs* GetOutputsFromAllLayers() const =0;
+
+        //! @brief Append views of the output buffers of all traced layers to
+        //! views. Does not allocate or copy layer data. Clear and re-use the
+        //! same vector across frames to avoid allocations.
+        //! @see LayerOutputView
+        //! @return Number of views appended
+        virtual size_t GetLayerOutputViews(LayerOutputViews& views) const =0;
 };
 /*!  @endcond
 */
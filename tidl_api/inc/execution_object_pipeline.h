@@ -33,6 +33,7 @@
 #include <vector>
 #include <cstdint>
 #include <cassert>
+#include <functional>
 
 #include "executor.h"
 #include "execution_object_internal.h"
@@ -40,6 +41,14 @@
 
 namespace tidl {
 
+//! @brief Converts a raw frame into the input of the first ExecutionObject
+//! of a pipeline, see ExecutionObjectPipeline::SetPreprocessStage
+//! @param raw Raw frame set via SetInputOutputBuffer
+//! @param input Network input buffer owned by the pipeline
+//! @return false if the frame cannot be converted, the frame then fails
+typedef std::function<bool(const ArgInfo& raw, const ArgInfo& input)>
+                                                        PreprocessFunction;
+
 /*! @class ExecutionObjectPipeline
     @brief Manages the pipelined execution using multiple ExecutionObjects.
     Each executor runs one layersGroup of the network.  ExecutionObjects
@@ -61,8 +70,38 @@ class ExecutionObjectPipeline : public ExecutionObjectInternalInterface
         //!   ExecutionObjectPipeline ep1({exe_eve[1], exe_dsp[1]});
         //! @endcode
         //!
+        //! With num_frames_in_flight > 1, the pipeline has a slot per
+        //! outstanding frame, each with its own input, output and
+        //! intermediate buffers. The first ExecutionObject can then start
+        //! frame n+1 while the second is still processing frame n, without
+        //! creating additional ExecutionObjectPipelines. Each successful
+        //! ProcessFrameStartAsync() advances the pipeline to the next slot.
+        //! All other per-frame calls (buffer access, SetInputOutputBuffer,
+        //! frame index, ProcessFrameWait) apply to the current slot. The
+        //! usual processing loop therefore works unchanged:
+        //! @code
+        //!   ExecutionObjectPipeline ep({exe_eve[0], exe_dsp[0]}, 2);
+        //!   for (int i = 0; i < num_frames + 2; i++)
+        //!   {
+        //!       if (ep.ProcessFrameWait())  WriteFrameOutput(ep);
+        //!       if (ReadFrame(ep, i))       ep.ProcessFrameStartAsync();
+        //!   }
+        //! @endcode
+        //!
+        //! Pipelines may have any number of stages, e.g. EVE -> DSP -> EVE,
+        //! or a network split across four EVEs. To keep every stage busy,
+        //! use at least as many frames in flight as there are stages. The
+        //! number of frames in flight may exceed the contexts of an
+        //! ExecutionObject (Configuration::numContexts), so each stage only
+        //! needs the contexts required to keep its own device busy. A frame
+        //! that finds no idle context on the next ExecutionObject waits for
+        //! one without blocking the other stages.
+        //!
         //! @param eos DSP or EVE ExecutionObjects forming a pipeline
-        ExecutionObjectPipeline(std::vector<ExecutionObject*> eos);
+        //! @param num_frames_in_flight Number of frames that can be in
+        //!        flight
+        ExecutionObjectPipeline(std::vector<ExecutionObject*> eos,
+                                uint32_t num_frames_in_flight = 1);
 
         //! @brief Tear down an ExecutionObjectPipeline and free used resources
         ~ExecutionObjectPipeline();
@@ -71,24 +110,68 @@ class ExecutionObjectPipeline : public ExecutionObjectInternalInterface
         //! ExecutionObjectPipeline
         uint32_t GetNumExecutionObjects() const;
 
+        //! @brief Returns an ExecutionObject of the pipeline, e.g. the last
+        //! one to query the shape of the network outputs
+        //! @param index Stage, from 0 to GetNumExecutionObjects() - 1
+        ExecutionObject* GetExecutionObject(uint32_t index) const;
+
+        //! Returns the number of frames that can be in flight
+        uint32_t GetNumFramesInFlight() const;
+
+        //! @brief Prepend a preprocessing stage to the pipeline. The buffer
+        //! set via SetInputOutputBuffer then holds a raw frame of raw_size
+        //! bytes, e.g. an interleaved BGR or NV12 camera frame, and
+        //! GetInputBuffer* refer to it. ProcessFrameStartAsync queues the
+        //! frame to a worker thread of the pipeline, which converts it with
+        //! preprocess into a network input buffer owned by the pipeline
+        //! and starts the first ExecutionObject. The thread dispatching
+        //! frames no longer runs the preprocessing, which overlaps with the
+        //! processing of earlier frames. Frames are preprocessed in order.
+        //! Call before the first frame is started, then set the buffers
+        //! of each slot. See imgutil::PreprocessRawFrame.
+        //! @param preprocess Converts a raw frame into the network input
+        //! @param raw_size Size in bytes of a raw frame
+        void SetPreprocessStage(PreprocessFunction preprocess,
+                                size_t raw_size);
+
         //! Specify the input and output buffers used by the EOP
         //! @param in buffer used for input.
         //! @param out buffer used for output.
         void SetInputOutputBuffer (const ArgInfo& in,
                                    const ArgInfo& out) override;
 
+        //! Specify the input and output buffers used by a slot. Used to set
+        //! up buffers for all slots before the first frame is started.
+        //! @param in buffer used for input.
+        //! @param out buffer used for output.
+        //! @param slot_idx Slot, from 0 to GetNumFramesInFlight() - 1
+        void SetInputOutputBuffer (const ArgInfo& in, const ArgInfo& out,
+                                   uint32_t slot_idx);
+
         //! Returns a pointer to the input buffer
         char* GetInputBufferPtr() const override;
 
-        //! Returns size of the input buffer
+        //! Returns a pointer to the input buffer of a slot
+        char* GetInputBufferPtr(uint32_t slot_idx) const;
+
+        //! Returns size of the input buffer, the raw frame size if the
+        //! pipeline has a preprocessing stage
         size_t GetInputBufferSizeInBytes() const override;
 
         //! Returns a pointer to the output buffer
         char* GetOutputBufferPtr() const override;
 
+        //! Returns a pointer to the output buffer of a slot
+        char* GetOutputBufferPtr(uint32_t slot_idx) const;
+
         //! Returns the number of bytes written to the output buffer
         size_t GetOutputBufferSizeInBytes() const override;
 
+        //! @brief Returns the Q factor of an output buffer of the frame in
+        //! the current slot, see tidl::postproc::Dequantize
+        //! @param buffer_idx Index of the network output buffer
+        int GetOutputDataQ(uint32_t buffer_idx=0) const override;
+
         //! @brief Set the frame index of the frame currently processed by the
         //! ExecutionObjectPipeline. Used for trace/debug messages
         //! @param idx index of the frame
@@ -99,14 +182,76 @@ class ExecutionObjectPipeline : public ExecutionObjectInternalInterface
 
         //! @brief Start processing a frame. The call is asynchronous and
         //! returns immediately. Use ProcessFrameWait() to wait
+        //! @return false if the frame could not be started, or if the
+        //! current slot has a frame that has not been waited on
         bool ProcessFrameStartAsync() override;
 
-        //! Wait for the executor pipeline to complete processing a frame
+        //! @brief Start processing a frame in the current slot. The call is
+        //! asynchronous and returns immediately. The callback is invoked on
+        //! an OpenCL runtime thread once the frame has completed on the last
+        //! ExecutionObject, after which the slot can be reused. Do not call
+        //! ProcessFrameWait() for frames started with a callback.
+        //! @param callback Invoked with the result of the frame. Must not
+        //! block on other frames processed by the pipeline.
+        //! @return false if the frame could not be started, or if the
+        //! current slot has a frame in flight
+        bool ProcessFrameStartAsync(FrameCallback callback) override;
+
+        //! Wait for the executor pipeline to complete processing the frame
+        //! in the current slot
         //! @return false if ProcessFrameWait() was called
         //! without a corresponding call to
         //! ExecutionObjectPipeline::ProcessFrameStartAsync().
         bool ProcessFrameWait() override;
 
+        //! @brief Wait at most timeout for the frame in the current slot to
+        //! complete on the last ExecutionObject. If the frame completes, it
+        //! is retired as by ProcessFrameWait(). Otherwise it stays in
+        //! flight and the current slot is unchanged: call again or call
+        //! ProcessFrameWait() later.
+        //! @return WaitStatus::PENDING if the frame has not completed
+        //! within timeout
+        WaitStatus ProcessFrameWaitFor(
+                                std::chrono::microseconds timeout) override;
+
+        //! Retire the frame in the current slot if it has completed,
+        //! without blocking
+        WaitStatus TryProcessFrameWait() override;
+
+        //! @brief Returns an eventfd that becomes readable when a frame
+        //! started without a callback completes on the last
+        //! ExecutionObject, to multiplex completions with other file
+        //! descriptors, e.g. via epoll. The eventfd is created by the first
+        //! call. Reading it returns the number of completions since the
+        //! last read; retire the frames in slot order with
+        //! TryProcessFrameWait() until it returns WaitStatus::PENDING. The
+        //! eventfd is owned by the pipeline, do not close it.
+        int GetCompletionFd();
+
+        //! @brief Returns the time spent by the frame in the current slot in
+        //! each ExecutionObject of the pipeline. Valid after
+        //! ProcessFrameWait() and until the next frame is started in the
+        //! slot. Frames started with a callback receive their timing in
+        //! FrameResult::GetTiming.
+        const FrameTiming& GetFrameTiming() const;
+
+        //! @brief Returns a snapshot of the runtime metrics of the pipeline.
+        //! Latency is measured from ProcessFrameStartAsync until the frame
+        //! completes on the last ExecutionObject. Frames are counted as
+        //! dropped when ProcessFrameStartAsync finds the slot busy. Does
+        //! not block frame processing.
+        Metrics GetMetrics() const;
+
+        //! @brief Start processing a batch of frames. Frames are processed
+        //! in order through the pipeline, with up to GetNumFramesInFlight()
+        //! frames in flight. The call is asynchronous and
+        //! returns immediately. Do not mix with ProcessFrameStartAsync while
+        //! the batch is in progress.
+        //! @param frames Input/output buffers and index of each frame
+        //! @return Handle used to wait for completion of the batch
+        std::unique_ptr<FrameBatch> ProcessFramesAsync(
+                                             const FrameDescriptors& frames);
+
         //! Return the combined device names that this pipeline runs on
         const std::string& GetDeviceName() const override;
 
@@ -127,10 +272,21 @@ class ExecutionObjectPipeline : public ExecutionObjectInternalInterface
         //! Get output buffers from all layers
         const LayerOutputs* GetOutputsFromAllLayers() const override;
 
+        //! @brief Append views of the output buffers of all traced layers to
+        //! views. The views point into device memory and are valid until the
+        //! next frame is processed. Does not allocate or copy layer data.
+        //! Clear and re-use the same vector across frames to avoid
+        //! allocations.
+        //! @see LayerOutputView
+        //! @return Number of views appended
+        size_t GetLayerOutputViews(LayerOutputViews& views) const override;
+
         //! @private Used by runtime
         //! @brief callback function at the completion of each ExecutionObject,
         //! to chain the next ExectionObject for execution
-        void RunAsyncNext();
+        //! @param slot_idx Slot of the frame that completed on the
+        //! ExecutionObject
+        void RunAsyncNext(uint32_t slot_idx);
 
         ExecutionObjectPipeline()                                     = delete;
         ExecutionObjectPipeline(const ExecutionObjectPipeline&)       = delete;
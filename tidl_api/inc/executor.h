@@ -36,8 +36,10 @@
 #include <cassert>
 #include <set>
 #include <exception>
+#include <future>
 
 #include "configuration.h"
+#include "metrics.h"
 #include "custom.h"
 
 namespace tidl {
@@ -58,8 +60,71 @@ enum class DeviceId : int { ID0=0, /**< DSP1 or EVE1 */
 typedef std::set<DeviceId> DeviceIds;
 
 class ExecutorImpl;
+class FrameSource;
 class ExecutionObject;
 
+//! @brief Device side heap sizes and usage reported by an Executor.
+//! Requested sizes are the total bytes allocated from a heap during
+//! network setup and initialization, i.e. the minimum heap size required.
+//! Requested sizes are 0 if they were not measured.
+//! @see Configuration::showHeapStats, Configuration::autoSizeHeaps
+struct HeapUsage
+{
+    //! Size of the parameter heap, one per Executor
+    size_t paramHeapSize;
+
+    //! Bytes requested from the parameter heap
+    size_t paramHeapRequested;
+
+    //! Size of the network heap, one per ExecutionObject
+    size_t networkHeapSize;
+
+    //! Largest number of bytes requested from the network heap across
+    //! the ExecutionObjects of the Executor
+    size_t networkHeapRequested;
+
+    HeapUsage() : paramHeapSize(0), paramHeapRequested(0),
+                  networkHeapSize(0), networkHeapRequested(0) {}
+};
+
+//! @brief Time spent in each phase of creating an Executor, in
+//! milliseconds. Phases that did not run, e.g. autoSizeHeaps when it is
+//! not set, are 0. If time stamps are enabled before the Executor is
+//! created, the phases are also recorded in the time stamp log.
+//! @see EnableTimeStamps
+struct StartupTiming
+{
+    //! Creating the OpenCL context and command queues and building the
+    //! kernels, Device::Create
+    float deviceCreateMs  = 0;
+
+    //! Applying environment variables and filling TIDL_CreateParams from
+    //! the configuration
+    float configMs        = 0;
+
+    //! Measurement pass of Configuration::autoSizeHeaps
+    float autoSizeHeapsMs = 0;
+
+    //! Reading the network binary, or finding it in the binary cache
+    float readNetworkMs   = 0;
+
+    //! Reading the parameter binary, or finding it in the binary cache
+    float readParamsMs    = 0;
+
+    //! Allocating the PARAM heap and running the setup kernel that fills
+    //! it, or loading the heap from paramHeapCacheFile
+    float setupKernelMs   = 0;
+
+    //! Creating the ExecutionObjects: device buffers and kernels
+    float createEosMs     = 0;
+
+    //! Initialization kernels of the ExecutionObjects, run concurrently
+    float initKernelMs    = 0;
+
+    //! From the start of Device::Create until the Executor is ready
+    float totalMs         = 0;
+};
+
 /*! @class Executor
     @brief Manages the overall execution of a layersGroup in a network using the
     specified configuration and the set of devices available to the
@@ -87,6 +152,122 @@ class Executor
                  const Configuration& configuration,
                  int layers_group_id = OCL_TIDL_DEFAULT_LAYERS_GROUP_ID);
 
+        //! @brief Create an Executor object asynchronously.
+        //!
+        //! Device creation, network setup and ExecutionObject initialization
+        //! run on a separate thread. Use this to overlap initialization of
+        //! multiple Executors (e.g. EVE and DSP layers groups) with each
+        //! other and with application setup. E.g.
+        //! @code
+        //!   auto f_eve = Executor::CreateAsync(DeviceType::EVE, ids, c, 1);
+        //!   auto f_dsp = Executor::CreateAsync(DeviceType::DSP, ids, c, 2);
+        //!   std::unique_ptr<Executor> e_eve = f_eve.get();
+        //!   std::unique_ptr<Executor> e_dsp = f_dsp.get();
+        //! @endcode
+        //! Exceptions thrown during initialization are rethrown by get().
+        //!
+        //! @param device_type DSP or EVE device
+        //! @param ids Set of devices uses by this instance of the Executor
+        //! @param configuration Configuration used to initialize the Executor
+        //! @param layers_group_id Layers group that this Executor should run
+        static std::future<std::unique_ptr<Executor>> CreateAsync(
+                 DeviceType device_type, const DeviceIds& ids,
+                 const Configuration& configuration,
+                 int layers_group_id = OCL_TIDL_DEFAULT_LAYERS_GROUP_ID);
+
+        //! @brief Switch the Executor to the network in configuration
+        //! without tearing it down.
+        //!
+        //! The new network is set up on the devices of the Executor while
+        //! frames continue to be processed with the current network. Each
+        //! ExecutionObject then switches at a frame boundary: frames in
+        //! flight complete with the current network, frames started
+        //! afterwards use the new one. ExecutionObjects and
+        //! ExecutionObjectPipelines created from the Executor remain valid,
+        //! as do their input and output buffers. Call from a separate
+        //! thread (e.g. with std::async) to keep processing frames during
+        //! the setup. E.g.
+        //! @code
+        //!   auto reload = std::async(std::launch::async,
+        //!                            [&]() { e->Reload(new_config); });
+        //! @endcode
+        //!
+        //! @param configuration Configuration of the new network. The
+        //!        network must have the same input and output buffer
+        //!        sizes and numContexts as the current network.
+        //! @return true if the Executor now runs the new network. Throws
+        //!         on failure, the Executor keeps running the current one.
+        bool Reload(const Configuration& configuration);
+
+        //! @brief Run frames through the network to warm up the
+        //! quantization range statistics, before processing user frames.
+        //!
+        //! TIDL quantizes activations using range statistics of previously
+        //! processed frames (see Configuration::quantHistoryParam1). Each
+        //! ExecutionObject processes num_frames frames from source. Outputs
+        //! are discarded, the buffers set on the ExecutionObjects are not
+        //! used.
+        //! @param source Calibration frames, each of the input buffer size
+        //!        of the Executor
+        //! @param num_frames Number of frames processed by each
+        //!        ExecutionObject. Frame indices wrap around the source.
+        //! @return false if processing a frame failed
+        bool WarmUp(const FrameSource& source, uint32_t num_frames);
+
+        //! @brief Save the quantization range history of each
+        //! ExecutionObject to file.
+        //!
+        //! The device library does not expose the range statistics on
+        //! their own, the network heap of each ExecutionObject (see
+        //! Configuration::NETWORK_HEAP_SIZE) is saved. Waits for the frames
+        //! in flight on each ExecutionObject.
+        //! @return false if the file could not be written
+        bool SaveQuantizationState(const std::string& file) const;
+
+        //! @brief Restore the quantization range history saved by
+        //! SaveQuantizationState, e.g. after a restart. Frames processed
+        //! afterwards continue from the saved statistics.
+        //!
+        //! The state is restored only if it was saved for the same network,
+        //! configuration and API version, and the network heaps are at the
+        //! same addresses (the device library stores absolute addresses).
+        //! @return false if the file is missing or does not match, the
+        //!         Executor is not modified in that case
+        bool LoadQuantizationState(const std::string& file);
+
+        //! @brief Initialize an additional network on the devices of the
+        //! Executor, to switch networks per frame without a Reload.
+        //!
+        //! Each ExecutionObject of the Executor then holds both networks,
+        //! the network run by a frame is selected with
+        //! ExecutionObject::SetNetworkIndex. The heaps of the added network
+        //! are sized to what its layers request (see
+        //! Configuration::autoSizeHeaps): the device library allocates the
+        //! persistent data and the scratch of a network from the same
+        //! heaps, resident networks cannot share them.
+        //! @param configuration Configuration of the network, with the same
+        //!        numContexts as the Executor
+        //! @return Index of the network on the ExecutionObjects. Network 0
+        //!         is the network the Executor was created with.
+        uint32_t AddNetwork(const Configuration& configuration);
+
+        //! @brief Recover an ExecutionObject after a device error, without
+        //! re-creating the Executor.
+        //!
+        //! OpenCL and device errors are reported as Exceptions from the
+        //! calls that observe them (e.g. ProcessFrameWait). Resetting the
+        //! ExecutionObject waits for the frames in flight on it to complete
+        //! or fail, including a frame started with ProcessFrameStartAsync
+        //! and not yet waited for, and initializes its network again. The
+        //! parameters of the network are kept, the reset does not re-read
+        //! or set up the network. The command queue to the device is
+        //! shared and is not replaced, the other ExecutionObjects,
+        //! including those of other Executors, keep processing frames.
+        //! Frames started on the ExecutionObject during the reset wait
+        //! until it is done.
+        //! @param index Index of the ExecutionObject, see operator[]
+        void ResetExecutionObject(uint32_t index);
+
         //! @brief Tear down an Executor and free resources used by the
         //! Executor object
         ~Executor();
@@ -98,6 +279,21 @@ class Executor
         //! Executor
         uint32_t GetNumExecutionObjects() const;
 
+        //! @brief Returns a snapshot of the runtime metrics of each
+        //! ExecutionObject, one per device used by the Executor
+        std::vector<Metrics> GetMetrics() const;
+
+        //! @brief Returns the sizes of the device side heaps and the bytes
+        //! requested from them. Usage is measured from the device heap
+        //! statistics, available if Configuration::showHeapStats or
+        //! Configuration::autoSizeHeaps is set.
+        HeapUsage GetHeapUsage() const;
+
+        //! @brief Returns the time spent in each phase of creating the
+        //! Executor, e.g. to confirm the effect of the binary cache or of
+        //! paramHeapCacheFile on startup time
+        StartupTiming GetStartupTiming() const;
+
         //! @brief Returns the number of devices of the specified type
         //! available for TI DL.
         //! @param  device_type DSP or EVE/EVE device
@@ -125,10 +321,50 @@ class ArgInfo
     public:
         enum class DeviceAccess { R_ONLY=0, W_ONLY, RW };
 
+        //! Layout of the channels in an input buffer. The copy into the
+        //! device buffer converts interleaved input to planes, so the
+        //! application does not split it.
+        enum class Layout
+        {
+            PLANAR=0,           //!< One plane per channel (CHW)
+            INTERLEAVED,        //!< Channels of each pixel adjacent (HWC)
+            INTERLEAVED_SWAP_RB //!< HWC, first and third channel swapped
+                                //!< in the copy, e.g. BGR input for a
+                                //!< network trained on RGB
+        };
+
+        //! Format of an output buffer. The copy out of the device buffer
+        //! converts the 8-bit fixed point output to float with the Q factor
+        //! of each output buffer, see ExecutionObject::GetOutputDataQ.
+        //! Float buffers hold 4 bytes per output value.
+        enum class OutputFormat
+        {
+            RAW=0,    //!< 8-bit output as computed by the network
+            FLOAT_S8, //!< float, output interpreted as int8_t
+            FLOAT_U8  //!< float, output interpreted as uint8_t
+        };
+
         //! Construct an ArgInfo object from a pointer to a chunk of memory
         //! and its size.
         ArgInfo(void *p, size_t size) :
-            ptr_m(p), size_m(size), access_m(DeviceAccess::RW) {}
+            ptr_m(p), size_m(size), access_m(DeviceAccess::RW),
+            layout_m(Layout::PLANAR), pitch_m(0),
+            format_m(OutputFormat::RAW) {}
+
+        //! Construct an ArgInfo object for an input buffer with the given
+        //! layout. Ignored for output buffers.
+        //! @param pitch Bytes between the start of consecutive rows, e.g.
+        //! cv::Mat::step. 0 if rows are packed.
+        ArgInfo(void *p, size_t size, Layout layout, size_t pitch = 0) :
+            ptr_m(p), size_m(size), access_m(DeviceAccess::RW),
+            layout_m(layout), pitch_m(pitch),
+            format_m(OutputFormat::RAW) {}
+
+        //! Construct an ArgInfo object for an output buffer with the given
+        //! format. Ignored for input buffers.
+        ArgInfo(void *p, size_t size, OutputFormat format) :
+            ptr_m(p), size_m(size), access_m(DeviceAccess::RW),
+            layout_m(Layout::PLANAR), pitch_m(0), format_m(format) {}
 
         ArgInfo(const ArgInfo& arg) = default;
         ArgInfo& operator=(const ArgInfo& arg) = default;
@@ -139,10 +375,22 @@ class ArgInfo
         //! @return The size of the buffer or scalar represented by ArgInfo
         size_t size() const { return size_m; }
 
+        //! @return Layout of the channels in the buffer
+        Layout layout() const { return layout_m; }
+
+        //! @return Bytes between consecutive rows, 0 if rows are packed
+        size_t pitch() const { return pitch_m; }
+
+        //! @return Format of the values in an output buffer
+        OutputFormat format() const { return format_m; }
+
     protected:
         void*        ptr_m;
         size_t       size_m;
         DeviceAccess access_m;
+        Layout       layout_m;
+        size_t       pitch_m;
+        OutputFormat format_m;
 };
 
 
@@ -173,9 +421,18 @@ inline T* malloc_ddr(size_t size)
     return val;
 }
 
-//! Enable time stamp generation for TIDL API events
+//! Enumerates formats of the time stamp log, see EnableTimeStamps
+enum class TimeStampFormat {
+    CSV,          /**< Read by viewer/execution_graph.py */
+    CHROME_TRACE  /**< Chrome trace event JSON, for chrome://tracing or
+                       ui.perfetto.dev. Includes device execution time. */
+};
+
+//! Enable time stamp generation for TIDL API events. Events are appended to
+//! file as they are recorded. num_frames sizes the per-thread event buffers.
 bool EnableTimeStamps(const std::string& file = "timestamp.log",
-                      size_t num_frames=32);
+                      size_t num_frames=32,
+                      TimeStampFormat format=TimeStampFormat::CSV);
 
 /*! @class Exception
  *  @brief Used to error reporting
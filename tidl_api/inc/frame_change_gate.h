@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file frame_change_gate.h
+
+#pragma once
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class FrameChangeGate
+    @brief Skips processing of frames that did not change, for cameras
+    watching mostly static scenes.
+
+    ShouldProcess() compares a plane of each input frame, e.g. the first
+    plane of a planar network input, with the same plane of the last
+    processed frame. The score is the mean absolute difference of the
+    pixels on every step-th row and column. Frames scoring below the
+    threshold are skipped and the output of the last processed frame is
+    reused, except every refresh_interval frames, which are always
+    processed. E.g.
+    @code
+      FrameChangeGate gate(width, height, 4.0f, 30);
+      while (ReadFrame(eo->GetInputBufferPtr()))
+      {
+          if (!gate.ShouldProcess(eo->GetInputBufferPtr()))
+          {
+              gate.GetCachedOutput(result, result_size);
+              continue;
+          }
+          eo->ProcessFrameStartAsync();
+          eo->ProcessFrameWait();
+          gate.UpdateOutput(eo->GetOutputBufferPtr(),
+                            eo->GetOutputBufferSizeInBytes());
+          ...
+      }
+    @endcode
+    UpdateOutput may be called from a completion callback. With frames in
+    flight, the cached output is that of the last processed frame that has
+    completed.
+*/
+class FrameChangeGate
+{
+    public:
+        //! @brief Create a gate
+        //! @param width Width in pixels of the compared plane
+        //! @param height Height in rows of the compared plane
+        //! @param threshold Mean absolute pixel difference (0-255) at or
+        //! above which a frame is processed
+        //! @param refresh_interval Process at least one frame in this many,
+        //! 0 to only process changed frames
+        //! @param step Compare every step-th row and column
+        FrameChangeGate(uint32_t width, uint32_t height, float threshold,
+                        uint32_t refresh_interval = 30, uint32_t step = 4);
+        ~FrameChangeGate();
+
+        //! @brief Score the frame against the last processed frame.
+        //! @param plane First pixel of the compared plane of the frame,
+        //! 8 bits per pixel
+        //! @param pitch Bytes between rows, 0 for width
+        //! @return true if the frame must be processed: it changed, it is
+        //! the first frame, a refresh is due or there is no cached output.
+        //! The frame then becomes the reference for the following frames.
+        bool ShouldProcess(const void* plane, size_t pitch = 0);
+
+        //! Keep a copy of the output of a processed frame
+        void UpdateOutput(const void* output, size_t size);
+
+        //! @brief Copy the output of the last processed frame
+        //! @return false if there is none or size differs from its size
+        bool GetCachedOutput(void* output, size_t size) const;
+
+        //! Process the next frame regardless of its score, e.g. after
+        //! changing the network
+        void Reset();
+
+        //! Score of the last frame passed to ShouldProcess
+        float    GetLastScore() const;
+
+        uint64_t GetNumFramesProcessed() const;
+        uint64_t GetNumFramesSkipped() const;
+
+        FrameChangeGate(const FrameChangeGate&)            = delete;
+        FrameChangeGate& operator=(const FrameChangeGate&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
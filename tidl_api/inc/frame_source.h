@@ -0,0 +1,97 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file frame_source.h
+
+#pragma once
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class FrameSource
+    @brief Input stage for files of preprocessed frames.
+
+    The file is memory-mapped read-only and split into frames of a fixed
+    size. GetFrame() returns a pointer into the mapping, so frames are not
+    copied through a stream buffer, and prefetches the following frames
+    with madvise(MADV_WILLNEED) to hide page-in latency. Frame indices wrap
+    around at the end of the file, which makes looping benchmarks over a
+    short file straightforward. E.g.
+    @code
+      FrameSource source(c.inData, frame_size);
+      for (int frame_idx = 0; frame_idx < num_frames; frame_idx++)
+      {
+          source.CopyFrame(frame_idx, eop->GetInputBufferPtr(), frame_size);
+          eop->ProcessFrameStartAsync();
+          ...
+      }
+    @endcode
+*/
+class FrameSource
+{
+    public:
+        //! @brief Map a file of preprocessed frames
+        //! @param file Path to the file, e.g. Configuration::inData
+        //! @param frame_size Size in bytes of one frame
+        //! @param prefetch_frames Number of frames after the requested one
+        //! to prefetch, 0 disables prefetching
+        //! Throws tidl::Exception if the file cannot be mapped or is
+        //! smaller than one frame.
+        FrameSource(const std::string& file, size_t frame_size,
+                    uint32_t prefetch_frames = 4);
+
+        //! Unmap the file. Pointers returned by GetFrame become invalid.
+        ~FrameSource();
+
+        //! @return Number of complete frames in the file. Trailing bytes
+        //! that do not form a complete frame are ignored.
+        uint32_t GetNumFrames() const;
+
+        //! @return Size in bytes of one frame
+        size_t GetFrameSize() const;
+
+        //! @brief Return frame frame_idx % GetNumFrames() without copying
+        //! @return Pointer to GetFrameSize() read-only bytes, valid for the
+        //! lifetime of the FrameSource
+        const char* GetFrame(uint32_t frame_idx) const;
+
+        //! @brief Copy frame frame_idx % GetNumFrames() into buffer
+        //! @return false if size is smaller than the frame size
+        bool CopyFrame(uint32_t frame_idx, char* buffer, size_t size) const;
+
+        FrameSource(const FrameSource&)            = delete;
+        FrameSource& operator=(const FrameSource&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
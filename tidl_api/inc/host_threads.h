@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file host_threads.h
+
+#pragma once
+#include <set>
+#include <functional>
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class HostThreads
+    @brief Placement of the host side work of the API on the A15 cores.
+
+    Frames completing on a device are picked up on the OpenCL runtime
+    thread that delivers the completion: it copies the output, starts the
+    frame on the next ExecutionObject of a pipeline (copying its input) and
+    runs completion callbacks. These threads are scheduled on any core.
+    StartWorkers moves this work to dedicated worker threads pinned to a
+    set of cores, e.g. away from the core running a camera thread. E.g.
+    @code
+      HostThreads::StartWorkers(1, {1}, 10);  // 1 worker on core 1
+      HostThreads::SetCurrentThread({0});     // camera thread on core 0
+    @endcode
+    Runtime starts the workers described by Configuration::hostWorkers.
+*/
+class HostThreads
+{
+    public:
+        //! @brief Run the completion work of ExecutionObjectPipelines and of
+        //! ExecutionObject frames started with a callback on num_workers
+        //! worker threads. Replaces workers started before. Do not call
+        //! from a completion callback.
+        //! @param num_workers Number of worker threads, at least 1
+        //! @param cpus Cores the workers run on, empty for any core
+        //! @param priority SCHED_FIFO priority of the workers (1-99), 0
+        //! keeps the default policy. Requires CAP_SYS_NICE.
+        //! @return false if the affinity or priority could not be applied,
+        //! the workers run with the default placement in that case
+        static bool StartWorkers(uint32_t num_workers,
+                                 const std::set<int>& cpus = {},
+                                 int priority = 0);
+
+        //! @brief Stop the workers after the pending work has run.
+        //! Completion work runs on the OpenCL runtime threads again. Do not
+        //! call from a completion callback.
+        static void StopWorkers();
+
+        //! Returns the number of worker threads running
+        static uint32_t GetNumWorkers();
+
+        //! @brief Pin the calling thread to cpus and set its priority, e.g.
+        //! for application threads capturing or dispatching frames
+        //! @param cpus Cores the thread runs on, empty leaves the affinity
+        //! unchanged
+        //! @param priority SCHED_FIFO priority (1-99), 0 leaves the policy
+        //! unchanged
+        //! @return false if the affinity or priority could not be applied
+        static bool SetCurrentThread(const std::set<int>& cpus,
+                                     int priority = 0);
+
+        //! @private
+        // Run work on a worker thread, or on the calling thread if no
+        // workers are running. Used by ExecutionObject and
+        // ExecutionObjectPipeline from OpenCL event callbacks.
+        static void Run(std::function<void()> work);
+};
+
+} // namespace tidl
@@ -39,7 +39,104 @@ namespace imgutil {
 //! the DL network expects
 //! @param image        Input image data (OpenCV data structure)
 //! @param ptr          Output buffer that TI DL takes as input
+//! Crops and resizes image as specified by Configuration::preProcType and
+//! preProcCropFactor, then converts it with PlanarizeImage
 bool PreprocessImage(cv::Mat& image, char *ptr, const tidl::Configuration& c);
 
+//! Scaling of an image to the network input size by ResizeImage
+enum class ResizeMode
+{
+    STRETCH,        //!< Scale width and height independently
+    CENTER_CROP,    //!< Preserve the aspect ratio, crop the central part of
+                    //!< the image that has the aspect ratio of the input
+    LETTERBOX       //!< Preserve the aspect ratio, scale the whole image
+                    //!< to fit and pad the borders
+};
+
+//! @brief Transform from image coordinates to network input coordinates
+//! applied by ResizeImage: input = image * scale + offset, per axis
+struct ResizeTransform
+{
+    float scale_x;
+    float scale_y;
+    float offset_x;
+    float offset_y;
+
+    //! Map a point of the network input, e.g. a detected box corner, back
+    //! to image coordinates
+    cv::Point2f ToImage(const cv::Point2f& p) const
+    {
+        return cv::Point2f((p.x - offset_x) / scale_x,
+                           (p.y - offset_y) / scale_y);
+    }
+};
+
+//! @brief Scale an image to size in a single resampling pass, with the
+//! crop or the borders of mode applied in the same pass
+//! @param image        Input image data (OpenCV data structure)
+//! @param out          Resized image. Kept if it already has the size and
+//!                     type, e.g. a Mat wrapping an interleaved input
+//!                     buffer, allocated otherwise.
+//! @param size         Size of the network input
+//! @param mode         Scaling of the image
+//! @param pad          Value of the LETTERBOX borders
+//! @return Transform from image to out coordinates
+ResizeTransform ResizeImage(const cv::Mat& image, cv::Mat& out,
+                            cv::Size size, ResizeMode mode,
+                            const cv::Scalar& pad = cv::Scalar());
+
+//! @brief Scale an image to the network input with ResizeImage, then
+//! convert it with PlanarizeImage. Replaces the crop and resize of
+//! Configuration::preProcType, the channel order and normalization of
+//! preProcType still apply.
+//! @param image        Input image data (OpenCV data structure)
+//! @param ptr          Output buffer that TI DL takes as input
+//! @param mode         Scaling of the image, LETTERBOX borders are black
+//! @param transform    If not null, set to the transform from image to
+//!                     network input coordinates
+bool PreprocessImage(const cv::Mat& image, char *ptr,
+                     const tidl::Configuration& c, ResizeMode mode,
+                     ResizeTransform* transform = nullptr);
+
+//! @brief Convert an image that is already inWidth x inHeight, with
+//! inNumChannels interleaved 8-bit channels, to the planar network input.
+//! Applies Configuration::preProcMean and preProcScale, or the mean of
+//! preProcType if they are empty, in a single pass specialized on the
+//! channel count and normalization. Applications with their own crop or
+//! resize use it for the final conversion.
+//! @param image        Input image data (OpenCV data structure)
+//! @param ptr          Output buffer that TI DL takes as input
+//! @param swap_rb      Swap the first and third channel, e.g. BGR to RGB
+//! @return false if the image does not match the network input
+bool PlanarizeImage(const cv::Mat& image, char *ptr,
+                    const tidl::Configuration& c, bool swap_rb = false);
+
+//! Pixel formats of the raw frames accepted by PreprocessRawFrame
+enum class RawFormat
+{
+    BGR,    //!< 8-bit interleaved BGR, 3 bytes per pixel
+    NV12,   //!< 8-bit Y plane followed by an interleaved UV plane at half
+            //!< resolution, as output by camera and video decoders
+    YUYV    //!< 8-bit packed Y0 U Y1 V, 2 bytes per pixel, as output by
+            //!< USB cameras
+};
+
+//! @brief Size in bytes of a raw frame of the given dimensions and format
+size_t GetRawFrameSize(int width, int height, RawFormat format);
+
+//! @brief Convert a raw camera or decoder frame to the network input.
+//! Suited to ExecutionObjectPipeline::SetPreprocessStage, the frames are
+//! then converted on the pipeline's stage thread.
+//! @param raw          Raw frame, GetRawFrameSize(width, height, format)
+//!                     bytes
+//! @param width        Width of the raw frame in pixels
+//! @param height       Height of the raw frame in pixels
+//! @param format       Pixel format of the raw frame
+//! @param ptr          Output buffer that TI DL takes as input
+//! @return false if the frame cannot be converted to the network input
+bool PreprocessRawFrame(const char *raw, int width, int height,
+                        RawFormat format, char *ptr,
+                        const tidl::Configuration& c);
+
 } // namesapce tidl::imgutil
 } // namespace tidl
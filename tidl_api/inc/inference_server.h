@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file inference_server.h
+
+#pragma once
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "configuration.h"
+
+namespace tidl {
+
+/*! @class InferenceServer
+    @brief Owns the EVE and DSP devices and processes frames for client
+    processes connected with InferenceClient.
+
+    Only one process can own the devices. The server creates the Executors
+    and pipelines of the configuration's topology with a Runtime, and
+    listens on a Unix domain socket. Each client connecting to the socket
+    gets a ring of frame slots in a SharedBuffer allocated by the server,
+    so that the devices access the frames of all clients in place. A
+    client writes a frame into a free slot and submits the slot index over
+    the socket, the server replies with the index once the output of the
+    slot is ready. Frames of all clients are queued to a Dispatcher in the
+    order they arrive, so the first idle pipeline takes the next frame
+    whichever client submitted it. The number of slots of the ring is the
+    quota of a client: a client never has more frames queued or in flight.
+    @code
+      Configuration c;
+      c.ReadFromFile("tidl_config.txt");
+      InferenceServer server(c, "/tmp/tidl.sock");
+      server_ptr = &server;   // SIGTERM handler calls server_ptr->Stop()
+      server.Run();
+    @endcode
+    The server and its clients require the CMEM driver, link with -lticmem.
+*/
+class InferenceServer
+{
+    public:
+        //! @brief Create the Executors and pipelines of the configuration,
+        //! and listen on socket_path. Throws an Exception if the devices
+        //! or the socket cannot be set up.
+        //! @param configuration Network configuration and topology
+        //! @param socket_path Path of the Unix domain socket, replaced if
+        //!        it exists
+        //! @param frames_per_client Slots in the ring of each client
+        //! @param max_clients Connections beyond this number are closed
+        InferenceServer(const Configuration& configuration,
+                        const std::string& socket_path,
+                        uint32_t frames_per_client = 2,
+                        uint32_t max_clients = 8);
+
+        //! Close the socket and tear down the pipelines and Executors
+        ~InferenceServer();
+
+        //! @brief Accept clients and process their frames until Stop() is
+        //! called. Returns once the frames in flight have completed.
+        void Run();
+
+        //! Make Run() return. Async-signal-safe, e.g. for a SIGTERM
+        //! handler.
+        void Stop();
+
+        //! @return Number of frames processed for all clients
+        uint64_t GetNumFramesCompleted() const;
+
+        //! @return Number of frames that failed or were rejected
+        uint64_t GetNumFramesFailed() const;
+
+        InferenceServer(const InferenceServer&)            = delete;
+        InferenceServer& operator=(const InferenceServer&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+/*! @class InferenceClient
+    @brief Connection of a process to an InferenceServer.
+
+    The client maps the ring of frame slots the server allocated for it.
+    A slot is free until submitted, and free again once Wait() returns it.
+    A slot submitted again before it is returned is rejected. E.g.
+    @code
+      InferenceClient client("/tmp/tidl.sock");
+      for (uint32_t s = 0; s < client.GetNumSlots(); s++)
+      {
+          ReadFrame(client.GetInputBufferPtr(s));
+          client.Submit(s, frame_idx++);
+      }
+      uint32_t slot;  int idx;  bool ok;
+      while (client.Wait(slot, idx, ok))
+      {
+          WriteFrameOutput(client.GetOutputBufferPtr(slot));
+          ReadFrame(client.GetInputBufferPtr(slot));
+          client.Submit(slot, frame_idx++);
+      }
+    @endcode
+    The client does not use the devices, it does not need OpenCL at
+    runtime.
+*/
+class InferenceClient
+{
+    public:
+        //! @brief Connect to the server listening on socket_path and map
+        //! the ring of the connection. Throws an Exception on failure.
+        explicit InferenceClient(const std::string& socket_path);
+
+        //! Disconnect, frames in flight are discarded
+        ~InferenceClient();
+
+        //! @return Number of slots, the maximum number of frames in flight
+        uint32_t GetNumSlots() const;
+
+        //! @return Input buffer of slot, GetInputBufferSizeInBytes() bytes
+        //! in the network input format
+        void*  GetInputBufferPtr(uint32_t slot) const;
+        size_t GetInputBufferSizeInBytes() const;
+
+        //! @return Output buffer of slot, valid after Wait() returns slot
+        void*  GetOutputBufferPtr(uint32_t slot) const;
+        size_t GetOutputBufferSizeInBytes() const;
+
+        //! @brief Submit the frame in slot for processing
+        //! @param frame_idx Returned by Wait() with the slot
+        //! @return false if the connection failed
+        bool Submit(uint32_t slot, int frame_idx);
+
+        //! @brief Wait for a submitted frame to complete
+        //! @param slot Set to the slot of the frame
+        //! @param frame_idx Set to the index submitted with the frame
+        //! @param status Set to false if processing the frame failed or the
+        //!        submission was rejected
+        //! @return false if the connection failed
+        bool Wait(uint32_t& slot, int& frame_idx, bool& status);
+
+        //! @return Socket of the connection, readable when Wait() would not
+        //! block, e.g. for poll or epoll
+        int GetFd() const;
+
+        InferenceClient(const InferenceClient&)            = delete;
+        InferenceClient& operator=(const InferenceClient&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file input_stage.h
+
+#pragma once
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace tidl {
+
+/*! @class InputStage
+    @brief Reads and preprocesses frames on a pool of worker threads, ahead
+    of the thread that dispatches them to ExecutionObjectPipelines.
+
+    Each worker calls the read function with the next frame index and an
+    idle input buffer. Buffers are allocated in CMEM, so they can be set as
+    ExecutionObjectPipeline input without a copy. GetNextFrame() returns
+    the frames in index order, whichever worker completes first. The number
+    of buffers bounds how far the workers read ahead. E.g.
+    @code
+      InputStage input([&](uint32_t idx, char* buf, size_t size)
+                       { return ReadFrame(idx, buf, size); },
+                       eop->GetInputBufferSizeInBytes(), 4, num_eops + 4);
+      uint32_t frame_idx;
+      while (char* frame = input.GetNextFrame(frame_idx))
+      {
+          eop->SetFrameIndex(frame_idx);
+          eop->SetInputOutputBuffer(ArgInfo(frame, frame_size), out);
+          eop->ProcessFrameStartAsync();
+          ...
+          input.ReleaseFrame(frame);  // once the frame is processed
+      }
+    @endcode
+*/
+class InputStage
+{
+    public:
+        //! @brief Read frame frame_idx into buffer. Called concurrently
+        //! from the worker threads, each with a different frame index.
+        //! Sequential sources such as a camera must serialize their
+        //! capture, and can use frame_idx to capture in order.
+        //! @return false at the end of the input or on error. Frames from
+        //! frame_idx onwards are not returned by GetNextFrame.
+        typedef std::function<bool(uint32_t frame_idx, char* buffer,
+                                   size_t size)> ReadFunction;
+
+        //! @brief Start reading frames from index 0
+        //! @param read Called to read and preprocess each frame
+        //! @param frame_size Size in bytes of a frame buffer
+        //! @param num_workers Number of worker threads
+        //! @param num_buffers Number of frame buffers. Must exceed the
+        //! number of frames held by the caller (e.g. one per EOP slot),
+        //! the remaining buffers are read ahead.
+        InputStage(ReadFunction read, size_t frame_size,
+                   uint32_t num_workers, uint32_t num_buffers);
+
+        //! Stop reading and join the worker threads. Waits for reads in
+        //! progress to complete.
+        ~InputStage();
+
+        //! @brief Get the next frame in index order. Blocks until the
+        //! frame has been read. Throws if all buffers are held by the
+        //! caller.
+        //! @param frame_idx Set to the index of the frame
+        //! @return Buffer holding the frame, to be returned via
+        //! ReleaseFrame, or nullptr at the end of the input
+        char* GetNextFrame(uint32_t& frame_idx);
+
+        //! @brief Return a buffer obtained from GetNextFrame, once the
+        //! frame has been processed. The buffer is reused for a later frame.
+        void  ReleaseFrame(char* buffer);
+
+        //! @return Size in bytes of a frame buffer
+        size_t GetFrameSize() const;
+
+        //! @return Number of worker threads
+        uint32_t GetNumWorkers() const;
+
+        InputStage(const InputStage&)            = delete;
+        InputStage& operator=(const InputStage&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file latest_frame_source.h
+
+#pragma once
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class LatestFrameSource
+    @brief Input stage for live sources that always provides the newest
+    captured frame.
+
+    A capture thread calls the capture function continuously, so frames
+    do not queue up in the driver (e.g. V4L2 buffers) while the devices are
+    busy. GetLatestFrame() returns the most recent frame that has not been
+    returned before; frames captured in between are dropped and counted.
+    Under overload, end-to-end latency stays bounded by one capture, the
+    frame rate drops instead. E.g.
+    @code
+      LatestFrameSource source([&cap](char* buf, size_t size)
+                               { return CaptureFrame(cap, buf, size); },
+                               frame_size);
+      while (source.GetLatestFrame(eop->GetInputBufferPtr(), frame_size))
+      {
+          eop->ProcessFrameStartAsync();
+          ...
+      }
+    @endcode
+*/
+class LatestFrameSource
+{
+    public:
+        //! @brief Fill buffer with the next frame from the source. Called
+        //! from the capture thread.
+        //! @return false at the end of the source or on error, capture
+        //! stops
+        typedef std::function<bool(char* buffer, size_t size)>
+                                                        CaptureFunction;
+
+        //! @brief Start capturing frames
+        //! @param capture Called to capture each frame
+        //! @param frame_size Size in bytes of a captured frame
+        LatestFrameSource(CaptureFunction capture, size_t frame_size);
+
+        //! Stop capturing and join the capture thread
+        ~LatestFrameSource();
+
+        //! @brief Copy the newest frame not returned before into buffer.
+        //! Blocks until a new frame has been captured.
+        //! @return false if capture has stopped and there are no new frames,
+        //! or if size is smaller than the frame size
+        bool GetLatestFrame(char* buffer, size_t size);
+
+        //! @return Number of frames captured
+        uint64_t GetNumFramesCaptured() const;
+
+        //! @return Number of captured frames replaced by a newer frame
+        //! before they were returned by GetLatestFrame
+        uint64_t GetNumFramesDropped() const;
+
+        LatestFrameSource(const LatestFrameSource&)            = delete;
+        LatestFrameSource& operator=(const LatestFrameSource&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
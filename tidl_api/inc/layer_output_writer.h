@@ -0,0 +1,119 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file layer_output_writer.h
+
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+
+namespace tidl {
+
+/*! @class LayerOutputWriter
+    @brief Writes traced layer outputs to a single container file on a
+    background thread.
+
+    Capture() copies the outputs of all traced layers into a staging pool
+    and returns. The copies are appended to the container file by a writer
+    thread, so file I/O does not stall the processing loop. Requires
+    Configuration::enableOutputTrace.
+
+    Container format (little endian):
+    @code
+      file header:   char magic[8] = "TIDLLOD1"
+      record:        LayerOutputWriter::RecordHeader, followed by
+                     payloadSize bytes of layer output (same layout as
+                     LayerOutput::Data())
+      ...
+      index:         uint64_t offset of each record from start of file
+      trailer:       uint64_t index offset, uint64_t number of records,
+                     char magic[8] = "TIDLLODI"
+    @endcode
+    The index and trailer are written when the writer is destroyed.
+*/
+class LayerOutputWriter
+{
+    public:
+        //! Header preceding each layer output in the container file
+        struct RecordHeader
+        {
+            int32_t  frameIndex;
+            int32_t  layerIndex;
+            int32_t  outputIndex;
+            int32_t  bufferId;
+            int32_t  numChannels;
+            int32_t  height;
+            int32_t  width;
+            int32_t  dataQ;
+            int32_t  minValue;
+            int32_t  maxValue;
+            uint64_t payloadSize;
+        };
+
+        //! @brief Open the container file and start the writer thread.
+        //! Throws an Exception if the file cannot be opened.
+        //! @param filename Path to the container file
+        //! @param staging_size Upper bound in bytes on layer outputs
+        //!        captured but not yet written to the file
+        LayerOutputWriter(const std::string& filename,
+                          size_t staging_size = 64 << 20);
+
+        //! Write all captured outputs, the index and close the file
+        ~LayerOutputWriter();
+
+        //! @brief Copy the outputs of all traced layers for the frame most
+        //! recently processed by an ExecutionObject or
+        //! ExecutionObjectPipeline into the staging pool and queue them for
+        //! writing. Call after the frame has completed.
+        //! @param eo ExecutionObject or ExecutionObjectPipeline
+        //! @param frame_idx Index of the frame, recorded in the file
+        //! @return false if the staging pool does not have space for the
+        //! outputs. The frame is dropped, the call does not block.
+        bool Capture(const ExecutionObjectInternalInterface& eo,
+                     int frame_idx);
+
+        //! Wait until all captured outputs have been written to the file
+        //! @return false if writing to the file failed
+        bool Flush();
+
+        //! @return Number of frames dropped because the staging pool was full
+        uint32_t GetNumFramesDropped() const;
+
+        LayerOutputWriter(const LayerOutputWriter&)            = delete;
+        LayerOutputWriter& operator=(const LayerOutputWriter&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
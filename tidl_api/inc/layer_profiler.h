@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file layer_profiler.h
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+
+#include "configuration.h"
+#include "executor.h"
+
+namespace tidl {
+
+/*! @class LayerProfiler
+    @brief Measures the device cycles taken by each layer of a network.
+
+    The device reports the cycles of a complete process call, not of
+    individual layers. The profiler recovers per-layer cycles from prefixes
+    of the network: for each profiled layer k it assigns layers 0..k to
+    layersGroupId 1 and the remaining layers to layersGroupId 2, runs the
+    first group on the device and records its cycles. The cycles of layer
+    k are the difference between the prefixes ending at k and at the
+    previous profiled layer. E.g.
+    @code
+      Configuration c;
+      c.ReadFromFile("path to configuration file");
+      LayerProfiler profiler(c, DeviceType::DSP);
+      if (profiler.Run())
+          profiler.WriteCSV(std::cout);
+    @endcode
+    The first profiled layer also includes the fixed overhead of a process
+    call. Profiling creates an Executor per layer and takes a while, it is
+    meant to be run offline.
+*/
+class LayerProfiler
+{
+    public:
+        //! Device cycles of a layer
+        struct LayerProfile
+        {
+            //! Index of the layer in sTIDL_Network_t::TIDLLayers
+            int      layerIndex;
+
+            //! eTIDL_LayerType of the layer
+            int      layerType;
+
+            //! Cycles, averaged across the profiled frames
+            uint64_t cycles;
+
+            //! Time on the device, in milliseconds
+            float    deviceMs;
+
+            //! Work of the layer, from the network: divided by cycles,
+            //! the MAC rate and memory traffic per cycle of the layer
+            uint64_t macs;
+            uint64_t paramBytes;
+            uint64_t outputBytes;
+        };
+
+        //! @brief Create a profiler for a network
+        //! @param configuration Configuration of the network.
+        //! layerIndex2LayerGroupId and runFullNet are ignored.
+        //! @param device_type Device to profile on. On EVE, only the layers
+        //! the import tool assigned to layersGroupId 1 are profiled.
+        //! @param num_frames Number of frames to average for each layer
+        LayerProfiler(const Configuration& configuration,
+                      DeviceType device_type, uint32_t num_frames = 4);
+
+        ~LayerProfiler();
+
+        //! @brief Profile the layers. Creates Executors on DeviceId::ID0 of
+        //! the device type, do not run other networks on it while
+        //! profiling.
+        //! @return false if there are no layers to profile on the device
+        bool Run();
+
+        //! @return Profile of each layer, in layer index order. Data layers
+        //! are not included.
+        const std::vector<LayerProfile>& GetLayerProfiles() const;
+
+        //! @brief Write the profiles as CSV, one line per layer:
+        //! layer index, layer type, cycles, device time in ms, MACs,
+        //! parameter bytes, output bytes
+        void WriteCSV(std::ostream& os) const;
+
+        LayerProfiler(const LayerProfiler&)            = delete;
+        LayerProfiler& operator=(const LayerProfiler&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
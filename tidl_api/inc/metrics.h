@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file metrics.h
+
+#pragma once
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class Metrics
+    @brief Snapshot of the runtime metrics of an ExecutionObject or
+    ExecutionObjectPipeline. Rolling values cover the most recent
+    Metrics::WINDOW_SIZE completed frames, up to the time of the snapshot,
+    so they decay when frames stop completing. Taking a snapshot does not
+    block frame processing and is cheap enough to poll from a monitoring
+    thread.
+*/
+struct Metrics
+{
+    //! Number of frames in the rolling window
+    static const uint32_t WINDOW_SIZE = 128;
+
+    //! Frames completed per second
+    float    fps               = 0;
+
+    //! Latency percentiles, from the start of a frame until its output is
+    //! available, in milliseconds
+    float    latencyP50Ms      = 0;
+    float    latencyP95Ms      = 0;
+    float    latencyP99Ms      = 0;
+
+    //! Percentage of wall time the device spent processing frames, from
+    //! the cycles reported by the device. For an ExecutionObjectPipeline,
+    //! the busiest device of the pipeline.
+    float    deviceBusyPercent = 0;
+
+    //! Frames currently in flight, and the maximum number of frames in
+    //! flight (contexts of an ExecutionObject, slots of a pipeline)
+    uint32_t framesInFlight    = 0;
+    uint32_t maxFramesInFlight = 0;
+
+    //! Totals since creation
+    uint64_t framesCompleted   = 0;
+    uint64_t framesFailed      = 0;
+
+    //! Frames not started because all contexts or slots were busy
+    uint64_t framesDropped     = 0;
+};
+
+} // namespace tidl
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file output_sink.h
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+
+namespace tidl {
+
+/*! @class SinkFrame
+    @brief Copy of a completed frame, handed to the SinkFunction of an
+    OutputSink. The buffers are valid until the function returns.
+*/
+class SinkFrame
+{
+    public:
+        //! @private
+        SinkFrame(int frame_idx, const std::vector<ArgInfo>& buffers):
+            frame_idx_m(frame_idx), buffers_m(buffers) {}
+
+        //! @return Index of the frame, as passed to OutputSink::Submit
+        int            GetFrameIndex() const { return frame_idx_m; }
+
+        //! @return Number of buffers copied from the frame
+        uint32_t       GetNumBuffers() const { return buffers_m.size(); }
+
+        //! @return Buffer i, in the order passed to OutputSink::Submit.
+        //! The pointer and size refer to the copy, the layout and format
+        //! are those of the submitted buffer.
+        const ArgInfo& GetBuffer(uint32_t i) const { return buffers_m[i]; }
+
+    private:
+        int                         frame_idx_m;
+        const std::vector<ArgInfo>& buffers_m;
+};
+
+//! Renders, encodes or writes out a frame. Returns false if it failed.
+typedef std::function<bool(const SinkFrame&)> SinkFunction;
+
+/*! @class OutputSink
+    @brief Consumes completed frames on worker threads, off the processing
+    loop.
+
+    Submit() copies the buffers of a completed frame into a staging slot
+    and returns, the frame is then free to be reused for the next input.
+    Worker threads run the SinkFunction on the copies, e.g. to draw the
+    detections, encode the frame and write it to a file or display it. A
+    slow disk or display then lowers the rate of frames written, not the
+    rate of frames processed.
+
+    At most queue_depth frames wait for a worker. When the queue is full,
+    Submit either drops the frame (Policy::DROP) or waits for a slot
+    (Policy::BLOCK). GetStats reports the frames dropped and the time
+    Submit waited, i.e. how much the sink holds back processing.
+
+    With a single worker, frames reach the SinkFunction in the order they
+    were submitted. Use a single worker for functions that must run on the
+    same thread, e.g. OpenCV imshow.
+*/
+class OutputSink
+{
+    public:
+        //! What Submit does when the queue is full
+        enum class Policy { DROP, BLOCK };
+
+        //! Counters since the sink was created
+        struct Stats
+        {
+            uint64_t framesSubmitted;  //!< Passed to Submit
+            uint64_t framesCompleted;  //!< SinkFunction returned true
+            uint64_t framesFailed;     //!< SinkFunction returned false
+                                       //!< or threw
+            uint64_t framesDropped;    //!< Queue was full, Policy::DROP
+            float    blockedMs;        //!< Time Submit waited for a slot
+            uint32_t queueDepth;       //!< Frames waiting for a worker
+            uint32_t maxQueueDepth;    //!< Highest queueDepth seen
+        };
+
+        //! @brief Start the worker threads
+        //! @param sink Function run on each frame, on a worker thread
+        //! @param queue_depth Frames that can wait for a worker
+        //! @param num_workers Number of worker threads
+        //! @param policy What Submit does when the queue is full
+        //! Throws an Exception if queue_depth or num_workers is 0.
+        OutputSink(SinkFunction sink, uint32_t queue_depth = 4,
+                   uint32_t num_workers = 1, Policy policy = Policy::DROP);
+
+        //! Run the SinkFunction on the queued frames and stop the workers
+        ~OutputSink();
+
+        //! @brief Copy buffers of a completed frame and queue it
+        //! @param frame_idx Index of the frame, see SinkFrame
+        //! @param buffers Buffers to copy, e.g. the input frame and the
+        //!        network output
+        //! @return false if the frame was dropped
+        bool Submit(int frame_idx, const std::vector<ArgInfo>& buffers);
+
+        //! @brief Copy the input and output buffers of the frame most
+        //! recently processed by an ExecutionObject or
+        //! ExecutionObjectPipeline, and queue it. Call after the frame
+        //! has completed. The input is buffer 0 of the SinkFrame, the
+        //! output buffer 1.
+        //! @return false if the frame was dropped
+        bool Submit(const ExecutionObjectInternalInterface& eo);
+
+        //! @brief Wait until the queued frames have been consumed
+        //! @return false if the SinkFunction failed on any frame so far
+        bool Flush();
+
+        //! @return Counters since the sink was created
+        Stats GetStats() const;
+
+        OutputSink(const OutputSink&)            = delete;
+        OutputSink& operator=(const OutputSink&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file partition_tuner.h
+
+#pragma once
+#include <map>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+
+#include "configuration.h"
+
+namespace tidl {
+
+/*! @class PartitionTuner
+    @brief Finds the split of a network between EVE (layersGroupId 1) and
+    DSP (layersGroupId 2) that balances the two pipeline stages.
+
+    The split produced by the import tool is the starting point: layers in
+    layersGroupId 1 with an index at or above the partition layer are moved
+    to layersGroupId 2. For each candidate partition layer the tuner
+    creates an EVE and a DSP Executor, runs frames through them and
+    measures the time each stage takes. The time of the EVE stage grows
+    and the time of the DSP stage shrinks as the partition layer moves
+    towards the end of the network, so the balanced split is found with a
+    binary search over the candidates. E.g.
+    @code
+      Configuration c;
+      c.ReadFromFile("path to configuration file");
+      PartitionTuner tuner(c, num_eves, num_dsps);
+      if (tuner.Run())
+          tuner.WriteConfiguration(std::cout);
+    @endcode
+    Frames are stage-throughput bound by max(EVE time / num_eves,
+    DSP time / num_dsps). Requires at least one EVE and one DSP.
+*/
+class PartitionTuner
+{
+    public:
+        //! Time taken by each stage, in milliseconds per frame
+        struct StageTimes
+        {
+            double eve_ms;
+            double dsp_ms;
+        };
+
+        //! @brief Create a tuner for a network
+        //! @param configuration Configuration of the network to partition.
+        //! layerIndex2LayerGroupId and runFullNet are ignored.
+        //! @param num_eves Number of EVEs that will run the first stage
+        //! @param num_dsps Number of DSPs that will run the second stage
+        //! @param num_frames Number of frames to time for each candidate
+        PartitionTuner(const Configuration& configuration,
+                       uint32_t num_eves, uint32_t num_dsps,
+                       uint32_t num_frames = 8);
+
+        ~PartitionTuner();
+
+        //! @brief Profile candidate partitions and pick the balanced one.
+        //! Creates Executors on one EVE and one DSP, do not run other
+        //! networks on them while tuning.
+        //! @return false if the network cannot be partitioned, e.g. it does
+        //! not have layers in both layersGroupIds
+        bool Run();
+
+        //! @return Index of the first layer moved to layersGroupId 2
+        int GetPartitionLayer() const;
+
+        //! @return Measured stage times for each candidate profiled, keyed
+        //! by partition layer
+        const std::map<int, StageTimes>& GetStageTimes() const;
+
+        //! @return The configuration with layerIndex2LayerGroupId set to the
+        //! balanced split
+        const Configuration& GetConfiguration() const;
+
+        //! @brief Write the layerIndex2LayerGroupId entry for the balanced
+        //! split in configuration file syntax
+        void WriteConfiguration(std::ostream& os) const;
+
+        PartitionTuner(const PartitionTuner&)            = delete;
+        PartitionTuner& operator=(const PartitionTuner&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file pipeline_depth_controller.h
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "execution_object_pipeline.h"
+
+namespace tidl {
+
+/*! @class PipelineDepthController
+    @brief Adjusts the number of frames in flight at runtime by enabling
+    and parking levels of a set of ExecutionObjectPipelines.
+
+    Applications duplicate their pipelines for double buffering: the EOPs
+    for depth 1, then another set for depth 2, and so on, as in the mcbench
+    example. A deeper pipeline raises throughput until the devices are
+    saturated, and adds a frame of latency per level. The controller
+    measures the throughput of the enabled levels over an interval and
+    moves the depth one level at a time towards the goal:
+    - Goal::MAX_THROUGHPUT adds a level while it raises the throughput
+      and the devices are not saturated, and parks a level that does not
+      contribute, probing again periodically as the load changes.
+    - Goal::MIN_LATENCY keeps the fewest levels that sustain min_fps.
+
+    The application calls Update() from its processing loop and only
+    starts frames on enabled EOPs. A parked EOP completes its frame in
+    flight and then stays idle. E.g.
+    @code
+      PipelineDepthController ctl(eops, num_eves + num_dsps,
+                              PipelineDepthController::Goal::MIN_LATENCY,
+                              25.0f);
+      for (uint32_t i = 0; running; i++)
+      {
+          ctl.Update();
+          ExecutionObjectPipeline* eop = eops[i % eops.size()];
+          if (eop->ProcessFrameWait())
+              WriteFrameOutput(*eop);
+          if (ctl.IsEnabled(i % eops.size()) && ReadFrame(*eop))
+              eop->ProcessFrameStartAsync();
+      }
+    @endcode
+    The controller is used from a single thread.
+*/
+class PipelineDepthController
+{
+    public:
+        //! Target of the controller
+        enum class Goal
+        {
+            //! Highest frames per second
+            MAX_THROUGHPUT,
+
+            //! Fewest frames in flight that sustain a minimum frame rate
+            MIN_LATENCY
+        };
+
+        //! @brief Create a controller, starting with all levels enabled
+        //! @param eops Pipelines, eops_per_level for each level of depth
+        //! @param eops_per_level Pipelines in each level, e.g. the number
+        //!        of devices processing frames in parallel
+        //! @param goal Target of the controller
+        //! @param min_fps Frame rate to sustain with Goal::MIN_LATENCY
+        //! @param interval_ms Time over which the throughput of a depth is
+        //!        measured before moving to another depth
+        PipelineDepthController(
+                        const std::vector<ExecutionObjectPipeline*>& eops,
+                        uint32_t eops_per_level, Goal goal,
+                        float min_fps = 0, uint32_t interval_ms = 1000);
+        ~PipelineDepthController();
+
+        //! @brief Measure the throughput and adjust the depth at the end of
+        //! each interval. Cheap otherwise, call once per frame.
+        //! @return true if the depth changed
+        bool Update();
+
+        //! @return true if frames can be started on eops[index]
+        bool IsEnabled(uint32_t index) const;
+
+        //! Current depth, in levels of eops_per_level pipelines
+        uint32_t GetDepth() const;
+
+        //! Number of levels in the pipelines passed to the constructor
+        uint32_t GetMaxDepth() const;
+
+        //! Frames per second completed in the last measured interval
+        float GetFps() const;
+
+        PipelineDepthController(const PipelineDepthController&) = delete;
+        PipelineDepthController& operator=(const PipelineDepthController&)
+                                                                   = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file postproc.h
+//! Host side processing of network outputs: top-k of classification
+//! scores, SSD detection decode and suppression, and segmentation class
+//! maps to colors. Vectorized with NEON on Arm.
+
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace tidl {
+namespace postproc {
+
+//! @brief Convert 8-bit network output to float. TIDL outputs are fixed
+//! point with a per-buffer scale dataQ in Q8, float = value * 256 / dataQ.
+//! @param data size 8-bit values, int8_t if is_signed, uint8_t otherwise
+//! @param dataQ Q factor of the output buffer, e.g. from
+//! ExecutionObject::GetOutputDataQ. Values convert to 0 if dataQ is 0.
+//! @param out size floats
+void Dequantize(const void *data, int size, int dataQ, bool is_signed,
+                float *out);
+
+//! Score and its index in the network output
+typedef std::pair<uint8_t, int> ScoreIndex;
+
+//! @brief Find the k largest scores in scores[0, size). Equal scores are
+//! ordered by index, the lower index ranks higher.
+//! @param sorted Set to the k largest scores in ascending order, the
+//! largest score is last. Holds size scores if size < k.
+void TopK(const uint8_t *scores, int size, int k,
+          std::vector<ScoreIndex>& sorted);
+
+//! Object detected by an SSD network, box corners in pixels
+struct DetectedObject
+{
+    int   label;
+    float score;
+    int   xmin;
+    int   ymin;
+    int   xmax;
+    int   ymax;
+};
+
+//! @brief Decode the detection output of an SSD network. Each object is
+//! described by 7 floats: index, label, score, xmin, ymin, xmax, ymax.
+//! Coordinates are normalized to [0, 1]. Decoding stops at the first
+//! negative index.
+//! @param width Image width the coordinates are scaled to
+//! @param height Image height the coordinates are scaled to
+//! @param confidence_value Objects with score * 100 below it are skipped
+//! @param objects Set to the decoded objects, in output order
+void DecodeBoxes(const float *out, int num_floats, int width, int height,
+                 float confidence_value, std::vector<DetectedObject>& objects);
+
+//! @brief Non-maximum suppression. Removes each object that overlaps an
+//! object of the same label with a higher score by more than max_iou
+//! (intersection over union). The TIDL detection output layer already
+//! suppresses overlaps, use this for networks that output raw boxes.
+//! @param objects Objects to filter, left ordered by descending score
+void SuppressOverlaps(std::vector<DetectedObject>& objects, float max_iou);
+
+//! Color of a segmentation class
+struct Color
+{
+    uint8_t blue;
+    uint8_t green;
+    uint8_t red;
+};
+
+//! @brief Map a per-pixel class output to colors, one plane per channel
+//! @param classes Class index of each pixel
+//! @param size Number of pixels
+//! @param colors Color of each class
+//! @param unknown Color of class indices without an entry in colors
+//! @param blue, green, red Color planes of size bytes
+void ColorizeClasses(const uint8_t *classes, int size,
+                     const std::vector<Color>& colors, Color unknown,
+                     uint8_t *blue, uint8_t *green, uint8_t *red);
+
+//! @brief Blend the colors of a per-pixel class output over an image in a
+//! single pass, e.g. to display segmentation. Optionally downscales by an
+//! integer factor, sampling the nearest pixel, so that the blend only
+//! visits the output pixels.
+//! @param classes Class index of each pixel, width x height
+//! @param width, height Size of the class output and of the image
+//! @param image BGR image, interleaved, or three planes if planar
+//! @param colors Color of each class
+//! @param unknown Color of class indices without an entry in colors
+//! @param alpha Weight of the class colors, in [0, 1]
+//! @param factor Downscale factor, 1 for full resolution
+//! @param out Interleaved BGR overlay of width / factor x height / factor
+void BlendClasses(const uint8_t *classes, int width, int height,
+                  const uint8_t *image, bool planar,
+                  const std::vector<Color>& colors, Color unknown,
+                  float alpha, int factor, uint8_t *out);
+
+} // namespace tidl::postproc
+} // namespace tidl
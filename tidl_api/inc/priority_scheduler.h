@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file priority_scheduler.h
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+#include "execution_object.h"
+
+namespace tidl {
+
+/*! @class PriorityScheduler
+    @brief Shares DSP/EVE devices between multiple networks, scheduling
+    frames by priority and deadline.
+
+    Each network is added with the ExecutionObjects of its Executor(s) and
+    a priority. ExecutionObjects of different networks on the same device
+    (per ExecutionObject::GetDeviceName) share that device: the scheduler
+    runs one frame at a time on each device and, whenever the device
+    becomes idle, starts the pending frame with the highest network
+    priority. Frames of equal priority run earliest deadline first, then
+    in submission order. A frame of a latency critical network therefore
+    waits for at most one frame of a lower priority network on the device.
+    Frames are not preempted once started. E.g.
+    @code
+      PriorityScheduler s;
+      int detector   = s.AddNetwork(detector_eos,   10, on_detection);
+      int classifier = s.AddNetwork(classifier_eos,  0, on_class);
+
+      s.Submit(detector, FrameDescriptor(in, out, i),
+               PriorityScheduler::Clock::now() + std::chrono::milliseconds(30));
+      s.Submit(classifier, FrameDescriptor(in2, out2, j));
+    @endcode
+
+    The scheduler does not own the ExecutionObjects. They must not be used
+    by the application while the scheduler exists.
+*/
+class PriorityScheduler
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        //! @brief Called on completion of a frame, from a scheduler thread.
+        //! Calls for frames on different devices can be concurrent.
+        //! @param frame Frame as submitted
+        //! @param eo ExecutionObject used to process the frame
+        //! @param status false if processing the frame failed, or if the
+        //!        frame was dropped because its deadline had passed
+        typedef std::function<void(const FrameDescriptor& frame,
+                                   ExecutionObjectInternalInterface& eo,
+                                   bool status)> CompletionCallback;
+
+        //! @brief Create a scheduler
+        //! @param drop_expired If true, frames whose deadline has passed
+        //!        before they are started are dropped instead of processed.
+        //!        The completion callback is invoked with status false.
+        PriorityScheduler(bool drop_expired = false);
+
+        //! Wait for all submitted frames to complete and tear down
+        ~PriorityScheduler();
+
+        //! @brief Add a network
+        //! @param eos ExecutionObjects of the network, at most one per
+        //!        device. A frame of the network runs on whichever of these
+        //!        devices becomes available first.
+        //! @param priority Frames of networks with larger values are
+        //!        started first
+        //! @param on_complete Invoked after each frame of the network
+        //! @return Identifier of the network, used with Submit
+        int  AddNetwork(const std::vector<ExecutionObject*>& eos,
+                        int priority, CompletionCallback on_complete);
+
+        //! @brief Submit a frame of a network for processing. The frame's
+        //! input and output buffers must remain valid until its completion
+        //! callback returns.
+        //! @param network Identifier returned by AddNetwork
+        //! @param frame Input/output buffers and index of the frame
+        //! @param deadline Time by which the frame should complete. Orders
+        //!        frames of equal priority.
+        void Submit(int network, const FrameDescriptor& frame,
+                    Clock::time_point deadline = Clock::time_point::max());
+
+        //! Wait until all submitted frames have completed
+        void Drain();
+
+        //! @return Number of frames completed, including failed frames
+        uint32_t GetNumFramesCompleted() const;
+
+        //! @return Number of frames for which processing failed
+        uint32_t GetNumFramesFailed() const;
+
+        //! @return Number of frames dropped because of an expired deadline
+        uint32_t GetNumFramesExpired() const;
+
+        PriorityScheduler(const PriorityScheduler&)            = delete;
+        PriorityScheduler& operator=(const PriorityScheduler&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file reorder_buffer.h
+
+#pragma once
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object.h"
+
+namespace tidl {
+
+/*! @class ReorderBuffer
+    @brief Delivers completed frames in frame index order.
+
+    Frames scheduled onto whichever ExecutionObject or
+    ExecutionObjectPipeline is idle, e.g. by a Dispatcher, complete out of
+    order. Completed frames are passed to Complete() and held until all
+    frames with a lower index have been delivered. Complete() does not
+    wait for missing frames, so the thread completing a frame is free to
+    dispatch the next one. At most window frames are held: if a frame is
+    completed with a full window, the missing frames before the oldest held
+    frame are skipped. With a skip timeout, a missing frame is also
+    skipped once it has been waited for that long. Skipped frames that
+    complete later are discarded. E.g.
+    @code
+      ReorderBuffer rb([](const FrameDescriptor& f, bool status)
+                       { WriteFrameOutput(f.GetOutput()); }, 8);
+      Dispatcher d(eops, [&rb](const FrameDescriptor& f,
+                                ExecutionObjectInternalInterface& eop,
+                                bool status)
+                         { rb.Complete(f, status); });
+      ...
+      d.Drain();
+      rb.Flush();
+    @endcode
+*/
+class ReorderBuffer
+{
+    public:
+        //! @brief Called for each completed frame, in frame index order.
+        //! Calls are not concurrent. The output buffer of the frame can be
+        //! reused once the call returns.
+        //! @param frame Frame as passed to Complete
+        //! @param status false if processing the frame failed
+        typedef std::function<void(const FrameDescriptor& frame,
+                                   bool status)> DeliverCallback;
+
+        //! @brief Create a ReorderBuffer
+        //! @param deliver Called for each frame, in order
+        //! @param window Maximum number of completed frames held while
+        //!        waiting for a missing frame, at least 1
+        //! @param skip_timeout Time to wait for a missing frame before it
+        //!        is skipped. 0 waits until the window is full.
+        //! @param first_frame_idx Index of the first frame delivered
+        ReorderBuffer(DeliverCallback deliver, uint32_t window,
+                      std::chrono::milliseconds skip_timeout =
+                                                std::chrono::milliseconds(0),
+                      int first_frame_idx = 0);
+
+        //! Stop the skip timer. Held frames are not delivered, see Flush.
+        ~ReorderBuffer();
+
+        //! @brief Pass a completed frame. Delivers it, and the held frames
+        //! that follow it, if all frames before it have been delivered.
+        //! Returns without delivering if another thread is delivering.
+        //! @param frame Frame, ordered by FrameDescriptor::GetFrameIndex
+        //! @param status false if processing the frame failed
+        void Complete(const FrameDescriptor& frame, bool status);
+
+        //! @brief Deliver all held frames, skipping the missing frames
+        //! between them. Call once all frames have completed, e.g. after
+        //! Dispatcher::Drain.
+        void Flush();
+
+        //! @return Index of the next frame to deliver
+        int GetNextFrameIndex() const;
+
+        //! @return Number of frames skipped because the window was full or
+        //! the skip timeout expired
+        uint32_t GetNumFramesSkipped() const;
+
+        //! @return Number of frames discarded because they completed after
+        //! they were skipped
+        uint32_t GetNumFramesLate() const;
+
+        ReorderBuffer(const ReorderBuffer&)            = delete;
+        ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
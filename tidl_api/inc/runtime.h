@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file runtime.h
+
+#pragma once
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "configuration.h"
+
+namespace tidl {
+
+class Executor;
+class ExecutionObjectPipeline;
+
+/*! @class Runtime
+    @brief Creates the Executors and ExecutionObjectPipelines described by
+    the topology of a Configuration.
+
+    The Executors listed in Configuration::topologyExecutors are created
+    concurrently. With topologyPipelined, the i-th pipeline chains the
+    (i mod n)-th ExecutionObject of each Executor, where n is the number of
+    cores of the largest Executor. Otherwise each ExecutionObject is a
+    pipeline of its own. Either set of pipelines is repeated topologyDepth
+    times, so that frames are read while earlier frames are processed. The
+    topology is read with the rest of the configuration, e.g.
+    @code
+      # tidl_config.txt: EVEs run layers group 1, DSPs layers group 2
+      topologyExecutors = { {EVE, 0, 1}, {DSP, 0, 2} }
+      topologyDepth     = 2
+    @endcode
+    @code
+      Configuration c;
+      c.ReadFromFile("tidl_config.txt");
+      Runtime runtime(c);
+      for (auto eop : runtime.GetExecutionObjectPipelines())
+          ...
+    @endcode
+    Retuning the topology for a device does not require rebuilding the
+    application.
+*/
+class Runtime
+{
+    public:
+        //! @brief Create the Executors and pipelines of a topology
+        //! @param configuration Network configuration and topology. If
+        //! topologyExecutors is empty, every EVE and DSP runs the full
+        //! network.
+        //! Throws an Exception if an Executor requires more cores than
+        //! available, or if no core is available.
+        explicit Runtime(const Configuration& configuration);
+
+        //! Delete the pipelines, then the Executors
+        ~Runtime();
+
+        //! @return Pipelines of the topology, owned by the Runtime
+        const std::vector<ExecutionObjectPipeline*>&
+                                    GetExecutionObjectPipelines() const;
+
+        //! @return Number of Executors created
+        uint32_t GetNumExecutors() const;
+
+        //! @return Executor at index, in topologyExecutors order
+        Executor* GetExecutor(uint32_t index) const;
+
+        Runtime(const Runtime&)            = delete;
+        Runtime& operator=(const Runtime&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
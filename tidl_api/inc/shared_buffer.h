@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file shared_buffer.h
+
+#pragma once
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "executor.h"
+
+namespace tidl {
+
+//! @brief Identifies a SharedBuffer across processes. Plain data, send it
+//! to the other process over any IPC channel, e.g. a socket or a pipe.
+struct SharedBufferHandle
+{
+    //! Physical address of the buffer in CMEM
+    uint64_t physAddr;
+
+    //! Size of the buffer in bytes
+    uint64_t size;
+};
+
+/*! @class SharedBuffer
+    @brief Buffer in CMEM shared by processes without copies.
+
+    The process running the network allocates the buffers, e.g. the input
+    and output buffers of an ExecutionObject, and sends their handles to
+    the other processes. These map the same physical memory, and read or
+    write frames in place. E.g. a capture process writes a frame into a
+    shared input buffer, then sends its index to the inference process,
+    which processes the frame and sends the index back when the output
+    buffer holds the result:
+    @code
+      // Inference process
+      SharedBuffer in(eo->GetInputBufferSizeInBytes());
+      SharedBuffer out(eo->GetOutputBufferSizeInBytes());
+      eo->SetInputOutputBuffer(in.GetArgInfo(), out.GetArgInfo());
+      SendHandles(socket, in.GetHandle(), out.GetHandle());
+
+      // Capture process
+      SharedBuffer in(ReceiveHandle(socket));
+      ReadFrame(in.ptr());
+    @endcode
+    Only buffers allocated by the process are used in place by the
+    devices, the mapping of another process is copied if passed to an
+    ExecutionObject. The processes synchronize access to the buffers, e.g.
+    with the messages carrying the buffer indices. Requires the CMEM
+    driver, link with -lticmem.
+*/
+class SharedBuffer
+{
+    public:
+        //! @brief Allocate a buffer of size bytes in CMEM, used in place by
+        //! the devices. Throws if it cannot be allocated.
+        explicit SharedBuffer(size_t size);
+
+        //! @brief Map a buffer allocated by another process. The buffer
+        //! must stay allocated while mapped. Throws if it cannot be mapped.
+        explicit SharedBuffer(const SharedBufferHandle& handle);
+
+        //! Free the buffer if allocated by this process, else unmap it
+        ~SharedBuffer();
+
+        //! Address of the buffer in this process
+        void*  ptr()  const;
+
+        //! Size of the buffer in bytes
+        size_t size() const;
+
+        //! Handle to map the buffer in another process
+        SharedBufferHandle GetHandle() const;
+
+        //! The buffer as an input or output buffer of an ExecutionObject
+        ArgInfo GetArgInfo() const;
+
+        //! true if the buffer was allocated by this process
+        bool IsOwner() const;
+
+        SharedBuffer(const SharedBuffer&)            = delete;
+        SharedBuffer& operator=(const SharedBuffer&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+//! @file stream_multiplexer.h
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "metrics.h"
+
+namespace tidl {
+
+/*! @class StreamMultiplexer
+    @brief Shares a pool of ExecutionObjects or ExecutionObjectPipelines
+    between multiple input streams, e.g. cameras, with weighted fair
+    scheduling across the streams.
+
+    Each stream has its own bounded queue. Whenever an
+    ExecutionObject/Pipeline of the pool becomes idle, it takes the next
+    frame of the stream that has received the smallest share of frames
+    relative to its weight. A stream with weight 2 gets twice the frames
+    of a stream with weight 1 while both have frames queued. A stream that
+    submits faster than its share only fills its own queue, it does not
+    delay the frames of the other streams. E.g.
+    @code
+      StreamMultiplexer m(eops);
+      std::vector<int> streams;
+      for (int i = 0; i < num_cameras; i++)
+          streams.push_back(m.AddStream(
+              [i](const FrameDescriptor& f,
+                  ExecutionObjectInternalInterface& eop, bool status)
+              { WriteFrameOutput(i, f.GetOutput()); }));
+
+      // From each camera's capture thread
+      m.Submit(streams[i], FrameDescriptor(in, out, frame_idx));
+    @endcode
+
+    A stream that was idle does not accumulate credit: it resumes at the
+    share of the streams that kept the pool busy, so it cannot lock the
+    others out once it starts submitting again.
+
+    The multiplexer does not own the ExecutionObjects or
+    ExecutionObjectPipelines. They must not be used by the application
+    while the multiplexer exists.
+*/
+class StreamMultiplexer
+{
+    public:
+        //! @brief Called on completion of a frame of a stream, from a
+        //! multiplexer thread. Calls for different frames can be concurrent,
+        //! including frames of the same stream.
+        //! @param frame Frame as submitted
+        //! @param eo ExecutionObject or ExecutionObjectPipeline used to
+        //!        process the frame. Can be used to query per-frame data,
+        //!        e.g. trace outputs, until the callback returns.
+        //! @param status false if processing the frame failed
+        typedef std::function<void(const FrameDescriptor& frame,
+                                   ExecutionObjectInternalInterface& eo,
+                                   bool status)> CompletionCallback;
+
+        //! @brief Create a multiplexer for a pool of ExecutionObjects
+        //! @param eos ExecutionObjects shared by all streams
+        StreamMultiplexer(const std::vector<ExecutionObject*>& eos);
+
+        //! @brief Create a multiplexer for a pool of ExecutionObjectPipelines
+        //! @param eops ExecutionObjectPipelines shared by all streams
+        StreamMultiplexer(const std::vector<ExecutionObjectPipeline*>& eops);
+
+        //! Wait for all submitted frames to complete and tear down
+        ~StreamMultiplexer();
+
+        //! @brief Add a stream. Streams can be added while frames of other
+        //! streams are being processed.
+        //! @param on_complete Invoked after each frame of the stream
+        //! @param weight Relative share of the pool for the stream, at
+        //!        least 1
+        //! @param queue_depth Maximum number of frames of the stream waiting
+        //!        for the pool. Defaults to the number of
+        //!        ExecutionObjects/Pipelines in the pool.
+        //! @return Identifier of the stream, used with Submit
+        int  AddStream(CompletionCallback on_complete, uint32_t weight = 1,
+                       uint32_t queue_depth = 0);
+
+        //! @brief Submit a frame of a stream for processing. Blocks while
+        //! the stream's queue is full. The frame's input and output buffers
+        //! must remain valid until its completion callback returns.
+        //! @param stream Identifier returned by AddStream
+        //! @param frame Input/output buffers and index of the frame
+        void Submit(int stream, const FrameDescriptor& frame);
+
+        //! @brief Submit a frame of a stream if the stream's queue is not
+        //! full. E.g. for live cameras, where a frame that cannot be queued
+        //! is better dropped than delaying capture.
+        //! @param stream Identifier returned by AddStream
+        //! @param frame Input/output buffers and index of the frame
+        //! @return false if the queue is full, the frame is not submitted
+        //!         and counts as dropped in the stream's metrics
+        bool TrySubmit(int stream, const FrameDescriptor& frame);
+
+        //! Wait until all submitted frames have completed
+        void Drain();
+
+        //! @return Number of streams added
+        uint32_t GetNumStreams() const;
+
+        //! @return Metrics of a stream. Latency is measured from Submit,
+        //! including the time the frame waited for the pool.
+        //! framesInFlight is the number of frames of the stream queued or
+        //! being processed, maxFramesInFlight its queue depth plus the
+        //! size of the pool.
+        Metrics GetStreamMetrics(int stream) const;
+
+        StreamMultiplexer(const StreamMultiplexer&)            = delete;
+        StreamMultiplexer& operator=(const StreamMultiplexer&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,114 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file tiling.h
+//! Tiled inference of frames larger than the network input: overlapping
+//! tiles of the network resolution are processed in parallel on the
+//! ExecutionObjects or ExecutionObjectPipelines, and their outputs are
+//! merged into results for the full frame.
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "executor.h"
+#include "execution_object_internal.h"
+#include "postproc.h"
+
+namespace tidl {
+namespace tiling {
+
+//! Rectangle of the frame processed as one network input, in pixels
+struct Tile
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+//! @brief Cover a frame with tiles of the network input size, overlapping
+//! by at least min_overlap pixels. Tiles are spread evenly, the first and
+//! last tile of each row and column are aligned with the frame edges.
+//! Frames smaller than a tile in a dimension get one tile in that
+//! dimension, cropped to the frame.
+//! @return Tiles in row-major order
+std::vector<Tile> ComputeTiles(int frame_width, int frame_height,
+                               int tile_width, int tile_height,
+                               int min_overlap);
+
+//! @brief Called to prepare the input of a tile in eo, e.g. by copying
+//! the tile of the frame into eo.GetInputBufferPtr()
+//! @return false to skip the tile
+typedef std::function<bool(uint32_t tile,
+                           ExecutionObjectInternalInterface& eo)> FillTile;
+
+//! @brief Called with the output of a tile in eo. Calls are made on the
+//! thread calling ProcessTiles, in the order the tiles complete.
+typedef std::function<void(uint32_t tile,
+                           ExecutionObjectInternalInterface& eo)> CollectTile;
+
+//! @brief Process num_tiles tiles on eos in parallel. Tile i runs on
+//! eos[i % eos.size()], each EO or EOP processes one tile at a time, so
+//! pass several EOPs per device to overlap filling with processing.
+//! @return false if a tile failed or eos is empty
+bool ProcessTiles(const std::vector<ExecutionObjectInternalInterface*>& eos,
+                  uint32_t num_tiles, FillTile fill, CollectTile collect);
+
+//! @brief Merge the objects detected in each tile into objects of the
+//! frame. Box coordinates of a tile's objects are in pixels of the tile,
+//! e.g. from postproc::DecodeBoxes with the tile size. Boxes touching a
+//! tile edge inside the frame are cut by the tile: they are dropped when
+//! another tile sees the object whole, and joined when the object is too
+//! large for any tile. Duplicates from overlapping tiles are suppressed
+//! per label, like postproc::SuppressOverlaps.
+//! @param objects Objects of each tile, indexed like tiles
+//! @param max_iou Duplicates overlap by more than this
+//! (intersection over union)
+//! @param merged Set to the objects of the frame, by descending score
+void MergeDetections(
+            const std::vector<std::vector<postproc::DetectedObject>>& objects,
+            const std::vector<Tile>& tiles, float max_iou,
+            std::vector<postproc::DetectedObject>& merged);
+
+//! @brief Stitch the per-pixel class outputs of the tiles, e.g. of a
+//! segmentation network, into a class map of the frame. In the overlap of
+//! two tiles, each pixel is taken from the tile whose edge is farther, so
+//! the seam runs through the middle of the overlap, away from the tile
+//! borders where the network lacks context.
+//! @param classes Class output of each tile, tile width x height bytes,
+//! indexed like tiles from ComputeTiles
+//! @param out Class map of the frame, frame_width x frame_height bytes
+void StitchClasses(const std::vector<const uint8_t*>& classes,
+                   const std::vector<Tile>& tiles,
+                   int frame_width, int frame_height, uint8_t* out);
+
+} // namespace tidl::tiling
+} // namespace tidl
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file v4l2_capture.h
+
+#pragma once
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "executor.h"
+
+namespace tidl {
+
+/*! @class V4L2Capture
+    @brief Captures frames from a V4L2 camera directly into CMEM buffers.
+
+    The capture buffers are allocated with __malloc_ddr and handed to the
+    driver as user pointers, so the camera DMA writes each frame to memory
+    that the device and the preprocessing read in place. A dequeued frame
+    is used as the raw input of an ExecutionObjectPipeline preprocessing
+    stage, or as ExecutionObject input if the camera already produces the
+    network input format, without an intermediate cv::Mat or copy. E.g.
+    @code
+      V4L2Capture camera("/dev/video1", 1280, 720, V4L2_PIX_FMT_NV12);
+      eop->SetPreprocessStage(ConvertNV12, camera.GetFrameSize());
+      ArgInfo frame(nullptr, 0);
+      while (camera.DequeueFrame(frame))
+      {
+          eop->SetInputOutputBuffer(frame, out);
+          eop->ProcessFrameStartAsync();
+          eop->ProcessFrameWait();
+          camera.QueueFrame(frame);
+      }
+    @endcode
+*/
+class V4L2Capture
+{
+    public:
+        //! @brief Open a V4L2 capture device and start streaming
+        //! @param device Device node, e.g. /dev/video1
+        //! @param width Requested frame width
+        //! @param height Requested frame height
+        //! @param pixel_format V4L2 fourcc, e.g. V4L2_PIX_FMT_NV12. Throws
+        //! if the driver does not support it.
+        //! @param num_buffers Number of capture buffers. Bounds the number
+        //! of frames held by the caller plus the frames queued to the
+        //! driver.
+        //! The driver may adjust the frame dimensions, see GetWidth() and
+        //! GetHeight(). Throws if the device does not support streaming
+        //! into user pointer buffers.
+        V4L2Capture(const std::string& device, uint32_t width,
+                    uint32_t height, uint32_t pixel_format,
+                    uint32_t num_buffers = 4);
+
+        //! Stop streaming, close the device and free the capture buffers
+        ~V4L2Capture();
+
+        //! @brief Wait for the next captured frame
+        //! @param frame Set to the CMEM buffer holding the frame. The
+        //! buffer belongs to the caller until returned via QueueFrame.
+        //! @return false on a capture error
+        bool DequeueFrame(ArgInfo& frame);
+
+        //! Return a frame obtained from DequeueFrame to the driver, once
+        //! it has been processed
+        void QueueFrame(const ArgInfo& frame);
+
+        //! @return Frame width set by the driver
+        uint32_t GetWidth() const;
+
+        //! @return Frame height set by the driver
+        uint32_t GetHeight() const;
+
+        //! @return Bytes per line of the first plane set by the driver.
+        //! Larger than the width times the bytes per pixel if the driver
+        //! pads lines.
+        uint32_t GetBytesPerLine() const;
+
+        //! @return Size in bytes of a captured frame
+        size_t   GetFrameSize() const;
+
+        V4L2Capture(const V4L2Capture&)            = delete;
+        V4L2Capture& operator=(const V4L2Capture&) = delete;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
+};
+
+} // namespace tidl
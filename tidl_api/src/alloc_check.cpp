@@ -0,0 +1,121 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file alloc_check.cpp */
+
+#include "alloc_check.h"
+
+#ifdef TIDL_API_ALLOC_CHECK
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+
+using namespace tidl;
+
+namespace {
+
+// Plain integers, operator new must not depend on dynamic initialization
+thread_local uint64_t num_allocs    = 0;
+thread_local uint32_t exclude_depth = 0;
+
+void* Allocate(std::size_t size)
+{
+    if (exclude_depth == 0)
+        num_allocs++;
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    void* p = Allocate(size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = Allocate(size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void operator delete(void* p) noexcept                          { free(p); }
+void operator delete[](void* p) noexcept                        { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept   { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+uint64_t AllocCheck::GetCount()
+{
+    return num_allocs;
+}
+
+AllocCheck::Scope::Scope(Counter& counter, const char* name):
+    name_m(name), start_m(num_allocs),
+    warm_m(counter.calls_m.fetch_add(1) >= WARMUP)
+{}
+
+// An exception on the way out may allocate, e.g. its message, and is not
+// a steady state frame
+AllocCheck::Scope::~Scope()
+{
+    if (!warm_m || std::uncaught_exception() || num_allocs == start_m)
+        return;
+
+    std::fprintf(stderr, "TIDL API: %s allocated %llu time(s) after "
+                 "warm-up\n", name_m,
+                 static_cast<unsigned long long>(num_allocs - start_m));
+    std::abort();
+}
+
+AllocCheck::Exclude::Exclude()
+{
+    exclude_depth++;
+}
+
+AllocCheck::Exclude::~Exclude()
+{
+    exclude_depth--;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file alloc_check.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace tidl {
+
+/*! @class AllocCheck
+    @brief Debug check that frames do not allocate once warmed up
+
+    Built with ALLOC_CHECK=1 (TIDL_API_ALLOC_CHECK), the library replaces
+    operator new to count the allocations of each thread. A Scope placed
+    on a call of the frame path aborts with a message if the thread
+    allocated during the call, once the object owning the Counter has run
+    WARMUP checked calls. Allocations within an Exclude, e.g. by the
+    OpenCL runtime or a user callback, are not counted.
+
+    Otherwise the classes are empty and the checks compile out.
+*/
+class AllocCheck
+{
+    public:
+        //! Checked calls of an object that may allocate, e.g. buffers or
+        //! descriptors bound on the first frames
+        static const uint32_t WARMUP = 16;
+
+#ifdef TIDL_API_ALLOC_CHECK
+        //! Allocations made by the calling thread so far
+        static uint64_t GetCount();
+
+        class Scope;
+
+        //! Checked calls made on an object, one per EO or EOP
+        class Counter
+        {
+            public:
+                Counter(): calls_m(0) {}
+            private:
+                friend class Scope;
+                std::atomic<uint32_t> calls_m;
+        };
+
+        class Scope
+        {
+            public:
+                Scope(Counter& counter, const char* name);
+                ~Scope();
+
+                //! Do not check the call, e.g. the frame failed
+                void Skip() { warm_m = false; }
+
+                Scope(const Scope&)            = delete;
+                Scope& operator=(const Scope&) = delete;
+            private:
+                const char* name_m;
+                uint64_t    start_m;
+                bool        warm_m;
+        };
+
+        class Exclude
+        {
+            public:
+                Exclude();
+                ~Exclude();
+
+                Exclude(const Exclude&)            = delete;
+                Exclude& operator=(const Exclude&) = delete;
+        };
+#else
+        class Counter {};
+
+        class Scope
+        {
+            public:
+                Scope(Counter&, const char*) {}
+                void Skip() {}
+        };
+
+        class Exclude
+        {
+            public:
+                Exclude() {}
+        };
+#endif
+};
+
+} // namespace tidl
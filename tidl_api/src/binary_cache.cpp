@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file binary_cache.cpp */
+
+#include <sys/stat.h>
+#include <map>
+#include <mutex>
+#include "executor.h"
+#include "binary_cache.h"
+#include "util.h"
+#include "network_binary.h"
+
+using namespace tidl;
+
+ParamBinary::ParamBinary(size_t size):
+    data_m(malloc_ddr<char>(size), &__free_ddr), size_m(size)
+{
+    if (data_m == nullptr)
+        throw Exception("Out of memory, parameter binary malloc_ddr failed "
+                        "for " + std::to_string(size) + " bytes",
+                        __FILE__, __FUNCTION__, __LINE__);
+}
+
+// Key is built from the path, size and modification time so that a file
+// updated on disk (e.g. a model reload) is read again.
+static bool GetCacheKey(const std::string& file, std::string& key)
+{
+    struct stat buffer;
+    if (stat(file.c_str(), &buffer) != 0)
+        return false;
+
+    key = file + ":" + std::to_string(buffer.st_size)
+               + ":" + std::to_string(buffer.st_mtime);
+    return true;
+}
+
+// Look up a cache entry, create it with read_func if it is not present or
+// has been released by all users
+template<class T, class F>
+static std::shared_ptr<const T> Lookup(const std::string& file, F read_func)
+{
+    static std::mutex m;
+    static std::map<std::string, std::weak_ptr<const T>> cache;
+
+    std::string key;
+    if (!GetCacheKey(file, key))
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(m);
+
+    std::shared_ptr<const T> entry = cache[key].lock();
+    if (entry)
+        return entry;
+
+    // Drop entries released by all users, including older versions of file
+    for (auto it = cache.begin(); it != cache.end(); )
+        if (it->second.expired())  it = cache.erase(it);
+        else                       ++it;
+
+    entry = read_func(file);
+    if (entry)
+        cache[key] = entry;
+
+    return entry;
+}
+
+BinaryCache::NetworkPtr BinaryCache::GetNetwork(const std::string& file)
+{
+    return Lookup<sTIDL_Network_t>(file, [](const std::string& f)
+    {
+        std::shared_ptr<sTIDL_Network_t> net(new sTIDL_Network_t);
+        if (!ReadNetworkBinary(f, reinterpret_cast<char *>(net.get())))
+            net.reset();
+        return std::shared_ptr<const sTIDL_Network_t>(net);
+    });
+}
+
+BinaryCache::ParamsPtr BinaryCache::GetParams(const std::string& file)
+{
+    return Lookup<ParamBinary>(file, [](const std::string& f)
+    {
+        // A compact container is decoded directly into the DDR buffer
+        bool   compact = IsCompactNetworkBinary(f);
+        size_t size    = compact ? GetCompactParamsSize(f)
+                                 : GetBinaryFileSize(f);
+        if (size == 0)
+            return ParamsPtr(nullptr);
+
+        std::shared_ptr<ParamBinary> params(new ParamBinary(size));
+        bool status = compact ? ReadCompactParams(f, params->data(), size)
+                              : ReadBinary(f, params->data(), size);
+        if (!status)
+            params.reset();
+        return ParamsPtr(params);
+    });
+}
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file binary_cache.h
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include "executor.h"
+#include "tidl_create_params.h"
+
+namespace tidl {
+
+/*! @class ParamBinary
+ *  @brief Contents of a TIDL parameter binary file, in DDR (CMEM) so that
+ *         it can be passed to the setup kernel without a copy.
+ */
+class ParamBinary
+{
+    public:
+        //! Allocates size bytes in DDR, throws Exception if CMEM is
+        //! exhausted
+        ParamBinary(size_t size);
+
+        char*  data() const { return data_m.get(); }
+        size_t size() const { return size_m; }
+
+        ParamBinary(const ParamBinary&)            = delete;
+        ParamBinary& operator=(const ParamBinary&) = delete;
+
+    private:
+        up_malloc_ddr<char> data_m;
+        size_t              size_m;
+};
+
+/*! @class BinaryCache
+ *  @brief Process wide cache of network and parameter binaries, keyed by
+ *         file path, size and modification time. Entries are reference
+ *         counted and released when the last Executor using them is
+ *         destroyed. Executors for different layer groups of the same
+ *         network read the files once.
+ */
+class BinaryCache
+{
+    public:
+        typedef std::shared_ptr<const sTIDL_Network_t> NetworkPtr;
+        typedef std::shared_ptr<const ParamBinary>     ParamsPtr;
+
+        //! @return Parsed network binary, nullptr if the file can't be read
+        static NetworkPtr GetNetwork(const std::string& file);
+
+        //! @return Parameter binary, nullptr if the file can't be read.
+        //! Throws Exception if the DDR buffer can't be allocated.
+        static ParamsPtr  GetParams (const std::string& file);
+};
+
+} // namespace tidl
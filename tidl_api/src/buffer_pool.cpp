@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file buffer_pool.cpp */
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include "executor.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "buffer_pool.h"
+
+using namespace tidl;
+
+class BufferPool::Impl
+{
+    public:
+        Impl(): bytes_m(0) {}
+        ~Impl();
+
+        char* Acquire(size_t size);
+        void  Release(void* buffer);
+        void  Trim();
+
+        mutable std::mutex                     mutex_m;
+        // Size class of each buffer allocated by the pool
+        std::map<char*, size_t>                buffers_m;
+        // Idle buffers, by size class
+        std::map<size_t, std::vector<char*>>   idle_m;
+        size_t                                 bytes_m;
+};
+
+const size_t BufferPool::SIZE_CLASS_GRANULE;
+
+BufferPool::BufferPool(): pimpl_m(new Impl)
+{}
+
+BufferPool::~BufferPool() = default;
+
+size_t BufferPool::GetSizeClass(size_t size)
+{
+    if (size == 0) size = 1;
+    return (size + SIZE_CLASS_GRANULE - 1) / SIZE_CLASS_GRANULE
+                                           * SIZE_CLASS_GRANULE;
+}
+
+char* BufferPool::Acquire(size_t size)
+{
+    return pimpl_m->Acquire(size);
+}
+
+void BufferPool::Release(void* buffer)
+{
+    pimpl_m->Release(buffer);
+}
+
+void BufferPool::Trim()
+{
+    pimpl_m->Trim();
+}
+
+void BufferPool::AllocateBuffers(ExecutionObject* eo)
+{
+    size_t in_size  = eo->GetInputBufferSizeInBytes();
+    size_t out_size = eo->GetOutputBufferSizeInBytes();
+
+    ArgInfo in (Acquire(in_size),  in_size);
+    ArgInfo out(Acquire(out_size), out_size);
+    eo->SetInputOutputBuffer(in, out);
+}
+
+void BufferPool::AllocateBuffers(ExecutionObjectPipeline* eop)
+{
+    size_t in_size  = eop->GetInputBufferSizeInBytes();
+    size_t out_size = eop->GetOutputBufferSizeInBytes();
+
+    for (uint32_t i = 0; i < eop->GetNumFramesInFlight(); i++)
+    {
+        ArgInfo in (Acquire(in_size),  in_size);
+        ArgInfo out(Acquire(out_size), out_size);
+        eop->SetInputOutputBuffer(in, out, i);
+    }
+}
+
+void BufferPool::ReleaseBuffers(ExecutionObject* eo)
+{
+    if (eo->GetInputBufferPtr())   Release(eo->GetInputBufferPtr());
+    if (eo->GetOutputBufferPtr())  Release(eo->GetOutputBufferPtr());
+}
+
+void BufferPool::ReleaseBuffers(ExecutionObjectPipeline* eop)
+{
+    for (uint32_t i = 0; i < eop->GetNumFramesInFlight(); i++)
+    {
+        if (eop->GetInputBufferPtr(i))   Release(eop->GetInputBufferPtr(i));
+        if (eop->GetOutputBufferPtr(i))  Release(eop->GetOutputBufferPtr(i));
+    }
+}
+
+size_t BufferPool::GetNumBuffers() const
+{
+    std::lock_guard<std::mutex> guard(pimpl_m->mutex_m);
+    return pimpl_m->buffers_m.size();
+}
+
+size_t BufferPool::GetNumIdleBuffers() const
+{
+    std::lock_guard<std::mutex> guard(pimpl_m->mutex_m);
+
+    size_t num_idle = 0;
+    for (const auto& idle : pimpl_m->idle_m)
+        num_idle += idle.second.size();
+    return num_idle;
+}
+
+size_t BufferPool::GetBytesAllocated() const
+{
+    std::lock_guard<std::mutex> guard(pimpl_m->mutex_m);
+    return pimpl_m->bytes_m;
+}
+
+BufferPool::Impl::~Impl()
+{
+    for (const auto& b : buffers_m)
+        __free_ddr(b.first);
+}
+
+char* BufferPool::Impl::Acquire(size_t size)
+{
+    size_t size_class = GetSizeClass(size);
+
+    std::lock_guard<std::mutex> guard(mutex_m);
+
+    std::vector<char*>& idle = idle_m[size_class];
+    if (!idle.empty())
+    {
+        char* buffer = idle.back();
+        idle.pop_back();
+        return buffer;
+    }
+
+    char* buffer = static_cast<char *>(__malloc_ddr(size_class));
+    if (buffer == nullptr)
+        throw Exception("Out of memory, BufferPool __malloc_ddr failed",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    buffers_m[buffer] = size_class;
+    bytes_m += size_class;
+    return buffer;
+}
+
+void BufferPool::Impl::Release(void* buffer)
+{
+    std::lock_guard<std::mutex> guard(mutex_m);
+
+    auto b = buffers_m.find(static_cast<char *>(buffer));
+    if (b == buffers_m.end())
+        throw Exception("Buffer not allocated by this BufferPool",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    idle_m[b->second].push_back(b->first);
+}
+
+void BufferPool::Impl::Trim()
+{
+    std::lock_guard<std::mutex> guard(mutex_m);
+
+    for (auto& idle : idle_m)
+    {
+        for (char* buffer : idle.second)
+        {
+            buffers_m.erase(buffer);
+            bytes_m -= idle.first;
+            __free_ddr(buffer);
+        }
+        idle.second.clear();
+    }
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include "completion_fd.h"
+#include "executor.h"
+
+using namespace tidl;
+
+CompletionFd::CompletionFd(): fd_m(-1)
+{
+}
+
+CompletionFd::~CompletionFd()
+{
+    int fd = fd_m.load();
+    if (fd >= 0)
+        close(fd);
+}
+
+int CompletionFd::Get()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+
+    if (fd_m.load() < 0)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0)
+            throw Exception(std::string("Cannot create eventfd: ") +
+                            strerror(errno), __FILE__, __FUNCTION__, __LINE__);
+        fd_m.store(fd);
+    }
+
+    return fd_m.load();
+}
+
+void CompletionFd::Signal()
+{
+    int fd = fd_m.load();
+    if (fd < 0)
+        return;
+
+    // Fails only if the count would overflow, i.e. completions are never
+    // read. The eventfd remains readable in that case.
+    uint64_t one = 1;
+    ssize_t  n   = write(fd, &one, sizeof(one));
+    (void)n;
+}
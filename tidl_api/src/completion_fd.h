@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+namespace tidl {
+
+/*! @class CompletionFd
+    @brief eventfd signalled on frame completions, for applications that
+           multiplex completions with other file descriptors (epoll etc.)
+
+    The eventfd is created by the first call to Get. Signal is called on
+    the OpenCL runtime thread completing a frame and does not block. The
+    eventfd counts completions, a read returns and resets the count.
+*/
+class CompletionFd
+{
+    public:
+        CompletionFd();
+        ~CompletionFd();
+
+        //! Returns the eventfd, creating it on the first call.
+        //! Throws if the eventfd cannot be created.
+        int  Get();
+
+        //! Returns true once the eventfd has been created
+        bool IsEnabled() const { return fd_m.load() >= 0; }
+
+        //! Count one completion if the eventfd has been created
+        void Signal();
+
+        CompletionFd(const CompletionFd&)            = delete;
+        CompletionFd& operator=(const CompletionFd&) = delete;
+
+    private:
+        std::mutex       mutex_m;
+        std::atomic<int> fd_m;
+};
+
+} // namespace tidl
@@ -38,15 +38,25 @@ Configuration::Configuration(): numFrames(0), inHeight(0), inWidth(0),
                      inNumChannels(0),
                      noZeroCoeffsPercentage(100),
                      preProcType(0),
+                     preProcCropFactor(0),
                      runFullNet(false),
                      NETWORK_HEAP_SIZE(internal::DEFAULT_NETWORK_HEAP_SIZE),
                      PARAM_HEAP_SIZE(internal::DEFAULT_PARAM_HEAP_SIZE),
+                     numContexts(internal::DEFAULT_NUM_CONTEXTS),
                      enableOutputTrace(false),
                      enableApiTrace(false),
                      showHeapStats(false),
+                     enableWorkCounters(false),
+                     autoSizeHeaps(false),
+                     loadGroupParamsOnly(false),
                      quantHistoryParam1(20),
                      quantHistoryParam2(5),
-                     quantMargin(0)
+                     quantMargin(0),
+                     topologyPipelined(true),
+                     topologyDepth(2),
+                     hostWorkers(0),
+                     hostWorkerPriority(0),
+                     waitSpinUs(0)
 {
 }
 
@@ -63,6 +73,15 @@ void Configuration::Print(std::ostream &os) const
        << "\nParameters               " << paramsBinFile
        << "\nEO Heap Size (MB)        " << (NETWORK_HEAP_SIZE >> 20)
        << "\nParameter heap size (MB) " << (PARAM_HEAP_SIZE >> 20)
+       << "\nContexts per EO          " << numContexts
+       << "\nTopology                 ";
+    for (const auto& e : topologyExecutors)
+        os << e.coreType << "x" << e.numCores << ":" << e.layersGroupId
+           << " ";
+    os << (topologyPipelined ? "pipelined" : "parallel")
+       << ", depth " << topologyDepth
+       << "\nHost workers             " << hostWorkers
+       << "\nWait spin (us)           " << waitSpinUs
        << "\n";
 }
 
@@ -83,6 +102,59 @@ bool Configuration::Validate() const
         errors++;
     }
 
+    size_t num_channels = inNumChannels;
+    if ((!preProcMean.empty()  && preProcMean.size()  != num_channels) ||
+        (!preProcScale.empty() && preProcScale.size() != num_channels))
+    {
+        std::cerr << "preProcMean, preProcScale must have inNumChannels "
+                     "values" << std::endl;
+        errors++;
+    }
+
+    if (preProcCropFactor < 0 || preProcCropFactor > 1)
+    {
+        std::cerr << "preProcCropFactor must be between 0 and 1"
+                  << std::endl;
+        errors++;
+    }
+
+    if (!outputTraceLayers.empty() && *outputTraceLayers.begin() < 0)
+    {
+        std::cerr << "outputTraceLayers must be >= 0" << std::endl;
+        errors++;
+    }
+
+    for (const auto& e : topologyExecutors)
+        if ((e.coreType != "EVE" && e.coreType != "DSP") ||
+            e.layersGroupId < 1)
+        {
+            std::cerr << "topologyExecutors must be {EVE|DSP, cores, "
+                         "layersGroupId >= 1}" << std::endl;
+            errors++;
+            break;
+        }
+
+    if (topologyDepth < 1)
+    {
+        std::cerr << "topologyDepth must be >= 1" << std::endl;
+        errors++;
+    }
+
+    if ((!hostWorkerCpus.empty() && *hostWorkerCpus.begin() < 0) ||
+        hostWorkerPriority < 0 || hostWorkerPriority > 99)
+    {
+        std::cerr << "hostWorkerCpus must be >= 0, hostWorkerPriority "
+                     "between 0 and 99" << std::endl;
+        errors++;
+    }
+
+    if (numContexts < 1 || numContexts > internal::MAX_NUM_CONTEXTS)
+    {
+        std::cerr << "numContexts must be between 1 and "
+                  << internal::MAX_NUM_CONTEXTS << std::endl;
+        errors++;
+    }
+
     struct stat buffer;
     if (stat(netBinFile.c_str(), &buffer) != 0)
     {
@@ -29,6 +29,7 @@
 #include <boost/spirit/include/qi.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/fusion/include/std_pair.hpp>
+#include <boost/fusion/include/adapt_struct.hpp>
 
 #include <string>
 #include <fstream>
@@ -37,6 +38,7 @@
 #include <cctype>
 #include <utility>
 #include <map>
+#include <set>
 
 #include "configuration.h"
 
@@ -46,12 +48,20 @@ namespace ph = boost::phoenix;
 
 using namespace tidl;
 
+BOOST_FUSION_ADAPT_STRUCT(
+    tidl::Configuration::TopologyExecutor,
+    (std::string, coreType)
+    (uint32_t,    numCores)
+    (int,         layersGroupId)
+)
+
 template <typename Iterator>
 struct ConfigParser : qi::grammar<Iterator, ascii::space_type>
 {
     ConfigParser(Configuration &x) : ConfigParser::base_type(entry)
     {
         using qi::int_;
+        using qi::float_;
         using qi::bool_;
         using qi::lit;
         using qi::lexeme;
@@ -62,6 +72,17 @@ struct ConfigParser : qi::grammar<Iterator, ascii::space_type>
         id2group  = '{' >> int_ >> ',' >> int_ >> '}';
         id2groups = '{' >> id2group >> *(qi::lit(',') >> id2group) >> '}';
 
+        // Rule for parsing a list of layer indices: { int, ... }
+        layer_ids = '{' >> (int_ % ',') >> '}';
+
+        // Rule for parsing per-channel values: { float, ... }
+        channel_values = '{' >> (float_ % ',') >> '}';
+
+        // Rules for parsing Executors: { {EVE|DSP, uint, int}, ... }
+        core_type = qi::string("EVE") | qi::string("DSP");
+        executor  = '{' >> core_type >> ',' >> qi::uint_ >> ',' >> int_ >> '}';
+        executors = '{' >> (executor % ',') >> '}';
+
         // Rules for parsing paths. Discard '"'
         path %= lexeme[+(char_ - '"')];
         q_path = qi::omit[*char_('"')] >> path >> qi::omit[*char_('"')];
@@ -73,6 +94,12 @@ struct ConfigParser : qi::grammar<Iterator, ascii::space_type>
          lit("#")             >>  *(char_) /* discard comments */             |
          lit("numFrames")     >> '=' >> int_[ph::ref(x.numFrames) = _1]       |
          lit("preProcType")   >> '=' >> int_[ph::ref(x.preProcType) = _1]     |
+         lit("preProcMean")   >> '=' >>
+                           channel_values[ph::ref(x.preProcMean) = _1]      |
+         lit("preProcScale")  >> '=' >>
+                           channel_values[ph::ref(x.preProcScale) = _1]     |
+         lit("preProcCropFactor") >> '=' >>
+                           float_[ph::ref(x.preProcCropFactor) = _1]        |
          lit("inWidth")       >> '=' >> int_[ph::ref(x.inWidth) = _1]         |
          lit("inHeight")      >> '=' >> int_[ph::ref(x.inHeight) = _1]        |
          lit("inNumChannels") >> '=' >> int_[ph::ref(x.inNumChannels) = _1]   |
@@ -80,12 +107,35 @@ struct ConfigParser : qi::grammar<Iterator, ascii::space_type>
          lit("outData")       >> '=' >> q_path[ph::ref(x.outData) = _1]       |
          lit("netBinFile")    >> '=' >> q_path[ph::ref(x.netBinFile) = _1]    |
          lit("paramsBinFile") >> '=' >> q_path[ph::ref(x.paramsBinFile) = _1] |
+         lit("paramHeapCacheFile") >> '=' >>
+                                q_path[ph::ref(x.paramHeapCacheFile) = _1] |
          lit("enableTrace")   >> '=' >> bool_[ph::ref(x.enableOutputTrace)= _1] |
+         lit("autoSizeHeaps") >> '=' >> bool_[ph::ref(x.autoSizeHeaps)= _1] |
+         lit("enableWorkCounters") >> '=' >>
+                               bool_[ph::ref(x.enableWorkCounters)= _1] |
+         lit("loadGroupParamsOnly") >> '=' >>
+                               bool_[ph::ref(x.loadGroupParamsOnly)= _1] |
+         lit("outputTraceLayers") >> '=' >>
+                            layer_ids[ph::ref(x.outputTraceLayers) = _1]     |
          lit("quantHistoryParam1")   >> '=' >>
                                    int_[ph::ref(x.quantHistoryParam1)= _1] |
          lit("quantHistoryParam2")   >> '=' >>
                                    int_[ph::ref(x.quantHistoryParam2)= _1] |
-         lit("quantMargin")   >> '=' >> int_[ph::ref(x.quantMargin)= _1]
+         lit("quantMargin")   >> '=' >> int_[ph::ref(x.quantMargin)= _1]   |
+         lit("numContexts")   >> '=' >> int_[ph::ref(x.numContexts)= _1]   |
+         lit("topologyExecutors") >> '=' >>
+                            executors[ph::ref(x.topologyExecutors) = _1]     |
+         lit("topologyPipelined") >> '=' >>
+                                bool_[ph::ref(x.topologyPipelined)= _1]  |
+         lit("topologyDepth") >> '=' >> int_[ph::ref(x.topologyDepth)= _1] |
+         lit("hostWorkers")   >> '=' >>
+                                qi::uint_[ph::ref(x.hostWorkers)= _1]    |
+         lit("hostWorkerCpus") >> '=' >>
+                            layer_ids[ph::ref(x.hostWorkerCpus) = _1]       |
+         lit("hostWorkerPriority") >> '=' >>
+                                   int_[ph::ref(x.hostWorkerPriority)= _1] |
+         lit("waitSpinUs")    >> '=' >>
+                                qi::uint_[ph::ref(x.waitSpinUs)= _1]
          ;
     }
 
@@ -95,6 +145,13 @@ struct ConfigParser : qi::grammar<Iterator, ascii::space_type>
 
     qi::rule<Iterator, std::pair<int, int>(), ascii::space_type> id2group;
     qi::rule<Iterator, std::map<int, int>(), ascii::space_type> id2groups;
+    qi::rule<Iterator, std::set<int>(), ascii::space_type> layer_ids;
+    qi::rule<Iterator, std::vector<float>(), ascii::space_type> channel_values;
+    qi::rule<Iterator, std::string(), ascii::space_type> core_type;
+    qi::rule<Iterator, Configuration::TopologyExecutor(),
+             ascii::space_type> executor;
+    qi::rule<Iterator, std::vector<Configuration::TopologyExecutor>(),
+             ascii::space_type> executors;
 };
 
 bool Configuration::ReadFromFile(const std::string &file_name)
@@ -161,6 +218,10 @@ enableTrace = true
 
 # Override layer group id assignments in the network
 layerIndex2LayerGroupId = { {12, 2}, {13, 2}, {14, 2} }
+
+# Run layers group 1 on every EVE, layers group 2 on 2 DSPs
+topologyExecutors = { {EVE, 0, 1}, {DSP, 2, 2} }
+topologyDepth     = 2
 ----------------
 #endif
 
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file copy_plan.cpp */
+
+#include <algorithm>
+#include "copy_plan.h"
+
+using namespace tidl;
+
+void CopyPlan::AddPlanes(size_t host_offset, size_t device_offset, int roi,
+                         int n, int width, int height, int pitch,
+                         int chOffset)
+{
+    size_t host = host_offset;
+
+    for (int r = 0; r < roi; r++)
+        for (int c = 0; c < n; c++)
+            for (int y = 0; y < height; y++)
+            {
+                AddRun(host, device_offset + (size_t) (r*n + c) * chOffset
+                                           + (size_t) y * pitch,
+                       width);
+                host += width;
+            }
+}
+
+void CopyPlan::AddRun(size_t host, size_t device, size_t length)
+{
+    if (length == 0)  return;
+
+    host_size_m = std::max(host_size_m, host + length);
+
+    if (!runs_m.empty())
+    {
+        Run& last = runs_m.back();
+        if (last.host + last.length == host &&
+            last.device + last.length == device)
+        {
+            last.length += length;
+            return;
+        }
+    }
+
+    runs_m.push_back({host, device, length});
+}
+
+size_t CopyPlan::Read(const char *host, char *device) const
+{
+    if (!host)  return 0;
+
+    for (const Run& run : runs_m)
+        CopyRow(device + run.device, host + run.host, run.length);
+
+    return host_size_m;
+}
+
+size_t CopyPlan::Write(char *host, const char *device) const
+{
+    if (!host)  return 0;
+
+    for (const Run& run : runs_m)
+        CopyRow(host + run.host, device + run.device, run.length);
+
+    return host_size_m;
+}
@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file copy_plan.h */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace tidl {
+
+//
+// Copy one row of a plane. Rows in the padded TIDL planes are typically a
+// few hundred bytes, use 16-byte NEON loads/stores when available.
+//
+inline void CopyRow(char *dst, const char *src, size_t width)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    size_t i = 0;
+    for (; i + 16 <= width; i += 16)
+        vst1q_u8((uint8_t *) dst + i, vld1q_u8((const uint8_t *) src + i));
+    if (i < width)
+        memcpy(dst + i, src + i, width - i);
+#else
+    memcpy(dst, src, width);
+#endif
+}
+
+/*! @class CopyPlan
+    @brief Copies between a packed host buffer and the padded planes of a
+           TIDL device buffer, computed once per network buffer
+
+    The plan is a list of (host offset, device offset, length) runs, with
+    runs that are contiguous on both sides merged. Reading or writing a
+    frame only walks the runs, the plane addresses are not recomputed.
+*/
+class CopyPlan
+{
+    public:
+        CopyPlan(): host_size_m(0) {}
+
+        //! Add the copy of roi x n planes of height x width, packed in the
+        //! host buffer at host_offset, to planes with the given pitch and
+        //! channel offset at device_offset. Matches readDataS8/writeDataS8.
+        void AddPlanes(size_t host_offset, size_t device_offset, int roi,
+                       int n, int width, int height, int pitch,
+                       int chOffset);
+
+        //! Copy the host buffer into the device buffer at device, returns
+        //! the number of bytes read from host
+        size_t Read(const char *host, char *device) const;
+
+        //! Copy the device buffer at device into the host buffer, returns
+        //! the number of bytes written to host
+        size_t Write(char *host, const char *device) const;
+
+        //! Size of the packed host buffer covered by the plan
+        size_t GetHostSize() const { return host_size_m; }
+
+        size_t GetNumRuns() const { return runs_m.size(); }
+
+    private:
+        struct Run
+        {
+            size_t host;
+            size_t device;
+            size_t length;
+        };
+
+        void AddRun(size_t host, size_t device, size_t length);
+
+        std::vector<Run> runs_m;
+        size_t           host_size_m;
+};
+
+} // namespace tidl
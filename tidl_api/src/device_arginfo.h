@@ -32,6 +32,7 @@
 
 #include "executor.h"
 #include <memory>
+#include <vector>
 
 namespace tidl
 {
@@ -92,14 +93,77 @@ class IODeviceArgInfo
             pipe_m = nullptr;
         }
 
+        //! One buffer per ROI processed by the network, instead of a single
+        //! buffer with all ROIs
+        explicit IODeviceArgInfo(const std::vector<ArgInfo>& rois):
+                        arg_m(nullptr, 0, DeviceArgInfo::Kind::BUFFER),
+                        rois_m(rois)
+        {
+            pipe_m = std::make_shared<PipeInfo>();
+        }
+
+        //! One buffer per network output buffer, instead of a single
+        //! buffer with all outputs. Buffers with a nullptr are not written.
+        static IODeviceArgInfo PerBuffer(const std::vector<ArgInfo>& bufs)
+        {
+            IODeviceArgInfo arg(ArgInfo(nullptr, 0));
+            arg.bufs_m = bufs;
+            return arg;
+        }
+
+        //! Point at new buffers, as if constructed from arg. The PipeInfo
+        //! and the vector capacity are reused, no memory is allocated once
+        //! the argument has been bound before.
+        void Rebind(const ArgInfo& arg)
+        {
+            arg_m = DeviceArgInfo(arg, DeviceArgInfo::Kind::BUFFER);
+            rois_m.clear();
+            bufs_m.clear();
+            KeepPipe();
+        }
+
+        //! Rebind to one buffer per ROI, see IODeviceArgInfo(rois)
+        void RebindROIs(const std::vector<ArgInfo>& rois)
+        {
+            Rebind(ArgInfo(nullptr, 0));
+            rois_m.assign(rois.begin(), rois.end());
+        }
+
+        //! Rebind to one buffer per network output, see PerBuffer
+        void RebindBuffers(const std::vector<ArgInfo>& bufs)
+        {
+            Rebind(ArgInfo(nullptr, 0));
+            bufs_m.assign(bufs.begin(), bufs.end());
+        }
+
         PipeInfo&            GetPipe()      { return *pipe_m; }
+
+        //! Q factor of buffer i from the last frame, 0 if not known
+        uint32_t GetDataQ(uint32_t i) const
+        {
+            if (pipe_m == nullptr || i >= OCL_TIDL_MAX_IN_BUFS)  return 0;
+            return pipe_m->dataQ_m[i];
+        }
         const DeviceArgInfo& GetArg() const { return arg_m; }
+        const std::vector<ArgInfo>& GetROIs() const { return rois_m; }
+        const std::vector<ArgInfo>& GetBuffers() const { return bufs_m; }
 
         //IODeviceArgInfo(const IODeviceArgInfo&)            = delete;
         //IODeviceArgInfo& operator=(const IODeviceArgInfo&) = delete;
 
     private:
+        // The pipe keeps its role across rebinds: the Q factors of an input
+        // are only written by the producer EO, if any, and those of an
+        // output by every frame.
+        void KeepPipe()
+        {
+            if (pipe_m == nullptr)
+                pipe_m = std::make_shared<PipeInfo>();
+        }
+
         DeviceArgInfo             arg_m;
+        std::vector<ArgInfo>      rois_m;
+        std::vector<ArgInfo>      bufs_m;
         std::shared_ptr<PipeInfo> pipe_m;
 };
 
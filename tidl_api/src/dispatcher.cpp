@@ -0,0 +1,342 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "dispatcher.h"
+#include "run_frame.h"
+#include "trace.h"
+
+using namespace tidl;
+
+// Returns the time to process the most recently completed frame, from the
+// timing the device reported for it
+typedef std::function<float()> ServiceTimeFn;
+
+class Dispatcher::Impl
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        Impl(const std::vector<ExecutionObjectInternalInterface*>& eos,
+             const std::vector<ServiceTimeFn>& service_time,
+             CompletionCallback on_complete, uint32_t queue_depth,
+             Policy policy);
+        ~Impl();
+
+        bool Submit(const FrameDescriptor& frame, bool block);
+        void Drain();
+
+        void WorkerLoop(uint32_t index, ExecutionObjectInternalInterface* eo,
+                        ServiceTimeFn service_time);
+
+        // Returns true if worker index should take the next queued frame
+        bool ShouldTake(uint32_t index) const;
+
+        CompletionCallback          on_complete_m;
+        uint32_t                    queue_depth_m;
+        Policy                      policy_m;
+
+        // Frames waiting for an idle ExecutionObject/Pipeline
+        std::deque<FrameDescriptor> queue_m;
+        uint32_t                    num_submitted_m;
+        uint32_t                    num_completed_m;
+        uint32_t                    num_failed_m;
+        bool                        stop_m;
+
+        // Per worker: average service time (0 until measured), and when
+        // its current frame started if it is busy
+        struct WorkerState
+        {
+            float           service_ms = 0;
+            bool            busy       = false;
+            Clock::time_point started;
+        };
+        std::vector<WorkerState>    state_m;
+
+        // Guards queue_m, the counters, state_m and stop_m
+        mutable std::mutex          mutex_m;
+        std::condition_variable     cv_work_m;   // frame queued or stop
+        std::condition_variable     cv_space_m;  // frame dequeued
+        std::condition_variable     cv_done_m;   // frame completed
+
+        // One worker per ExecutionObject/Pipeline. A worker takes the next
+        // frame from the queue as soon as its ExecutionObject is idle.
+        std::vector<std::thread>    workers_m;
+};
+
+template<typename T>
+static std::vector<ExecutionObjectInternalInterface*>
+ToInterfaces(const std::vector<T*>& v)
+{
+    return std::vector<ExecutionObjectInternalInterface*>(v.begin(), v.end());
+}
+
+static float ServiceTimeMs(const StageTiming& t)
+{
+    return t.copyInMs + t.deviceMs + t.copyOutMs;
+}
+
+static std::vector<ServiceTimeFn>
+ServiceTimes(const std::vector<ExecutionObject*>& eos)
+{
+    std::vector<ServiceTimeFn> v;
+    for (auto eo : eos)
+        v.push_back([eo]() { return ServiceTimeMs(eo->GetFrameTiming()); });
+    return v;
+}
+
+static std::vector<ServiceTimeFn>
+ServiceTimes(const std::vector<ExecutionObjectPipeline*>& eops)
+{
+    std::vector<ServiceTimeFn> v;
+    for (auto eop : eops)
+        v.push_back([eop]()
+                    {
+                        float ms = 0;
+                        for (const auto& stage : eop->GetFrameTiming())
+                            ms += ServiceTimeMs(stage);
+                        return ms;
+                    });
+    return v;
+}
+
+Dispatcher::Dispatcher(const std::vector<ExecutionObject*>& eos,
+                       CompletionCallback on_complete, uint32_t queue_depth,
+                       Policy policy):
+    pimpl_m(new Impl(ToInterfaces(eos), ServiceTimes(eos), on_complete,
+                     queue_depth, policy))
+{}
+
+Dispatcher::Dispatcher(const std::vector<ExecutionObjectPipeline*>& eops,
+                       CompletionCallback on_complete, uint32_t queue_depth,
+                       Policy policy):
+    pimpl_m(new Impl(ToInterfaces(eops), ServiceTimes(eops), on_complete,
+                     queue_depth, policy))
+{}
+
+// Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
+// Both unique_ptr and shared_ptr can be instantiated with an incomplete type
+// unique_ptr's destructor requires a complete type in order to invoke delete
+Dispatcher::~Dispatcher() = default;
+
+void Dispatcher::Submit(const FrameDescriptor& frame)
+{
+    pimpl_m->Submit(frame, true);
+}
+
+bool Dispatcher::TrySubmit(const FrameDescriptor& frame)
+{
+    return pimpl_m->Submit(frame, false);
+}
+
+void Dispatcher::Drain()
+{
+    pimpl_m->Drain();
+}
+
+uint32_t Dispatcher::GetNumFramesCompleted() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_completed_m;
+}
+
+uint32_t Dispatcher::GetNumFramesFailed() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_failed_m;
+}
+
+float Dispatcher::GetServiceTimeMs(uint32_t index) const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    if (index >= pimpl_m->state_m.size())
+        throw Exception("Invalid ExecutionObject index " +
+                        std::to_string(index),
+                        __FILE__, __FUNCTION__, __LINE__);
+    return pimpl_m->state_m[index].service_ms;
+}
+
+
+Dispatcher::Impl::Impl(
+                    const std::vector<ExecutionObjectInternalInterface*>& eos,
+                    const std::vector<ServiceTimeFn>& service_time,
+                    CompletionCallback on_complete, uint32_t queue_depth,
+                    Policy policy):
+    on_complete_m(on_complete),
+    queue_depth_m(queue_depth != 0 ? queue_depth : 2 * eos.size()),
+    policy_m(policy),
+    num_submitted_m(0), num_completed_m(0), num_failed_m(0), stop_m(false),
+    state_m(eos.size())
+{
+    if (eos.empty())
+        throw Exception("Dispatcher requires at least one ExecutionObject",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < eos.size(); i++)
+        workers_m.emplace_back(&Dispatcher::Impl::WorkerLoop, this, i,
+                               eos[i], service_time[i]);
+}
+
+Dispatcher::Impl::~Impl()
+{
+    Drain();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_work_m.notify_all();
+
+    for (auto& t : workers_m)
+        t.join();
+}
+
+bool Dispatcher::Impl::Submit(const FrameDescriptor& frame, bool block)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        if (queue_m.size() >= queue_depth_m)
+        {
+            if (!block)
+                return false;
+            cv_space_m.wait(lock,
+                            [this]{ return queue_m.size() < queue_depth_m; });
+        }
+
+        queue_m.push_back(frame);
+        num_submitted_m++;
+    }
+
+    // A worker woken for the frame may leave it to a faster one
+    if (policy_m == Policy::SERVICE_TIME)
+        cv_work_m.notify_all();
+    else
+        cv_work_m.notify_one();
+
+    return true;
+}
+
+void Dispatcher::Impl::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_done_m.wait(lock, [this]{ return num_completed_m == num_submitted_m; });
+}
+
+// Take the frame unless enough other workers are expected to complete a
+// new frame before this one would, to take all queued frames. A worker
+// that has not completed a frame yet always takes one, to be measured.
+// The fastest worker always takes a frame, so frames are never stranded.
+bool Dispatcher::Impl::ShouldTake(uint32_t index) const
+{
+    float service_ms = state_m[index].service_ms;
+    if (policy_m == Policy::FIRST_IDLE || service_ms == 0)
+        return true;
+
+    Clock::time_point now = Clock::now();
+    uint32_t num_faster = 0;
+    for (uint32_t i = 0; i < state_m.size(); i++)
+    {
+        const WorkerState& w = state_m[i];
+        if (i == index || w.service_ms == 0)
+            continue;
+
+        float expected_ms = w.service_ms;
+        if (w.busy)
+        {
+            std::chrono::duration<float, std::milli> elapsed = now - w.started;
+            expected_ms += std::max(0.0f, w.service_ms - elapsed.count());
+        }
+
+        if (expected_ms < service_ms)
+            num_faster++;
+    }
+
+    return queue_m.size() > num_faster;
+}
+
+void Dispatcher::Impl::WorkerLoop(uint32_t index,
+                                  ExecutionObjectInternalInterface* eo,
+                                  ServiceTimeFn service_time)
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        while (!stop_m || !queue_m.empty())
+        {
+            if (queue_m.empty())
+                cv_work_m.wait(lock);
+            else if (ShouldTake(index))
+                break;
+            else
+            {
+                // Expected completion times change as frames progress,
+                // re-evaluate periodically
+                std::chrono::duration<float, std::milli> poll(
+                            std::max(state_m[index].service_ms / 8, 0.1f));
+                cv_work_m.wait_for(lock, poll);
+            }
+        }
+        if (queue_m.empty())
+            break;
+
+        FrameDescriptor frame = queue_m.front();
+        queue_m.pop_front();
+        state_m[index].busy    = true;
+        state_m[index].started = Clock::now();
+        lock.unlock();
+        cv_space_m.notify_one();
+
+        bool status = RunFrame(*eo, frame, "Dispatcher");
+
+        // Weighted towards recent frames, so that the estimate follows
+        // changes in load, e.g. other networks sharing the device. Failed
+        // frames do not report a meaningful time.
+        float ms = status ? service_time() : 0;
+
+        NotifyFrame(on_complete_m, frame, *eo, status, "Dispatcher");
+
+        lock.lock();
+        WorkerState& w = state_m[index];
+        w.busy = false;
+        if (ms > 0)
+            w.service_ms = w.service_ms == 0 ?
+                           ms : 0.75f * w.service_ms + 0.25f * ms;
+        num_completed_m++;
+        if (!status)  num_failed_m++;
+        lock.unlock();
+        cv_done_m.notify_all();
+        if (policy_m == Policy::SERVICE_TIME)
+            cv_work_m.notify_all();
+    }
+}
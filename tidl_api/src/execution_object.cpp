@@ -32,8 +32,15 @@
 #include <fstream>
 #include <climits>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <chrono>
+#include <deque>
+#include <utility>
+#include <exception>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 #include "executor.h"
 #include "execution_object.h"
 #include "trace.h"
@@ -42,7 +49,17 @@
 #include "common_defines.h"
 #include "tidl_create_params.h"
 #include "device_arginfo.h"
+#include "frame_batch.h"
 #include "util.h"
+#include "metrics_recorder.h"
+#include "completion_fd.h"
+#include "host_threads.h"
+#include "postproc.h"
+#include "copy_plan.h"
+#include "ring_queue.h"
+#include "alloc_check.h"
+#include "network_cost.h"
+#include "run_frame.h"
 
 using namespace tidl;
 
@@ -58,18 +75,55 @@ class ExecutionObject::Impl
 
         bool RunAsync(CallType ct, uint32_t context_idx);
         bool Wait    (CallType ct, uint32_t context_idx);
-        bool AddCallback(CallType ct, void *user_data, uint32_t context_idx);
+        bool AddCallback(CallType ct, std::function<void()> callback,
+                         uint32_t context_idx);
+        bool WaitForProcess(std::chrono::microseconds timeout,
+                            uint32_t context_idx);
 
         uint64_t GetProcessCycles(uint32_t context_idx) const;
         int  GetLayersGroupId() const;
+        void RecordEvent(uint32_t context_idx, TimeStampRecorder::API api,
+                         TimeStampRecorder::Phase phase,
+                         uint64_t timestamp=0) const;
+        void RecordSpan(uint32_t context_idx, TimeStampRecorder::API api,
+                        uint64_t start, uint64_t end) const;
+        DeviceBufferView GetBufferView(const OCL_TIDL_BufParams* buf,
+                                       uint32_t context_idx) const;
+        bool TryAcquireContext(uint32_t& context_idx);
         void AcquireContext(uint32_t& context_idx);
+        void AcquireContextAt(uint32_t context_idx);
+        bool TryAcquireContext(uint32_t& context_idx,
+                               std::function<void()> on_release);
         void ReleaseContext(uint32_t  context_idx);
+        uint32_t GetNumBusyContexts() const;
+        void AcquireAllContexts();
+        void ReleaseAllContexts();
+        void SwapNetwork(Impl& other);
+        void Reset();
+
+        // Frame started with ProcessFrameStartAsync(). The output is copied
+        // in the completion path as soon as the device is done,
+        // ProcessFrameWait only waits for the copy.
+        // One per EO, reused by every frame.
+        struct EagerFrame
+        {
+            std::mutex              mutex;
+            std::condition_variable cv;
+            bool                    done   = false;
+            bool                    status = false;
+            std::exception_ptr      error;
+            // EO that delegated the frame, see started_by_m
+            Impl*                   started_by = nullptr;
+        };
+        void StartEagerCopy();
+        void CompleteEagerFrame();
 
         // Trace related
         void WriteLayerOutputsToFile (const std::string& filename_prefix) const;
         const LayerOutput* GetOutputFromLayer (uint32_t layer_index,
                                                uint32_t output_index) const;
         const LayerOutputs* GetOutputsFromAllLayers() const;
+        size_t GetLayerOutputViews(LayerOutputViews& views) const;
 
 
         Device*                         device_m;
@@ -85,15 +139,56 @@ class ExecutionObject::Impl
 
         size_t                          in_size_m;
         size_t                          out_size_m;
-        IODeviceArgInfo                 in_m[tidl::internal::NUM_CONTEXTS];
-        IODeviceArgInfo                 out_m[tidl::internal::NUM_CONTEXTS];
 
-        // Frame being processed by the EO
-        int current_frame_idx_m[tidl::internal::NUM_CONTEXTS];
+        // Number of frames that can be in flight on the EO
+        uint32_t                        num_contexts_m;
+        std::vector<IODeviceArgInfo>    in_m;
+        std::vector<IODeviceArgInfo>    out_m;
+
+        // Network output buffers copied to the host, see SetOutputMask
+        uint32_t                        output_mask_m;
+
+        // Copies between packed host buffers and the network input and
+        // output buffers, built once the network is initialized. Device
+        // offsets are relative to the context, see GetContextBase.
+        std::vector<CopyPlan>           in_plans_m;
+        std::vector<CopyPlan>           out_plans_m;
+
+        // Frame being processed by the EO, one per context
+        std::vector<int>                current_frame_idx_m;
+
+        // Pipeline the frame belongs to in the time stamp log, one per
+        // context. 0 if the EO is used on its own.
+        std::vector<uint32_t>           current_pipeline_id_m;
+
+        // Callback of the frame started with
+        // ProcessFrameStartAsync(FrameCallback), one per context
+        std::vector<FrameCallback>      callbacks_m;
 
         // LayersGroupId being processed by the EO
         int layers_group_id_m;
 
+        // Timing of the frame in each context, and of the most recently
+        // completed frame
+        std::vector<StageTiming>        timing_m;
+        StageTiming                     last_timing_m;
+        mutable std::mutex              timing_mutex_m;
+
+        // macs, paramBytes and activationBytes of the layers group, copied
+        // into the timing of each frame if enableWorkCounters is set
+        StageTiming                     work_m;
+
+        // When the frame in each context started, for latency metrics
+        std::vector<uint64_t>           frame_start_us_m;
+        MetricsRecorder                 metrics_m;
+
+        // Calls on the frame path, see AllocCheck
+        AllocCheck::Counter             alloc_check_m;
+
+        // Signalled when a frame started with ProcessFrameStartAsync()
+        // completes, see GetCompletionFd
+        CompletionFd                    completion_fd_m;
+
         uint32_t                          num_network_layers_m;
         up_malloc_ddr<OCL_TIDL_BufParams> trace_buf_params_m;
         size_t                            trace_buf_params_sz_m;
@@ -102,11 +197,17 @@ class ExecutionObject::Impl
         void SetupInitializeKernel(const DeviceArgInfo& create_arg,
                                    const DeviceArgInfo& param_heap_arg);
         void EnableOutputBufferTrace();
+        const OCL_TIDL_BufParams* GetTracedBuffer(uint32_t layer_index,
+                                                  uint32_t output_index) const;
         void SetupProcessKernel();
+        void InitializeInitParams();
 
         void HostWriteNetInput(uint32_t context_idx);
         void HostReadNetOutput(uint32_t context_idx);
         void ComputeInputOutputSizes();
+        void BuildCopyPlans();
+        char* GetContextBase(const OCL_TIDL_BufParams* buf,
+                             uint32_t context_idx) const;
 
         std::unique_ptr<Kernel>         k_initialize_m;
         std::unique_ptr<Kernel>         k_process_m;
@@ -114,11 +215,40 @@ class ExecutionObject::Impl
 
         // Guarding sole access to input/output for one frame during execution
         // Encoding: context at bit index, bit value: 0 for idle, 1 for busy
-        uint32_t                        idle_encoding_m;
+        // Contexts are claimed with a CAS on the bitmask. The mutex and
+        // condition variable are only used when all contexts are busy.
+        std::atomic<uint32_t>           idle_encoding_m;
+        std::atomic<uint32_t>           num_waiters_m;
         std::mutex                      mutex_access_m;
         std::condition_variable         cv_access_m;
 
-        const Configuration             configuration_m;
+        // Callbacks of callers that did not block for a context, invoked
+        // one per released context. Guarded by mutex_access_m, counted in
+        // num_waiters_m.
+        RingQueue<std::function<void()>> deferred_m;
+
+        Configuration                   configuration_m;
+
+    public:
+        // Context 0 is held by a frame started with ProcessFrameStartAsync()
+        // until ProcessFrameWait()
+        bool                            context0_held_m;
+
+        // Additional networks resident on the device core, see
+        // Executor::AddNetwork. Network 0 is the EO itself. Frames started
+        // via the EO's own buffers run the selected network.
+        std::vector<ExecutionObject*>   networks_m;
+        uint32_t                        network_idx_m;
+        // Network of the frame started with ProcessFrameStartAsync()
+        ExecutionObject*                started_network_m;
+        // EO that delegated the frame being started to this network, its
+        // completion fd is signalled as well
+        Impl*                           started_by_m;
+        // Completion of the frame started with ProcessFrameStartAsync(),
+        // nullptr if the output is copied by ProcessFrameWait
+        std::shared_ptr<EagerFrame>     eager_frame_m;
+        // Reused for every frame, allocated by the first one
+        std::shared_ptr<EagerFrame>     eager_frame_pool_m;
 };
 
 
@@ -158,7 +288,16 @@ ExecutionObject::Impl::Impl(Device* d, DeviceType t, uint8_t device_index,
     shared_process_params_m(nullptr, &__free_ddr),
     in_size_m(0),
     out_size_m(0),
+    num_contexts_m(configuration.numContexts),
+    in_m(num_contexts_m),
+    out_m(num_contexts_m),
+    output_mask_m(~0u),
+    current_frame_idx_m(num_contexts_m, 0),
+    current_pipeline_id_m(num_contexts_m, 0),
+    callbacks_m(num_contexts_m),
     layers_group_id_m(layers_group_id),
+    timing_m(num_contexts_m),
+    frame_start_us_m(num_contexts_m, 0),
     num_network_layers_m(0),
     trace_buf_params_m(nullptr, &__free_ddr),
     trace_buf_params_sz_m(0),
@@ -166,23 +305,39 @@ ExecutionObject::Impl::Impl(Device* d, DeviceType t, uint8_t device_index,
     k_process_m(nullptr),
     k_cleanup_m(nullptr),
     idle_encoding_m(0),  // all contexts are idle
-    configuration_m(configuration)
+    num_waiters_m(0),
+    configuration_m(configuration),
+    context0_held_m(false),
+    network_idx_m(0),
+    started_network_m(nullptr),
+    started_by_m(nullptr)
 {
     device_name_m = device_m->GetDeviceName() + std::to_string(device_index_m);
+    last_timing_m.layersGroupId = layers_group_id_m;
+
     // Save number of layers in the network
     const TIDL_CreateParams* cp =
                 static_cast<const TIDL_CreateParams *>(create_arg.ptr());
     num_network_layers_m = cp->net.numLayers;
 
+    if (configuration_m.enableWorkCounters)
+    {
+        NetworkCost cost(cp->net);
+        auto it = cost.GetLayersGroups().find(layers_group_id_m);
+        if (it != cost.GetLayersGroups().end())
+        {
+            work_m.macs            = it->second.macs;
+            work_m.paramBytes      = it->second.paramBytes;
+            work_m.activationBytes = it->second.activationBytes;
+        }
+    }
+
     SetupInitializeKernel(create_arg, param_heap_arg);
 
     if (configuration_m.enableOutputTrace)
         EnableOutputBufferTrace();
 
     SetupProcessKernel();
-
-    for (int i = 0; i < tidl::internal::NUM_CONTEXTS; i++)
-        current_frame_idx_m[i] = 0;
 }
 
 // Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
@@ -197,6 +352,8 @@ char* ExecutionObject::GetInputBufferPtr() const
 
 size_t ExecutionObject::GetInputBufferSizeInBytes() const
 {
+    if (pimpl_m->network_idx_m != 0)
+        return GetNetwork()->GetInputBufferSizeInBytes();
     return pimpl_m->in_size_m;
 }
 
@@ -207,9 +364,116 @@ char* ExecutionObject::GetOutputBufferPtr() const
 
 size_t ExecutionObject::GetOutputBufferSizeInBytes() const
 {
+    if (pimpl_m->network_idx_m != 0)
+        return GetNetwork()->GetOutputBufferSizeInBytes();
     return pimpl_m->out_size_m;
 }
 
+int ExecutionObject::GetOutputDataQ(uint32_t buffer_idx) const
+{
+    return pimpl_m->out_m[0].GetDataQ(buffer_idx);
+}
+
+void ExecutionObject::SetInputOutputROIBuffers(const std::vector<ArgInfo>& in,
+                                               const std::vector<ArgInfo>& out)
+{
+    if (in.size() != GetNumROIs() || out.size() != GetNumOutputROIs())
+        throw Exception("Number of ROI buffers does not match the network",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (const auto& a : in)
+        if (a.ptr() == nullptr || a.size() < GetInputROISizeInBytes())
+            throw Exception("ROI input buffer is too small",
+                            __FILE__, __FUNCTION__, __LINE__);
+
+    for (const auto& a : out)
+        if (a.ptr() == nullptr || a.size() < GetOutputROISizeInBytes())
+            throw Exception("ROI output buffer is too small",
+                            __FILE__, __FUNCTION__, __LINE__);
+
+    pimpl_m->in_m[0].RebindROIs(in);
+    pimpl_m->out_m[0].RebindROIs(out);
+}
+
+uint32_t ExecutionObject::GetNumROIs() const
+{
+    const OCL_TIDL_InitializeParams* p =
+                                    pimpl_m->shared_initialize_params_m.get();
+    return p->numInBufs > 0 ? p->inBufs[0].numROIs : 0;
+}
+
+uint32_t ExecutionObject::GetNumOutputROIs() const
+{
+    const OCL_TIDL_InitializeParams* p =
+                                    pimpl_m->shared_initialize_params_m.get();
+    return p->numOutBufs > 0 ? p->outBufs[0].numROIs : 0;
+}
+
+size_t ExecutionObject::GetInputROISizeInBytes() const
+{
+    uint32_t num_rois = GetNumROIs();
+    return num_rois > 0 ? pimpl_m->in_size_m / num_rois : 0;
+}
+
+size_t ExecutionObject::GetOutputROISizeInBytes() const
+{
+    uint32_t num_rois = GetNumOutputROIs();
+    return num_rois > 0 ? pimpl_m->out_size_m / num_rois : 0;
+}
+
+void ExecutionObject::SetInputOutputBuffers(const ArgInfo& in,
+                                            const std::vector<ArgInfo>& out)
+{
+    if (out.size() != GetNumNetOutputs())
+        throw Exception("Number of output buffers does not match the network",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < out.size(); i++)
+    {
+        size_t size = GetNetOutputSizeInBytes(i);
+        if (out[i].format() != ArgInfo::OutputFormat::RAW)
+            size *= sizeof(float);
+        if (out[i].ptr() != nullptr && out[i].size() < size)
+            throw Exception("Output buffer " + std::to_string(i) +
+                            " is too small", __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    pimpl_m->in_m[0].Rebind(in);
+    pimpl_m->out_m[0].RebindBuffers(out);
+}
+
+uint32_t ExecutionObject::GetNumNetOutputs() const
+{
+    if (pimpl_m->network_idx_m != 0)
+        return GetNetwork()->GetNumNetOutputs();
+    return pimpl_m->shared_initialize_params_m->numOutBufs;
+}
+
+size_t ExecutionObject::GetNetOutputSizeInBytes(uint32_t buffer_idx) const
+{
+    if (pimpl_m->network_idx_m != 0)
+        return GetNetwork()->GetNetOutputSizeInBytes(buffer_idx);
+
+    if (buffer_idx >= GetNumNetOutputs())
+        throw Exception("Invalid output buffer " + std::to_string(buffer_idx),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    const OCL_TIDL_BufParams* outBuf =
+                &pimpl_m->shared_initialize_params_m->outBufs[buffer_idx];
+    return outBuf->numROIs * outBuf->numChannels * outBuf->ROIWidth *
+           outBuf->ROIHeight;
+}
+
+void ExecutionObject::SetOutputMask(uint32_t mask)
+{
+    pimpl_m->output_mask_m = mask;
+}
+
+uint32_t ExecutionObject::GetOutputMask() const
+{
+    return pimpl_m->output_mask_m;
+}
+
 void  ExecutionObject::SetFrameIndex(int idx)
 {
     pimpl_m->current_frame_idx_m[0] = idx;
@@ -223,18 +487,373 @@ int ExecutionObject::GetFrameIndex() const
 void ExecutionObject::SetInputOutputBuffer(const ArgInfo& in,
                                            const ArgInfo& out)
 {
-    pimpl_m->in_m[0]  = IODeviceArgInfo(in);
-    pimpl_m->out_m[0] = IODeviceArgInfo(out);
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    if (out.format() != ArgInfo::OutputFormat::RAW &&
+        out.size() < GetOutputBufferSizeInBytes() * sizeof(float))
+        throw Exception("Float output buffer is too small",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    pimpl_m->in_m[0].Rebind(in);
+    pimpl_m->out_m[0].Rebind(out);
+}
+
+void ExecutionObject::AddNetwork(ExecutionObject* eo)
+{
+    pimpl_m->networks_m.push_back(eo);
+}
+
+uint32_t ExecutionObject::GetNumNetworks() const
+{
+    return pimpl_m->networks_m.size() + 1;
+}
+
+void ExecutionObject::SetNetworkIndex(uint32_t idx)
+{
+    if (idx >= GetNumNetworks())
+        throw Exception("Network " + std::to_string(idx) + " not resident on "
+                        + GetDeviceName(), __FILE__, __FUNCTION__, __LINE__);
+    pimpl_m->network_idx_m = idx;
+}
+
+uint32_t ExecutionObject::GetNetworkIndex() const
+{
+    return pimpl_m->network_idx_m;
+}
+
+// EO of the selected network, for sizes and to delegate frames to
+ExecutionObject* ExecutionObject::GetNetwork() const
+{
+    return pimpl_m->networks_m[pimpl_m->network_idx_m - 1];
+}
+
+// EO of the selected network, with the buffers, output mask and frame
+// index of this EO for the frame being started. The vectors keep their
+// capacity, no memory is allocated once a frame has been started with the
+// same kind of buffers. The output PipeInfo is shared, the Q factors of
+// the frame are seen by GetOutputDataQ on this EO.
+ExecutionObject* ExecutionObject::StartOnNetwork()
+{
+    ExecutionObject* eo = GetNetwork();
+    eo->pimpl_m->in_m[0]                = pimpl_m->in_m[0];
+    eo->pimpl_m->out_m[0]               = pimpl_m->out_m[0];
+    eo->pimpl_m->output_mask_m          = pimpl_m->output_mask_m;
+    eo->pimpl_m->current_frame_idx_m[0] = pimpl_m->current_frame_idx_m[0];
+    return eo;
 }
 
 bool ExecutionObject::ProcessFrameStartAsync()
 {
-    return pimpl_m->RunAsync(ExecutionObject::CallType::PROCESS, 0);
+    if (pimpl_m->network_idx_m != 0)
+    {
+        ExecutionObject* eo = StartOnNetwork();
+        eo->pimpl_m->started_by_m = pimpl_m.get();
+        bool status = eo->ProcessFrameStartAsync();
+        pimpl_m->started_network_m = eo;
+        return status;
+    }
+
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    // Hold context 0 while the frame is in flight, so that a network swap
+    // waits for the frame to complete
+    pimpl_m->AcquireContextAt(0);
+    pimpl_m->context0_held_m = true;
+
+    pimpl_m->timing_m[0] = StageTiming();
+    pimpl_m->timing_m[0].layersGroupId = pimpl_m->layers_group_id_m;
+    pimpl_m->frame_start_us_m[0] = TimeStampNow();
+    try
+    {
+        bool status = pimpl_m->RunAsync(ExecutionObject::CallType::PROCESS, 0);
+        if (status)
+            pimpl_m->StartEagerCopy();
+        return status;
+    }
+    catch (...)
+    {
+        pimpl_m->context0_held_m = false;
+        pimpl_m->ReleaseContext(0);
+        throw;
+    }
+}
+
+WaitStatus ExecutionObject::ProcessFrameWaitFor(
+                                        std::chrono::microseconds timeout)
+{
+    ExecutionObject* eo = pimpl_m->started_network_m;
+    if (eo != nullptr)
+    {
+        WaitStatus status = eo->ProcessFrameWaitFor(timeout);
+        if (status != WaitStatus::PENDING)
+            pimpl_m->started_network_m = nullptr;
+        return status;
+    }
+
+    std::shared_ptr<Impl::EagerFrame> frame = pimpl_m->eager_frame_m;
+    if (frame)
+    {
+        std::unique_lock<std::mutex> lock(frame->mutex);
+        if (!frame->cv.wait_for(lock, timeout, [&frame]{ return frame->done; }))
+            return WaitStatus::PENDING;
+    }
+    else if (!pimpl_m->WaitForProcess(timeout, 0))
+        return WaitStatus::PENDING;
+
+    return ProcessFrameWait() ? WaitStatus::COMPLETED : WaitStatus::NO_FRAME;
+}
+
+WaitStatus ExecutionObject::TryProcessFrameWait()
+{
+    return ProcessFrameWaitFor(std::chrono::microseconds::zero());
+}
+
+int ExecutionObject::GetCompletionFd()
+{
+    return pimpl_m->completion_fd_m.Get();
 }
 
 bool ExecutionObject::ProcessFrameWait()
 {
-    return pimpl_m->Wait(ExecutionObject::CallType::PROCESS, 0);
+    if (pimpl_m->started_network_m != nullptr)
+    {
+        ExecutionObject* eo = pimpl_m->started_network_m;
+        pimpl_m->started_network_m = nullptr;
+        return eo->ProcessFrameWait();
+    }
+
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    // The output was copied in the completion path, wait for the copy
+    std::shared_ptr<Impl::EagerFrame> frame = std::move(pimpl_m->eager_frame_m);
+    if (frame)
+    {
+        {
+            std::unique_lock<std::mutex> lock(frame->mutex);
+            frame->cv.wait(lock, [&frame]{ return frame->done; });
+        }
+
+        pimpl_m->context0_held_m = false;
+        pimpl_m->ReleaseContext(0);
+        if (frame->error)
+            std::rethrow_exception(frame->error);
+        return frame->status;
+    }
+
+    if (!pimpl_m->context0_held_m)
+        return pimpl_m->Wait(ExecutionObject::CallType::PROCESS, 0);
+
+    pimpl_m->context0_held_m = false;
+    try
+    {
+        bool status = pimpl_m->Wait(ExecutionObject::CallType::PROCESS, 0);
+        pimpl_m->ReleaseContext(0);
+        return status;
+    }
+    catch (...)
+    {
+        pimpl_m->ReleaseContext(0);
+        throw;
+    }
+}
+
+void ExecutionObject::Reset()
+{
+    // A frame started with ProcessFrameStartAsync is retired by its caller,
+    // the thread resetting the EO. Its failure is expected.
+    if (pimpl_m->context0_held_m || pimpl_m->started_network_m != nullptr)
+    {
+        try
+        {
+            ProcessFrameWait();
+        }
+        catch (const std::exception& e)
+        {
+            TRACE::print("Frame failed on %s: %s\n",
+                         GetDeviceName().c_str(), e.what());
+        }
+    }
+
+    pimpl_m->Reset();
+}
+
+void ExecutionObject::SwapNetwork(ExecutionObject& other)
+{
+    pimpl_m->SwapNetwork(*other.pimpl_m);
+}
+
+size_t ExecutionObject::GetNetworkHeapSize() const
+{
+    return pimpl_m->shared_initialize_params_m->tidlHeapSize;
+}
+
+uintptr_t ExecutionObject::GetNetworkHeapAddress() const
+{
+    return reinterpret_cast<uintptr_t>(pimpl_m->tidl_extmem_heap_m.get());
+}
+
+void ExecutionObject::ReadNetworkHeap(char* heap)
+{
+    pimpl_m->AcquireAllContexts();
+    memcpy(heap, pimpl_m->tidl_extmem_heap_m.get(), GetNetworkHeapSize());
+    pimpl_m->ReleaseAllContexts();
+}
+
+void ExecutionObject::WriteNetworkHeap(const char* heap)
+{
+    pimpl_m->AcquireAllContexts();
+    memcpy(pimpl_m->tidl_extmem_heap_m.get(), heap, GetNetworkHeapSize());
+    pimpl_m->ReleaseAllContexts();
+}
+
+bool ExecutionObject::ProcessFrameStartAsync(FrameCallback callback)
+{
+    if (pimpl_m->network_idx_m != 0)
+        return StartOnNetwork()->ProcessFrameStartAsync(std::move(callback));
+
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    // Use the buffers and frame index set via SetInputOutputBuffer and
+    // SetFrameIndex, run the frame on the first idle context
+    uint32_t context_idx;
+    if (!AcquireAndRunContext(context_idx, pimpl_m->current_frame_idx_m[0],
+                              pimpl_m->in_m[0], pimpl_m->out_m[0]))
+    {
+        pimpl_m->ReleaseContext(context_idx);
+        return false;
+    }
+
+    // Copy the output to the host, release the context and notify the
+    // user. The callback is kept by the context, the completion only
+    // captures the context and fits in a std::function without
+    // allocating.
+    pimpl_m->callbacks_m[context_idx] = std::move(callback);
+    auto complete = [this, context_idx]()
+    {
+        AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, "FrameCallback");
+
+        const int     frame_idx = pimpl_m->current_frame_idx_m[context_idx];
+        const ArgInfo out       = pimpl_m->out_m[context_idx].GetArg();
+        FrameCallback callback  =
+                            std::move(pimpl_m->callbacks_m[context_idx]);
+        pimpl_m->callbacks_m[context_idx] = nullptr;
+
+        bool        status = false;
+        StageTiming timing;
+        timing.layersGroupId = GetLayersGroupId();
+        try
+        {
+            status = WaitAndReleaseContext(context_idx, &timing);
+        }
+        catch (const Exception& e)
+        {
+            no_alloc.Skip();
+            TRACE::print("Frame %d failed on %s: %s\n", frame_idx,
+                         GetDeviceName().c_str(), e.what());
+        }
+
+        // One timing per thread, allocated by its first frame. A frame
+        // completing within the callback of another frame on the same
+        // thread gets its own.
+        static thread_local bool thread_timing_busy = false;
+        const bool   nested = thread_timing_busy;
+        FrameTiming  nested_timing;
+        FrameTiming* frame_timing;
+        {
+            AllocCheck::Exclude first_use;
+            static thread_local FrameTiming thread_timing(1);
+            frame_timing = nested ? &nested_timing : &thread_timing;
+            frame_timing->assign(1, timing);
+        }
+
+        FrameResult result(frame_idx, status, out, *this, *frame_timing);
+        if (!callback)
+            return;
+
+        // The context is released, an exception from the callback is
+        // reported here rather than leaving the OpenCL or worker thread
+        AllocCheck::Exclude user_callback;
+        thread_timing_busy = true;
+        try
+        {
+            callback(result);
+        }
+        catch (...)
+        {
+            ReportCallbackError("ExecutionObject", frame_idx);
+        }
+        thread_timing_busy = nested;
+    };
+
+    // If the callback cannot be registered, complete the frame synchronously
+    if (!AddCallback(CallType::PROCESS,
+                     [complete]() { HostThreads::Run(complete); },
+                     context_idx))
+        complete();
+
+    return true;
+}
+
+std::unique_ptr<FrameBatch>
+ExecutionObject::ProcessFramesAsync(const FrameDescriptors& frames)
+{
+    // Keep up to num_contexts frames in flight, retire them in order
+    auto runner = [this](FrameBatch::Impl& batch)
+    {
+        const FrameDescriptors& frames = batch.GetFrames();
+        std::deque<uint32_t>    in_flight;
+        size_t                  next = 0;
+        bool                    status = true;
+        // Rebound for each frame, the contexts keep a copy
+        IODeviceArgInfo         in, out;
+
+        try
+        {
+            while (next < frames.size() || !in_flight.empty())
+            {
+                if (next < frames.size() &&
+                    in_flight.size() < pimpl_m->num_contexts_m)
+                {
+                    const FrameDescriptor& f = frames[next++];
+                    uint32_t context_idx;
+                    in.Rebind(f.GetInput());
+                    out.Rebind(f.GetOutput());
+                    status &= AcquireAndRunContext(context_idx,
+                                                   f.GetFrameIndex(),
+                                                   in, out);
+                    in_flight.push_back(context_idx);
+                }
+                else
+                {
+                    uint32_t context_idx = in_flight.front();
+                    in_flight.pop_front();
+                    status &= WaitAndReleaseContext(context_idx);
+                    batch.FrameCompleted();
+                }
+            }
+        }
+        catch (...)
+        {
+            // Release the contexts of the frames still in flight, they
+            // would otherwise stay held by an abandoned batch
+            for (uint32_t context_idx : in_flight)
+            {
+                try
+                {
+                    WaitAndReleaseContext(context_idx);
+                }
+                catch (const Exception&)
+                {
+                }
+            }
+            throw;
+        }
+
+        return status;
+    };
+
+    return std::unique_ptr<FrameBatch>
+           { new FrameBatch(new FrameBatch::Impl(frames, runner)) };
 }
 
 bool ExecutionObject::RunAsync (CallType ct)
@@ -251,40 +870,139 @@ bool ExecutionObject::Wait (CallType ct)
 bool ExecutionObject::AcquireAndRunContext(uint32_t& context_idx,
                                           int frame_idx,
                                           const IODeviceArgInfo& in,
-                                          const IODeviceArgInfo& out)
+                                          const IODeviceArgInfo& out,
+                                          uint32_t pipeline_id)
+{
+    AcquireContext(context_idx, frame_idx, in, out, pipeline_id);
+    try
+    {
+        return RunContext(context_idx);
+    }
+    catch (...)
+    {
+        ReleaseContext(context_idx);
+        throw;
+    }
+}
+
+bool ExecutionObject::WaitAndReleaseContext(uint32_t context_idx,
+                                            StageTiming* timing)
 {
+    TRACE::print("-> ExecutionObject::WaitAndReleaseContext(%d)\n",
+                 context_idx);
+
+    bool status;
+    try
+    {
+        status = WaitContext(context_idx);
+    }
+    catch (...)
+    {
+        ReleaseContext(context_idx);
+        throw;
+    }
+    if (timing)  *timing = GetContextTiming(context_idx);
+    ReleaseContext(context_idx);
+
+    return status;
+}
+
+void ExecutionObject::AcquireContext(uint32_t& context_idx,
+                                     int frame_idx,
+                                     const IODeviceArgInfo& in,
+                                     const IODeviceArgInfo& out,
+                                     uint32_t pipeline_id)
+{
+    uint64_t start = TimeStampNow();
     pimpl_m->AcquireContext(context_idx);
 
-    pimpl_m->current_frame_idx_m[context_idx] = frame_idx;
+    pimpl_m->frame_start_us_m[context_idx] = start;
+
+    StageTiming& timing  = pimpl_m->timing_m[context_idx];
+    timing               = StageTiming();
+    timing.layersGroupId = pimpl_m->layers_group_id_m;
+    timing.queueWaitMs   = (TimeStampNow() - start) / 1000.0f;
+
+    pimpl_m->current_frame_idx_m[context_idx]   = frame_idx;
+    pimpl_m->current_pipeline_id_m[context_idx] = pipeline_id;
+    pimpl_m->in_m[context_idx]  = in;
+    pimpl_m->out_m[context_idx] = out;
+}
+
+bool ExecutionObject::TryAcquireContext(uint32_t& context_idx,
+                                        int frame_idx,
+                                        const IODeviceArgInfo& in,
+                                        const IODeviceArgInfo& out,
+                                        uint32_t pipeline_id,
+                                        std::function<void()> on_release)
+{
+    uint64_t start = TimeStampNow();
+    if (!pimpl_m->TryAcquireContext(context_idx, std::move(on_release)))
+        return false;
+
+    pimpl_m->frame_start_us_m[context_idx] = start;
+
+    StageTiming& timing  = pimpl_m->timing_m[context_idx];
+    timing               = StageTiming();
+    timing.layersGroupId = pimpl_m->layers_group_id_m;
+
+    pimpl_m->current_frame_idx_m[context_idx]   = frame_idx;
+    pimpl_m->current_pipeline_id_m[context_idx] = pipeline_id;
     pimpl_m->in_m[context_idx]  = in;
     pimpl_m->out_m[context_idx] = out;
+    return true;
+}
 
+bool ExecutionObject::RunContext(uint32_t context_idx)
+{
     return pimpl_m->RunAsync(ExecutionObject::CallType::PROCESS,
-                                    context_idx);
+                             context_idx);
 }
 
-bool ExecutionObject::WaitAndReleaseContext(uint32_t context_idx)
+bool ExecutionObject::WaitContext(uint32_t context_idx)
 {
-    TRACE::print("-> ExecutionObject::WaitAndReleaseContext(%d)\n",
-                 context_idx);
+    return pimpl_m->Wait(ExecutionObject::CallType::PROCESS, context_idx);
+}
 
-    bool status = pimpl_m->Wait(ExecutionObject::CallType::PROCESS,
-                                context_idx);
+void ExecutionObject::ReleaseContext(uint32_t context_idx)
+{
     pimpl_m->ReleaseContext(context_idx);
-
-    return status;
 }
 
-bool ExecutionObject::AddCallback(CallType ct, void *user_data,
+bool ExecutionObject::AddCallback(CallType ct, std::function<void()> callback,
                                   uint32_t context_idx)
 {
-    return pimpl_m->AddCallback(ct, user_data, context_idx);
+    return pimpl_m->AddCallback(ct, std::move(callback), context_idx);
 }
 
 float ExecutionObject::GetProcessTimeInMilliSeconds() const
 {
-    float frequency = pimpl_m->device_m->GetFrequencyInMhz() * 1000000;
-    return ((float)pimpl_m->GetProcessCycles(0)) / frequency * 1000;
+    return GetFrameTiming().deviceMs;
+}
+
+StageTiming ExecutionObject::GetFrameTiming() const
+{
+    if (pimpl_m->network_idx_m != 0)
+        return pimpl_m->networks_m[pimpl_m->network_idx_m - 1]
+                      ->GetFrameTiming();
+
+    std::lock_guard<std::mutex> lock(pimpl_m->timing_mutex_m);
+    return pimpl_m->last_timing_m;
+}
+
+Metrics ExecutionObject::GetMetrics() const
+{
+    Metrics m = pimpl_m->metrics_m.GetSnapshot();
+
+    m.framesInFlight    = pimpl_m->GetNumBusyContexts();
+    m.maxFramesInFlight = pimpl_m->num_contexts_m;
+
+    return m;
+}
+
+StageTiming ExecutionObject::GetContextTiming(uint32_t context_idx) const
+{
+    return pimpl_m->timing_m[context_idx];
 }
 
 void
@@ -304,16 +1022,54 @@ const LayerOutputs* ExecutionObject::GetOutputsFromAllLayers() const
     return pimpl_m->GetOutputsFromAllLayers();
 }
 
+size_t ExecutionObject::GetLayerOutputViews(LayerOutputViews& views) const
+{
+    return pimpl_m->GetLayerOutputViews(views);
+}
+
 int ExecutionObject::GetLayersGroupId() const
 {
     return pimpl_m->layers_group_id_m;
 }
 
+uint32_t ExecutionObject::GetNumContexts() const
+{
+    return pimpl_m->num_contexts_m;
+}
+
 const std::string& ExecutionObject::GetDeviceName() const
 {
     return pimpl_m->device_name_m;
 }
 
+DeviceBufferViews
+ExecutionObject::GetDeviceInputBuffers(uint32_t context_idx) const
+{
+    DeviceBufferViews views;
+    if (context_idx >= pimpl_m->num_contexts_m)  return views;
+
+    const OCL_TIDL_InitializeParams* p =
+                                    pimpl_m->shared_initialize_params_m.get();
+    for (unsigned int i = 0; i < p->numInBufs; i++)
+        views.push_back(pimpl_m->GetBufferView(&p->inBufs[i], context_idx));
+
+    return views;
+}
+
+DeviceBufferViews
+ExecutionObject::GetDeviceOutputBuffers(uint32_t context_idx) const
+{
+    DeviceBufferViews views;
+    if (context_idx >= pimpl_m->num_contexts_m)  return views;
+
+    const OCL_TIDL_InitializeParams* p =
+                                    pimpl_m->shared_initialize_params_m.get();
+    for (unsigned int i = 0; i < p->numOutBufs; i++)
+        views.push_back(pimpl_m->GetBufferView(&p->outBufs[i], context_idx));
+
+    return views;
+}
+
 
 //
 // Create a kernel to call the "initialize" function
@@ -334,17 +1090,7 @@ ExecutionObject::Impl::SetupInitializeKernel(const DeviceArgInfo& create_arg,
 
     // Set up parameter struct for the initialize kernel
     shared_initialize_params_m.reset(malloc_ddr<OCL_TIDL_InitializeParams>());
-    memset(shared_initialize_params_m.get(), 0,
-           sizeof(OCL_TIDL_InitializeParams));
-
-    shared_initialize_params_m->tidlHeapSize =configuration_m.NETWORK_HEAP_SIZE;
-    shared_initialize_params_m->l2HeapSize   = tidl::internal::DMEM1_SIZE;
-    shared_initialize_params_m->l1HeapSize   = tidl::internal::DMEM0_SIZE;
-    shared_initialize_params_m->numContexts  = tidl::internal::NUM_CONTEXTS;
-
-    // Set up execution trace specified in the configuration
-    EnableExecutionTrace(configuration_m,
-                         &shared_initialize_params_m->enableTrace);
+    InitializeInitParams();
 
     // Setup kernel arguments for initialize
     KernelArgs args = { create_arg,
@@ -366,6 +1112,21 @@ ExecutionObject::Impl::SetupInitializeKernel(const DeviceArgInfo& create_arg,
                                     device_index_m));
 }
 
+void ExecutionObject::Impl::InitializeInitParams()
+{
+    memset(shared_initialize_params_m.get(), 0,
+           sizeof(OCL_TIDL_InitializeParams));
+
+    shared_initialize_params_m->tidlHeapSize =configuration_m.NETWORK_HEAP_SIZE;
+    shared_initialize_params_m->l2HeapSize   = tidl::internal::DMEM1_SIZE;
+    shared_initialize_params_m->l1HeapSize   = tidl::internal::DMEM0_SIZE;
+    shared_initialize_params_m->numContexts  = num_contexts_m;
+
+    // Set up execution trace specified in the configuration
+    EnableExecutionTrace(configuration_m,
+                         &shared_initialize_params_m->enableTrace);
+}
+
 //
 // Allocate an OpenCL buffer for TIDL layer output buffer metadata.
 // The device will populate metadata for every buffer that is used as an
@@ -378,18 +1139,68 @@ void ExecutionObject::Impl::EnableOutputBufferTrace()
                              num_network_layers_m*
                              TIDL_NUM_OUT_BUFS);
 
-    trace_buf_params_m.reset(malloc_ddr<OCL_TIDL_BufParams>
-                             (trace_buf_params_sz_m));
+    trace_buf_params_m.reset(malloc_ddr<OCL_TIDL_BufParams>
+                             (trace_buf_params_sz_m));
+
+    // Device will update bufferId if there is valid data for the entry
+    OCL_TIDL_BufParams* bufferParams = trace_buf_params_m.get();
+    for (uint32_t i = 0; i < num_network_layers_m; i++)
+        for (int j = 0; j < TIDL_NUM_OUT_BUFS; j++)
+        {
+            OCL_TIDL_BufParams *bufP =
+                                &bufferParams[i*TIDL_NUM_OUT_BUFS+j];
+            bufP->bufferId = UINT_MAX;
+        }
+}
+
+//
+// Return the trace metadata for an output buffer of a layer. Returns nullptr
+// if the layer is not traced, the buffer has no valid data or, if extmem
+// optimization is in effect, the buffer was re-used by a subsequent layer.
+//
+const OCL_TIDL_BufParams* ExecutionObject::Impl::GetTracedBuffer(
+                            uint32_t layer_index, uint32_t output_index) const
+{
+    if (trace_buf_params_sz_m == 0)
+        return nullptr;
+
+    if (layer_index >= num_network_layers_m ||
+        output_index >= TIDL_NUM_OUT_BUFS)
+        return nullptr;
 
-    // Device will update bufferId if there is valid data for the entry
-    OCL_TIDL_BufParams* bufferParams = trace_buf_params_m.get();
-    for (uint32_t i = 0; i < num_network_layers_m; i++)
+    const OCL_TIDL_BufParams* bufferParams = trace_buf_params_m.get();
+    const OCL_TIDL_BufParams* buf = &bufferParams[layer_index*TIDL_NUM_OUT_BUFS+
+                                                  output_index];
+    if (buf->bufferId == UINT_MAX)
+        return nullptr;
+
+    // All layers are traced, each layer has a separate output buffer
+    const std::set<int>& layers = configuration_m.outputTraceLayers;
+    if (layers.empty())
+        return buf;
+
+    if (layers.count(layer_index) == 0)
+        return nullptr;
+
+    // Check if any subsequent layer wrote to the memory occupied by buf
+    const size_t start = buf->bufPlaneBufOffset;
+    const size_t end   = start + buf->bufPlaneWidth * buf->bufPlaneHeight;
+    for (uint32_t i = layer_index + 1; i < num_network_layers_m; i++)
         for (int j = 0; j < TIDL_NUM_OUT_BUFS; j++)
         {
-            OCL_TIDL_BufParams *bufP =
-                                &bufferParams[i*TIDL_NUM_OUT_BUFS+j];
-            bufP->bufferId = UINT_MAX;
+            const OCL_TIDL_BufParams* next =
+                                    &bufferParams[i*TIDL_NUM_OUT_BUFS+j];
+            if (next->bufferId == UINT_MAX)
+                continue;
+
+            const size_t next_start = next->bufPlaneBufOffset;
+            const size_t next_end   = next_start +
+                                     next->bufPlaneWidth * next->bufPlaneHeight;
+            if (next_start < end && start < next_end)
+                return nullptr;
         }
+
+    return buf;
 }
 
 //
@@ -399,10 +1210,10 @@ void
 ExecutionObject::Impl::SetupProcessKernel()
 {
     shared_process_params_m.reset(malloc_ddr<OCL_TIDL_ProcessParams>(
-               tidl::internal::NUM_CONTEXTS * sizeof(OCL_TIDL_ProcessParams)));
+               num_contexts_m * sizeof(OCL_TIDL_ProcessParams)));
 
     // Set up execution trace specified in the configuration
-    for (int i = 0; i < tidl::internal::NUM_CONTEXTS; i++)
+    for (uint32_t i = 0; i < num_contexts_m; i++)
     {
         OCL_TIDL_ProcessParams *p_params = shared_process_params_m.get() + i;
         EnableExecutionTrace(configuration_m, &p_params->enableTrace);
@@ -410,7 +1221,7 @@ ExecutionObject::Impl::SetupProcessKernel()
 
     uint32_t context_idx = 0;
     KernelArgs args = { DeviceArgInfo(shared_process_params_m.get(),
-                                      tidl::internal::NUM_CONTEXTS *
+                                      num_contexts_m *
                                       sizeof(OCL_TIDL_ProcessParams),
                                       DeviceArgInfo::Kind::BUFFER),
                         DeviceArgInfo(tidl_extmem_heap_m.get(),
@@ -426,24 +1237,126 @@ ExecutionObject::Impl::SetupProcessKernel()
 
     k_process_m.reset(new Kernel(device_m,
                                  STRING(PROCESS_KERNEL), args,
-                                 device_index_m));
+                                 device_index_m, num_contexts_m));
+    k_process_m->SetSpinWait(
+                     std::chrono::microseconds(configuration_m.waitSpinUs));
+
+    // Each context has its own kernel object, set its context index once
+    for (context_idx = 0; context_idx < num_contexts_m; context_idx++)
+        k_process_m->UpdateScalarArg(3, sizeof(uint32_t), &context_idx,
+                                     context_idx);
 }
 
 
+//
+// Copy n planes of height x width from a packed buffer into (or out of)
+// planes with the given pitch and channel offset. Rows are coalesced into a
+// single copy per plane when there is no padding between them, and planes
+// into a single copy when there is no gap between planes.
+//
+static void CopyPlanes(char *dst, const char *src, int n, int width,
+                       int height, int dst_pitch, int dst_chOffset,
+                       int src_pitch, int src_chOffset)
+{
+    size_t plane_size = (size_t) width * height;
+
+    if (dst_pitch == width && src_pitch == width)
+    {
+        if ((size_t) dst_chOffset == plane_size &&
+            (size_t) src_chOffset == plane_size)
+        {
+            memcpy(dst, src, plane_size * n);
+            return;
+        }
+
+        for(int i0 = 0; i0 < n; i0++)
+            memcpy(&dst[i0*dst_chOffset], &src[i0*src_chOffset], plane_size);
+        return;
+    }
+
+    for(int i0 = 0; i0 < n; i0++)
+        for(int i1 = 0; i1 < height; i1++)
+            CopyRow(&dst[i0*dst_chOffset + i1*dst_pitch],
+                    &src[i0*src_chOffset + i1*src_pitch],
+                    width);
+}
+
 static size_t readDataS8(const char *readPtr, char *ptr, int roi, int n,
                          int width, int height, int pitch,
-                         int chOffset)
+                         int chOffset, int src_pitch = 0)
 {
     if (!readPtr)  return 0;
+    if (src_pitch == 0)  src_pitch = width;
 
     for(int i2 = 0; i2 < roi; i2++)
-        for(int i0 = 0; i0 < n; i0++)
-            for(int i1 = 0; i1 < height; i1++)
-                memcpy(&ptr[i2*n*chOffset + i0*chOffset + i1*pitch],
-                       &readPtr[i2*n*width*height + i0*width*height+ i1*width],
-                       width);
+        CopyPlanes(&ptr[i2*n*chOffset], &readPtr[i2*n*src_pitch*height],
+                   n, width, height,
+                   pitch, chOffset,
+                   src_pitch, src_pitch*height);
+
+    return src_pitch*height*n*roi;
+}
+
+//
+// Copy one row of interleaved pixels with n channels into n planes
+// chOffset apart, swapping the first and third channel if swap_rb. Three
+// channel rows are deinterleaved 16 pixels at a time with NEON.
+//
+static void DeinterleaveRow(char *dst, const char *src, int n, int width,
+                            int chOffset, bool swap_rb)
+{
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t       *d = (uint8_t *) dst;
+    int i = 0;
+
+    if (n == 3)
+    {
+        uint8_t *p0 = d, *p1 = d + chOffset, *p2 = d + 2 * chOffset;
+        if (swap_rb)  std::swap(p0, p2);
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        for (; i + 16 <= width; i += 16)
+        {
+            uint8x16x3_t px = vld3q_u8(s + 3 * i);
+            vst1q_u8(p0 + i, px.val[0]);
+            vst1q_u8(p1 + i, px.val[1]);
+            vst1q_u8(p2 + i, px.val[2]);
+        }
+#endif
+        for (; i < width; i++)
+        {
+            p0[i] = s[3 * i];
+            p1[i] = s[3 * i + 1];
+            p2[i] = s[3 * i + 2];
+        }
+        return;
+    }
+
+    for (int c = 0; c < n; c++)
+    {
+        int plane = (swap_rb && n > 2 && c != 1 && c < 3) ? 2 - c : c;
+        for (i = 0; i < width; i++)
+            d[plane * chOffset + i] = s[n * i + c];
+    }
+}
+
+//
+// Copy interleaved (HWC) host input into the padded planes of a device
+// buffer, in a single pass over the input
+//
+static size_t readInterleavedS8(const char *readPtr, char *ptr, int roi,
+                                int n, int width, int height, int pitch,
+                                int chOffset, int src_pitch, bool swap_rb)
+{
+    if (!readPtr)  return 0;
+    if (src_pitch == 0)  src_pitch = n * width;
 
-    return width*height*n*roi;
+    for (int i2 = 0; i2 < roi; i2++)
+        for (int i1 = 0; i1 < height; i1++)
+            DeinterleaveRow(&ptr[i2*n*chOffset + i1*pitch],
+                            &readPtr[(i2*height + i1) * src_pitch],
+                            n, width, chOffset, swap_rb);
+
+    return (size_t) src_pitch * height * roi;
 }
 
 static size_t writeDataS8(char *writePtr, const char *ptr, int n, int width,
@@ -451,15 +1364,89 @@ static size_t writeDataS8(char *writePtr, const char *ptr, int n, int width,
 {
     if (!writePtr)  return 0;
 
+    CopyPlanes(writePtr, ptr, n, width, height,
+               width, width*height,
+               pitch, chOffset);
+
+    return width*height*n;
+}
+
+//
+// Convert the padded planes of a device buffer to packed float planes in
+// the host buffer, in the same pass that drops the padding
+//
+static size_t writeDataF32(float *writePtr, const char *ptr, int n, int width,
+                           int height, int pitch, int chOffset, int dataQ,
+                           bool is_signed)
+{
+    if (!writePtr)  return 0;
+
     for(int i0 = 0; i0 < n; i0++)
         for(int i1 = 0; i1 < height; i1++)
-            memcpy(&writePtr[i0*width*height + i1*width],
-                   &ptr[i0*chOffset + i1*pitch],
-                   width);
+            postproc::Dequantize(&ptr[i0*chOffset + i1*pitch], width, dataQ,
+                                 is_signed,
+                                 &writePtr[(i0*height + i1) * width]);
 
     return width*height*n;
 }
 
+//
+// Describe the padded plane layout of a TIDL device buffer for a context.
+// Matches the layout used by readDataS8/writeDataS8.
+//
+DeviceBufferView
+ExecutionObject::Impl::GetBufferView(const OCL_TIDL_BufParams* buf,
+                                     uint32_t context_idx) const
+{
+    char *addr = tidl_extmem_heap_m.get() + buf->bufPlaneBufOffset
+                 + context_idx * buf->contextSize
+                 + buf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
+                 + OCL_TIDL_MAX_PAD_SIZE;
+
+    return DeviceBufferView(addr, buf->numROIs, buf->numChannels,
+                            buf->ROIHeight, buf->ROIWidth,
+                            buf->bufPlaneWidth,
+                            (buf->bufPlaneWidth * buf->bufPlaneHeight) /
+                             buf->numChannels);
+}
+
+//
+// Start of the buffers of a context in the device heap, the copy plans of
+// buf are relative to it
+//
+char* ExecutionObject::Impl::GetContextBase(const OCL_TIDL_BufParams* buf,
+                                            uint32_t context_idx) const
+{
+    return tidl_extmem_heap_m.get() + context_idx * buf->contextSize;
+}
+
+//
+// Flatten the plane layout of the network input and output buffers into
+// copy plans. The layout is fixed once the network is initialized, and the
+// same for every context apart from the context offset.
+//
+void ExecutionObject::Impl::BuildCopyPlans()
+{
+    in_plans_m.assign(shared_initialize_params_m->numInBufs, CopyPlan());
+    out_plans_m.assign(shared_initialize_params_m->numOutBufs, CopyPlan());
+
+    auto build = [](CopyPlan& plan, const OCL_TIDL_BufParams* buf)
+    {
+        plan.AddPlanes(0, buf->bufPlaneBufOffset
+                          + buf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
+                          + OCL_TIDL_MAX_PAD_SIZE,
+                       buf->numROIs, buf->numChannels, buf->ROIWidth,
+                       buf->ROIHeight, buf->bufPlaneWidth,
+                       (buf->bufPlaneWidth * buf->bufPlaneHeight) /
+                        buf->numChannels);
+    };
+
+    for (unsigned int i = 0; i < shared_initialize_params_m->numInBufs; i++)
+        build(in_plans_m[i], &shared_initialize_params_m->inBufs[i]);
+    for (unsigned int i = 0; i < shared_initialize_params_m->numOutBufs; i++)
+        build(out_plans_m[i], &shared_initialize_params_m->outBufs[i]);
+}
+
 //
 // Copy from host buffer to TIDL device buffer
 //
@@ -467,6 +1454,11 @@ void ExecutionObject::Impl::HostWriteNetInput(uint32_t context_idx)
 {
     const char*     readPtr  = (const char *) in_m[context_idx].GetArg().ptr();
     const PipeInfo& pipe     = in_m[context_idx].GetPipe();
+    const std::vector<ArgInfo>& rois = in_m[context_idx].GetROIs();
+    size_t          roiOffset = 0;
+    // Layout of the host input, per-ROI buffers are planar
+    ArgInfo::Layout layout    = in_m[context_idx].GetArg().layout();
+    int             src_pitch = in_m[context_idx].GetArg().pitch();
     OCL_TIDL_ProcessParams *p_params = shared_process_params_m.get()
                                        + context_idx;
 
@@ -476,6 +1468,38 @@ void ExecutionObject::Impl::HostWriteNetInput(uint32_t context_idx)
         char *inBufAddr = tidl_extmem_heap_m.get() + inBuf->bufPlaneBufOffset
                           + context_idx * inBuf->contextSize;
 
+        // Per-ROI buffers: each holds the input buffers of its ROI, packed
+        if (!rois.empty())
+        {
+            DeviceBufferView view = GetBufferView(inBuf, context_idx);
+            for (int r = 0; r < view.NumberOfROIs(); r++)
+                readDataS8((const char *) rois[r].ptr() + roiOffset,
+                           view.Row(r, 0, 0), 1,
+                           view.NumberOfChannels(), view.Width(),
+                           view.Height(), view.Pitch(), view.ChannelStride());
+            roiOffset += view.NumberOfChannels() * view.Width() *
+                         view.Height();
+        }
+        else if (layout != ArgInfo::Layout::PLANAR)
+            readPtr += readInterleavedS8(
+                readPtr,
+                (char *) inBufAddr
+                    + inBuf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
+                    + OCL_TIDL_MAX_PAD_SIZE,
+                inBuf->numROIs,
+                inBuf->numChannels,
+                inBuf->ROIWidth,
+                inBuf->ROIHeight,
+                inBuf->bufPlaneWidth,
+                ((inBuf->bufPlaneWidth * inBuf->bufPlaneHeight) /
+                 inBuf->numChannels),
+                src_pitch,
+                layout == ArgInfo::Layout::INTERLEAVED_SWAP_RB);
+        // Packed planar input, the common case, follows the copy plan
+        else if (src_pitch == 0 || src_pitch == (int) inBuf->ROIWidth)
+            readPtr += in_plans_m[i].Read(readPtr,
+                                          GetContextBase(inBuf, context_idx));
+        else
             readPtr += readDataS8(
                 readPtr,
                 (char *) inBufAddr
@@ -487,7 +1511,8 @@ void ExecutionObject::Impl::HostWriteNetInput(uint32_t context_idx)
                 inBuf->ROIHeight,
                 inBuf->bufPlaneWidth,
                 ((inBuf->bufPlaneWidth * inBuf->bufPlaneHeight) /
-                 inBuf->numChannels));
+                 inBuf->numChannels),
+                src_pitch);
 
         p_params->dataQ[i] = pipe.dataQ_m[i];
     }
@@ -499,31 +1524,80 @@ void ExecutionObject::Impl::HostWriteNetInput(uint32_t context_idx)
 void ExecutionObject::Impl::HostReadNetOutput(uint32_t context_idx)
 {
     char* writePtr = (char *) out_m[context_idx].GetArg().ptr();
+    ArgInfo::OutputFormat format = out_m[context_idx].GetArg().format();
     PipeInfo& pipe = out_m[context_idx].GetPipe();
+    const std::vector<ArgInfo>& rois = out_m[context_idx].GetROIs();
+    const std::vector<ArgInfo>& bufs = out_m[context_idx].GetBuffers();
+    size_t roiOffset = 0;
     OCL_TIDL_ProcessParams *p_params = shared_process_params_m.get()
                                        + context_idx;
 
     for (unsigned int i = 0; i < shared_initialize_params_m->numOutBufs; i++)
     {
         OCL_TIDL_BufParams *outBuf = &shared_initialize_params_m->outBufs[i];
-        char *outBufAddr = tidl_extmem_heap_m.get() + outBuf->bufPlaneBufOffset
-                           + context_idx * outBuf->contextSize;
-        if (writePtr != nullptr)
-        {
-            writePtr += writeDataS8(
-                writePtr,
-                (char *) outBufAddr
-                    + outBuf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
-                    + OCL_TIDL_MAX_PAD_SIZE,
-                outBuf->numChannels,
-                outBuf->ROIWidth,
-                outBuf->ROIHeight,
-                outBuf->bufPlaneWidth,
-                ((outBuf->bufPlaneWidth * outBuf->bufPlaneHeight)/
-                 outBuf->numChannels));
+        pipe.dataQ_m[i]   = p_params->dataQ[i];
+
+        // Each output buffer into its own buffer, if specified
+        if (!bufs.empty())
+        {
+            writePtr = (char *) bufs[i].ptr();
+            format   = bufs[i].format();
         }
 
-        pipe.dataQ_m[i]   = p_params->dataQ[i];
+        // Outputs not selected by the mask are skipped, their place in a
+        // single output buffer is left untouched
+        if (!(output_mask_m & (1u << i)) || (!bufs.empty() && !writePtr))
+        {
+            size_t size = outBuf->numROIs * outBuf->numChannels *
+                          outBuf->ROIWidth * outBuf->ROIHeight;
+            if (rois.empty() && format != ArgInfo::OutputFormat::RAW)
+                size *= sizeof(float);
+            if (writePtr != nullptr)
+                writePtr += size;
+            roiOffset += outBuf->numChannels * outBuf->ROIWidth *
+                         outBuf->ROIHeight;
+            continue;
+        }
+
+        // Packed raw output follows the copy plan
+        if (rois.empty() && format == ArgInfo::OutputFormat::RAW)
+        {
+            writePtr += out_plans_m[i].Write(writePtr,
+                                             GetContextBase(outBuf,
+                                                            context_idx));
+            continue;
+        }
+
+        DeviceBufferView view = GetBufferView(outBuf, context_idx);
+
+        // Output ROIs are written one after the other, or each into its
+        // per-ROI buffer. Float output is converted during the copy, with
+        // the Q factor the device computed for this frame.
+        for (int r = 0; r < view.NumberOfROIs(); r++)
+        {
+            if (rois.empty() && format != ArgInfo::OutputFormat::RAW)
+            {
+                bool is_signed = format == ArgInfo::OutputFormat::FLOAT_S8;
+                size_t n = writeDataF32((float *) writePtr, view.Row(r, 0, 0),
+                                        view.NumberOfChannels(), view.Width(),
+                                        view.Height(), view.Pitch(),
+                                        view.ChannelStride(),
+                                        p_params->dataQ[i], is_signed);
+                if (writePtr != nullptr)
+                    writePtr += n * sizeof(float);
+                continue;
+            }
+
+            char *dst = rois.empty() ? writePtr
+                                     : (char *) rois[r].ptr() + roiOffset;
+            size_t n = writeDataS8(dst, view.Row(r, 0, 0),
+                                   view.NumberOfChannels(), view.Width(),
+                                   view.Height(), view.Pitch(),
+                                   view.ChannelStride());
+            if (rois.empty() && writePtr != nullptr)
+                writePtr += n;
+        }
+        roiOffset += view.NumberOfChannels() * view.Width() * view.Height();
     }
 }
 
@@ -553,7 +1627,8 @@ void ExecutionObject::Impl::ComputeInputOutputSizes()
     for (unsigned int i = 0; i < shared_initialize_params_m->numOutBufs; i++)
     {
         OCL_TIDL_BufParams *outBuf = &shared_initialize_params_m->outBufs[i];
-        out_size_m += outBuf->numChannels * outBuf->ROIWidth *outBuf->ROIHeight;
+        out_size_m += outBuf->numROIs * outBuf->numChannels *
+                      outBuf->ROIWidth * outBuf->ROIHeight;
     }
 }
 
@@ -568,25 +1643,19 @@ bool ExecutionObject::Impl::RunAsync(CallType ct, uint32_t context_idx)
         }
         case CallType::PROCESS:
         {
-            RecordEvent(current_frame_idx_m[context_idx],
-                        (layers_group_id_m == 1) ? TimeStamp::EO1_PFSA_START:
-                                                   TimeStamp::EO2_PFSA_START,
-                        static_cast<int>(device_type_m),
-                        device_index_m);
+            using API = TimeStampRecorder::API;
+            uint64_t start = TimeStampNow();
 
             OCL_TIDL_ProcessParams *p_params = shared_process_params_m.get()
                                                + context_idx;
             p_params->frameIdx = current_frame_idx_m[context_idx];
             HostWriteNetInput(context_idx);
-            {
-                std::unique_lock<std::mutex> lock(mutex_access_m);
-                k_process_m->UpdateScalarArg(3, sizeof(uint32_t), &context_idx);
-                k_process_m->RunAsync(context_idx);
-            }
+            uint64_t copied = TimeStampNow();
+            k_process_m->RunAsync(context_idx);
 
-            RecordEvent(current_frame_idx_m[context_idx],
-                        (layers_group_id_m == 1) ?  TimeStamp::EO1_PFSA_END:
-                                                    TimeStamp::EO2_PFSA_END);
+            timing_m[context_idx].copyInMs = (copied - start) / 1000.0f;
+            RecordSpan(context_idx, API::COPY_IN, start, copied);
+            RecordSpan(context_idx, API::PFSA, start, 0);
             break;
         }
         case CallType::CLEANUP:
@@ -601,6 +1670,14 @@ bool ExecutionObject::Impl::RunAsync(CallType ct, uint32_t context_idx)
     return true;
 }
 
+// Wait at most timeout for the frame in context_idx to complete on the
+// device. The frame is retired by Wait.
+bool ExecutionObject::Impl::WaitForProcess(std::chrono::microseconds timeout,
+                                           uint32_t context_idx)
+{
+    return k_process_m->WaitForCompletion(timeout, context_idx);
+}
+
 bool ExecutionObject::Impl::Wait(CallType ct, uint32_t context_idx)
 {
     switch (ct)
@@ -615,36 +1692,59 @@ bool ExecutionObject::Impl::Wait(CallType ct, uint32_t context_idx)
                 if (shared_initialize_params_m->errorCode != OCL_TIDL_SUCCESS)
                     throw Exception(shared_initialize_params_m->errorCode,
                                     __FILE__, __FUNCTION__, __LINE__);
+                BuildCopyPlans();
             }
             return has_work;
         }
         case CallType::PROCESS:
         {
-            RecordEvent(current_frame_idx_m[context_idx],
-                        (layers_group_id_m == 1) ? TimeStamp::EO1_PFW_START:
-                                                   TimeStamp::EO2_PFW_START);
+            using API = TimeStampRecorder::API;
+
+            // Only record the wait if there was a frame to wait for
+            uint64_t start = TimeStampNow();
 
             bool has_work = k_process_m->Wait(context_idx);
             if (has_work)
             {
+                uint64_t done = TimeStampNow();
+
                 OCL_TIDL_ProcessParams *p_params = shared_process_params_m.get()
                                                    + context_idx;
                 if (p_params->errorCode != OCL_TIDL_SUCCESS)
+                {
+                    metrics_m.FrameFailed();
                     throw Exception(p_params->errorCode,
                                     __FILE__, __FUNCTION__, __LINE__);
+                }
 
                 HostReadNetOutput(context_idx);
-
-                RecordEvent(current_frame_idx_m[context_idx],
-                            (layers_group_id_m == 1) ? TimeStamp::EO1_PFW_END:
-                                                       TimeStamp::EO2_PFW_END);
-            }
-            else
-            {
-                // If there is no work, reset start event time
-                ResetEvent(current_frame_idx_m[context_idx],
-                           (layers_group_id_m == 1) ? TimeStamp::EO1_PFW_START:
-                                                      TimeStamp::EO2_PFW_START);
+                uint64_t copied = TimeStampNow();
+
+                StageTiming& timing = timing_m[context_idx];
+                timing.copyOutMs    = (copied - done) / 1000.0f;
+                timing.deviceCycles = GetProcessCycles(context_idx);
+                timing.deviceMs     = timing.deviceCycles /
+                                      (device_m->GetFrequencyInMhz() * 1000.0f);
+                timing.macs            = work_m.macs;
+                timing.paramBytes      = work_m.paramBytes;
+                timing.activationBytes = work_m.activationBytes;
+                {
+                    std::lock_guard<std::mutex> lock(timing_mutex_m);
+                    last_timing_m = timing;
+                }
+                metrics_m.FrameCompleted(copied - frame_start_us_m[context_idx],
+                                         timing.deviceMs * 1000);
+
+                if (TimeStampsEnabled())
+                {
+                    // The device reports cycles, not time stamps. Place the
+                    // process call so that it ends when the wait returned.
+                    uint64_t device_us = timing.deviceMs * 1000;
+                    RecordSpan(context_idx, API::DEVICE,
+                               done > device_us ? done - device_us : 0, done);
+                    RecordSpan(context_idx, API::COPY_OUT, done, copied);
+                    RecordSpan(context_idx, API::PFW, start, copied);
+                }
             }
 
             return has_work;
@@ -661,14 +1761,15 @@ bool ExecutionObject::Impl::Wait(CallType ct, uint32_t context_idx)
     return false;
 }
 
-bool ExecutionObject::Impl::AddCallback(CallType ct, void *user_data,
+bool ExecutionObject::Impl::AddCallback(CallType ct,
+                                        std::function<void()> callback,
                                         uint32_t context_idx)
 {
     switch (ct)
     {
         case CallType::PROCESS:
         {
-            return k_process_m->AddCallback(user_data, context_idx);
+            return k_process_m->AddCallback(std::move(callback), context_idx);
             break;
         }
         default:
@@ -678,6 +1779,26 @@ bool ExecutionObject::Impl::AddCallback(CallType ct, void *user_data,
     return false;
 }
 
+void ExecutionObject::Impl::RecordEvent(uint32_t context_idx,
+                                        TimeStampRecorder::API api,
+                                        TimeStampRecorder::Phase phase,
+                                        uint64_t timestamp) const
+{
+    tidl::RecordEvent(current_frame_idx_m[context_idx],
+                      current_pipeline_id_m[context_idx], layers_group_id_m,
+                      api, phase, static_cast<int>(device_type_m),
+                      device_index_m, context_idx, timestamp);
+}
+
+// Record START at start and END at end, or now if end is 0
+void ExecutionObject::Impl::RecordSpan(uint32_t context_idx,
+                                       TimeStampRecorder::API api,
+                                       uint64_t start, uint64_t end) const
+{
+    RecordEvent(context_idx, api, TimeStampRecorder::Phase::START, start);
+    RecordEvent(context_idx, api, TimeStampRecorder::Phase::END, end);
+}
+
 uint64_t ExecutionObject::Impl::GetProcessCycles(uint32_t context_idx) const
 {
     uint8_t factor = 1;
@@ -700,36 +1821,23 @@ ExecutionObject::Impl::WriteLayerOutputsToFile(const std::string& filename_prefi
     if (trace_buf_params_sz_m == 0)
         return;
 
-    OCL_TIDL_BufParams* bufferParams = trace_buf_params_m.get();
+    // Re-used across layers, grows to the size of the largest output
+    std::vector<char> tmp;
 
     for (uint32_t i = 0; i < num_network_layers_m; i++)
         for (int j = 0; j < TIDL_NUM_OUT_BUFS; j++)
         {
-            OCL_TIDL_BufParams* buf = &bufferParams[i*TIDL_NUM_OUT_BUFS+j];
+            const OCL_TIDL_BufParams* buf = GetTracedBuffer(i, j);
 
-            if (buf->bufferId == UINT_MAX)
+            if (buf == nullptr)
                 continue;
 
-            size_t buffer_size = buf->numChannels * buf->ROIHeight *
-                                 buf->ROIWidth;
-
-            char *tmp = new char[buffer_size];
-
-            if (tmp == nullptr)
-                throw Exception("Out of memory, new failed",
-                        __FILE__, __FUNCTION__, __LINE__);
-
-            writeDataS8(
-                tmp,
-                (char *) tidl_extmem_heap_m.get() + buf->bufPlaneBufOffset
-                + buf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
-                + OCL_TIDL_MAX_PAD_SIZE,
-                buf->numChannels,
-                buf->ROIWidth,
-                buf->ROIHeight,
-                buf->bufPlaneWidth,
-                ((buf->bufPlaneWidth * buf->bufPlaneHeight)/
-                 buf->numChannels));
+            LayerOutputView lv(i, j, buf->bufferId, buf->dataQ,
+                               buf->minValue, buf->maxValue,
+                               GetBufferView(buf, 0));
+            if (tmp.size() < lv.Size())
+                tmp.resize(lv.Size());
+            lv.CopyTo(tmp.data(), tmp.size());
 
             std::string filename(filename_prefix);
             filename += std::to_string(buf->bufferId) + "_";
@@ -740,7 +1848,7 @@ ExecutionObject::Impl::WriteLayerOutputsToFile(const std::string& filename_prefi
 
             std::ofstream ofs;
             ofs.open(filename, std::ofstream::out);
-            ofs.write(tmp, buffer_size);
+            ofs.write(tmp.data(), lv.Size());
             ofs.close();
 
             std::ofstream info_ofs(info_filename, std::ofstream::out);
@@ -748,8 +1856,6 @@ ExecutionObject::Impl::WriteLayerOutputsToFile(const std::string& filename_prefi
             info_ofs << "minValue: " << buf->minValue << std::endl;
             info_ofs << "maxValue: " << buf->maxValue << std::endl;
             info_ofs.close();
-
-            delete[] tmp;
         }
 }
 
@@ -757,44 +1863,48 @@ ExecutionObject::Impl::WriteLayerOutputsToFile(const std::string& filename_prefi
 const LayerOutput* ExecutionObject::Impl::GetOutputFromLayer(
                             uint32_t layer_index, uint32_t output_index) const
 {
-    if (trace_buf_params_sz_m == 0)
-        return nullptr;
-
-    if (layer_index > num_network_layers_m || output_index > TIDL_NUM_OUT_BUFS)
-        return nullptr;
+    const OCL_TIDL_BufParams* buf = GetTracedBuffer(layer_index, output_index);
 
-    OCL_TIDL_BufParams* bufferParams = trace_buf_params_m.get();
-    OCL_TIDL_BufParams* buf = &bufferParams[layer_index*TIDL_NUM_OUT_BUFS+
-                                            output_index];
-
-    if (buf->bufferId == UINT_MAX)
+    if (buf == nullptr)
         return nullptr;
 
-    size_t buffer_size = buf->numChannels * buf->ROIHeight *
-                         buf->ROIWidth;
+    LayerOutputView lv(layer_index, output_index, buf->bufferId, buf->dataQ,
+                       buf->minValue, buf->maxValue, GetBufferView(buf, 0));
 
-    char *data = new char[buffer_size];
+    char *data = new char[lv.Size()];
 
     if (data == nullptr)
         throw Exception("Out of memory, new failed",
                 __FILE__, __FUNCTION__, __LINE__);
 
-    writeDataS8(data,
-                (char *) tidl_extmem_heap_m.get() + buf->bufPlaneBufOffset
-                + buf->bufPlaneWidth * OCL_TIDL_MAX_PAD_SIZE
-                + OCL_TIDL_MAX_PAD_SIZE,
-                buf->numChannels,
-                buf->ROIWidth,
-                buf->ROIHeight,
-                buf->bufPlaneWidth,
-                ((buf->bufPlaneWidth * buf->bufPlaneHeight)/
-                 buf->numChannels));
+    lv.CopyTo(data, lv.Size());
 
     return new LayerOutput(layer_index, output_index, buf->bufferId,
                            buf->numROIs, buf->numChannels, buf->ROIHeight,
                            buf->ROIWidth, data);
 }
 
+size_t
+ExecutionObject::Impl::GetLayerOutputViews(LayerOutputViews& views) const
+{
+    size_t count = 0;
+
+    for (uint32_t i=0; i < num_network_layers_m; i++)
+        for (int j=0; j < TIDL_NUM_OUT_BUFS; j++)
+        {
+            const OCL_TIDL_BufParams* buf = GetTracedBuffer(i, j);
+            if (buf == nullptr)
+                continue;
+
+            views.emplace_back(i, j, buf->bufferId, buf->dataQ,
+                               buf->minValue, buf->maxValue,
+                               GetBufferView(buf, 0));
+            count++;
+        }
+
+    return count;
+}
+
 const LayerOutputs* ExecutionObject::Impl::GetOutputsFromAllLayers() const
 {
     LayerOutputs* result = new LayerOutputs;
@@ -813,7 +1923,8 @@ const LayerOutputs* ExecutionObject::Impl::GetOutputsFromAllLayers() const
 LayerOutput::LayerOutput(int layer_index, int output_index, int buffer_id,
                          int num_roi, int num_channels, size_t height,
                          size_t width, const char* data):
-                        layer_index_m(layer_index), buffer_id_m(buffer_id),
+                        layer_index_m(layer_index),
+                        output_index_m(output_index), buffer_id_m(buffer_id),
                         num_roi_m(num_roi), num_channels_m(num_channels),
                         height_m(height), width_m(width), data_m(data)
 { }
@@ -823,26 +1934,299 @@ LayerOutput::~LayerOutput()
     delete[] data_m;
 }
 
+size_t LayerOutputView::CopyTo(char* dst, size_t size) const
+{
+    if (dst == nullptr || size < Size())
+        return 0;
+
+    return writeDataS8(dst, buffer_m.Data(), buffer_m.NumberOfChannels(),
+                       buffer_m.Width(), buffer_m.Height(), buffer_m.Pitch(),
+                       buffer_m.ChannelStride());
+}
+
+bool DeviceBufferView::CopyTo(const DeviceBufferView& dst) const
+{
+    if (dst.num_rois_m != num_rois_m || dst.num_channels_m != num_channels_m ||
+        dst.height_m != height_m || dst.width_m != width_m)
+        return false;
+
+    for (int i = 0; i < num_rois_m; i++)
+        CopyPlanes(dst.Row(i, 0, 0), Row(i, 0, 0), num_channels_m,
+                   width_m, height_m,
+                   dst.pitch_m, dst.channel_stride_m,
+                   pitch_m, channel_stride_m);
+
+    return true;
+}
+
+//
+// Claim the lowest idle context. Returns false if all contexts are busy.
+//
+bool ExecutionObject::Impl::TryAcquireContext(uint32_t& context_idx)
+{
+    uint32_t busy = idle_encoding_m.load();
+    const uint32_t all_busy = (1u << num_contexts_m) - 1;
+
+    while (busy != all_busy)
+    {
+        uint32_t i = 0;
+        while (((1u << i) & busy) != 0)  i++;
+
+        // mark the bit as busy
+        if (idle_encoding_m.compare_exchange_weak(busy, busy | (1u << i)))
+        {
+            context_idx = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t ExecutionObject::Impl::GetNumBusyContexts() const
+{
+    uint32_t n = 0;
+    for (uint32_t busy = idle_encoding_m.load(); busy != 0; busy &= busy - 1)
+        n++;
+    return n;
+}
+
 void ExecutionObject::Impl::AcquireContext(uint32_t& context_idx)
 {
+    if (TryAcquireContext(context_idx))
+        return;
+
+    // Slow path, all contexts are busy. Block until one is released.
+    std::unique_lock<std::mutex> lock(mutex_access_m);
+    num_waiters_m++;
+    cv_access_m.wait(lock, [this, &context_idx]
+                     { return this->TryAcquireContext(context_idx); });
+    num_waiters_m--;
+}
+
+void ExecutionObject::Impl::AcquireContextAt(uint32_t context_idx)
+{
+    const uint32_t bit = 1u << context_idx;
+    auto try_acquire = [this, bit]()
+    {
+        uint32_t busy = idle_encoding_m.load();
+        while ((busy & bit) == 0)
+            if (idle_encoding_m.compare_exchange_weak(busy, busy | bit))
+                return true;
+        return false;
+    };
+
+    if (try_acquire())
+        return;
+
     std::unique_lock<std::mutex> lock(mutex_access_m);
-    cv_access_m.wait(lock, [this]{ return this->idle_encoding_m <
-                                   (1 << tidl::internal::NUM_CONTEXTS) - 1; });
+    num_waiters_m++;
+    cv_access_m.wait(lock, try_acquire);
+    num_waiters_m--;
+}
+
+//
+// Replace the network run by this EO with the network initialized on other.
+// Waits for the frames in flight to complete and holds all contexts during
+// the swap, frames started afterwards run the new network. Buffers, frame
+// indices and metrics of the EO are kept.
+//
+void ExecutionObject::Impl::SwapNetwork(Impl& other)
+{
+    if (other.in_size_m != in_size_m || other.out_size_m != out_size_m ||
+        other.num_contexts_m != num_contexts_m)
+        throw Exception("Network input/output sizes or number of contexts "
+                        "differ, cannot swap on " + device_name_m,
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    AcquireAllContexts();
+
+    std::swap(tidl_extmem_heap_m,         other.tidl_extmem_heap_m);
+    std::swap(shared_initialize_params_m, other.shared_initialize_params_m);
+    std::swap(shared_process_params_m,    other.shared_process_params_m);
+    std::swap(num_network_layers_m,       other.num_network_layers_m);
+    std::swap(trace_buf_params_m,         other.trace_buf_params_m);
+    std::swap(trace_buf_params_sz_m,      other.trace_buf_params_sz_m);
+    std::swap(k_initialize_m,             other.k_initialize_m);
+    std::swap(k_process_m,                other.k_process_m);
+    std::swap(k_cleanup_m,                other.k_cleanup_m);
+    std::swap(configuration_m,            other.configuration_m);
+    std::swap(in_plans_m,                 other.in_plans_m);
+    std::swap(out_plans_m,                other.out_plans_m);
+    std::swap(work_m,                     other.work_m);
+
+    ReleaseAllContexts();
+}
+
+//
+// Copy the output of the frame started in context 0 as soon as it completes,
+// on a host worker if any (see HostThreads) or on the OpenCL runtime thread.
+// If the completion cannot be observed, ProcessFrameWait copies the output.
+//
+void ExecutionObject::Impl::StartEagerCopy()
+{
+    // The previous frame was waited for, see ProcessFrameWait
+    if (eager_frame_pool_m == nullptr)
+        eager_frame_pool_m = std::make_shared<EagerFrame>();
+    EagerFrame& frame = *eager_frame_pool_m;
+    {
+        std::lock_guard<std::mutex> lock(frame.mutex);
+        frame.done       = false;
+        frame.status     = false;
+        frame.error      = nullptr;
+        frame.started_by = started_by_m;
+    }
+    started_by_m = nullptr;
+
+    Impl* impl    = this;
+    auto complete = [impl]() { impl->CompleteEagerFrame(); };
+    if (AddCallback(CallType::PROCESS,
+                    [complete]() { HostThreads::Run(complete); }, 0))
+        eager_frame_m = eager_frame_pool_m;
+}
+
+void ExecutionObject::Impl::CompleteEagerFrame()
+{
+    AllocCheck::Scope  no_alloc(alloc_check_m, __FUNCTION__);
+    EagerFrame&        frame  = *eager_frame_pool_m;
+    bool               status = false;
+    std::exception_ptr error;
+    try
+    {
+        status = Wait(CallType::PROCESS, 0);
+    }
+    catch (...)
+    {
+        no_alloc.Skip();
+        error = std::current_exception();
+    }
+
+    // Signal and notify under the lock: once the waiter sees done, the EO
+    // and the frame it owns may be destroyed
+    std::lock_guard<std::mutex> lock(frame.mutex);
+    frame.done   = true;
+    frame.status = status;
+    frame.error  = error;
+    completion_fd_m.Signal();
+    if (frame.started_by)  frame.started_by->completion_fd_m.Signal();
+    frame.cv.notify_all();
+}
+
+//
+// Recover the EO after a device error. Frames in flight are abandoned and
+// the network instance on the device is cleaned up and initialized again,
+// from the create parameters and parameter heap kept by the Executor. The
+// command queue is shared by all EOs on the device and is left alone, a
+// failed command does not prevent later ones from running.
+//
+// Every context is claimed first. Frames in flight on other threads, e.g.
+// with a callback or from a pipeline, release their context once their
+// completion has waited for the device, failed or not. Claiming the
+// contexts waits for those completions, rather than marking the contexts
+// idle under them, and holds off new frames until the reset is done.
+//
+void ExecutionObject::Impl::Reset()
+{
+    AcquireAllContexts();
+
+    // No completion is pending once all contexts are held, abandon any
+    // kernel left enqueued by a call that failed
+    for (uint32_t i = 0; i < num_contexts_m; i++)
+        k_process_m->Abandon(i);
+    k_initialize_m->Abandon();
+    k_cleanup_m->Abandon();
 
-    for (uint32_t i = 0; i < tidl::internal::NUM_CONTEXTS; i++)
-        if (((1 << i) & idle_encoding_m) == 0)
+    started_by_m = nullptr;
+
+    try
+    {
+        // The network instance may not be intact, cleanup errors are
+        // expected
+        try
         {
-            context_idx = i;
-            break;
+            RunAsync(CallType::CLEANUP, 0);
+            Wait(CallType::CLEANUP, 0);
         }
-    idle_encoding_m |= (1 << context_idx);  // mark the bit as busy
+        catch (const Exception& e)
+        {
+            TRACE::print("Cleanup failed on %s: %s\n", device_name_m.c_str(),
+                         e.what());
+        }
+
+        InitializeInitParams();
+        RunAsync(CallType::INIT, 0);
+        Wait(CallType::INIT, 0);
+    }
+    catch (...)
+    {
+        ReleaseAllContexts();
+        throw;
+    }
+
+    ReleaseAllContexts();
+}
+
+// Wait for the frames in flight, and hold off new frames, by claiming every
+// context of the EO
+void ExecutionObject::Impl::AcquireAllContexts()
+{
+    for (uint32_t i = 0; i < num_contexts_m; i++)
+        AcquireContextAt(i);
+}
+
+void ExecutionObject::Impl::ReleaseAllContexts()
+{
+    for (uint32_t i = 0; i < num_contexts_m; i++)
+        ReleaseContext(i);
+}
+
+//
+// Claim an idle context without blocking. If all contexts are busy,
+// on_release is invoked once a context is released, on the releasing
+// thread, to let the caller try again.
+//
+bool ExecutionObject::Impl::TryAcquireContext(uint32_t& context_idx,
+                                              std::function<void()> on_release)
+{
+    if (TryAcquireContext(context_idx))
+        return true;
+
+    // Count the waiter before trying again, so that a concurrent release
+    // either is seen by the second try or sees the waiter
+    std::lock_guard<std::mutex> lock(mutex_access_m);
+    num_waiters_m++;
+    if (TryAcquireContext(context_idx))
+    {
+        num_waiters_m--;
+        return true;
+    }
+
+    deferred_m.push_back(std::move(on_release));
+    return false;
 }
 
 void ExecutionObject::Impl::ReleaseContext(uint32_t context_idx)
 {
+    // mark the bit as free
+    idle_encoding_m.fetch_and(~(1u << context_idx));
+
+    // Only take the lock if there is a thread blocked in AcquireContext or
+    // a deferred caller. Taking the lock orders the release with the
+    // waiter's predicate check.
+    if (num_waiters_m.load() > 0)
     {
-        std::unique_lock<std::mutex> lock(mutex_access_m);
-        idle_encoding_m &= (~(1 << context_idx));  // mark the bit as free
+        std::function<void()> deferred;
+        {
+            std::lock_guard<std::mutex> lock(mutex_access_m);
+            if (!deferred_m.empty())
+            {
+                deferred = std::move(deferred_m.front());
+                deferred_m.pop_front();
+                num_waiters_m--;
+            }
+        }
+        cv_access_m.notify_all();
+
+        if (deferred)  deferred();
     }
-    cv_access_m.notify_all();
 }
@@ -27,66 +27,181 @@
  *****************************************************************************/
 
 #include <assert.h>
+#include <algorithm>
+#include <map>
+#include <atomic>
 #include <mutex>
+#include <thread>
 #include <condition_variable>
+#include "buffer_pool.h"
 #include "device_arginfo.h"
 #include "execution_object_pipeline.h"
+#include "frame_batch.h"
 #include "parameters.h"
+#include "trace.h"
 #include "util.h"
+#include "metrics_recorder.h"
+#include "completion_fd.h"
+#include "host_threads.h"
+#include "ring_queue.h"
+#include "alloc_check.h"
+#include "run_frame.h"
 
 using namespace tidl;
 
+// State of a frame in flight through the pipeline
+struct FrameSlot
+{
+    ExecutionObjectPipeline*      eop;
+    uint32_t                      slot_idx;
+
+    //! frame index
+    int                           frame_idx;
+
+    //! current execution object index, and it context index
+    uint32_t                      curr_eo_idx;
+    uint32_t                      curr_eo_context_idx;
+
+    //! input, intermediate and output buffers for the frame
+    std::vector<IODeviceArgInfo*> iobufs;
+
+    //! raw frame set by the user if the pipeline has a preprocessing
+    //! stage. iobufs[0] is then owned by the pipeline.
+    ArgInfo                       raw{nullptr, 0};
+
+    //! time spent by the frame in each EO
+    FrameTiming                   timing;
+
+    //! when the frame was started, for latency metrics
+    uint64_t                      start_us;
+
+    //! user callback, if the frame was started with one
+    FrameCallback                 callback;
+
+    //! output of the current EO has been read and its context released,
+    //! the frame waits for a context on the next EO
+    bool                          output_read;
+
+    //! flags for signaling completion and waiting, guarded by Impl::mutex_m
+    bool                          has_work;
+    bool                          is_processed;
+    bool                          status;
+};
+
 class ExecutionObjectPipeline::Impl
 {
     public:
-        Impl(std::vector<ExecutionObject*> &eos);
+        Impl(ExecutionObjectPipeline* eop, std::vector<ExecutionObject*> &eos,
+             uint32_t num_slots);
         ~Impl();
 
-        void SetInputOutputBuffer(const ArgInfo &in, const ArgInfo &out);
-        bool RunAsyncStart();
-        bool RunAsyncNext();
-        bool Wait();
+        void SetInputOutputBuffer(const ArgInfo &in, const ArgInfo &out,
+                                  uint32_t slot_idx);
+        bool RunAsyncStart(FrameSlot& slot);
+        enum class Next { DONE, STARTED, DEFERRED };
+        Next RunAsyncNext(FrameSlot& slot);
+        bool Wait(FrameSlot& slot);
+        WaitStatus WaitFor(FrameSlot& slot,
+                           std::chrono::microseconds timeout);
+        bool IsBusy(FrameSlot& slot);
+        void Complete(FrameSlot& slot, bool status);
+        void FailStart(FrameSlot& slot);
+        bool AddCallback(FrameSlot& slot);
+        void AcquireBuffers(FrameSlot& slot);
+        void ReleaseBuffers(FrameSlot& slot);
+        void SetPreprocessStage(PreprocessFunction preprocess,
+                                size_t raw_size);
+        void RunPreprocessStage();
+
+        FrameSlot&       CurrentSlot()       { return slots_m[curr_slot_m]; }
+        const FrameSlot& CurrentSlot() const { return slots_m[curr_slot_m]; }
+        void             AdvanceSlot()
+                    { curr_slot_m = (curr_slot_m + 1) % slots_m.size(); }
 
         // Trace related
         void WriteLayerOutputsToFile(const std::string& filename_prefix) const;
         const LayerOutput* GetOutputFromLayer(uint32_t layer_index,
                                               uint32_t output_index) const;
         const LayerOutputs* GetOutputsFromAllLayers() const;
+        size_t GetLayerOutputViews(LayerOutputViews& views) const;
 
         //! for pipelined execution
         std::vector<ExecutionObject*> eos_m;
-        std::vector<IODeviceArgInfo*> iobufs_m;
+
+        //! one slot per frame in flight, and the slot used by the next frame
+        std::vector<FrameSlot>        slots_m;
+        uint32_t                      curr_slot_m;
 
         std::string device_name_m;
 
-        //! current frame index
-        int frame_idx_m;
+        //! identifies the pipeline in the time stamp log
+        uint32_t                      pipeline_id_m;
+
+        //! frames started and not yet completed
+        std::atomic<uint32_t>         frames_in_flight_m;
+        MetricsRecorder               metrics_m;
+
+        // Signalled when a frame started without a callback completes
+        CompletionFd                  completion_fd_m;
 
-        //! current execution object index, and it context index
-        uint32_t curr_eo_idx_m;
-        uint32_t curr_eo_context_idx_m;
+        // Calls on the frame path, see AllocCheck
+        AllocCheck::Counter           alloc_check_m;
+
+        void RecordEvent(int frame_idx, uint32_t slot_idx,
+                         TimeStampRecorder::API api,
+                         TimeStampRecorder::Phase phase) const
+        {
+            tidl::RecordEvent(frame_idx, pipeline_id_m,
+                              TimeStampRecorder::PIPELINE_STAGE, api, phase,
+                              0, 0, slot_idx);
+        }
+
+        //! true if the output of the i-th EO is copied directly from its
+        //! device buffers into the input device buffers of the (i+1)-th EO
+        std::vector<bool>             handoff_m;
+
+        //! DDR pool for the output of the i-th EO, shared with other
+        //! pipelines on the same EO. nullptr if the output is handed off.
+        std::vector<std::shared_ptr<BufferPool>> pools_m;
+
+        //! optional preprocessing stage ahead of the first EO, run on
+        //! stage_thread_m for the frames in stage_queue_m
+        PreprocessFunction            preprocess_m;
+        size_t                        raw_size_m;
+        BufferPool                    stage_pool_m;
+        std::thread                   stage_thread_m;
+        RingQueue<FrameSlot*>         stage_queue_m;
+        bool                          stage_stop_m;
+        std::mutex                    stage_mutex_m;
+        std::condition_variable       stage_cv_m;
 
     private:
         //! @brief Initialize ExecutionObjectPipeline with given
         //! ExecutionObjects: check consecutive layersGroup, allocate memory
-        void Initialize();
+        void Initialize(ExecutionObjectPipeline* eop, uint32_t num_slots);
 
-        // flag, mutex and cond var for signaling completion and waiting
-        bool has_work_m, is_processed_m;
+        // mutex and cond var for signaling completion and waiting
         std::mutex mutex_m;
         std::condition_variable cv_m;
+        // Frame callbacks being invoked, the slots are retired before
+        uint32_t callbacks_running_m;
 };
 
 ExecutionObjectPipeline::ExecutionObjectPipeline(
-    std::vector<ExecutionObject*> eos)
+    std::vector<ExecutionObject*> eos, uint32_t num_frames_in_flight)
 {
-    pimpl_m = std::unique_ptr<Impl> { new Impl(eos) };
+    pimpl_m = std::unique_ptr<Impl> { new Impl(this, eos,
+                                               num_frames_in_flight) };
 }
 
-ExecutionObjectPipeline::Impl::Impl(std::vector<ExecutionObject *> &eos) :
-    eos_m(eos), has_work_m(false), is_processed_m(false)
+ExecutionObjectPipeline::Impl::Impl(ExecutionObjectPipeline* eop,
+                                    std::vector<ExecutionObject *> &eos,
+                                    uint32_t num_slots) :
+    eos_m(eos), curr_slot_m(0), pipeline_id_m(NewPipelineId()),
+    frames_in_flight_m(0), raw_size_m(0), stage_stop_m(false),
+    callbacks_running_m(0)
 {
-    Initialize();
+    Initialize(eop, num_slots);
 }
 
 // Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
@@ -96,7 +211,17 @@ ExecutionObjectPipeline::~ExecutionObjectPipeline() = default;
 
 char* ExecutionObjectPipeline::GetInputBufferPtr() const
 {
-    return static_cast<char *>(pimpl_m->iobufs_m.front()->GetArg().ptr());
+    return GetInputBufferPtr(pimpl_m->curr_slot_m);
+}
+
+char* ExecutionObjectPipeline::GetInputBufferPtr(uint32_t slot_idx) const
+{
+    assert(slot_idx < pimpl_m->slots_m.size());
+    if (pimpl_m->preprocess_m)
+        return static_cast<char *>(pimpl_m->slots_m[slot_idx].raw.ptr());
+
+    return static_cast<char *>(
+                    pimpl_m->slots_m[slot_idx].iobufs.front()->GetArg().ptr());
 }
 
 uint32_t ExecutionObjectPipeline::GetNumExecutionObjects() const
@@ -104,14 +229,45 @@ uint32_t ExecutionObjectPipeline::GetNumExecutionObjects() const
     return pimpl_m->eos_m.size();
 }
 
+ExecutionObject* ExecutionObjectPipeline::GetExecutionObject(
+                                                        uint32_t index) const
+{
+    if (index >= pimpl_m->eos_m.size())
+        throw Exception("Invalid ExecutionObject index " +
+                        std::to_string(index),
+                        __FILE__, __FUNCTION__, __LINE__);
+    return pimpl_m->eos_m[index];
+}
+
+uint32_t ExecutionObjectPipeline::GetNumFramesInFlight() const
+{
+    return pimpl_m->slots_m.size();
+}
+
 size_t ExecutionObjectPipeline::GetInputBufferSizeInBytes() const
 {
+    if (pimpl_m->preprocess_m)
+        return pimpl_m->raw_size_m;
+
     return pimpl_m->eos_m.front()->GetInputBufferSizeInBytes();
 }
 
+void ExecutionObjectPipeline::SetPreprocessStage(PreprocessFunction preprocess,
+                                                 size_t raw_size)
+{
+    pimpl_m->SetPreprocessStage(preprocess, raw_size);
+}
+
 char* ExecutionObjectPipeline::GetOutputBufferPtr() const
 {
-    return static_cast<char *>(pimpl_m->iobufs_m.back()->GetArg().ptr());
+    return GetOutputBufferPtr(pimpl_m->curr_slot_m);
+}
+
+char* ExecutionObjectPipeline::GetOutputBufferPtr(uint32_t slot_idx) const
+{
+    assert(slot_idx < pimpl_m->slots_m.size());
+    return static_cast<char *>(
+                    pimpl_m->slots_m[slot_idx].iobufs.back()->GetArg().ptr());
 }
 
 size_t ExecutionObjectPipeline::GetOutputBufferSizeInBytes() const
@@ -119,60 +275,203 @@ size_t ExecutionObjectPipeline::GetOutputBufferSizeInBytes() const
     return pimpl_m->eos_m.back()->GetOutputBufferSizeInBytes();
 }
 
+int ExecutionObjectPipeline::GetOutputDataQ(uint32_t buffer_idx) const
+{
+    return pimpl_m->CurrentSlot().iobufs.back()->GetDataQ(buffer_idx);
+}
+
 void ExecutionObjectPipeline::SetInputOutputBuffer(const ArgInfo& in,
                                                    const ArgInfo& out)
 {
     assert(in.ptr() != nullptr  && in.size() >= GetInputBufferSizeInBytes());
     assert(out.ptr() != nullptr && out.size() >= GetOutputBufferSizeInBytes());
-    pimpl_m->SetInputOutputBuffer(in, out);
+    pimpl_m->SetInputOutputBuffer(in, out, pimpl_m->curr_slot_m);
+}
+
+void ExecutionObjectPipeline::SetInputOutputBuffer(const ArgInfo& in,
+                                                   const ArgInfo& out,
+                                                   uint32_t slot_idx)
+{
+    assert(in.ptr() != nullptr  && in.size() >= GetInputBufferSizeInBytes());
+    assert(out.ptr() != nullptr && out.size() >= GetOutputBufferSizeInBytes());
+    assert(slot_idx < pimpl_m->slots_m.size());
+    pimpl_m->SetInputOutputBuffer(in, out, slot_idx);
 }
 
 void ExecutionObjectPipeline::SetFrameIndex(int idx)
 {
-    pimpl_m->frame_idx_m = idx;
+    pimpl_m->CurrentSlot().frame_idx = idx;
 }
 
 int ExecutionObjectPipeline::GetFrameIndex() const
 {
-    return pimpl_m->frame_idx_m;
+    return pimpl_m->CurrentSlot().frame_idx;
 }
 
 bool ExecutionObjectPipeline::ProcessFrameStartAsync()
 {
-    RecordEvent(pimpl_m->frame_idx_m, TimeStamp::EOP_PFSA_START);
+    return ProcessFrameStartAsync(FrameCallback());
+}
+
+bool ExecutionObjectPipeline::ProcessFrameStartAsync(FrameCallback callback)
+{
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    FrameSlot& slot = pimpl_m->CurrentSlot();
+    pimpl_m->RecordEvent(slot.frame_idx, slot.slot_idx,
+                         TimeStampRecorder::API::PFSA,
+                         TimeStampRecorder::Phase::START);
 
     assert(GetInputBufferPtr() != nullptr && GetOutputBufferPtr() != nullptr);
-    bool st = pimpl_m->RunAsyncStart();
+    if (pimpl_m->IsBusy(slot))
+    {
+        pimpl_m->metrics_m.FrameDropped();
+        return false;
+    }
+
+    slot.callback = std::move(callback);
+    slot.start_us = TimeStampNow();
+    bool st = pimpl_m->RunAsyncStart(slot);
     if (st)
-        st = pimpl_m->eos_m[0]->AddCallback(ExecutionObject::CallType::PROCESS,
-                                         this, pimpl_m->curr_eo_context_idx_m);
+    {
+        // With a preprocessing stage, the stage thread starts the first EO
+        if (!pimpl_m->preprocess_m)
+            st = pimpl_m->AddCallback(slot);
+        pimpl_m->AdvanceSlot();
+
+        // Nothing would complete the running frame, fail it. Advanced
+        // first, a callback starting the next frame gets the next slot.
+        if (!st)
+        {
+            no_alloc.Skip();
+            pimpl_m->FailStart(slot);
+        }
+    }
 
-    RecordEvent(pimpl_m->frame_idx_m, TimeStamp::EOP_PFSA_END);
+    pimpl_m->RecordEvent(slot.frame_idx, slot.slot_idx,
+                         TimeStampRecorder::API::PFSA,
+                         TimeStampRecorder::Phase::END);
     return st;
 }
 
 bool ExecutionObjectPipeline::ProcessFrameWait()
 {
-    return pimpl_m->Wait();
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+    return pimpl_m->Wait(pimpl_m->CurrentSlot());
+}
+
+WaitStatus ExecutionObjectPipeline::ProcessFrameWaitFor(
+                                        std::chrono::microseconds timeout)
+{
+    return pimpl_m->WaitFor(pimpl_m->CurrentSlot(), timeout);
+}
+
+WaitStatus ExecutionObjectPipeline::TryProcessFrameWait()
+{
+    return ProcessFrameWaitFor(std::chrono::microseconds::zero());
+}
+
+int ExecutionObjectPipeline::GetCompletionFd()
+{
+    return pimpl_m->completion_fd_m.Get();
+}
+
+const FrameTiming& ExecutionObjectPipeline::GetFrameTiming() const
+{
+    return pimpl_m->CurrentSlot().timing;
+}
+
+Metrics ExecutionObjectPipeline::GetMetrics() const
+{
+    Metrics m = pimpl_m->metrics_m.GetSnapshot();
+
+    // The pipeline runs at the rate of its busiest device
+    for (const ExecutionObject* eo : pimpl_m->eos_m)
+        m.deviceBusyPercent = std::max(m.deviceBusyPercent,
+                                       eo->GetMetrics().deviceBusyPercent);
+
+    m.framesInFlight    = pimpl_m->frames_in_flight_m.load();
+    m.maxFramesInFlight = pimpl_m->slots_m.size();
+
+    return m;
 }
 
-void CallbackWrapper(void *user_data)
+std::unique_ptr<FrameBatch>
+ExecutionObjectPipeline::ProcessFramesAsync(const FrameDescriptors& frames)
 {
-    int frame_index = ((ExecutionObjectPipeline *) user_data)->GetFrameIndex();
-    RecordEvent(frame_index, TimeStamp::EOP_RAN_START);
+    // Keep up to one frame in flight per slot. Slots are used in order,
+    // frames complete in the order they were submitted.
+    auto runner = [this](FrameBatch::Impl& batch)
+    {
+        bool status = true;
+        for (const FrameDescriptor& f : batch.GetFrames())
+        {
+            FrameSlot& slot = pimpl_m->CurrentSlot();
+            if (pimpl_m->IsBusy(slot))
+            {
+                status &= ProcessFrameWait();
+                batch.FrameCompleted();
+            }
+
+            pimpl_m->SetInputOutputBuffer(f.GetInput(), f.GetOutput(),
+                                          pimpl_m->curr_slot_m);
+            SetFrameIndex(f.GetFrameIndex());
+            if (!ProcessFrameStartAsync())
+            {
+                // A frame failed after it was set up is retired by the
+                // wait on its slot, one never set up is accounted here
+                status = false;
+                if (!pimpl_m->IsBusy(slot))
+                    batch.FrameCompleted();
+            }
+        }
 
-    ((ExecutionObjectPipeline *) user_data)->RunAsyncNext();
+        // Drain, starting with the oldest frame in flight
+        for (uint32_t i = 0; i < pimpl_m->slots_m.size(); i++)
+        {
+            if (pimpl_m->IsBusy(pimpl_m->CurrentSlot()))
+            {
+                status &= ProcessFrameWait();
+                batch.FrameCompleted();
+            }
+            pimpl_m->AdvanceSlot();
+        }
+        return status;
+    };
 
-    RecordEvent(frame_index, TimeStamp::EOP_RAN_END);
+    return std::unique_ptr<FrameBatch>
+           { new FrameBatch(new FrameBatch::Impl(frames, runner)) };
 }
 
-void ExecutionObjectPipeline::RunAsyncNext()
+void ExecutionObjectPipeline::RunAsyncNext(uint32_t slot_idx)
 {
-    bool has_next = pimpl_m->RunAsyncNext();
-    if (has_next)
-        pimpl_m->eos_m[pimpl_m->curr_eo_idx_m]->AddCallback(
-                                     ExecutionObject::CallType::PROCESS, this,
-                                     pimpl_m->curr_eo_context_idx_m);
+    AllocCheck::Scope no_alloc(pimpl_m->alloc_check_m, __FUNCTION__);
+
+    FrameSlot& slot = pimpl_m->slots_m[slot_idx];
+    int frame_index = slot.frame_idx;
+    pimpl_m->RecordEvent(frame_index, slot_idx,
+                         TimeStampRecorder::API::RAN,
+                         TimeStampRecorder::Phase::START);
+
+    bool has_next = false;
+    try
+    {
+        has_next = pimpl_m->RunAsyncNext(slot) == Impl::Next::STARTED;
+    }
+    catch (const Exception& e)
+    {
+        no_alloc.Skip();
+        TRACE::print("Frame %d failed on %s: %s\n", frame_index,
+                     pimpl_m->device_name_m.c_str(), e.what());
+        pimpl_m->Complete(slot, false);
+    }
+
+    if (has_next && !pimpl_m->AddCallback(slot))
+        pimpl_m->Complete(slot, false);
+
+    pimpl_m->RecordEvent(frame_index, slot_idx,
+                         TimeStampRecorder::API::RAN,
+                         TimeStampRecorder::Phase::END);
 }
 
 const std::string& ExecutionObjectPipeline::GetDeviceName() const
@@ -200,22 +499,58 @@ ExecutionObjectPipeline::GetOutputsFromAllLayers() const
     return pimpl_m->GetOutputsFromAllLayers();
 }
 
+size_t
+ExecutionObjectPipeline::GetLayerOutputViews(LayerOutputViews& views) const
+{
+    return pimpl_m->GetLayerOutputViews(views);
+}
+
 
 /// Impl methods start here
 
 
 static
-void* AllocateMem(size_t size)
+bool CanHandoff(const ExecutionObject* producer,
+                const ExecutionObject* consumer)
 {
-    if (size == 0)  return nullptr;
-    void *ptr = malloc(size);
-    if (ptr == nullptr)
-        throw Exception("Out of memory, ExecutionObjectPipeline malloc failed",
-                        __FILE__, __FUNCTION__, __LINE__);
-    return ptr;
+    DeviceBufferViews out = producer->GetDeviceOutputBuffers();
+    DeviceBufferViews in  = consumer->GetDeviceInputBuffers();
+    if (out.empty() || out.size() != in.size())
+        return false;
+
+    for (size_t i = 0; i < out.size(); i++)
+        if (out[i].NumberOfROIs()     != in[i].NumberOfROIs()     ||
+            out[i].NumberOfChannels() != in[i].NumberOfChannels() ||
+            out[i].Height()           != in[i].Height()           ||
+            out[i].Width()            != in[i].Width())
+            return false;
+
+    return true;
+}
+
+// All pipelines using the output of producer as an intermediate buffer
+// share a pool. Released when the last pipeline is destroyed.
+static
+std::shared_ptr<BufferPool> GetIntermediatePool(const ExecutionObject* producer)
+{
+    static std::mutex m;
+    static std::map<const ExecutionObject*, std::weak_ptr<BufferPool>> pools;
+
+    std::lock_guard<std::mutex> guard(m);
+
+    std::weak_ptr<BufferPool>& entry = pools[producer];
+    std::shared_ptr<BufferPool> pool = entry.lock();
+    if (pool == nullptr)
+    {
+        pool  = std::make_shared<BufferPool>();
+        entry = pool;
+    }
+
+    return pool;
 }
 
-void ExecutionObjectPipeline::Impl::Initialize()
+void ExecutionObjectPipeline::Impl::Initialize(ExecutionObjectPipeline* eop,
+                                               uint32_t num_slots)
 {
     // Check consecutive layersGroups to form a pipeline
     int prev_group = 0;
@@ -229,101 +564,515 @@ void ExecutionObjectPipeline::Impl::Initialize()
         prev_group = group;
     }
 
+    // Each frame in flight occupies a context on an EO. Frames may exceed
+    // the contexts of an EO: the first EO blocks the caller until a
+    // context is free, later EOs defer the frame until a context is
+    // released rather than blocking a completion callback.
+    if (num_slots == 0)
+        throw Exception("ExecutionObjectPipeline requires at least one "
+                        "frame in flight", __FILE__, __FUNCTION__, __LINE__);
+
     for (auto eo : eos_m)
         device_name_m += eo->GetDeviceName() + "+";
     device_name_m.resize(device_name_m.size() - 1);
 
-    // Allocate input and output memory for EOs/layersGroups
+    // Hand off directly between EO device buffers when the output planes
+    // of an EO match the input planes of the next. The intermediate host
+    // buffer is then not needed: the producer skips unpadding into it and
+    // the consumer skips padding from it. dataQ is still propagated via
+    // the PipeInfo shared by both EOs.
+    for (uint32_t i = 0; i + 1 < eos_m.size(); i++)
+        handoff_m.push_back(CanHandoff(eos_m[i], eos_m[i+1]));
+
+    // Otherwise, intermediate buffers come from a DDR pool shared by all
+    // pipelines on the producer EO. A frame holds its buffers only while it
+    // is in flight.
+    for (uint32_t i = 0; i + 1 < eos_m.size(); i++)
+    {
+        if (handoff_m[i])
+            pools_m.push_back(nullptr);
+        else
+            pools_m.push_back(GetIntermediatePool(eos_m[i]));
+    }
+
+    // Input and output buffer descriptors for EOs/layersGroups, per slot
     // Note that i-th EO's output buffer is the same as (i+1)-th EO's input
     // So, if n EOs, then (n+1) buffers: b EO b EO b EO b ... EO b
     // User must set the first input buffer and the last output buffer
-    size_t size;
-    ArgInfo in(nullptr, 0);
-    iobufs_m.push_back(new IODeviceArgInfo(in));
-    for (auto eo : eos_m)
+    // Intermediate buffers are acquired from pools_m when a frame starts
+    slots_m.resize(num_slots);
+    for (uint32_t i = 0; i < num_slots; i++)
     {
-        if (eo != eos_m.back())
-            size = eo->GetOutputBufferSizeInBytes();
-        else
-            size = 0;
+        FrameSlot& slot = slots_m[i];
+        slot.eop                 = eop;
+        slot.slot_idx            = i;
+        slot.frame_idx           = 0;
+        slot.curr_eo_idx         = 0;
+        slot.curr_eo_context_idx = 0;
+        slot.output_read         = false;
+        slot.has_work            = false;
+        slot.is_processed        = false;
+        slot.status              = true;
+        slot.timing.resize(eos_m.size());
 
-        void *ptr = AllocateMem(size);
-        ArgInfo out(ptr, size);
-        iobufs_m.push_back(new IODeviceArgInfo(out));
+        ArgInfo in(nullptr, 0);
+        slot.iobufs.push_back(new IODeviceArgInfo(in));
+        for (uint32_t j = 0; j < eos_m.size(); j++)
+        {
+            ArgInfo out(nullptr, 0);
+            slot.iobufs.push_back(new IODeviceArgInfo(out));
+        }
     }
 }
 
 ExecutionObjectPipeline::Impl::~Impl()
 {
-    int num_iobufs = iobufs_m.size();
-    for (int i = 0; i < num_iobufs; i++)
+    // Frames in flight reference the slots from their callbacks. A running
+    // callback may start another frame.
+    for (;;)
+    {
+        for (auto& slot : slots_m)
+            Wait(slot);
+
+        std::unique_lock<std::mutex> lock(mutex_m);
+        cv_m.wait(lock, [this]{ return callbacks_running_m == 0; });
+        if (std::none_of(slots_m.begin(), slots_m.end(),
+                         [](const FrameSlot& s) { return s.has_work; }))
+            break;
+    }
+
+    if (stage_thread_m.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(stage_mutex_m);
+            stage_stop_m = true;
+        }
+        stage_cv_m.notify_one();
+        stage_thread_m.join();
+    }
+
+    for (auto& slot : slots_m)
     {
-        if (! (i == 0 || i == num_iobufs-1))
-            free(iobufs_m[i]->GetArg().ptr());
-        delete iobufs_m[i];
+        ReleaseBuffers(slot);
+        if (preprocess_m)
+            stage_pool_m.Release(slot.iobufs.front()->GetArg().ptr());
+        for (auto iobuf : slot.iobufs)
+            delete iobuf;
     }
 }
 
 void ExecutionObjectPipeline::Impl::SetInputOutputBuffer(const ArgInfo &in,
-                                                         const ArgInfo &out)
+                                                         const ArgInfo &out,
+                                                         uint32_t slot_idx)
+{
+    AllocCheck::Scope no_alloc(alloc_check_m, __FUNCTION__);
+
+    if (out.format() != ArgInfo::OutputFormat::RAW &&
+        out.size() < eos_m.back()->GetOutputBufferSizeInBytes() *
+                     sizeof(float))
+        throw Exception("Float output buffer is too small",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    std::vector<IODeviceArgInfo*>& iobufs = slots_m[slot_idx].iobufs;
+    if (preprocess_m)
+        slots_m[slot_idx].raw = in;
+    else
+        iobufs.front()->Rebind(in);
+    iobufs.back()->Rebind(out);
+}
+
+// The network input of each slot is allocated once, in CMEM so that the
+// first EO reads it in place
+void ExecutionObjectPipeline::Impl::SetPreprocessStage(
+                                            PreprocessFunction preprocess,
+                                            size_t raw_size)
+{
+    if (!preprocess)
+        throw Exception("Preprocessing stage requires a function",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (auto& slot : slots_m)
+        if (IsBusy(slot))
+            throw Exception("Preprocessing stage set with frames in flight",
+                            __FILE__, __FUNCTION__, __LINE__);
+
+    if (!preprocess_m)
+    {
+        size_t in_size = eos_m.front()->GetInputBufferSizeInBytes();
+        for (auto& slot : slots_m)
+        {
+            ArgInfo in(stage_pool_m.Acquire(in_size), in_size);
+            slot.iobufs.front()->Rebind(in);
+            slot.raw = ArgInfo(nullptr, 0);
+        }
+        stage_thread_m = std::thread(&Impl::RunPreprocessStage, this);
+    }
+
+    std::lock_guard<std::mutex> lock(stage_mutex_m);
+    preprocess_m = preprocess;
+    raw_size_m   = raw_size;
+}
+
+// Preprocess queued frames in order and start them on the first EO
+void ExecutionObjectPipeline::Impl::RunPreprocessStage()
 {
-    delete iobufs_m.front();
-    delete iobufs_m.back();
-    iobufs_m.front() = new IODeviceArgInfo(in);
-    iobufs_m.back()  = new IODeviceArgInfo(out);
+    while (true)
+    {
+        FrameSlot* slot;
+        {
+            std::unique_lock<std::mutex> lock(stage_mutex_m);
+            stage_cv_m.wait(lock, [this]
+                            { return stage_stop_m || !stage_queue_m.empty(); });
+            if (stage_queue_m.empty())
+                return;
+
+            slot = stage_queue_m.front();
+            stage_queue_m.pop_front();
+        }
+
+        bool status = false;
+        try
+        {
+            status = slot->raw.ptr() &&
+                     preprocess_m(slot->raw, slot->iobufs[0]->GetArg());
+            if (status && !eos_m[0]->AcquireAndRunContext(
+                                            slot->curr_eo_context_idx,
+                                            slot->frame_idx,
+                                            *slot->iobufs[0], *slot->iobufs[1],
+                                            pipeline_id_m))
+            {
+                eos_m[0]->ReleaseContext(slot->curr_eo_context_idx);
+                status = false;
+            }
+            status = status && AddCallback(*slot);
+        }
+        catch (const Exception& e)
+        {
+            TRACE::print("Frame %d failed to preprocess: %s\n",
+                         slot->frame_idx, e.what());
+            status = false;
+        }
+
+        if (!status)
+            Complete(*slot, false);
+    }
 }
 
 // Start execution on the first EO in the pipeline. Callbacks are used
 // to trigger execution on subsequent EOs
-bool ExecutionObjectPipeline::Impl::RunAsyncStart()
+bool ExecutionObjectPipeline::Impl::RunAsyncStart(FrameSlot& slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (slot.has_work)  return false;
+
+        slot.has_work     = true;
+        slot.is_processed = false;
+        slot.status       = true;
+    }
+    frames_in_flight_m++;
+    slot.curr_eo_idx = 0;
+    slot.output_read = false;
+    for (uint32_t i = 0; i < eos_m.size(); i++)
+    {
+        slot.timing[i] = StageTiming();
+        slot.timing[i].layersGroupId = eos_m[i]->GetLayersGroupId();
+    }
+    try
+    {
+        AcquireBuffers(slot);
+    }
+    catch (...)
+    {
+        ReleaseBuffers(slot);
+        frames_in_flight_m--;
+        metrics_m.FrameFailed();
+        std::lock_guard<std::mutex> lock(mutex_m);
+        slot.has_work = false;
+        throw;
+    }
+
+    if (preprocess_m)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stage_mutex_m);
+            stage_queue_m.push_back(&slot);
+        }
+        stage_cv_m.notify_one();
+        return true;
+    }
+
+    if (eos_m[0]->AcquireAndRunContext(slot.curr_eo_context_idx,
+                                       slot.frame_idx,
+                                       *slot.iobufs[0], *slot.iobufs[1],
+                                       pipeline_id_m))
+        return true;
+
+    FailStart(slot);
+    return false;
+}
+
+// Intermediate buffers are set up before the frame starts. The slot's
+// descriptors are rebound, their PipeInfo is shared by the producer and
+// consumer EO of the frame.
+void ExecutionObjectPipeline::Impl::AcquireBuffers(FrameSlot& slot)
 {
-    has_work_m = true;
-    is_processed_m = false;
-    curr_eo_idx_m = 0;
-    return eos_m[0]->AcquireAndRunContext(curr_eo_context_idx_m,
-                                          frame_idx_m,
-                                          *iobufs_m[0], *iobufs_m[1]);
+    for (uint32_t i = 0; i < pools_m.size(); i++)
+    {
+        if (pools_m[i] == nullptr)  continue;
+
+        size_t size = eos_m[i]->GetOutputBufferSizeInBytes();
+        ArgInfo buf(pools_m[i]->Acquire(size), size);
+        slot.iobufs[i+1]->Rebind(buf);
+    }
 }
 
-// Invoked via the callback function, CallbackWrapper. Used to advance the
-// pipeline.
-// returns true if we have more EOs to execute
-bool ExecutionObjectPipeline::Impl::RunAsyncNext()
+void ExecutionObjectPipeline::Impl::ReleaseBuffers(FrameSlot& slot)
 {
-    eos_m[curr_eo_idx_m]->WaitAndReleaseContext(curr_eo_context_idx_m);
-    curr_eo_idx_m += 1;
-    if (curr_eo_idx_m < eos_m.size())
+    for (uint32_t i = 0; i < pools_m.size(); i++)
     {
-        eos_m[curr_eo_idx_m]->AcquireAndRunContext(curr_eo_context_idx_m,
-                                                   frame_idx_m,
-                                                   *iobufs_m[curr_eo_idx_m],
-                                                   *iobufs_m[curr_eo_idx_m+1]);
-        return true;
+        char* ptr = static_cast<char *>(slot.iobufs[i+1]->GetArg().ptr());
+        if (pools_m[i] == nullptr || ptr == nullptr)  continue;
+
+        pools_m[i]->Release(ptr);
+        slot.iobufs[i+1]->Rebind(ArgInfo(nullptr, 0));
     }
-    else
+}
+
+// Invoked from the completion callback of the current EO. Used to advance
+// the pipeline. If the next EO has no idle context, RunAsyncNext is invoked
+// again for the slot when one is released.
+// returns STARTED if the frame started on the next EO
+ExecutionObjectPipeline::Impl::Next
+ExecutionObjectPipeline::Impl::RunAsyncNext(FrameSlot& slot)
+{
+    uint32_t         idx  = slot.curr_eo_idx;
+    ExecutionObject* curr = eos_m[idx];
+    uint32_t         curr_context_idx = slot.curr_eo_context_idx;
+
+    if (idx + 1 == eos_m.size())
+    {
+        curr->WaitAndReleaseContext(curr_context_idx, &slot.timing[idx]);
+        Complete(slot, true);
+        return Next::DONE;
+    }
+
+    // Without a handoff, the output is read into the intermediate buffer
+    // and the context released before waiting for the next EO
+    if (!handoff_m[idx] && !slot.output_read)
+    {
+        curr->WaitAndReleaseContext(curr_context_idx, &slot.timing[idx]);
+        slot.output_read = true;
+    }
+
+    // With a handoff, hold the producer context until its output has been
+    // copied into the consumer's input, another frame cannot overwrite it
+    // in the meantime
+    ExecutionObjectPipeline* eop = slot.eop;
+    uint32_t slot_idx = slot.slot_idx;
+    ExecutionObject* next = eos_m[idx + 1];
+    uint32_t next_context_idx;
+    if (!next->TryAcquireContext(next_context_idx, slot.frame_idx,
+                                 *slot.iobufs[idx + 1], *slot.iobufs[idx + 2],
+                                 pipeline_id_m,
+                                 [eop, slot_idx]()
+                                 { eop->RunAsyncNext(slot_idx); }))
+        return Next::DEFERRED;
+
+    slot.output_read = false;
+
+    if (handoff_m[idx])
     {
+        try
+        {
+            curr->WaitContext(curr_context_idx);
+            slot.timing[idx] = curr->GetContextTiming(curr_context_idx);
+
+            // The device to device copy is the producer's copy out
+            uint64_t start = TimeStampNow();
+            DeviceBufferViews out =
+                            curr->GetDeviceOutputBuffers(curr_context_idx);
+            DeviceBufferViews in  =
+                            next->GetDeviceInputBuffers(next_context_idx);
+            for (size_t i = 0; i < out.size(); i++)
+                out[i].CopyTo(in[i]);
+            slot.timing[idx].copyOutMs += (TimeStampNow() - start) / 1000.0f;
+        }
+        catch (...)
         {
-            std::lock_guard<std::mutex> lock(mutex_m);
-            is_processed_m = true;
+            curr->ReleaseContext(curr_context_idx);
+            next->ReleaseContext(next_context_idx);
+            throw;
         }
+        curr->ReleaseContext(curr_context_idx);
+    }
+
+    slot.curr_eo_idx         = idx + 1;
+    slot.curr_eo_context_idx = next_context_idx;
+    try
+    {
+        next->RunContext(next_context_idx);
+    }
+    catch (...)
+    {
+        next->ReleaseContext(next_context_idx);
+        throw;
+    }
+    return Next::STARTED;
+}
+
+// Chain RunAsyncNext to the completion of the frame on the current EO
+bool ExecutionObjectPipeline::Impl::AddCallback(FrameSlot& slot)
+{
+    ExecutionObjectPipeline* eop = slot.eop;
+    uint32_t slot_idx = slot.slot_idx;
+    auto next = [eop, slot_idx]() { eop->RunAsyncNext(slot_idx); };
+    return eos_m[slot.curr_eo_idx]->AddCallback(
+                            ExecutionObject::CallType::PROCESS,
+                            [next]() { HostThreads::Run(next); },
+                            slot.curr_eo_context_idx);
+}
+
+// The frame has completed on the last EO (or failed). If the frame was
+// started with a callback, retire the frame and invoke the callback.
+// Otherwise ProcessFrameWait retires the frame.
+void ExecutionObjectPipeline::Impl::Complete(FrameSlot& slot, bool status)
+{
+    ReleaseBuffers(slot);
+
+    frames_in_flight_m--;
+    if (status)
+        metrics_m.FrameCompleted(TimeStampNow() - slot.start_us, 0);
+    else
+        metrics_m.FrameFailed();
+
+    FrameCallback callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    if (!callback)
+    {
+        // Notify under the lock: once the frame is retired the destructor
+        // waiting on is_processed may proceed and destroy cv_m
+        std::lock_guard<std::mutex> lock(mutex_m);
+        slot.status       = status;
+        slot.is_processed = true;
+        completion_fd_m.Signal();
+        cv_m.notify_all();
+        return;
+    }
+
+    // The callback may start the next frame on the slot, as on an
+    // ExecutionObject whose context is released first. Copy what the
+    // result refers to. One timing per thread, allocated by its first
+    // frame, a frame completing within the callback of another frame on
+    // the same thread gets its own.
+    const int                frame_idx = slot.frame_idx;
+    const ArgInfo            out       = slot.iobufs.back()->GetArg();
+    ExecutionObjectPipeline& eop       = *slot.eop;
+    static thread_local bool thread_timing_busy = false;
+    const bool   nested = thread_timing_busy;
+    FrameTiming  nested_timing;
+    FrameTiming* timing;
+    {
+        AllocCheck::Exclude first_use;
+        static thread_local FrameTiming thread_timing;
+        timing = nested ? &nested_timing : &thread_timing;
+        timing->assign(slot.timing.begin(), slot.timing.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        slot.status       = status;
+        slot.is_processed = true;
+        slot.has_work     = false;
+        callbacks_running_m++;
+        cv_m.notify_all();
+    }
+
+    // The frame is complete, an exception from the callback is reported
+    // here. Rethrown, it would fail the frame a second time in
+    // RunAsyncNext, or leave the OpenCL or worker thread.
+    FrameResult result(frame_idx, status, out, eop, *timing);
+    thread_timing_busy = true;
+    try
+    {
+        AllocCheck::Exclude user_callback;
+        callback(result);
+    }
+    catch (...)
+    {
+        AllocCheck::Exclude report;
+        ReportCallbackError("ExecutionObjectPipeline", frame_idx);
+    }
+    thread_timing_busy = nested;
+
+    // As above, the destructor may proceed once notified
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        callbacks_running_m--;
         cv_m.notify_all();
-        return false;
     }
 }
 
-bool ExecutionObjectPipeline::Impl::Wait()
+// The frame holds a context on its current EO but was not started, or
+// its completion callback could not be added. Release the context and
+// fail the frame: its callback is invoked, or ProcessFrameWait returns
+// false for it rather than blocking.
+void ExecutionObjectPipeline::Impl::FailStart(FrameSlot& slot)
 {
-    if (! has_work_m)  return false;
+    AllocCheck::Exclude failed;
+    try
+    {
+        eos_m[slot.curr_eo_idx]->WaitAndReleaseContext(
+                                                slot.curr_eo_context_idx);
+    }
+    catch (const Exception& e)
+    {
+        TRACE::print("Frame %d failed on %s: %s\n", slot.frame_idx,
+                     device_name_m.c_str(), e.what());
+    }
+    Complete(slot, false);
+}
 
-    RecordEvent(frame_idx_m, TimeStamp::EOP_PFW_START);
+bool ExecutionObjectPipeline::Impl::IsBusy(FrameSlot& slot)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return slot.has_work;
+}
 
+bool ExecutionObjectPipeline::Impl::Wait(FrameSlot& slot)
+{
     std::unique_lock<std::mutex> lock(mutex_m);
-    cv_m.wait(lock, [this]{ return this->is_processed_m; });
-    has_work_m = false;
+    if (! slot.has_work)  return false;
 
-    RecordEvent(frame_idx_m, TimeStamp::EOP_PFW_END);
+    RecordEvent(slot.frame_idx, slot.slot_idx,
+                TimeStampRecorder::API::PFW,
+                TimeStampRecorder::Phase::START);
 
-    return true;
+    cv_m.wait(lock, [&slot]{ return slot.is_processed; });
+    slot.has_work = false;
+
+    RecordEvent(slot.frame_idx, slot.slot_idx,
+                TimeStampRecorder::API::PFW,
+                TimeStampRecorder::Phase::END);
+
+    return slot.status;
+}
+
+// Wait for the frame to be processed, then retire it via Wait, which
+// returns without blocking at that point
+WaitStatus ExecutionObjectPipeline::Impl::WaitFor(FrameSlot& slot,
+                                        std::chrono::microseconds timeout)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        if (! slot.has_work)  return WaitStatus::NO_FRAME;
+
+        if (!cv_m.wait_for(lock, timeout,
+                           [&slot]{ return slot.is_processed; }))
+            return WaitStatus::PENDING;
+    }
+
+    return Wait(slot) ? WaitStatus::COMPLETED : WaitStatus::FAILED;
 }
 
 void
@@ -362,3 +1111,13 @@ ExecutionObjectPipeline::Impl::GetOutputsFromAllLayers() const
     return all;
 }
 
+size_t
+ExecutionObjectPipeline::Impl::GetLayerOutputViews(
+                                            LayerOutputViews& views) const
+{
+    size_t count = 0;
+    for (auto eo : eos_m)
+        count += eo->GetLayerOutputViews(views);
+    return count;
+}
+
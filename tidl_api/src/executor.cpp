@@ -28,21 +28,33 @@
 
 #include <assert.h>
 #include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <mutex>
+#include <unistd.h>
 #include "executor.h"
 #include "executor_impl.h"
 #include "parameters.h"
 #include "util.h"
+#include "network_binary.h"
+#include "network_cost.h"
+#include "frame_source.h"
+#include "device_arginfo.h"
 #include "trace.h"
 
 
 using namespace tidl;
 
 using std::unique_ptr;
+typedef TimeStampRecorder::API API;
 
 Executor::Executor(DeviceType core_type, const DeviceIds& ids,
                    const Configuration& configuration, int layers_group_id)
 {
-    TRACE::enabled = configuration.enableApiTrace;
+    TRACE::enable(configuration.enableApiTrace);
 
     TRACE::print("-> Executor::Executor()\n");
 
@@ -54,6 +66,63 @@ Executor::Executor(DeviceType core_type, const DeviceIds& ids,
 }
 
 
+bool Executor::Reload(const Configuration& configuration)
+{
+    TRACE::print("-> Executor::Reload()\n");
+
+    bool status = pimpl_m->Reload(configuration);
+
+    TRACE::print("<- Executor::Reload()\n");
+    return status;
+}
+
+bool Executor::WarmUp(const FrameSource& source, uint32_t num_frames)
+{
+    return pimpl_m->WarmUp(source, num_frames);
+}
+
+bool Executor::SaveQuantizationState(const std::string& file) const
+{
+    return pimpl_m->SaveQuantizationState(file);
+}
+
+bool Executor::LoadQuantizationState(const std::string& file)
+{
+    return pimpl_m->LoadQuantizationState(file);
+}
+
+void Executor::ResetExecutionObject(uint32_t index)
+{
+    TRACE::print("-> Executor::ResetExecutionObject(%d)\n", index);
+
+    pimpl_m->ResetExecutionObject(index);
+
+    TRACE::print("<- Executor::ResetExecutionObject()\n");
+}
+
+uint32_t Executor::AddNetwork(const Configuration& configuration)
+{
+    TRACE::print("-> Executor::AddNetwork()\n");
+
+    uint32_t idx = pimpl_m->AddNetwork(configuration);
+
+    TRACE::print("<- Executor::AddNetwork()\n");
+    return idx;
+}
+
+std::future<std::unique_ptr<Executor>>
+Executor::CreateAsync(DeviceType core_type, const DeviceIds& ids,
+                      const Configuration& configuration, int layers_group_id)
+{
+    // Arguments are copied, the caller's objects need not outlive the call
+    return std::async(std::launch::async,
+                      [core_type, ids, configuration, layers_group_id]()
+                      {
+                          return unique_ptr<Executor>
+                                 { new Executor(core_type, ids, configuration,
+                                                layers_group_id) };
+                      });
+}
 
 // Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
 // Both unique_ptr and shared_ptr can be instantiated with an incomplete type
@@ -71,26 +140,69 @@ uint32_t Executor::GetNumDevices(DeviceType device_type)
 
 #define STRING(S)  XSTRING(S)
 #define XSTRING(S) #S
+// Hashed into the keys of saved state, must not change within a build
+static const char API_VERSION[] = STRING(_BUILD_VER) "." STRING(_BUILD_SHA);
+
 std::string Executor::GetAPIVersion()
 {
-    static std::string version = STRING(_BUILD_VER);
-    version += ".";
-    version += STRING(_BUILD_SHA);
-    return version;
+    return API_VERSION;
 }
 
 
+namespace {
+// Measures a phase of Executor startup for its lifetime: adds the time to
+// ms and records the phase in the time stamp log, on a track of its own
+class StartupPhase
+{
+    public:
+        StartupPhase(float& ms, TimeStampRecorder::API api, DeviceType type,
+                     int layers_group_id, int eo_id = 0):
+            ms_m(ms), api_m(api), type_m(static_cast<int>(type)),
+            stage_m(layers_group_id), eo_id_m(eo_id),
+            start_m(TimeStampNow()) {}
+
+        ~StartupPhase()
+        {
+            typedef TimeStampRecorder::Phase Phase;
+            uint64_t end = TimeStampNow();
+            ms_m += (end - start_m) / 1000.0f;
+            RecordEvent(-1, 0, stage_m, api_m, Phase::START, type_m, eo_id_m,
+                        -1, start_m);
+            RecordEvent(-1, 0, stage_m, api_m, Phase::END, type_m, eo_id_m,
+                        -1, end);
+        }
+
+        StartupPhase(const StartupPhase&)            = delete;
+        StartupPhase& operator=(const StartupPhase&) = delete;
+
+    private:
+        float&                 ms_m;
+        TimeStampRecorder::API api_m;
+        int                    type_m;
+        int                    stage_m;
+        int                    eo_id_m;
+        uint64_t               start_m;
+};
+}
+
 ExecutorImpl::ExecutorImpl(DeviceType core_type, const DeviceIds& ids,
                            int layers_group_id):
     configuration_m(),
     shared_networkparam_heap_m(nullptr, &__free_ddr),
+    shared_createparam_m(nullptr, &__free_ddr),
+    network_m(nullptr),
+    params_m(nullptr),
     device_ids_m(ids),
     core_type_m(core_type),
     layers_group_id_m(layers_group_id),
-    extmem_alloc_opt_m(TIDL_optimiseExtMemL1)
+    extmem_alloc_opt_m(TIDL_optimiseExtMemL1),
+    startup_start_us_m(TimeStampNow())
 {
     std::string name = STRING(SETUP_KERNEL) ";" STRING(INIT_KERNEL) ";"
                        STRING(PROCESS_KERNEL) ";" STRING(CLEANUP_KERNEL);
+
+    StartupPhase phase(startup_m.deviceCreateMs, API::DEVICE_CREATE,
+                       core_type_m, layers_group_id_m);
     device_m = Device::Create(core_type_m, ids, name);
 }
 
@@ -105,8 +217,138 @@ uint32_t Executor::GetNumExecutionObjects() const
     return pimpl_m->execution_objects_m.size();
 }
 
+std::vector<Metrics> Executor::GetMetrics() const
+{
+    std::vector<Metrics> metrics;
+    for (const auto& eo : pimpl_m->execution_objects_m)
+        metrics.push_back(eo->GetMetrics());
+
+    return metrics;
+}
+
+HeapUsage Executor::GetHeapUsage() const
+{
+    return pimpl_m->GetHeapUsage();
+}
+
+StartupTiming Executor::GetStartupTiming() const
+{
+    return pimpl_m->GetStartupTiming();
+}
+
+namespace {
+// The device reports heap statistics as trace output on the host's stdout,
+// the setup and initialization kernels have no other way to return them.
+// Redirects stdout to a temporary file for the lifetime of the object. The
+// captured output is echoed to stdout when the redirection ends.
+//
+// stdout is process wide. Captures are serialized by a process wide lock,
+// held from the redirection until the output has been echoed: Executors
+// initialized concurrently, e.g. by Executor::CreateAsync or AddNetwork,
+// then neither interleave their save/restore of stdout nor read each
+// other's statistics. The output of other threads written during a
+// capture is delayed until it ends.
+class OutputCapture
+{
+    public:
+        OutputCapture() : lock_m(GetMutex()), file_m(std::tmpfile()),
+                          saved_fd_m(-1)
+        {
+            if (file_m == nullptr)
+            {
+                lock_m.unlock();
+                return;
+            }
+
+            std::cout.flush();
+            std::fflush(stdout);
+            saved_fd_m = dup(STDOUT_FILENO);
+            if (saved_fd_m >= 0 &&
+                dup2(fileno(file_m), STDOUT_FILENO) < 0)
+            {
+                close(saved_fd_m);
+                saved_fd_m = -1;
+            }
+        }
+
+        ~OutputCapture() { Release(); }
+
+        // Restore stdout and return the captured output
+        std::string Release()
+        {
+            std::string output;
+            if (file_m == nullptr)
+                return output;
+
+            if (saved_fd_m >= 0)
+            {
+                std::cout.flush();
+                std::fflush(stdout);
+                dup2(saved_fd_m, STDOUT_FILENO);
+                close(saved_fd_m);
+                saved_fd_m = -1;
+
+                std::rewind(file_m);
+                char   buf[4096];
+                size_t n;
+                while ((n = std::fread(buf, 1, sizeof(buf), file_m)) > 0)
+                    output.append(buf, n);
+
+                std::fwrite(output.data(), 1, output.size(), stdout);
+                std::fflush(stdout);
+            }
+
+            std::fclose(file_m);
+            file_m = nullptr;
+            lock_m.unlock();
+            return output;
+        }
+
+        OutputCapture(const OutputCapture&)            = delete;
+        OutputCapture& operator=(const OutputCapture&) = delete;
+
+    private:
+        static std::mutex& GetMutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+
+        std::unique_lock<std::mutex> lock_m;
+        FILE*                        file_m;
+        int                          saved_fd_m;
+};
+
+// Parse heap statistics from device trace output. E.g.
+// [eve 0] TIDL Device Trace: PARAM heap: Size 9437184, Free 6556180, ...
+void ParseHeapUsage(const std::string& output, HeapUsage& usage)
+{
+    std::istringstream is(output);
+    std::string line;
+    while (std::getline(is, line))
+    {
+        unsigned long size, avail, requested;
+        const char *p;
+        if ((p = strstr(line.c_str(), "PARAM heap:")) != nullptr &&
+            sscanf(p, "PARAM heap: Size %lu, Free %lu, Total requested %lu",
+                   &size, &avail, &requested) == 3)
+            usage.paramHeapRequested = std::max<size_t>(
+                                         usage.paramHeapRequested, requested);
+        else if ((p = strstr(line.c_str(), "NETWORK heap:")) != nullptr &&
+            sscanf(p, "NETWORK heap: Size %lu, Free %lu, Total requested %lu",
+                   &size, &avail, &requested) == 3)
+            usage.networkHeapRequested = std::max<size_t>(
+                                       usage.networkHeapRequested, requested);
+    }
+}
+}
+
 bool ExecutorImpl::Initialize(const Configuration& configuration)
 {
+    std::unique_ptr<StartupPhase> phase(
+                        new StartupPhase(startup_m.configMs, API::CONFIG,
+                                         core_type_m, layers_group_id_m));
+
     configuration_m = configuration;
 
     // Env Vars: Overwrite default heap sizes and allocation optimization level
@@ -132,18 +374,43 @@ bool ExecutorImpl::Initialize(const Configuration& configuration)
     if (extmem_opt != nullptr && *extmem_opt == '2')
         extmem_alloc_opt_m = TIDL_optimiseExtMemL2;
 
+    if (configuration_m.autoSizeHeaps)
+    {
+        phase.reset();
+        StartupPhase auto_size(startup_m.autoSizeHeapsMs, API::AUTO_SIZE,
+                               core_type_m, layers_group_id_m);
+        AutoSizeHeaps();
+    }
+
+    // Heap statistics are reported by the setup and initialization kernels
+    std::unique_ptr<OutputCapture> capture;
+    if (configuration_m.showHeapStats)
+        capture.reset(new OutputCapture());
+
+    if (!phase)
+        phase.reset(new StartupPhase(startup_m.configMs, API::CONFIG,
+                                     core_type_m, layers_group_id_m));
+
     // Allocate, initialize TIDL_CreateParams object
     up_malloc_ddr<TIDL_CreateParams> shared_createparam(
                                             malloc_ddr<TIDL_CreateParams>(),
                                             &__free_ddr);
     InitializeNetworkCreateParam(shared_createparam.get(), configuration);
 
-    // Read network from file into network struct in TIDL_CreateParams
-    sTIDL_Network_t *net = &(shared_createparam.get())->net;
+    // Read network from file (or the binary cache) into network struct in
+    // TIDL_CreateParams. Copied since layersGroupIds are updated below.
+    phase.reset(new StartupPhase(startup_m.readNetworkMs, API::READ_NETWORK,
+                                 core_type_m, layers_group_id_m));
+    network_m = BinaryCache::GetNetwork(configuration_m.netBinFile);
+    if (network_m == nullptr)
+        throw Exception("Failed to read network binary " +
+                        configuration_m.netBinFile,
+                        __FILE__, __FUNCTION__, __LINE__);
 
-    bool status = ReadNetworkBinary(configuration_m.netBinFile,
-                                    reinterpret_cast<char *>(net));
-    assert(status != false);
+    phase.reset();
+
+    sTIDL_Network_t *net = &(shared_createparam.get())->net;
+    memcpy(net, network_m.get(), sizeof(sTIDL_Network_t));
 
     // Force to run full network if runFullNet is set
     if (configuration.runFullNet)
@@ -171,6 +438,8 @@ bool ExecutorImpl::Initialize(const Configuration& configuration)
     for (auto ids : device_ids_m)
     {
         uint8_t index = static_cast<uint8_t>(ids);
+        StartupPhase create(startup_m.createEosMs, API::CREATE_EO,
+                            core_type_m, layers_group_id_m, index);
         execution_objects_m.push_back(
              unique_ptr<ExecutionObject>
              {new ExecutionObject(device_m.get(), core_type_m, index,
@@ -179,30 +448,344 @@ bool ExecutorImpl::Initialize(const Configuration& configuration)
                                   layers_group_id_m)} );
     }
 
+    phase.reset(new StartupPhase(startup_m.initKernelMs, API::INIT_KERNEL,
+                                 core_type_m, layers_group_id_m));
     for (auto &eo : execution_objects_m)
         eo->RunAsync(ExecutionObject::CallType::INIT);
 
     for (auto &eo : execution_objects_m)
         eo->Wait(ExecutionObject::CallType::INIT);
+    phase.reset();
+
+    if (capture)
+        ParseHeapUsage(capture->Release(), heap_usage_m);
+
+    heap_usage_m.paramHeapSize   = configuration_m.PARAM_HEAP_SIZE;
+    heap_usage_m.networkHeapSize = configuration_m.NETWORK_HEAP_SIZE;
+
+    shared_createparam_m = std::move(shared_createparam);
+
+    startup_m.totalMs = (TimeStampNow() - startup_start_us_m) / 1000.0f;
 
     return true;
 }
 
+// Set up the new network on the device of this Executor while the current
+// network keeps processing frames, then swap it into each EO. The EOs, and
+// any ExecutionObjectPipelines built from them, remain valid. The previous
+// network is cleaned up once all EOs have switched.
+bool ExecutorImpl::Reload(const Configuration& configuration)
+{
+    if (configuration.numContexts != configuration_m.numContexts)
+        throw Exception("Reload cannot change the number of contexts",
+                        __FILE__, __FUNCTION__, __LINE__);
 
-bool ExecutorImpl::InitializeNetworkParams(TIDL_CreateParams *cp)
+    std::unique_ptr<ExecutorImpl> staged(
+                new ExecutorImpl(core_type_m, device_ids_m, layers_group_id_m));
+    staged->Initialize(configuration);
+
+    std::lock_guard<std::mutex> guard(reload_mutex_m);
+
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+        if (execution_objects_m[i]->GetInputBufferSizeInBytes() !=
+                staged->execution_objects_m[i]->GetInputBufferSizeInBytes() ||
+            execution_objects_m[i]->GetOutputBufferSizeInBytes() !=
+                staged->execution_objects_m[i]->GetOutputBufferSizeInBytes())
+            throw Exception("Reload requires the same input and output "
+                            "buffer sizes",
+                            __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+        execution_objects_m[i]->SwapNetwork(*staged->execution_objects_m[i]);
+
+    // The previous network parameters are released with staged, after its
+    // EOs (now holding the previous network) run the cleanup kernel
+    std::swap(configuration_m,            staged->configuration_m);
+    std::swap(shared_networkparam_heap_m, staged->shared_networkparam_heap_m);
+    std::swap(shared_createparam_m,       staged->shared_createparam_m);
+    std::swap(network_m,                  staged->network_m);
+    std::swap(params_m,                   staged->params_m);
+    std::swap(extmem_alloc_opt_m,         staged->extmem_alloc_opt_m);
+    std::swap(heap_usage_m,               staged->heap_usage_m);
+
+    return true;
+}
+
+// Initialize the network on the devices of this Executor and make it
+// selectable on each EO. The device library allocates the persistent data
+// and the scratch of a network from the same heaps, heaps cannot be shared
+// across networks. The heaps of the added network are sized to what its
+// layers request, so that networks resident together fit in device memory.
+uint32_t ExecutorImpl::AddNetwork(const Configuration& configuration)
 {
-    // Determine size of network parameters buffer, allocate it
-    size_t networkparam_size =
-                        GetBinaryFileSize(configuration_m.paramsBinFile);
+    if (configuration.numContexts != configuration_m.numContexts)
+        throw Exception("Resident networks must have the same number of "
+                        "contexts", __FILE__, __FUNCTION__, __LINE__);
+
+    Configuration c = configuration;
+    c.autoSizeHeaps = true;
+
+    std::unique_ptr<ExecutorImpl> net(
+                new ExecutorImpl(core_type_m, device_ids_m, layers_group_id_m));
+    net->Initialize(c);
 
-    up_malloc_ddr<char> networkparam(malloc_ddr<char>(networkparam_size),
-                                &__free_ddr);
+    std::lock_guard<std::mutex> guard(reload_mutex_m);
 
-    // Read network parameters from bin file into buffer
-    bool status = ReadBinary(configuration_m.paramsBinFile,
-                             networkparam.get(),
-                             networkparam_size);
-    assert(status != false);
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+        execution_objects_m[i]->AddNetwork(net->execution_objects_m[i].get());
+
+    networks_m.push_back(std::move(net));
+    return networks_m.size();
+}
+
+// Reset a single EO after a device error, the other EOs keep processing
+// frames. The parameter heap set up by Initialize is intact (the devices
+// only read it), only the network instance of the EO is re-created.
+void ExecutorImpl::ResetExecutionObject(uint32_t index)
+{
+    if (index >= execution_objects_m.size())
+        throw Exception("No ExecutionObject at index " + std::to_string(index),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    std::lock_guard<std::mutex> guard(reload_mutex_m);
+    execution_objects_m[index]->Reset();
+}
+
+// Process frames from source on all EOs, one frame per EO at a time. The
+// frames are copied to the device from the source directly, the output is
+// not copied back.
+bool ExecutorImpl::WarmUp(const FrameSource& source, uint32_t num_frames)
+{
+    if (execution_objects_m.empty() ||
+        source.GetFrameSize() !=
+                execution_objects_m[0]->GetInputBufferSizeInBytes())
+        throw Exception("Warm up frame size does not match the network input",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    const IODeviceArgInfo out(ArgInfo(nullptr, 0));
+    std::vector<uint32_t> contexts(execution_objects_m.size());
+    bool status = true;
+
+    for (uint32_t f = 0; f < num_frames; f++)
+    {
+        const IODeviceArgInfo in(ArgInfo(const_cast<char *>(
+                                         source.GetFrame(f)),
+                                         source.GetFrameSize()));
+
+        for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+            status &= execution_objects_m[i]->AcquireAndRunContext(
+                                                    contexts[i], f, in, out);
+
+        for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+            status &= execution_objects_m[i]->WaitAndReleaseContext(
+                                                    contexts[i]);
+    }
+
+    TRACE::print("\tWarm up: %u frames on %zu EOs\n", num_frames,
+                 execution_objects_m.size());
+    return status;
+}
+
+namespace {
+// Header of a quantization state file, followed by a QuantStateEntry and
+// the network heap of each EO
+struct QuantStateHeader
+{
+    char     magic[8];
+    uint64_t key;
+    uint64_t num_eos;
+    uint64_t heap_size;
+};
+
+struct QuantStateEntry
+{
+    uint64_t device_name_hash;
+    uint64_t heap_address;
+};
+
+const char QUANT_STATE_MAGIC[8] = { 'T','I','D','L','Q','S','T','1' };
+}
+
+// The saved heaps are valid for the same network (including layer group
+// assignment), parameter file, heap layout options and API version
+uint64_t ExecutorImpl::GetQuantizationStateKey() const
+{
+    const Configuration& c = configuration_m;
+    int32_t values[] = { layers_group_id_m, c.runFullNet, c.numContexts,
+                         c.quantHistoryParam1, c.quantHistoryParam2,
+                         c.quantMargin, c.enableOutputTrace,
+                         static_cast<int32_t>(extmem_alloc_opt_m),
+                         static_cast<int32_t>(c.NETWORK_HEAP_SIZE) };
+
+    uint64_t h = HashBytes(API_VERSION, sizeof(API_VERSION));
+    h = HashBytes(network_m.get(), sizeof(sTIDL_Network_t), h);
+    h = HashBytes(c.paramsBinFile.data(), c.paramsBinFile.size(), h);
+    h = HashBytes(values, sizeof(values), h);
+    for (const auto &item : c.layerIndex2LayerGroupId)
+        h = HashBytes(&item, sizeof(item), h);
+    return h;
+}
+
+bool ExecutorImpl::SaveQuantizationState(const std::string& file) const
+{
+    QuantStateHeader header;
+    memcpy(header.magic, QUANT_STATE_MAGIC, sizeof(header.magic));
+    header.key       = GetQuantizationStateKey();
+    header.num_eos   = execution_objects_m.size();
+    header.heap_size = configuration_m.NETWORK_HEAP_SIZE;
+
+    // Write to a temporary file and rename to avoid leaving a partial
+    // state file behind
+    std::string tmp_file = file + ".tmp";
+    std::ofstream ofs(tmp_file, std::ios::binary);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::unique_ptr<char[]> heap(new char[header.heap_size]);
+    for (const auto &eo : execution_objects_m)
+    {
+        std::string name = eo->GetDeviceName();
+        QuantStateEntry entry;
+        entry.device_name_hash = HashBytes(name.data(), name.size());
+        entry.heap_address     = eo->GetNetworkHeapAddress();
+
+        eo->ReadNetworkHeap(heap.get());
+        ofs.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        ofs.write(heap.get(), header.heap_size);
+    }
+    ofs.close();
+
+    if (!ofs.good() || std::rename(tmp_file.c_str(), file.c_str()) != 0)
+    {
+        std::remove(tmp_file.c_str());
+        std::cerr << "TIDL API Warning: Failed to write quantization state "
+                  << file << std::endl;
+        return false;
+    }
+
+    // LoadQuantizationState only accepts the state if the key computed
+    // then matches, check that the saved header reads back with it
+    QuantStateHeader saved;
+    std::ifstream ifs(file, std::ios::binary);
+    ifs.read(reinterpret_cast<char *>(&saved), sizeof(saved));
+    if (!ifs.good() || saved.key != GetQuantizationStateKey() ||
+        saved.num_eos != header.num_eos ||
+        saved.heap_size != header.heap_size)
+    {
+        std::cerr << "TIDL API Warning: Quantization state " << file
+                  << " does not read back" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ExecutorImpl::LoadQuantizationState(const std::string& file)
+{
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.good())
+        return false;
+
+    QuantStateHeader header;
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!ifs.good() ||
+        memcmp(header.magic, QUANT_STATE_MAGIC, sizeof(header.magic)) ||
+        header.key != GetQuantizationStateKey() ||
+        header.num_eos != execution_objects_m.size() ||
+        header.heap_size != configuration_m.NETWORK_HEAP_SIZE)
+        return false;
+
+    // Read and check the heaps of all EOs before restoring any of them
+    std::vector<std::unique_ptr<char[]>> heaps;
+    for (const auto &eo : execution_objects_m)
+    {
+        std::string name = eo->GetDeviceName();
+        QuantStateEntry entry;
+        ifs.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+        if (!ifs.good() ||
+            entry.device_name_hash != HashBytes(name.data(), name.size()))
+            return false;
+
+        if (entry.heap_address != eo->GetNetworkHeapAddress())
+        {
+            TRACE::print("\tQuantization state: heap address mismatch\n");
+            return false;
+        }
+
+        heaps.emplace_back(new char[header.heap_size]);
+        ifs.read(heaps.back().get(), header.heap_size);
+        if (!ifs.good())
+            return false;
+    }
+
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+        execution_objects_m[i]->WriteNetworkHeap(heaps[i].get());
+
+    TRACE::print("\tQuantization state: restored from %s\n", file.c_str());
+    return true;
+}
+
+// Initialize the network on the first device of the Executor with the
+// configured heap sizes and heap statistics enabled. Use the measured
+// requirements to size the heaps of this Executor.
+void ExecutorImpl::AutoSizeHeaps()
+{
+    Configuration probe = configuration_m;
+    probe.autoSizeHeaps = false;
+    probe.showHeapStats = true;
+    // The snapshot depends on the heap size and would skip the setup kernel
+    probe.paramHeapCacheFile.clear();
+
+    HeapUsage usage;
+    {
+        DeviceIds ids = { *device_ids_m.cbegin() };
+        ExecutorImpl pre(core_type_m, ids, layers_group_id_m);
+        pre.Initialize(probe);
+        usage = pre.GetHeapUsage();
+    }
+
+    if (usage.paramHeapRequested == 0 || usage.networkHeapRequested == 0)
+    {
+        std::cerr << "TIDL API Warning: Heap statistics not available, "
+                     "using configured heap sizes" << std::endl;
+        return;
+    }
+
+    TRACE::print("\tAuto heap sizes: PARAM %zu, NETWORK %zu\n",
+                 usage.paramHeapRequested, usage.networkHeapRequested);
+
+    configuration_m.PARAM_HEAP_SIZE   = usage.paramHeapRequested;
+    configuration_m.NETWORK_HEAP_SIZE = usage.networkHeapRequested;
+    heap_usage_m.paramHeapRequested   = usage.paramHeapRequested;
+    heap_usage_m.networkHeapRequested = usage.networkHeapRequested;
+}
+
+
+bool ExecutorImpl::InitializeNetworkParams(TIDL_CreateParams *cp)
+{
+    // Read network parameters from bin file (or the binary cache) into a
+    // DDR buffer. The setup kernel only reads from this buffer, it is
+    // shared across Executors using the same parameter file.
+    bool group_params = false;
+    {
+        StartupPhase phase(startup_m.readParamsMs, API::READ_PARAMS,
+                           core_type_m, layers_group_id_m);
+        if (configuration_m.loadGroupParamsOnly)
+        {
+            params_m     = ReadLayersGroupParams(&cp->net);
+            group_params = (params_m != nullptr);
+        }
+        if (params_m == nullptr)
+            params_m = BinaryCache::GetParams(configuration_m.paramsBinFile);
+        if (params_m == nullptr)
+            throw Exception("Failed to read parameter binary " +
+                            configuration_m.paramsBinFile,
+                            __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    // The remainder is the setup phase, including the early return when
+    // the heap is loaded from a snapshot
+    StartupPhase phase(startup_m.setupKernelMs, API::SETUP_KERNEL,
+                       core_type_m, layers_group_id_m);
 
     // Allocate a buffer for passing parameters to the kernel
     up_malloc_ddr<OCL_TIDL_SetupParams> setupParams(
@@ -221,9 +804,21 @@ bool ExecutorImpl::InitializeNetworkParams(TIDL_CreateParams *cp)
     // kernel to allocate and initialize network parameters for the layers
     shared_networkparam_heap_m.reset(malloc_ddr<char>(setupParams->networkParamHeapSize));
 
+    // If a snapshot of the populated heap is available, skip setup
+    uint64_t snapshot_key = 0;
+    if (!configuration_m.paramHeapCacheFile.empty())
+    {
+        snapshot_key = GetParamHeapSnapshotKey(cp);
+        if (LoadParamHeapSnapshot(cp, snapshot_key))
+        {
+            if (group_params)  params_m.reset();
+            return true;
+        }
+    }
+
     KernelArgs args = { DeviceArgInfo(cp, sizeof(TIDL_CreateParams),
                                       DeviceArgInfo::Kind::BUFFER),
-                        DeviceArgInfo(networkparam.get(), networkparam_size,
+                        DeviceArgInfo(params_m->data(), params_m->size(),
                                       DeviceArgInfo::Kind::BUFFER),
                         DeviceArgInfo(shared_networkparam_heap_m.get(),
                                       setupParams->networkParamHeapSize,
@@ -243,17 +838,208 @@ bool ExecutorImpl::InitializeNetworkParams(TIDL_CreateParams *cp)
         throw Exception(setupParams->errorCode,
                         __FILE__, __FUNCTION__, __LINE__);
 
-    return status;
+    if (!configuration_m.paramHeapCacheFile.empty())
+        SaveParamHeapSnapshot(cp, snapshot_key);
+
+    // Setup has copied the parameters into the heap. A buffer read for
+    // this layer group is not shared, release it.
+    if (group_params)
+        params_m.reset();
+
+    return true;
+}
+
+// Read the parameter binary, skipping the parameters of layers in other
+// layer groups. Offsets of the parameters are kept, the skipped ranges are
+// zeroed. Returns nullptr if the parameter sizes computed from the network
+// do not match the file.
+BinaryCache::ParamsPtr
+ExecutorImpl::ReadLayersGroupParams(const sTIDL_Network_t *net) const
+{
+    const std::string& file = configuration_m.paramsBinFile;
+
+    // Parameters in a compact container are stored as a whole
+    if (IsCompactNetworkBinary(file))
+        return nullptr;
+
+    // Contiguous ranges of the file used by this layer group
+    struct Span { std::size_t offset; std::size_t size; };
+    std::vector<Span> spans;
+    std::size_t file_offset = 0;
+    std::size_t group_size  = 0;
+
+    for (int i = 0; i < net->numLayers; i++)
+    {
+        const sTIDL_Layer_t& layer = net->TIDLLayers[i];
+        std::size_t size = GetParamSize(*net, layer);
+        if (size > 0 && layer.layersGroupId == layers_group_id_m)
+        {
+            if (!spans.empty() &&
+                spans.back().offset + spans.back().size == file_offset)
+                spans.back().size += size;
+            else
+                spans.push_back({file_offset, size});
+            group_size += size;
+        }
+        file_offset += size;
+    }
+
+    std::size_t file_size = GetBinaryFileSize(file);
+    if (file_offset != file_size || file_size == 0)
+    {
+        TRACE::print("\tGroup params: layers %zu bytes, file %zu bytes, "
+                     "reading entire file\n", file_offset, file_size);
+        return nullptr;
+    }
+
+    std::shared_ptr<ParamBinary> params(new ParamBinary(file_size));
+    memset(params->data(), 0, file_size);
+
+    std::ifstream ifs(file, std::ios::binary);
+    for (const Span& s : spans)
+    {
+        ifs.seekg(s.offset);
+        ifs.read(params->data() + s.offset, s.size);
+    }
+    if (!ifs.good())
+        return nullptr;
+
+    TRACE::print("\tGroup params: read %zu of %zu bytes for layer group %d\n",
+                 group_size, file_size, layers_group_id_m);
+    return params;
+}
+
+namespace {
+// Header of a parameter heap snapshot file, followed by the post-setup
+// TIDL_CreateParams and the contents of the parameter heap
+struct ParamHeapSnapshotHeader
+{
+    char     magic[8];
+    uint64_t key;
+    uint64_t heap_address;
+    uint64_t heap_size;
+    uint64_t create_params_size;
+};
+
+const char PARAM_HEAP_SNAPSHOT_MAGIC[8] = { 'T','I','D','L','P','H','S','1' };
 }
 
+// The snapshot is valid for the same network (including layer group
+// assignment), parameters, setup options and API version. The key only
+// depends on these, not on earlier calls in the process: snapshots
+// written by one run are found by the next.
+uint64_t
+ExecutorImpl::GetParamHeapSnapshotKey(const TIDL_CreateParams *cp) const
+{
+    uint32_t noZero = configuration_m.noZeroCoeffsPercentage;
+
+    uint64_t h = HashBytes(API_VERSION, sizeof(API_VERSION));
+    h = HashBytes(cp, sizeof(TIDL_CreateParams), h);
+    h = HashBytes(params_m->data(), params_m->size(), h);
+    h = HashBytes(&configuration_m.PARAM_HEAP_SIZE,
+                  sizeof(configuration_m.PARAM_HEAP_SIZE), h);
+    h = HashBytes(&noZero, sizeof(noZero), h);
+    return h;
+}
+
+bool ExecutorImpl::LoadParamHeapSnapshot(TIDL_CreateParams *cp, uint64_t key)
+{
+    std::ifstream ifs(configuration_m.paramHeapCacheFile, std::ios::binary);
+    if (!ifs.good())
+        return false;
+
+    ParamHeapSnapshotHeader header;
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!ifs.good() ||
+        memcmp(header.magic, PARAM_HEAP_SNAPSHOT_MAGIC, sizeof(header.magic))||
+        header.key != key ||
+        header.heap_size != configuration_m.PARAM_HEAP_SIZE ||
+        header.create_params_size != sizeof(TIDL_CreateParams))
+        return false;
+
+    // The device library may store absolute addresses in the heap
+    if (header.heap_address !=
+            reinterpret_cast<uintptr_t>(shared_networkparam_heap_m.get()))
+    {
+        TRACE::print("\tParam heap snapshot: heap address mismatch\n");
+        return false;
+    }
 
+    // TIDL_CreateParams is large, avoid placing it on the stack
+    std::unique_ptr<TIDL_CreateParams> tmp(new TIDL_CreateParams);
+    ifs.read(reinterpret_cast<char *>(tmp.get()), sizeof(TIDL_CreateParams));
+    ifs.read(shared_networkparam_heap_m.get(), header.heap_size);
+    if (!ifs.good())
+        return false;
+
+    memcpy(cp, tmp.get(), sizeof(TIDL_CreateParams));
+    TRACE::print("\tParam heap snapshot: restored from %s\n",
+                 configuration_m.paramHeapCacheFile.c_str());
+    return true;
+}
+
+void ExecutorImpl::SaveParamHeapSnapshot(const TIDL_CreateParams *cp,
+                                         uint64_t key)
+{
+    ParamHeapSnapshotHeader header;
+    memcpy(header.magic, PARAM_HEAP_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.key                = key;
+    header.heap_address       =
+                reinterpret_cast<uintptr_t>(shared_networkparam_heap_m.get());
+    header.heap_size          = configuration_m.PARAM_HEAP_SIZE;
+    header.create_params_size = sizeof(TIDL_CreateParams);
+
+    // Write to a temporary file and rename to avoid leaving a partial
+    // snapshot behind
+    std::string tmp_file = configuration_m.paramHeapCacheFile + ".tmp";
+    std::ofstream ofs(tmp_file, std::ios::binary);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(cp), sizeof(TIDL_CreateParams));
+    ofs.write(shared_networkparam_heap_m.get(), header.heap_size);
+    ofs.close();
+
+    if (!ofs.good() ||
+        std::rename(tmp_file.c_str(),
+                    configuration_m.paramHeapCacheFile.c_str()) != 0)
+    {
+        std::remove(tmp_file.c_str());
+        std::cerr << "TIDL API Warning: Failed to write parameter heap "
+                     "snapshot " << configuration_m.paramHeapCacheFile
+                  << std::endl;
+    }
+}
+
+
+// Called from the destructor, errors are traced and do not keep the other
+// EOs from cleaning up
 void ExecutorImpl::Cleanup()
 {
-    for (auto &eo : execution_objects_m)
-        eo->RunAsync(ExecutionObject::CallType::CLEANUP);
+    std::vector<bool> started(execution_objects_m.size(), false);
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+    {
+        try
+        {
+            started[i] = execution_objects_m[i]->RunAsync(
+                                        ExecutionObject::CallType::CLEANUP);
+        }
+        catch (const Exception& e)
+        {
+            TRACE::print("Cleanup failed: %s\n", e.what());
+        }
+    }
 
-    for (auto &eo : execution_objects_m)
-        eo->Wait(ExecutionObject::CallType::CLEANUP);
+    for (uint32_t i = 0; i < execution_objects_m.size(); i++)
+    {
+        if (!started[i])  continue;
+        try
+        {
+            execution_objects_m[i]->Wait(ExecutionObject::CallType::CLEANUP);
+        }
+        catch (const Exception& e)
+        {
+            TRACE::print("Cleanup failed: %s\n", e.what());
+        }
+    }
 }
 
 
@@ -270,10 +1056,12 @@ void ExecutorImpl::InitializeNetworkCreateParam(TIDL_CreateParams *CP,
     CP->quantHistoryParam2   = c.quantHistoryParam2;
     CP->quantMargin          = c.quantMargin;
 
-    // If trace is enabled, setup the device TIDL library to allocate separate
-    // output buffers for each layer. This makes it possible for the host
-    // to access the output of each layer after a frame is processed.
-    if (configuration_m.enableOutputTrace)
+    // If trace is enabled for all layers, setup the device TIDL library to
+    // allocate separate output buffers for each layer. This makes it possible
+    // for the host to access the output of each layer after a frame is
+    // processed. If only selected layers are traced, retain the optimization.
+    if (configuration_m.enableOutputTrace &&
+        configuration_m.outputTraceLayers.empty())
         CP->optimiseExtMem       = TIDL_optimiseExtMemL0;
     else
         CP->optimiseExtMem       = extmem_alloc_opt_m;
@@ -34,9 +34,12 @@
 #include <vector>
 #include <memory>
 #include <fstream>
+#include <mutex>
 
 #include "configuration.h"
+#include "executor.h"
 #include "ocl_device.h"
+#include "binary_cache.h"
 
 #include "common_defines.h"
 #include "tidl_create_params.h" // for TIDL types
@@ -56,6 +59,15 @@ class ExecutorImpl
         ~ExecutorImpl() { Cleanup(); }
 
         bool Initialize(const Configuration& configuration);
+        bool Reload(const Configuration& configuration);
+        bool WarmUp(const FrameSource& source, uint32_t num_frames);
+        bool SaveQuantizationState(const std::string& file) const;
+        bool LoadQuantizationState(const std::string& file);
+        uint32_t AddNetwork(const Configuration& configuration);
+        void ResetExecutionObject(uint32_t index);
+
+        const HeapUsage& GetHeapUsage() const { return heap_usage_m; }
+        const StartupTiming& GetStartupTiming() const { return startup_m; }
 
         ExecutorImpl(const ExecutorImpl&)            = delete;
         ExecutorImpl& operator=(const ExecutorImpl&) = delete;
@@ -66,15 +78,33 @@ class ExecutorImpl
         void InitializeNetworkCreateParam(TIDL_CreateParams *cp,
                                           const Configuration& c);
         bool InitializeNetworkParams(TIDL_CreateParams *cp);
+        BinaryCache::ParamsPtr ReadLayersGroupParams(
+                                            const sTIDL_Network_t *net) const;
+        uint64_t GetParamHeapSnapshotKey(const TIDL_CreateParams *cp) const;
+        bool LoadParamHeapSnapshot(TIDL_CreateParams *cp, uint64_t key);
+        void SaveParamHeapSnapshot(const TIDL_CreateParams *cp, uint64_t key);
+        void AutoSizeHeaps();
+        uint64_t GetQuantizationStateKey() const;
         void Cleanup();
 
-        Device::Ptr          device_m; // vector of devices?
-        Configuration        configuration_m;
-        up_malloc_ddr<char>  shared_networkparam_heap_m;
-        DeviceIds            device_ids_m;
-        DeviceType           core_type_m;
-        int                  layers_group_id_m;
-        eTIDL_optimiseExtMem extmem_alloc_opt_m;
+        Device::Ptr             device_m; // vector of devices?
+        Configuration           configuration_m;
+        up_malloc_ddr<char>     shared_networkparam_heap_m;
+        // Kept after initialization, read by the initialize kernel again
+        // when an EO is reset
+        up_malloc_ddr<TIDL_CreateParams> shared_createparam_m;
+        BinaryCache::NetworkPtr network_m;
+        BinaryCache::ParamsPtr  params_m;
+        DeviceIds               device_ids_m;
+        DeviceType              core_type_m;
+        int                     layers_group_id_m;
+        eTIDL_optimiseExtMem    extmem_alloc_opt_m;
+        HeapUsage               heap_usage_m;
+        StartupTiming           startup_m;
+        uint64_t                startup_start_us_m;
+        std::mutex              reload_mutex_m;
+        // Networks added via AddNetwork, resident on the same EOs
+        std::vector<std::unique_ptr<ExecutorImpl>> networks_m;
 };
 
 } // namespace tidl
@@ -0,0 +1,102 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file frame_batch.cpp */
+
+#include "frame_batch.h"
+
+using namespace tidl;
+
+FrameBatch::Impl::Impl(const FrameDescriptors& frames, Runner runner):
+    frames_m(frames), num_completed_m(0), is_done_m(false), status_m(false),
+    error_m(nullptr)
+{
+    // Start the thread last, the runner accesses the members above
+    thread_m = std::thread([this, runner]()
+               {
+                   try
+                   {
+                       status_m = runner(*this);
+                   }
+                   catch (...)
+                   {
+                       error_m  = std::current_exception();
+                       status_m = false;
+                   }
+                   is_done_m = true;
+               });
+}
+
+FrameBatch::Impl::~Impl()
+{
+    if (thread_m.joinable())
+        thread_m.join();
+}
+
+bool FrameBatch::Impl::Wait()
+{
+    if (thread_m.joinable())
+        thread_m.join();
+
+    // Report errors from the batch thread on the waiting thread
+    if (error_m)
+    {
+        std::exception_ptr e = error_m;
+        error_m = nullptr;
+        std::rethrow_exception(e);
+    }
+
+    return status_m;
+}
+
+FrameBatch::FrameBatch(Impl* impl): pimpl_m(impl)
+{}
+
+// Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
+// unique_ptr's destructor requires a complete type in order to invoke delete
+FrameBatch::~FrameBatch() = default;
+
+bool FrameBatch::Wait()
+{
+    return pimpl_m->Wait();
+}
+
+bool FrameBatch::IsComplete() const
+{
+    return pimpl_m->is_done_m;
+}
+
+uint32_t FrameBatch::GetNumFrames() const
+{
+    return pimpl_m->frames_m.size();
+}
+
+uint32_t FrameBatch::GetNumFramesCompleted() const
+{
+    return pimpl_m->GetNumFramesCompleted();
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file frame_batch.h
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include "executor.h"
+#include "execution_object.h"
+
+namespace tidl {
+
+/*! @class FrameBatch::Impl
+ *  @brief Runs a batch of frames on a separate thread. The runner is
+ *         provided by the ExecutionObject or ExecutionObjectPipeline that
+ *         the batch was submitted to and reports completed frames via
+ *         FrameCompleted().
+ */
+class FrameBatch::Impl
+{
+    public:
+        typedef std::function<bool(FrameBatch::Impl&)> Runner;
+
+        Impl(const FrameDescriptors& frames, Runner runner);
+        ~Impl();
+
+        bool Wait();
+
+        const FrameDescriptors& GetFrames() const { return frames_m; }
+        void     FrameCompleted() { num_completed_m++; }
+        uint32_t GetNumFramesCompleted() const { return num_completed_m; }
+
+        Impl(const Impl&)            = delete;
+        Impl& operator=(const Impl&) = delete;
+
+    private:
+        const FrameDescriptors frames_m;
+        std::atomic<uint32_t>  num_completed_m;
+        std::atomic<bool>      is_done_m;
+        bool                   status_m;
+        std::exception_ptr     error_m;
+        std::thread            thread_m;
+
+        friend class FrameBatch;
+};
+
+} // namespace tidl
@@ -0,0 +1,230 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file frame_change_gate.cpp */
+
+#include <cstring>
+#include <vector>
+#include <mutex>
+
+#include "frame_change_gate.h"
+#include "executor.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TIDL_GATE_NEON
+#endif
+
+using namespace tidl;
+
+class FrameChangeGate::Impl
+{
+    public:
+        Impl(uint32_t width, uint32_t height, float threshold,
+             uint32_t refresh_interval, uint32_t step);
+
+        bool  ShouldProcess(const uint8_t* plane, size_t pitch);
+        float Score(const uint8_t* plane, size_t pitch) const;
+
+        const uint32_t width_m;
+        const uint32_t height_m;
+        const float    threshold_m;
+        const uint32_t refresh_interval_m;
+        const uint32_t step_m;
+
+        // Sampled pixels of the last processed frame, one row of
+        // width_m / step_m pixels per compared row
+        std::vector<uint8_t> reference_m;
+        std::vector<uint8_t> sampled_m;
+        bool                 has_reference_m;
+        uint32_t             since_refresh_m;
+        float                last_score_m;
+
+        mutable std::mutex   output_mutex_m;
+        std::vector<char>    output_m;
+        bool                 has_output_m;
+
+        uint64_t             num_processed_m;
+        uint64_t             num_skipped_m;
+};
+
+FrameChangeGate::Impl::Impl(uint32_t width, uint32_t height,
+                            float threshold, uint32_t refresh_interval,
+                            uint32_t step):
+    width_m(width), height_m(height), threshold_m(threshold),
+    refresh_interval_m(refresh_interval), step_m(step),
+    has_reference_m(false), since_refresh_m(0), last_score_m(0),
+    has_output_m(false), num_processed_m(0), num_skipped_m(0)
+{
+    if (width == 0 || height == 0 || step == 0)
+        throw Exception("Invalid FrameChangeGate plane",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    reference_m.resize((size_t) ((height_m + step_m - 1) / step_m) *
+                       ((width_m + step_m - 1) / step_m));
+    sampled_m.resize((width_m + step_m - 1) / step_m);
+}
+
+//
+// Gather every step-th pixel of a row. Steps of 2 and 4 use de-interleaving
+// NEON loads.
+//
+static void SampleRow(const uint8_t* row, uint32_t width, uint32_t step,
+                      uint8_t* out)
+{
+    uint32_t i = 0, x = 0;
+#ifdef TIDL_GATE_NEON
+    if (step == 4)
+        for (; x + 64 <= width; x += 64, i += 16)
+            vst1q_u8(out + i, vld4q_u8(row + x).val[0]);
+    else if (step == 2)
+        for (; x + 32 <= width; x += 32, i += 16)
+            vst1q_u8(out + i, vld2q_u8(row + x).val[0]);
+#endif
+    for (; x < width; x += step, i++)
+        out[i] = row[x];
+}
+
+// Sum of absolute differences of n bytes
+static uint64_t Sad(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    uint64_t sum = 0;
+    size_t   i   = 0;
+#ifdef TIDL_GATE_NEON
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t d = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        acc = vpadalq_u16(acc, vpaddlq_u8(d));
+    }
+    uint64x2_t s = vpaddlq_u32(acc);
+    sum = vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1);
+#endif
+    for (; i < n; i++)
+        sum += (a[i] > b[i]) ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+bool FrameChangeGate::Impl::ShouldProcess(const uint8_t* plane, size_t pitch)
+{
+    if (pitch == 0)  pitch = width_m;
+
+    const size_t row_samples = sampled_m.size();
+    uint64_t sad = 0;
+    size_t   r   = 0;
+
+    // Score against the reference while sampling the frame, the reference
+    // is only replaced if the frame is processed
+    for (uint32_t y = 0; y < height_m; y += step_m, r++)
+    {
+        SampleRow(plane + y * pitch, width_m, step_m, sampled_m.data());
+        sad += Sad(sampled_m.data(), &reference_m[r * row_samples],
+                   row_samples);
+    }
+    last_score_m = (float) sad / reference_m.size();
+
+    bool has_output;
+    {
+        std::lock_guard<std::mutex> lock(output_mutex_m);
+        has_output = has_output_m;
+    }
+
+    bool refresh = refresh_interval_m > 0 &&
+                   since_refresh_m + 1 >= refresh_interval_m;
+    if (has_reference_m && has_output && !refresh &&
+        last_score_m < threshold_m)
+    {
+        since_refresh_m++;
+        num_skipped_m++;
+        return false;
+    }
+
+    r = 0;
+    for (uint32_t y = 0; y < height_m; y += step_m, r++)
+        SampleRow(plane + y * pitch, width_m, step_m,
+                  &reference_m[r * row_samples]);
+    has_reference_m = true;
+    since_refresh_m = 0;
+    num_processed_m++;
+    return true;
+}
+
+
+FrameChangeGate::FrameChangeGate(uint32_t width, uint32_t height,
+                                 float threshold, uint32_t refresh_interval,
+                                 uint32_t step):
+    pimpl_m(new Impl(width, height, threshold, refresh_interval, step))
+{
+}
+
+FrameChangeGate::~FrameChangeGate()
+{
+}
+
+bool FrameChangeGate::ShouldProcess(const void* plane, size_t pitch)
+{
+    return pimpl_m->ShouldProcess((const uint8_t *) plane, pitch);
+}
+
+void FrameChangeGate::UpdateOutput(const void* output, size_t size)
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->output_mutex_m);
+    pimpl_m->output_m.assign((const char *) output,
+                             (const char *) output + size);
+    pimpl_m->has_output_m = true;
+}
+
+bool FrameChangeGate::GetCachedOutput(void* output, size_t size) const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->output_mutex_m);
+    if (!pimpl_m->has_output_m || size != pimpl_m->output_m.size())
+        return false;
+
+    memcpy(output, pimpl_m->output_m.data(), size);
+    return true;
+}
+
+void FrameChangeGate::Reset()
+{
+    pimpl_m->has_reference_m = false;
+}
+
+float FrameChangeGate::GetLastScore() const
+{
+    return pimpl_m->last_score_m;
+}
+
+uint64_t FrameChangeGate::GetNumFramesProcessed() const
+{
+    return pimpl_m->num_processed_m;
+}
+
+uint64_t FrameChangeGate::GetNumFramesSkipped() const
+{
+    return pimpl_m->num_skipped_m;
+}
@@ -0,0 +1,164 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file frame_source.cpp */
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "frame_source.h"
+#include "executor.h"
+
+using namespace tidl;
+
+class FrameSource::Impl
+{
+    public:
+        Impl(const std::string& file, size_t frame_size,
+             uint32_t prefetch_frames);
+        ~Impl();
+
+        void Prefetch(uint32_t frame_idx) const;
+
+        const char* data_m;
+        size_t      map_size_m;
+        size_t      frame_size_m;
+        uint32_t    num_frames_m;
+        uint32_t    prefetch_frames_m;
+        size_t      page_size_m;
+};
+
+FrameSource::FrameSource(const std::string& file, size_t frame_size,
+                         uint32_t prefetch_frames)
+    : pimpl_m(new Impl(file, frame_size, prefetch_frames))
+{
+}
+
+FrameSource::~FrameSource() = default;
+
+uint32_t FrameSource::GetNumFrames() const
+{
+    return pimpl_m->num_frames_m;
+}
+
+size_t FrameSource::GetFrameSize() const
+{
+    return pimpl_m->frame_size_m;
+}
+
+const char* FrameSource::GetFrame(uint32_t frame_idx) const
+{
+    uint32_t idx = frame_idx % pimpl_m->num_frames_m;
+    pimpl_m->Prefetch(idx);
+    return pimpl_m->data_m + idx * pimpl_m->frame_size_m;
+}
+
+bool FrameSource::CopyFrame(uint32_t frame_idx, char* buffer,
+                            size_t size) const
+{
+    if (buffer == nullptr || size < pimpl_m->frame_size_m)
+        return false;
+
+    std::memcpy(buffer, GetFrame(frame_idx), pimpl_m->frame_size_m);
+    return true;
+}
+
+FrameSource::Impl::Impl(const std::string& file, size_t frame_size,
+                        uint32_t prefetch_frames)
+    : data_m(nullptr), map_size_m(0), frame_size_m(frame_size),
+      num_frames_m(0), prefetch_frames_m(prefetch_frames),
+      page_size_m(sysconf(_SC_PAGESIZE))
+{
+    if (frame_size == 0)
+        throw Exception("Frame size must be non-zero",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw Exception("Unable to open " + file + ": " + strerror(errno),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < frame_size)
+    {
+        close(fd);
+        throw Exception(file + " is smaller than one frame",
+                        __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    num_frames_m = st.st_size / frame_size;
+    map_size_m   = num_frames_m * frame_size;
+
+    void* addr = mmap(nullptr, map_size_m, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file referenced
+    if (addr == MAP_FAILED)
+        throw Exception("Unable to map " + file + ": " + strerror(errno),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    data_m = static_cast<const char*>(addr);
+
+    // Frames are usually consumed in order, let the kernel read ahead
+    madvise(addr, map_size_m, MADV_SEQUENTIAL);
+    Prefetch(0);
+}
+
+FrameSource::Impl::~Impl()
+{
+    if (data_m != nullptr)
+        munmap(const_cast<char*>(data_m), map_size_m);
+}
+
+// Ask the kernel to page in the frames following frame_idx. Wraps around
+// at the end of the file so looping reads stay prefetched. Advisory only,
+// failures are ignored.
+void FrameSource::Impl::Prefetch(uint32_t frame_idx) const
+{
+    uint32_t count = std::min(prefetch_frames_m, num_frames_m - 1);
+    if (count == 0)
+        return;
+
+    size_t start = ((frame_idx + 1) % num_frames_m) * frame_size_m;
+    size_t end   = start + count * frame_size_m;
+    size_t spans[2][2] = { { start, std::min(end, map_size_m) },
+                           { 0, end > map_size_m ? end - map_size_m : 0 } };
+
+    for (auto& span : spans)
+    {
+        if (span[1] <= span[0])
+            continue;
+
+        size_t offset = span[0] & ~(page_size_m - 1);
+        madvise(const_cast<char*>(data_m) + offset, span[1] - offset,
+                MADV_WILLNEED);
+    }
+}
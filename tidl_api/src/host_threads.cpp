@@ -0,0 +1,248 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file host_threads.cpp */
+
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <iostream>
+
+#include "host_threads.h"
+#include "trace.h"
+#include "ring_queue.h"
+
+using namespace tidl;
+
+namespace {
+
+// Worker threads running the work posted via HostThreads::Run, in order.
+// The constructor returns once every worker has applied its placement.
+class WorkerPool
+{
+    public:
+        WorkerPool(uint32_t num_workers, const std::set<int>& cpus,
+                   int priority);
+        ~WorkerPool() { Stop(); }
+
+        // Returns false if the pool is stopping, the caller runs the work
+        bool     Post(std::function<void()> work);
+        // Run the pending work and join the workers. Not called from a
+        // worker.
+        void     Stop();
+        uint32_t GetNumWorkers() const { return workers_m.size(); }
+        bool     IsPlaced() const      { return num_placed_m == num_ready_m; }
+
+    private:
+        void WorkerLoop(const std::set<int>& cpus, int priority);
+
+        std::vector<std::thread>          workers_m;
+        RingQueue<std::function<void()>>  work_m;
+        std::mutex                        mutex_m;
+        std::condition_variable           cv_m;
+        std::condition_variable           cv_ready_m;
+        bool                              stop_m;
+        uint32_t                          num_ready_m;
+        uint32_t                          num_placed_m;
+};
+
+// The pool is replaced under the mutex. Callers posting work hold a
+// reference, the pool is stopped by StartWorkers/StopWorkers.
+std::mutex                  pool_mutex;
+std::shared_ptr<WorkerPool> pool;
+
+} // namespace
+
+WorkerPool::WorkerPool(uint32_t num_workers, const std::set<int>& cpus,
+                       int priority):
+    stop_m(false), num_ready_m(0), num_placed_m(0)
+{
+    for (uint32_t i = 0; i < num_workers; i++)
+        workers_m.emplace_back(&WorkerPool::WorkerLoop, this, cpus, priority);
+
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_ready_m.wait(lock, [this, num_workers]
+                          { return num_ready_m == num_workers; });
+}
+
+// Pending work runs before the workers exit. Work posted meanwhile runs on
+// the posting thread.
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_m.notify_all();
+
+    for (auto& t : workers_m)
+        if (t.joinable())
+            t.join();
+}
+
+bool WorkerPool::Post(std::function<void()> work)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (stop_m)
+            return false;
+        work_m.push_back(std::move(work));
+    }
+    cv_m.notify_one();
+    return true;
+}
+
+void WorkerPool::WorkerLoop(const std::set<int>& cpus, int priority)
+{
+    bool placed = HostThreads::SetCurrentThread(cpus, priority);
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        num_ready_m++;
+        if (placed)  num_placed_m++;
+    }
+    cv_ready_m.notify_one();
+
+    while (true)
+    {
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(mutex_m);
+            cv_m.wait(lock, [this] { return stop_m || !work_m.empty(); });
+            if (work_m.empty())
+                return;
+
+            work = std::move(work_m.front());
+            work_m.pop_front();
+        }
+
+        // An exception leaving the worker would terminate the process
+        try
+        {
+            work();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "TIDL API: host worker task threw" << std::endl;
+        }
+    }
+}
+
+bool HostThreads::StartWorkers(uint32_t num_workers,
+                               const std::set<int>& cpus, int priority)
+{
+    if (num_workers == 0)
+    {
+        StopWorkers();
+        return true;
+    }
+
+    auto p = std::make_shared<WorkerPool>(num_workers, cpus, priority);
+    std::shared_ptr<WorkerPool> previous;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        previous = pool;
+        pool     = p;
+    }
+
+    // Drain the previous workers outside the lock, their work may post
+    if (previous)
+        previous->Stop();
+
+    return p->IsPlaced();
+}
+
+void HostThreads::StopWorkers()
+{
+    std::shared_ptr<WorkerPool> previous;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        previous = std::move(pool);
+    }
+
+    if (previous)
+        previous->Stop();
+}
+
+uint32_t HostThreads::GetNumWorkers()
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    return pool ? pool->GetNumWorkers() : 0;
+}
+
+bool HostThreads::SetCurrentThread(const std::set<int>& cpus, int priority)
+{
+    bool status = true;
+
+    if (!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        {
+            TRACE::print("\tHostThreads: cannot set affinity\n");
+            status = false;
+        }
+    }
+
+    if (priority > 0)
+    {
+        sched_param param;
+        param.sched_priority = priority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+        {
+            TRACE::print("\tHostThreads: cannot set priority %d\n", priority);
+            status = false;
+        }
+    }
+
+    return status;
+}
+
+void HostThreads::Run(std::function<void()> work)
+{
+    std::shared_ptr<WorkerPool> p;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        p = pool;
+    }
+
+    if (!p || !p->Post(work))
+        work();
+}
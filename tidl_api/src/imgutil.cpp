@@ -27,65 +27,63 @@
  *****************************************************************************/
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 #include "imgutil.h"
 
 #include "opencv2/imgproc.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TIDL_IMGUTIL_NEON
+#endif
+
 using namespace tidl;
 using namespace cv;
 
+// Normalization of the input channels, resolved from the Configuration
+struct Normalization
+{
+    enum class Kind { COPY, MEAN, TABLE };
+    Kind    kind;
+    int32_t mean[3];        // MEAN: integer mean, saturated to int8
+    int8_t  table[3][256];  // TABLE: (value - mean) * scale, saturated
+};
+
+static bool GetNormalization(const Configuration& c, Normalization& n);
+
+template<int NumChannels>
+static void Planarize(const Mat& image, char* ptr, int pitch, int chOffset,
+                      bool swapRB, const Normalization& n);
+
 bool tidl::imgutil::PreprocessImage(Mat& image, char *ptr,
                                     const Configuration& c)
 {
-    int num_channels  = c.inNumChannels;
     int output_width  = c.inWidth;
     int output_height = c.inHeight;
-    int pitch         = c.inWidth;
-    int chOffset      = c.inWidth * c.inHeight;
     int preProcType   = c.preProcType;
 
-    bool enableMeanSub = false;
-    Mat tempImage;
-    int32_t meanValues[num_channels];
-
-    if(preProcType == 0) // Caffe-Jacinto Models
+    if (preProcType < 0 || preProcType > 4)
     {
-        int32_t half_the_width  =  256/ 2;
-        int32_t half_the_height =  256/ 2;
-
-        int32_t startX  = half_the_width - output_width/2;
-        int32_t startY  = half_the_height - output_height/2;
-
-        cv::resize(image, tempImage, Size(256,256), 0,0,cv::INTER_AREA);
-
-        cv::Rect myROI(startX, startY, output_width, output_height);
-        image = tempImage(myROI);
-
-        enableMeanSub = false;
+        std::cerr << "Unsupported preProcType : " << preProcType << std::endl;
+        return false;
     }
-    else if (preProcType == 1) // Caffe Models , eg : SqueezeNet
-    {
-        int32_t half_the_width  =  256/ 2;
-        int32_t half_the_height =  256/ 2;
 
-        int32_t startX  = half_the_width - output_width/2;
-        int32_t startY  = half_the_height - output_height/2;
-
-        cv::resize(image, tempImage, Size(256,256), 0,0,cv::INTER_AREA);
+    bool swapRB = false;
+    Mat tempImage;
 
-        cv::Rect myROI(startX, startY, output_width, output_height);
-        image = tempImage(myROI);
+    // See https://github.com/tensorflow/models/blob/82e783e3172f254b62dc4af08987754ebb7c348c/research/slim/preprocessing/inception_preprocessing.py#L244
+    // mobileNet, inceptionNet, or an explicit crop factor
+    float factor = c.preProcCropFactor;
+    if (factor == 0 && preProcType == 2)
+        factor = 0.875; // From TF preprocess_for_eval
 
-        enableMeanSub = true;
-        meanValues[0] = 104;
-        meanValues[1] = 117;
-        meanValues[2] = 123;
+    // BGR to RGB, folded into Planarize
+    if (preProcType == 2 || preProcType == 3)
+        swapRB = true;
 
-    }
-    // See https://github.com/tensorflow/models/blob/82e783e3172f254b62dc4af08987754ebb7c348c/research/slim/preprocessing/inception_preprocessing.py#L244
-    else if (preProcType == 2) // mobileNet, inceptionNet
+    if (factor > 0)
     {
-        cv::cvtColor(image, image, CV_BGR2RGB);
-        float factor  = 0.875; // From TF preprocess_for_eval
         int32_t orgWidth  = image.size[1];
         int32_t orgHeight = image.size[0];
 
@@ -97,20 +95,27 @@ bool tidl::imgutil::PreprocessImage(Mat& image, char *ptr,
         int32_t startX  = half_the_width - crop_width/2;
         int32_t startY  = half_the_height - crop_height/2;
 
+        // Resized into tempImage, image may wrap a read-only raw frame
         cv::Rect myROI(startX, startY, crop_width, crop_height);
-        tempImage = image(myROI);
-
-        cv::resize(tempImage, image, Size(output_width,output_height),
+        cv::resize(image(myROI), tempImage, Size(output_width,output_height),
                    0, 0, CV_INTER_AREA);
+        image = tempImage;
+    }
+    else if (preProcType == 0 || preProcType == 1) // Caffe-Jacinto, Caffe
+    {
+        int32_t half_the_width  =  256/ 2;
+        int32_t half_the_height =  256/ 2;
+
+        int32_t startX  = half_the_width - output_width/2;
+        int32_t startY  = half_the_height - output_height/2;
 
-        enableMeanSub = true;
-        meanValues[0] = 128;
-        meanValues[1] = 128;
-        meanValues[2] = 128;
+        cv::resize(image, tempImage, Size(256,256), 0,0,cv::INTER_AREA);
+
+        cv::Rect myROI(startX, startY, output_width, output_height);
+        image = tempImage(myROI);
     }
     else if (preProcType == 3) // CIFAR 10
     {
-        cv::cvtColor(image, image, CV_BGR2RGB);
         int32_t half_the_width  =  32/ 2;
         int32_t half_the_height =  32/ 2;
 
@@ -121,49 +126,338 @@ bool tidl::imgutil::PreprocessImage(Mat& image, char *ptr,
         cv::resize(image, tempImage, Size(32,32), 0,0,cv::INTER_AREA);
         cv::Rect myROI(startX, startY, output_width, output_height);
         image = tempImage(myROI);
-        enableMeanSub = false;
     }
     else if (preProcType == 4) // JdetNet
     {
         cv::resize(image, tempImage, Size(output_width,output_height),
                    0, 0, cv::INTER_AREA);
-        enableMeanSub = false;
     }
-    else
+
+    return imgutil::PlanarizeImage(image, ptr, c, swapRB);
+}
+
+// The crop (or the letterbox area) is chosen so that a single resize
+// covers it. Only the borders are filled, the resized part is written once.
+imgutil::ResizeTransform tidl::imgutil::ResizeImage(const Mat& image,
+                                                    Mat& out, Size size,
+                                                    ResizeMode mode,
+                                                    const Scalar& pad)
+{
+    out.create(size, image.type());
+
+    Rect from(0, 0, image.cols, image.rows);
+    Rect to(0, 0, size.width, size.height);
+    float scale_x = (float) size.width  / image.cols;
+    float scale_y = (float) size.height / image.rows;
+
+    if (mode == ResizeMode::CENTER_CROP)
     {
-        std::cerr << "Unsupported preProcType : " << preProcType << std::endl;
+        float scale = std::max(scale_x, scale_y);
+        from.width  = std::lround(size.width  / scale);
+        from.height = std::lround(size.height / scale);
+        from.width  = std::min(from.width,  image.cols);
+        from.height = std::min(from.height, image.rows);
+        from.x = (image.cols - from.width)  / 2;
+        from.y = (image.rows - from.height) / 2;
+    }
+    else if (mode == ResizeMode::LETTERBOX)
+    {
+        float scale = std::min(scale_x, scale_y);
+        to.width  = std::lround(image.cols * scale);
+        to.height = std::lround(image.rows * scale);
+        to.width  = std::max(1, std::min(to.width,  size.width));
+        to.height = std::max(1, std::min(to.height, size.height));
+        to.x = (size.width  - to.width)  / 2;
+        to.y = (size.height - to.height) / 2;
+
+        Rect borders[] = {
+            Rect(0, 0, size.width, to.y),
+            Rect(0, to.y + to.height, size.width,
+                 size.height - to.y - to.height),
+            Rect(0, to.y, to.x, to.height),
+            Rect(to.x + to.width, to.y, size.width - to.x - to.width,
+                 to.height) };
+        for (const Rect& r : borders)
+            if (r.area() > 0)
+                out(r).setTo(pad);
+    }
+
+    Mat dst = out(to);
+    cv::resize(image(from), dst, to.size(), 0, 0, cv::INTER_AREA);
+
+    ResizeTransform t;
+    t.scale_x  = (float) to.width  / from.width;
+    t.scale_y  = (float) to.height / from.height;
+    t.offset_x = to.x - from.x * t.scale_x;
+    t.offset_y = to.y - from.y * t.scale_y;
+    return t;
+}
+
+bool tidl::imgutil::PreprocessImage(const Mat& image, char *ptr,
+                                    const Configuration& c, ResizeMode mode,
+                                    ResizeTransform* transform)
+{
+    if (image.empty())
         return false;
+
+    Mat resized;
+    ResizeTransform t = ResizeImage(image, resized,
+                                    Size(c.inWidth, c.inHeight), mode);
+    if (transform != nullptr)
+        *transform = t;
+
+    // BGR to RGB, as for the crop and resize of preProcType
+    bool swapRB = c.preProcType == 2 || c.preProcType == 3;
+    return imgutil::PlanarizeImage(resized, ptr, c, swapRB);
+}
+
+size_t tidl::imgutil::GetRawFrameSize(int width, int height,
+                                      RawFormat format)
+{
+    if (format == RawFormat::NV12)
+        return width * height * 3 / 2;
+    if (format == RawFormat::YUYV)
+        return width * height * 2;
+
+    return width * height * 3;
+}
+
+bool tidl::imgutil::PreprocessRawFrame(const char *raw, int width,
+                                       int height, RawFormat format,
+                                       char *ptr, const Configuration& c)
+{
+    if (raw == nullptr || width <= 0 || height <= 0)
+        return false;
+
+    // The raw frame is only read, the Mat headers do not copy it
+    void* data = const_cast<char *>(raw);
+    Mat image;
+    if (format == RawFormat::NV12)
+    {
+        if (width % 2 != 0 || height % 2 != 0)
+            return false;
+
+        Mat yuv(height * 3 / 2, width, CV_8UC1, data);
+        cvtColor(yuv, image, COLOR_YUV2BGR_NV12);
+    }
+    else if (format == RawFormat::YUYV)
+    {
+        if (width % 2 != 0)
+            return false;
+
+        Mat yuyv(height, width, CV_8UC2, data);
+        cvtColor(yuyv, image, COLOR_YUV2BGR_YUY2);
     }
+    else
+        image = Mat(height, width, CV_8UC3, data);
+
+    return PreprocessImage(image, ptr, c);
+}
+
+bool tidl::imgutil::PlanarizeImage(const Mat& image, char *ptr,
+                                   const Configuration& c, bool swap_rb)
+{
+    int num_channels  = c.inNumChannels;
+    int pitch         = c.inWidth;
+    int chOffset      = c.inWidth * c.inHeight;
 
     if (image.channels() > 3)
         return false;
 
-    if (image.total() != (unsigned int) (output_height * output_width))
+    if (image.total() != (unsigned int) (c.inHeight * c.inWidth))
         return false;
 
-    Mat spl[num_channels];
-    split(image,spl);
+    // Rows are scattered with the network pitch
+    if (image.cols != c.inWidth || image.channels() != num_channels ||
+        image.depth() != CV_8U)
+        return false;
+
+    Normalization n;
+    if (!GetNormalization(c, n))
+        return false;
+
+    switch (num_channels)
+    {
+        case 1: Planarize<1>(image, ptr, pitch, chOffset, swap_rb, n); break;
+        case 2: Planarize<2>(image, ptr, pitch, chOffset, swap_rb, n); break;
+        case 3: Planarize<3>(image, ptr, pitch, chOffset, swap_rb, n); break;
+    }
+
+    return true;
+}
 
-    for(int c = 0; c < num_channels; c++)
+static bool GetNormalization(const Configuration& c, Normalization& n)
+{
+    const int num_channels = c.inNumChannels;
+
+    float mean[3]  = { 0, 0, 0 };
+    float scale[3] = { 1, 1, 1 };
+    bool  normalize = false;
+
+    for (int i = 0; i < 3; i++)
+        n.mean[i] = 0;
+
+    if (c.preProcType == 1) // Caffe Models , eg : SqueezeNet
     {
-        const unsigned char* data = spl[c].ptr();
+        mean[0] = 104; mean[1] = 117; mean[2] = 123;
+        normalize = true;
+    }
+    else if (c.preProcType == 2) // mobileNet, inceptionNet
+    {
+        mean[0] = mean[1] = mean[2] = 128;
+        normalize = true;
+    }
 
-        for(int rows = 0; rows < output_height; rows++)
-            for(int cols = 0; cols < output_width; cols++)
+    if ((!c.preProcMean.empty() &&
+         c.preProcMean.size() != (size_t) num_channels) ||
+        (!c.preProcScale.empty() &&
+         c.preProcScale.size() != (size_t) num_channels))
+    {
+        std::cerr << "preProcMean, preProcScale must have inNumChannels "
+                     "values" << std::endl;
+        return false;
+    }
+
+    for (int i = 0; i < (int) c.preProcMean.size(); i++)
+        mean[i] = c.preProcMean[i];
+    for (int i = 0; i < (int) c.preProcScale.size(); i++)
+        scale[i] = c.preProcScale[i];
+    normalize |= !c.preProcMean.empty() || !c.preProcScale.empty();
+
+    if (!normalize)
+    {
+        n.kind = Normalization::Kind::COPY;
+        return true;
+    }
+
+    // Integer means without scaling use the vectorized subtraction,
+    // anything else a lookup table per channel
+    bool integer = true;
+    for (int i = 0; i < num_channels; i++)
+        integer &= scale[i] == 1 && mean[i] == std::floor(mean[i]);
+
+    if (integer)
+    {
+        n.kind = Normalization::Kind::MEAN;
+        for (int i = 0; i < 3; i++)
+            n.mean[i] = mean[i];
+        return true;
+    }
+
+    n.kind = Normalization::Kind::TABLE;
+    for (int i = 0; i < num_channels; i++)
+        for (int v = 0; v < 256; v++)
+        {
+            float out = std::round((v - mean[i]) * scale[i]);
+            n.table[i][v] = out > 127 ? 127 : (out < -128 ? -128 : out);
+        }
+
+    return true;
+}
+
+// Convert the rows of an interleaved 8-bit image to the planar layout
+// expected by the network in a single pass: optionally swap the first and
+// third channels (BGR to RGB), normalize, and scatter each channel to its
+// plane. Specialized on the channel count, the swap and the kind of
+// normalization so the per-pixel loop has no branches.
+template<int NumChannels, bool Swap, Normalization::Kind Kind>
+static void PlanarizeRows(const Mat& image, char* ptr, int pitch,
+                          int chOffset, const Normalization& n)
+{
+    for (int rows = 0; rows < image.rows; rows++)
+    {
+        // Rows of a cropped image are not contiguous
+        const unsigned char* src = image.ptr<unsigned char>(rows);
+        char*                dst = ptr + rows*pitch;
+        int cols = 0;
+
+#ifdef TIDL_IMGUTIL_NEON
+        // 16 pixels per iteration, vld3 de-interleaves the channels
+        if (NumChannels == 3 && Kind != Normalization::Kind::TABLE)
+        {
+            int16x8_t vmean[3];
+            for (int c = 0; c < 3; c++)
+                vmean[c] = vdupq_n_s16(n.mean[c]);
+
+            for (; cols + 16 <= image.cols; cols += 16)
             {
-                int32_t in =  data[rows*output_width + cols];
+                uint8x16x3_t px = vld3q_u8(src + 3*cols);
+                if (Swap)
+                {
+                    uint8x16_t t = px.val[0];
+                    px.val[0]    = px.val[2];
+                    px.val[2]    = t;
+                }
 
-                if(enableMeanSub)
+                for (int c = 0; c < 3; c++)
                 {
-                    in -= meanValues[c];
+                    char* out = dst + c*chOffset + cols;
+                    if (Kind == Normalization::Kind::COPY)
+                    {
+                        vst1q_u8((uint8_t *) out, px.val[c]);
+                        continue;
+                    }
 
-                    if(in > 127)  in  = 127;
-                    if(in < -128) in = -128;
+                    int16x8_t lo = vreinterpretq_s16_u16(
+                                        vmovl_u8(vget_low_u8(px.val[c])));
+                    int16x8_t hi = vreinterpretq_s16_u16(
+                                        vmovl_u8(vget_high_u8(px.val[c])));
+                    lo = vsubq_s16(lo, vmean[c]);
+                    hi = vsubq_s16(hi, vmean[c]);
+                    vst1q_s8((int8_t *) out,
+                             vcombine_s8(vqmovn_s16(lo), vqmovn_s16(hi)));
                 }
+            }
+        }
+#endif
+
+        for (; cols < image.cols; cols++)
+            for (int c = 0; c < NumChannels; c++)
+            {
+                int32_t in = src[cols*NumChannels +
+                                 (Swap && NumChannels == 3 ? 2 - c : c)];
 
-                ptr[c*chOffset + rows*pitch + cols] = in;
+                if (Kind == Normalization::Kind::MEAN)
+                {
+                    in -= n.mean[c];
+                    in  = in > 127 ? 127 : (in < -128 ? -128 : in);
+                }
+                else if (Kind == Normalization::Kind::TABLE)
+                    in = n.table[c][in];
+
+                dst[c*chOffset + cols] = in;
             }
     }
+}
 
-    return true;
+template<int NumChannels, bool Swap>
+static void PlanarizeKind(const Mat& image, char* ptr, int pitch,
+                          int chOffset, const Normalization& n)
+{
+    switch (n.kind)
+    {
+        case Normalization::Kind::COPY:
+            PlanarizeRows<NumChannels, Swap, Normalization::Kind::COPY>
+                                            (image, ptr, pitch, chOffset, n);
+            break;
+        case Normalization::Kind::MEAN:
+            PlanarizeRows<NumChannels, Swap, Normalization::Kind::MEAN>
+                                            (image, ptr, pitch, chOffset, n);
+            break;
+        case Normalization::Kind::TABLE:
+            PlanarizeRows<NumChannels, Swap, Normalization::Kind::TABLE>
+                                            (image, ptr, pitch, chOffset, n);
+            break;
+    }
+}
+
+// The channel swap only applies to 3 channel images
+template<int NumChannels>
+static void Planarize(const Mat& image, char* ptr, int pitch, int chOffset,
+                      bool swapRB, const Normalization& n)
+{
+    if (swapRB && NumChannels == 3)
+        PlanarizeKind<NumChannels, true>(image, ptr, pitch, chOffset, n);
+    else
+        PlanarizeKind<NumChannels, false>(image, ptr, pitch, chOffset, n);
 }
@@ -0,0 +1,509 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file inference_server.cpp */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "inference_server.h"
+#include "runtime.h"
+#include "dispatcher.h"
+#include "shared_buffer.h"
+#include "execution_object_pipeline.h"
+#include "trace.h"
+
+using namespace tidl;
+
+namespace {
+
+// Messages on the socket, one per SOCK_SEQPACKET record
+const uint32_t PROTOCOL_MAGIC = 0x54494431;  // "TID1"
+
+struct HelloMsg
+{
+    uint32_t           magic;
+    uint32_t           numSlots;
+    uint64_t           inputSize;
+    uint64_t           outputSize;
+    uint64_t           outputOffset;   // of the output in a slot
+    uint64_t           slotSize;
+    SharedBufferHandle ring;
+};
+
+struct RequestMsg
+{
+    uint32_t slot;
+    int32_t  frameIndex;
+};
+
+struct ResponseMsg
+{
+    uint32_t slot;
+    int32_t  frameIndex;
+    uint32_t status;
+};
+
+// Slots start on a cache line
+const size_t SLOT_ALIGN = 128;
+
+size_t AlignUp(size_t size)
+{
+    return (size + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+}
+
+sockaddr_un SocketAddress(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        throw Exception("Invalid socket path " + path,
+                        __FILE__, __FUNCTION__, __LINE__);
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+template<typename T>
+bool SendMsg(int fd, const T& msg)
+{
+    return send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) == sizeof(msg);
+}
+
+template<typename T>
+bool ReceiveMsg(int fd, T& msg)
+{
+    ssize_t n;
+    do
+        n = recv(fd, &msg, sizeof(msg), 0);
+    while (n < 0 && errno == EINTR);
+    return n == sizeof(msg);
+}
+
+} // namespace
+
+class InferenceServer::Impl
+{
+    public:
+        // A connected client and its ring. Kept alive by its frames in
+        // flight after it disconnects.
+        struct Client
+        {
+            Client(int fd, size_t ring_size, uint32_t num_slots):
+                fd_m(fd), ring_m(ring_size), busy_m(num_slots, false) {}
+            ~Client() { close(fd_m); }
+
+            int               fd_m;
+            SharedBuffer      ring_m;
+            std::vector<bool> busy_m;    // guarded by Impl::mutex_m
+        };
+
+        // Frame submitted to the Dispatcher, indexed by the frame index
+        // passed to the Dispatcher
+        struct Ticket
+        {
+            std::shared_ptr<Client> client;
+            uint32_t                slot;
+            int32_t                 frame_idx;
+        };
+
+        Impl(const Configuration& configuration,
+             const std::string& socket_path, uint32_t frames_per_client,
+             uint32_t max_clients);
+        ~Impl();
+
+        void Run();
+        void Accept();
+        bool Receive(const std::shared_ptr<Client>& client);
+        void Complete(int32_t ticket, bool status);
+
+        Runtime                     runtime_m;
+        const std::string           socket_path_m;
+        const uint32_t              num_slots_m;
+        const uint32_t              max_clients_m;
+        size_t                      input_size_m;
+        size_t                      output_size_m;
+        size_t                      slot_size_m;
+        int                         listen_fd_m;
+        int                         stop_fd_m[2];
+
+        // Used by the Run() thread only
+        std::vector<std::shared_ptr<Client>> clients_m;
+
+        // Guards the tickets, the busy slots of the clients and the
+        // counters, shared with the completion callbacks
+        mutable std::mutex          mutex_m;
+        std::map<int32_t, Ticket>   tickets_m;
+        int32_t                     next_ticket_m;
+        uint64_t                    num_completed_m;
+        uint64_t                    num_failed_m;
+
+        // Destroyed first, waits for the frames in flight
+        std::unique_ptr<Dispatcher> dispatcher_m;
+};
+
+InferenceServer::InferenceServer(const Configuration& configuration,
+                                 const std::string& socket_path,
+                                 uint32_t frames_per_client,
+                                 uint32_t max_clients):
+    pimpl_m(new Impl(configuration, socket_path, frames_per_client,
+                     max_clients))
+{
+}
+
+InferenceServer::~InferenceServer() = default;
+
+InferenceServer::Impl::Impl(const Configuration& configuration,
+                            const std::string& socket_path,
+                            uint32_t frames_per_client,
+                            uint32_t max_clients):
+    runtime_m(configuration), socket_path_m(socket_path),
+    num_slots_m(frames_per_client), max_clients_m(max_clients),
+    listen_fd_m(-1), stop_fd_m{-1, -1}, next_ticket_m(0),
+    num_completed_m(0), num_failed_m(0)
+{
+    if (num_slots_m == 0 || max_clients_m == 0)
+        throw Exception("frames_per_client and max_clients must be > 0",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    const std::vector<ExecutionObjectPipeline*>& eops =
+                                    runtime_m.GetExecutionObjectPipelines();
+    input_size_m  = eops[0]->GetInputBufferSizeInBytes();
+    output_size_m = eops[0]->GetOutputBufferSizeInBytes();
+    slot_size_m   = AlignUp(input_size_m) + AlignUp(output_size_m);
+
+    // With the quotas, the queue always has room for the frames of all
+    // clients
+    dispatcher_m.reset(new Dispatcher(eops,
+                    [this](const FrameDescriptor& f,
+                           ExecutionObjectInternalInterface&, bool status)
+                    { Complete(f.GetFrameIndex(), status); },
+                    num_slots_m * max_clients_m));
+
+    if (pipe2(stop_fd_m, O_CLOEXEC | O_NONBLOCK) != 0)
+        throw Exception("Cannot create pipe: " +
+                        std::string(strerror(errno)),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    sockaddr_un addr = SocketAddress(socket_path_m);
+    listen_fd_m = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    unlink(socket_path_m.c_str());
+    if (listen_fd_m < 0 ||
+        bind(listen_fd_m, (sockaddr *) &addr, sizeof(addr)) != 0 ||
+        listen(listen_fd_m, max_clients_m) != 0)
+    {
+        std::string error = strerror(errno);
+        if (listen_fd_m >= 0)  close(listen_fd_m);
+        close(stop_fd_m[0]);
+        close(stop_fd_m[1]);
+        throw Exception("Cannot listen on " + socket_path_m + ": " + error,
+                        __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+InferenceServer::Impl::~Impl()
+{
+    dispatcher_m.reset();
+    clients_m.clear();
+    close(listen_fd_m);
+    unlink(socket_path_m.c_str());
+    close(stop_fd_m[0]);
+    close(stop_fd_m[1]);
+}
+
+void InferenceServer::Run()
+{
+    pimpl_m->Run();
+}
+
+void InferenceServer::Stop()
+{
+    // write is async-signal-safe, the pipe wakes up Run()
+    char c = 0;
+    ssize_t n = write(pimpl_m->stop_fd_m[1], &c, 1);
+    (void) n;
+}
+
+uint64_t InferenceServer::GetNumFramesCompleted() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_completed_m;
+}
+
+uint64_t InferenceServer::GetNumFramesFailed() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_failed_m;
+}
+
+void InferenceServer::Impl::Run()
+{
+    std::vector<pollfd> fds;
+    while (true)
+    {
+        fds.clear();
+        fds.push_back({stop_fd_m[0], POLLIN, 0});
+        fds.push_back({listen_fd_m,  POLLIN, 0});
+        for (const auto& client : clients_m)
+            fds.push_back({client->fd_m, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)  continue;
+            throw Exception("poll failed: " + std::string(strerror(errno)),
+                            __FILE__, __FUNCTION__, __LINE__);
+        }
+
+        if (fds[0].revents != 0)
+            break;
+
+        // Clients accepted below are polled from the next iteration
+        std::vector<std::shared_ptr<Client>> connected;
+        for (uint32_t i = 0; i < clients_m.size(); i++)
+        {
+            if (fds[i + 2].revents == 0 || Receive(clients_m[i]))
+                connected.push_back(clients_m[i]);
+            else
+                TRACE::print("InferenceServer: client %d disconnected\n",
+                             clients_m[i]->fd_m);
+        }
+        clients_m.swap(connected);
+
+        if (fds[1].revents != 0)
+            Accept();
+    }
+
+    dispatcher_m->Drain();
+    clients_m.clear();
+}
+
+void InferenceServer::Impl::Accept()
+{
+    int fd = accept4(listen_fd_m, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    if (clients_m.size() >= max_clients_m)
+    {
+        TRACE::print("InferenceServer: client rejected, %u connected\n",
+                     max_clients_m);
+        close(fd);
+        return;
+    }
+
+    std::shared_ptr<Client> client;
+    try
+    {
+        client = std::make_shared<Client>(fd, num_slots_m * slot_size_m,
+                                          num_slots_m);
+    }
+    catch (const Exception& e)
+    {
+        TRACE::print("InferenceServer: %s\n", e.what());
+        close(fd);
+        return;
+    }
+
+    HelloMsg hello = { PROTOCOL_MAGIC, num_slots_m, input_size_m,
+                       output_size_m, AlignUp(input_size_m), slot_size_m,
+                       client->ring_m.GetHandle() };
+    if (SendMsg(fd, hello))
+        clients_m.push_back(client);
+}
+
+bool InferenceServer::Impl::Receive(const std::shared_ptr<Client>& client)
+{
+    RequestMsg req;
+    if (!ReceiveMsg(client->fd_m, req))
+        return false;
+
+    bool    accepted = false;
+    int32_t ticket   = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (req.slot < num_slots_m && !client->busy_m[req.slot])
+        {
+            accepted = true;
+            client->busy_m[req.slot] = true;
+            ticket = next_ticket_m;
+            next_ticket_m = (next_ticket_m + 1) & INT32_MAX;
+            tickets_m[ticket] = {client, req.slot, req.frameIndex};
+        }
+        else
+            num_failed_m++;
+    }
+
+    // Slot in use or invalid, the client exceeds its quota
+    if (!accepted)
+    {
+        ResponseMsg rsp = { req.slot, req.frameIndex, 0 };
+        return SendMsg(client->fd_m, rsp);
+    }
+
+    char* slot = static_cast<char *>(client->ring_m.ptr()) +
+                 req.slot * slot_size_m;
+    FrameDescriptor frame(ArgInfo(slot, input_size_m),
+                          ArgInfo(slot + AlignUp(input_size_m),
+                                  output_size_m),
+                          ticket);
+    if (!dispatcher_m->TrySubmit(frame))
+        Complete(ticket, false);
+
+    return true;
+}
+
+// Called from the Dispatcher threads
+void InferenceServer::Impl::Complete(int32_t ticket, bool status)
+{
+    Ticket t;
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        auto it = tickets_m.find(ticket);
+        if (it == tickets_m.end())
+            return;
+        t = it->second;
+        tickets_m.erase(it);
+        t.client->busy_m[t.slot] = false;
+        if (status)  num_completed_m++;
+        else         num_failed_m++;
+    }
+
+    // Fails harmlessly if the client has disconnected
+    ResponseMsg rsp = { t.slot, t.frame_idx, status ? 1u : 0u };
+    SendMsg(t.client->fd_m, rsp);
+}
+
+
+class InferenceClient::Impl
+{
+    public:
+        explicit Impl(const std::string& socket_path);
+        ~Impl() { ring_m.reset();  close(fd_m); }
+
+        char* Slot(uint32_t slot) const;
+
+        int                           fd_m;
+        HelloMsg                      hello_m;
+        std::unique_ptr<SharedBuffer> ring_m;
+};
+
+InferenceClient::Impl::Impl(const std::string& socket_path):
+    fd_m(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0))
+{
+    sockaddr_un addr = SocketAddress(socket_path);
+    if (fd_m < 0 ||
+        connect(fd_m, (sockaddr *) &addr, sizeof(addr)) != 0 ||
+        !ReceiveMsg(fd_m, hello_m) || hello_m.magic != PROTOCOL_MAGIC)
+    {
+        std::string error = errno != 0 ? strerror(errno) : "rejected";
+        if (fd_m >= 0)  close(fd_m);
+        throw Exception("Cannot connect to " + socket_path + ": " + error,
+                        __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    try
+    {
+        ring_m.reset(new SharedBuffer(hello_m.ring));
+    }
+    catch (...)
+    {
+        close(fd_m);
+        throw;
+    }
+}
+
+char* InferenceClient::Impl::Slot(uint32_t slot) const
+{
+    if (slot >= hello_m.numSlots)
+        throw Exception("Invalid slot " + std::to_string(slot),
+                        __FILE__, __FUNCTION__, __LINE__);
+    return static_cast<char *>(ring_m->ptr()) + slot * hello_m.slotSize;
+}
+
+InferenceClient::InferenceClient(const std::string& socket_path):
+    pimpl_m(new Impl(socket_path))
+{
+}
+
+InferenceClient::~InferenceClient() = default;
+
+uint32_t InferenceClient::GetNumSlots() const
+{
+    return pimpl_m->hello_m.numSlots;
+}
+
+void* InferenceClient::GetInputBufferPtr(uint32_t slot) const
+{
+    return pimpl_m->Slot(slot);
+}
+
+size_t InferenceClient::GetInputBufferSizeInBytes() const
+{
+    return pimpl_m->hello_m.inputSize;
+}
+
+void* InferenceClient::GetOutputBufferPtr(uint32_t slot) const
+{
+    return pimpl_m->Slot(slot) + pimpl_m->hello_m.outputOffset;
+}
+
+size_t InferenceClient::GetOutputBufferSizeInBytes() const
+{
+    return pimpl_m->hello_m.outputSize;
+}
+
+bool InferenceClient::Submit(uint32_t slot, int frame_idx)
+{
+    RequestMsg req = { slot, frame_idx };
+    return SendMsg(pimpl_m->fd_m, req);
+}
+
+bool InferenceClient::Wait(uint32_t& slot, int& frame_idx, bool& status)
+{
+    ResponseMsg rsp;
+    if (!ReceiveMsg(pimpl_m->fd_m, rsp))
+        return false;
+
+    slot      = rsp.slot;
+    frame_idx = rsp.frameIndex;
+    status    = rsp.status != 0;
+    return true;
+}
+
+int InferenceClient::GetFd() const
+{
+    return pimpl_m->fd_m;
+}
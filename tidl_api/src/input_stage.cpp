@@ -0,0 +1,220 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file input_stage.cpp */
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "input_stage.h"
+#include "buffer_pool.h"
+#include "executor.h"
+#include "trace.h"
+
+using namespace tidl;
+
+class InputStage::Impl
+{
+    public:
+        Impl(ReadFunction read, size_t frame_size, uint32_t num_workers,
+             uint32_t num_buffers);
+        ~Impl();
+
+        char* GetNextFrame(uint32_t& frame_idx);
+        void  ReleaseFrame(char* buffer);
+        void  ReadLoop();
+
+        ReadFunction             read_m;
+        size_t                   frame_size_m;
+
+        // Buffers are owned by pool_m. A buffer is idle in free_m, being
+        // read by a worker, ready in ready_m, or held by the caller.
+        BufferPool               pool_m;
+        std::vector<char*>       free_m;
+        std::map<uint32_t, char*> ready_m;
+        uint32_t                 num_reading_m;
+
+        // Next index handed to a worker, next index returned by
+        // GetNextFrame, and first index that failed to read
+        uint32_t                 next_read_m;
+        uint32_t                 next_out_m;
+        uint32_t                 end_m;
+        bool                     stop_m;
+
+        // Guards the buffers, indices and flags. Workers wait on read_cv_m
+        // for an idle buffer, GetNextFrame on ready_cv_m for the next frame
+        std::mutex               mutex_m;
+        std::condition_variable  read_cv_m;
+        std::condition_variable  ready_cv_m;
+
+        std::vector<std::thread> workers_m;
+};
+
+InputStage::InputStage(ReadFunction read, size_t frame_size,
+                       uint32_t num_workers, uint32_t num_buffers):
+    pimpl_m(new Impl(read, frame_size, num_workers, num_buffers))
+{}
+
+InputStage::~InputStage() = default;
+
+char* InputStage::GetNextFrame(uint32_t& frame_idx)
+{
+    return pimpl_m->GetNextFrame(frame_idx);
+}
+
+void InputStage::ReleaseFrame(char* buffer)
+{
+    pimpl_m->ReleaseFrame(buffer);
+}
+
+size_t InputStage::GetFrameSize() const
+{
+    return pimpl_m->frame_size_m;
+}
+
+uint32_t InputStage::GetNumWorkers() const
+{
+    return pimpl_m->workers_m.size();
+}
+
+
+InputStage::Impl::Impl(ReadFunction read, size_t frame_size,
+                       uint32_t num_workers, uint32_t num_buffers):
+    read_m(read), frame_size_m(frame_size), num_reading_m(0),
+    next_read_m(0), next_out_m(0),
+    end_m(std::numeric_limits<uint32_t>::max()), stop_m(false)
+{
+    if (!read_m || frame_size_m == 0)
+        throw Exception("Input stage requires a read function and a "
+                        "non-zero frame size",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    if (num_workers == 0 || num_buffers == 0)
+        throw Exception("Input stage requires at least one worker and "
+                        "one buffer", __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < num_buffers; i++)
+        free_m.push_back(pool_m.Acquire(frame_size_m));
+
+    for (uint32_t i = 0; i < num_workers; i++)
+        workers_m.emplace_back(&InputStage::Impl::ReadLoop, this);
+}
+
+InputStage::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    read_cv_m.notify_all();
+    for (auto& worker : workers_m)
+        worker.join();
+}
+
+// A worker takes an idle buffer before taking the next index, so that the
+// lowest index not yet returned always has a buffer
+void InputStage::Impl::ReadLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (true)
+    {
+        read_cv_m.wait(lock, [this]
+                       { return stop_m || next_read_m >= end_m ||
+                                !free_m.empty(); });
+        if (stop_m || next_read_m >= end_m)
+            break;
+
+        char*    buffer    = free_m.back();
+        uint32_t frame_idx = next_read_m++;
+        free_m.pop_back();
+        num_reading_m++;
+
+        // Read outside the lock, concurrently with the other workers
+        lock.unlock();
+        bool status = false;
+        try
+        {
+            status = read_m(frame_idx, buffer, frame_size_m);
+        }
+        catch (const std::exception& e)
+        {
+            TRACE::print("Frame %d failed to read: %s\n", frame_idx,
+                         e.what());
+        }
+        lock.lock();
+
+        num_reading_m--;
+        if (status)
+            ready_m[frame_idx] = buffer;
+        else
+        {
+            end_m = std::min(end_m, frame_idx);
+            free_m.push_back(buffer);
+            read_cv_m.notify_all();
+        }
+        ready_cv_m.notify_all();
+    }
+}
+
+char* InputStage::Impl::GetNextFrame(uint32_t& frame_idx)
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    ready_cv_m.wait(lock, [this]
+                    { return next_out_m >= end_m ||
+                             ready_m.count(next_out_m) > 0 ||
+                             (free_m.empty() && num_reading_m == 0); });
+    if (next_out_m >= end_m)
+        return nullptr;
+
+    auto it = ready_m.find(next_out_m);
+    if (it == ready_m.end())
+        throw Exception("All input stage buffers are held by the caller",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    char* buffer = it->second;
+    ready_m.erase(it);
+    frame_idx = next_out_m++;
+    return buffer;
+}
+
+void InputStage::Impl::ReleaseFrame(char* buffer)
+{
+    if (buffer == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        free_m.push_back(buffer);
+    }
+    read_cv_m.notify_one();
+}
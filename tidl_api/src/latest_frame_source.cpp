@@ -0,0 +1,156 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file latest_frame_source.cpp */
+
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "latest_frame_source.h"
+
+using namespace tidl;
+
+class LatestFrameSource::Impl
+{
+    public:
+        Impl(CaptureFunction capture, size_t frame_size);
+        ~Impl();
+
+        bool GetLatestFrame(char* buffer, size_t size);
+        void CaptureLoop();
+
+        CaptureFunction         capture_m;
+        size_t                  frame_size_m;
+
+        // The capture thread fills back_m, then swaps it with ready_m.
+        // ready_m holds the newest complete frame.
+        std::vector<char>       back_m;
+        std::vector<char>       ready_m;
+        bool                    has_new_frame_m;
+        bool                    stop_m;
+        bool                    done_m;
+        uint64_t                num_captured_m;
+        uint64_t                num_dropped_m;
+
+        // Guards ready_m, the flags and the counters
+        mutable std::mutex      mutex_m;
+        std::condition_variable cv_m;
+
+        std::thread             thread_m;
+};
+
+LatestFrameSource::LatestFrameSource(CaptureFunction capture,
+                                     size_t frame_size):
+    pimpl_m(new Impl(capture, frame_size))
+{}
+
+LatestFrameSource::~LatestFrameSource() = default;
+
+bool LatestFrameSource::GetLatestFrame(char* buffer, size_t size)
+{
+    return pimpl_m->GetLatestFrame(buffer, size);
+}
+
+uint64_t LatestFrameSource::GetNumFramesCaptured() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_captured_m;
+}
+
+uint64_t LatestFrameSource::GetNumFramesDropped() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_dropped_m;
+}
+
+
+LatestFrameSource::Impl::Impl(CaptureFunction capture, size_t frame_size):
+    capture_m(capture), frame_size_m(frame_size),
+    back_m(frame_size), ready_m(frame_size),
+    has_new_frame_m(false), stop_m(false), done_m(false),
+    num_captured_m(0), num_dropped_m(0)
+{
+    thread_m = std::thread(&LatestFrameSource::Impl::CaptureLoop, this);
+}
+
+LatestFrameSource::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    thread_m.join();
+}
+
+void LatestFrameSource::Impl::CaptureLoop()
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_m);
+            if (stop_m)  break;
+        }
+
+        // Capture outside the lock, GetLatestFrame only touches ready_m
+        if (!capture_m(back_m.data(), frame_size_m))
+            break;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_m);
+            back_m.swap(ready_m);
+            if (has_new_frame_m)  num_dropped_m++;
+            has_new_frame_m = true;
+            num_captured_m++;
+        }
+        cv_m.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        done_m = true;
+    }
+    cv_m.notify_all();
+}
+
+bool LatestFrameSource::Impl::GetLatestFrame(char* buffer, size_t size)
+{
+    if (buffer == nullptr || size < frame_size_m)
+        return false;
+
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_m.wait(lock, [this]{ return has_new_frame_m || done_m; });
+    if (!has_new_frame_m)
+        return false;
+
+    memcpy(buffer, ready_m.data(), frame_size_m);
+    has_new_frame_m = false;
+    return true;
+}
@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+
+#include "layer_output_writer.h"
+#include "execution_object.h"
+
+using namespace tidl;
+
+static const char kFileMagic[8]    = { 'T','I','D','L','L','O','D','1' };
+static const char kTrailerMagic[8] = { 'T','I','D','L','L','O','D','I' };
+
+// Layer outputs captured from one frame. Buffers are returned to the
+// staging pool after they are written and re-used by subsequent captures.
+struct StagedFrame
+{
+    std::vector<LayerOutputWriter::RecordHeader> records;
+    std::vector<char>                            payload;
+};
+
+class LayerOutputWriter::Impl
+{
+    public:
+        Impl(const std::string& filename, size_t staging_size);
+        ~Impl();
+
+        bool Capture(const ExecutionObjectInternalInterface& eo,
+                     int frame_idx);
+        bool Flush();
+
+        void WriterLoop();
+        void WriteIndex();
+
+        std::ofstream       ofs_m;
+        size_t              staging_size_m;
+        size_t              staged_bytes_m;
+        uint32_t            num_dropped_m;
+        bool                stop_m;
+        bool                write_error_m;
+
+        std::deque<std::unique_ptr<StagedFrame>>  queue_m;
+        std::vector<std::unique_ptr<StagedFrame>> free_m;
+        std::vector<uint64_t>                     offsets_m;
+
+        // Guards queue_m, free_m, staged_bytes_m, stop_m and the counters
+        std::mutex              mutex_m;
+        std::condition_variable cv_work_m;
+        std::condition_variable cv_idle_m;
+
+        // Serializes Capture() calls, views_m is re-used across captures
+        std::mutex              capture_mutex_m;
+        LayerOutputViews        views_m;
+
+        std::thread             thread_m;
+};
+
+LayerOutputWriter::LayerOutputWriter(const std::string& filename,
+                                     size_t staging_size):
+    pimpl_m(new Impl(filename, staging_size))
+{}
+
+LayerOutputWriter::~LayerOutputWriter() = default;
+
+bool LayerOutputWriter::Capture(const ExecutionObjectInternalInterface& eo,
+                                int frame_idx)
+{
+    return pimpl_m->Capture(eo, frame_idx);
+}
+
+bool LayerOutputWriter::Flush()
+{
+    return pimpl_m->Flush();
+}
+
+uint32_t LayerOutputWriter::GetNumFramesDropped() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_dropped_m;
+}
+
+
+LayerOutputWriter::Impl::Impl(const std::string& filename,
+                              size_t staging_size):
+    ofs_m(filename, std::ofstream::out | std::ofstream::binary |
+                    std::ofstream::trunc),
+    staging_size_m(staging_size), staged_bytes_m(0), num_dropped_m(0),
+    stop_m(false), write_error_m(false)
+{
+    if (!ofs_m.is_open())
+        throw Exception("Failed to open layer output file " + filename,
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    ofs_m.write(kFileMagic, sizeof(kFileMagic));
+
+    thread_m = std::thread(&LayerOutputWriter::Impl::WriterLoop, this);
+}
+
+LayerOutputWriter::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_work_m.notify_one();
+    thread_m.join();
+
+    WriteIndex();
+    ofs_m.close();
+}
+
+bool LayerOutputWriter::Impl::Capture(
+                                const ExecutionObjectInternalInterface& eo,
+                                int frame_idx)
+{
+    std::lock_guard<std::mutex> capture_lock(capture_mutex_m);
+
+    views_m.clear();
+    eo.GetLayerOutputViews(views_m);
+    if (views_m.empty())
+        return true;
+
+    size_t total = 0;
+    for (const LayerOutputView& lv : views_m)
+        total += lv.Size();
+
+    // Claim space in the staging pool. Drop the frame rather than block
+    // the caller if the writer has fallen behind.
+    std::unique_ptr<StagedFrame> frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (staged_bytes_m + total > staging_size_m)
+        {
+            num_dropped_m++;
+            return false;
+        }
+        staged_bytes_m += total;
+
+        if (!free_m.empty())
+        {
+            frame = std::move(free_m.back());
+            free_m.pop_back();
+        }
+    }
+
+    if (!frame)
+        frame.reset(new StagedFrame);
+
+    frame->records.clear();
+    frame->payload.resize(total);
+
+    char *payload = frame->payload.data();
+    for (const LayerOutputView& lv : views_m)
+    {
+        RecordHeader r;
+        r.frameIndex  = frame_idx;
+        r.layerIndex  = lv.LayerIndex();
+        r.outputIndex = lv.OutputIndex();
+        r.bufferId    = lv.BufferId();
+        r.numChannels = lv.NumberOfChannels();
+        r.height      = lv.Height();
+        r.width       = lv.Width();
+        r.dataQ       = lv.DataQ();
+        r.minValue    = lv.MinValue();
+        r.maxValue    = lv.MaxValue();
+        r.payloadSize = lv.Size();
+        frame->records.push_back(r);
+
+        payload += lv.CopyTo(payload, lv.Size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        queue_m.push_back(std::move(frame));
+    }
+    cv_work_m.notify_one();
+
+    return true;
+}
+
+bool LayerOutputWriter::Impl::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_idle_m.wait(lock, [this]{ return staged_bytes_m == 0; });
+    return !write_error_m;
+}
+
+//
+// Append staged frames to the container file. Runs on thread_m.
+//
+void LayerOutputWriter::Impl::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (true)
+    {
+        cv_work_m.wait(lock, [this]{ return stop_m || !queue_m.empty(); });
+        if (queue_m.empty())
+            break;
+
+        std::unique_ptr<StagedFrame> frame = std::move(queue_m.front());
+        queue_m.pop_front();
+        lock.unlock();
+
+        std::vector<uint64_t> offsets;
+        const char *payload = frame->payload.data();
+        for (const RecordHeader& r : frame->records)
+        {
+            offsets.push_back(static_cast<uint64_t>(ofs_m.tellp()));
+            ofs_m.write(reinterpret_cast<const char *>(&r), sizeof(r));
+            ofs_m.write(payload, r.payloadSize);
+            payload += r.payloadSize;
+        }
+        const bool failed = !ofs_m.good();
+        if (failed)
+            ofs_m.clear();
+
+        lock.lock();
+        offsets_m.insert(offsets_m.end(), offsets.begin(), offsets.end());
+        write_error_m |= failed;
+        staged_bytes_m -= frame->payload.size();
+        free_m.push_back(std::move(frame));
+        cv_idle_m.notify_all();
+    }
+}
+
+//
+// Write the record index and trailer. Called after the writer thread exits.
+//
+void LayerOutputWriter::Impl::WriteIndex()
+{
+    uint64_t index_offset = static_cast<uint64_t>(ofs_m.tellp());
+    uint64_t num_records  = offsets_m.size();
+
+    ofs_m.write(reinterpret_cast<const char *>(offsets_m.data()),
+                offsets_m.size() * sizeof(uint64_t));
+    ofs_m.write(reinterpret_cast<const char *>(&index_offset),
+                sizeof(index_offset));
+    ofs_m.write(reinterpret_cast<const char *>(&num_records),
+                sizeof(num_records));
+    ofs_m.write(kTrailerMagic, sizeof(kTrailerMagic));
+}
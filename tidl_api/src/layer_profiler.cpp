@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file layer_profiler.cpp */
+
+#include <map>
+#include <vector>
+#include "layer_profiler.h"
+#include "execution_object.h"
+#include "binary_cache.h"
+#include "parameters.h"
+#include "network_cost.h"
+#include "trace.h"
+
+using namespace tidl;
+
+class LayerProfiler::Impl
+{
+    public:
+        Impl(const Configuration& configuration, DeviceType device_type,
+             uint32_t num_frames);
+
+        bool Run();
+
+        std::map<int, int> Overrides(int last_layer) const;
+        StageTiming         Profile(int last_layer);
+
+        Configuration             configuration_m;
+        DeviceType                device_type_m;
+        uint32_t                  num_frames_m;
+
+        // Layers that can run on the device, and the type and cost of
+        // every layer
+        std::vector<int>          layers_m;
+        std::vector<bool>         profiled_m;
+        std::vector<int>          types_m;
+        std::vector<NetworkCost::Layer> costs_m;
+
+        std::vector<LayerProfile> profiles_m;
+};
+
+LayerProfiler::LayerProfiler(const Configuration& configuration,
+                             DeviceType device_type, uint32_t num_frames)
+{
+    if (num_frames == 0)
+        throw Exception("LayerProfiler requires frames",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    pimpl_m = std::unique_ptr<Impl>
+              { new Impl(configuration, device_type, num_frames) };
+}
+
+LayerProfiler::~LayerProfiler() = default;
+
+bool LayerProfiler::Run()
+{
+    return pimpl_m->Run();
+}
+
+const std::vector<LayerProfiler::LayerProfile>&
+LayerProfiler::GetLayerProfiles() const
+{
+    return pimpl_m->profiles_m;
+}
+
+void LayerProfiler::WriteCSV(std::ostream& os) const
+{
+    os << "layer,type,cycles,ms,macs,param_bytes,output_bytes\n";
+    for (const LayerProfile& p : pimpl_m->profiles_m)
+        os << p.layerIndex << "," << p.layerType << "," << p.cycles << ","
+           << p.deviceMs << "," << p.macs << "," << p.paramBytes << ","
+           << p.outputBytes << "\n";
+    os.flush();
+}
+
+
+LayerProfiler::Impl::Impl(const Configuration& configuration,
+                          DeviceType device_type, uint32_t num_frames):
+    configuration_m(configuration), device_type_m(device_type),
+    num_frames_m(num_frames)
+{
+    configuration_m.runFullNet = false;
+    configuration_m.layerIndex2LayerGroupId.clear();
+
+    BinaryCache::NetworkPtr net =
+                            BinaryCache::GetNetwork(configuration.netBinFile);
+    if (net == nullptr)
+        throw Exception("Failed to read network binary " +
+                        configuration.netBinFile,
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    costs_m.resize(net->numLayers);
+    for (const NetworkCost::Layer& l : NetworkCost(*net).GetLayers())
+        costs_m[l.index] = l;
+
+    // EVE does not support all layer types, only profile the layers the
+    // import tool placed on it. The DSP runs any layer.
+    for (int i = 0; i < net->numLayers; i++)
+    {
+        const sTIDL_Layer_t& layer = net->TIDLLayers[i];
+        types_m.push_back(layer.layerType);
+
+        bool profiled = layer.layerType != TIDL_DataLayer &&
+                        (device_type_m == DeviceType::DSP ||
+                         layer.layersGroupId == 1);
+        profiled_m.push_back(profiled);
+        if (profiled)
+            layers_m.push_back(i);
+    }
+}
+
+// Run the profiled layers up to last_layer in layersGroupId 1 and the
+// remaining layers in layersGroupId 2. Data layers keep their
+// layersGroupId.
+std::map<int, int> LayerProfiler::Impl::Overrides(int last_layer) const
+{
+    std::map<int, int> overrides;
+    for (int i = 0; i < (int) types_m.size(); i++)
+        if (types_m[i] != TIDL_DataLayer)
+            overrides[i] = (profiled_m[i] && i <= last_layer) ? 1 : 2;
+
+    return overrides;
+}
+
+// Average device cycles of the prefix ending at last_layer. The first frame
+// is not timed.
+StageTiming LayerProfiler::Impl::Profile(int last_layer)
+{
+    Configuration c = configuration_m;
+    c.layerIndex2LayerGroupId = Overrides(last_layer);
+
+    DeviceIds ids = {DeviceId::ID0};
+    std::unique_ptr<Executor> e(new Executor(device_type_m, ids, c, 1));
+    ExecutionObject* eo = (*e)[0];
+
+    std::vector<char> in (eo->GetInputBufferSizeInBytes(), 0);
+    std::vector<char> out(eo->GetOutputBufferSizeInBytes(), 0);
+    eo->SetInputOutputBuffer(ArgInfo(in.data(),  in.size()),
+                             ArgInfo(out.data(), out.size()));
+
+    StageTiming t;
+    for (uint32_t i = 0; i <= num_frames_m; i++)
+    {
+        eo->ProcessFrameStartAsync();
+        eo->ProcessFrameWait();
+
+        if (i == 0)  continue;
+        StageTiming frame = eo->GetFrameTiming();
+        t.deviceCycles += frame.deviceCycles;
+        t.deviceMs     += frame.deviceMs;
+    }
+
+    t.deviceCycles /= num_frames_m;
+    t.deviceMs     /= num_frames_m;
+
+    TRACE::print("LayerProfiler: layers 0-%d, %llu cycles\n", last_layer,
+                 (unsigned long long) t.deviceCycles);
+
+    return t;
+}
+
+bool LayerProfiler::Impl::Run()
+{
+    profiles_m.clear();
+    if (layers_m.empty())
+        return false;
+
+    // Timing noise can make a prefix faster than a shorter one, report
+    // such layers as 0 cycles
+    StageTiming prev;
+    for (int layer : layers_m)
+    {
+        StageTiming t = Profile(layer);
+
+        LayerProfile p;
+        p.layerIndex = layer;
+        p.layerType  = types_m[layer];
+        p.cycles     = t.deviceCycles > prev.deviceCycles ?
+                       t.deviceCycles - prev.deviceCycles : 0;
+        p.deviceMs   = t.deviceMs > prev.deviceMs ?
+                       t.deviceMs - prev.deviceMs : 0;
+        p.macs        = costs_m[layer].macs;
+        p.paramBytes  = costs_m[layer].paramBytes;
+        p.outputBytes = costs_m[layer].outputBytes;
+        profiles_m.push_back(p);
+
+        prev = t;
+    }
+
+    return true;
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <algorithm>
+#include "metrics_recorder.h"
+#include "util.h"
+
+using namespace tidl;
+
+MetricsRecorder::MetricsRecorder():
+    next_m(0), count_m(0), seq_m(0), window_start_us_m(0),
+    window_device_us_m(0), window_frames_m(0), p50_us_m(0), p95_us_m(0),
+    p99_us_m(0), completed_m(0), failed_m(0), dropped_m(0)
+{
+}
+
+void MetricsRecorder::FrameCompleted(uint64_t latency_us, uint64_t device_us)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+
+    end_us_m[next_m]     = TimeStampNow();
+    latency_us_m[next_m] = latency_us;
+    device_us_m[next_m]  = device_us;
+    next_m = (next_m + 1) % W;
+    if (count_m < W)  count_m++;
+
+    completed_m.store(completed_m.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    Publish();
+}
+
+void MetricsRecorder::FrameFailed()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    failed_m.store(failed_m.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    Publish();
+}
+
+void MetricsRecorder::FrameDropped()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    dropped_m.store(dropped_m.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    Publish();
+}
+
+// Called with mutex_m held. The oldest frame in the window marks its start,
+// so its device time is not counted.
+void MetricsRecorder::Publish()
+{
+    uint32_t oldest = (next_m + W - count_m) % W;
+
+    uint64_t device_us = 0;
+    uint32_t latency[W];
+    for (uint32_t i = 0; i < count_m; i++)
+    {
+        uint32_t j = (oldest + i) % W;
+        latency[i] = latency_us_m[j];
+        if (i > 0)  device_us += device_us_m[j];
+    }
+
+    auto percentile = [&latency, this](uint32_t p)
+    {
+        if (count_m == 0)  return 0u;
+        uint32_t k = (count_m - 1) * p / 100;
+        std::nth_element(latency, latency + k, latency + count_m);
+        return latency[k];
+    };
+
+    uint32_t seq = seq_m.load(std::memory_order_relaxed);
+    seq_m.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto relaxed = std::memory_order_relaxed;
+    window_start_us_m.store(count_m > 0 ? end_us_m[oldest] : 0, relaxed);
+    window_device_us_m.store(device_us, relaxed);
+    window_frames_m.store(count_m, relaxed);
+    p50_us_m.store(percentile(50), relaxed);
+    p95_us_m.store(percentile(95), relaxed);
+    p99_us_m.store(percentile(99), relaxed);
+
+    seq_m.store(seq + 2, std::memory_order_release);
+}
+
+Metrics MetricsRecorder::GetSnapshot() const
+{
+    const auto relaxed = std::memory_order_relaxed;
+
+    uint64_t start_us, device_us, completed, failed, dropped;
+    uint32_t frames, p50, p95, p99, seq;
+    do
+    {
+        // Retry while a writer is publishing
+        while ((seq = seq_m.load(std::memory_order_acquire)) & 1) {}
+
+        start_us  = window_start_us_m.load(relaxed);
+        device_us = window_device_us_m.load(relaxed);
+        frames    = window_frames_m.load(relaxed);
+        p50       = p50_us_m.load(relaxed);
+        p95       = p95_us_m.load(relaxed);
+        p99       = p99_us_m.load(relaxed);
+        completed = completed_m.load(relaxed);
+        failed    = failed_m.load(relaxed);
+        dropped   = dropped_m.load(relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (seq_m.load(relaxed) != seq);
+
+    Metrics m;
+    m.latencyP50Ms    = p50 / 1000.0f;
+    m.latencyP95Ms    = p95 / 1000.0f;
+    m.latencyP99Ms    = p99 / 1000.0f;
+    m.framesCompleted = completed;
+    m.framesFailed    = failed;
+    m.framesDropped   = dropped;
+
+    // Frames after the oldest one in the window, up to now
+    uint64_t now = TimeStampNow();
+    if (frames > 1 && now > start_us)
+    {
+        double elapsed_us   = now - start_us;
+        m.fps               = (frames - 1) * 1000000.0 / elapsed_us;
+        m.deviceBusyPercent = std::min(100.0, device_us * 100.0 / elapsed_us);
+    }
+
+    return m;
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include "metrics.h"
+
+namespace tidl {
+
+/*! @class MetricsRecorder
+    @brief Records completed frames and publishes Metrics snapshots.
+
+    Frames are recorded under a mutex, from the threads completing them.
+    Each recorded frame updates the published values, which are read with a
+    sequence lock: GetSnapshot never blocks the recording threads.
+*/
+class MetricsRecorder
+{
+    public:
+        MetricsRecorder();
+
+        //! Record a frame that completed now
+        //! @param latency_us Time from the start of the frame until now
+        //! @param device_us Time spent on the device
+        void FrameCompleted(uint64_t latency_us, uint64_t device_us);
+        void FrameFailed();
+        void FrameDropped();
+
+        //! @return Snapshot of the rolling window, framesInFlight and
+        //! maxFramesInFlight are left for the caller
+        Metrics GetSnapshot() const;
+
+        MetricsRecorder(const MetricsRecorder&)            = delete;
+        MetricsRecorder& operator=(const MetricsRecorder&) = delete;
+
+    private:
+        void Publish();
+
+        static const uint32_t W = Metrics::WINDOW_SIZE;
+
+        // Rolling window, guarded by mutex_m
+        std::mutex            mutex_m;
+        uint64_t              end_us_m[W];
+        uint32_t              latency_us_m[W];
+        uint32_t              device_us_m[W];
+        uint32_t              next_m;
+        uint32_t              count_m;
+
+        // Published values, written under mutex_m between two increments
+        // of seq_m
+        std::atomic<uint32_t> seq_m;
+        std::atomic<uint64_t> window_start_us_m;
+        std::atomic<uint64_t> window_device_us_m;
+        std::atomic<uint32_t> window_frames_m;
+        std::atomic<uint32_t> p50_us_m;
+        std::atomic<uint32_t> p95_us_m;
+        std::atomic<uint32_t> p99_us_m;
+        std::atomic<uint64_t> completed_m;
+        std::atomic<uint64_t> failed_m;
+        std::atomic<uint64_t> dropped_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,374 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file network_binary.cpp */
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "network_binary.h"
+#include "util.h"
+
+using namespace tidl;
+
+static const char     COMPACT_MAGIC[8] = { 'T','I','D','L','N','E','T','C' };
+static const uint32_t COMPACT_VERSION  = 1;
+
+// Bytes of sTIDL_Network_t preceding the layer array
+static const std::size_t NETWORK_HEADER_SIZE =
+                                    offsetof(sTIDL_Network_t, TIDLLayers);
+
+static bool ReadHeader(std::ifstream& ifs, CompactNetworkHeader& header)
+{
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    return ifs.good() &&
+           memcmp(header.magic, COMPACT_MAGIC, sizeof(COMPACT_MAGIC)) == 0;
+}
+
+static bool CheckHeader(const std::string& F,
+                        const CompactNetworkHeader& header)
+{
+    if (header.version != COMPACT_VERSION ||
+        header.layer_size != sizeof(sTIDL_Layer_t) ||
+        header.num_layers > TIDL_NUM_MAX_LAYERS)
+    {
+        std::cout << "ERROR: Unsupported compact network binary " << F
+                  << ", version " << header.version << ", "
+                  << header.num_layers << " layers of "
+                  << header.layer_size << " bytes" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool tidl::IsCompactNetworkBinary(const std::string& F)
+{
+    std::ifstream ifs(F, std::ios::binary);
+    CompactNetworkHeader header;
+    return ReadHeader(ifs, header);
+}
+
+bool tidl::ReadCompactNetwork(const std::string& F, sTIDL_Network_t* net)
+{
+    std::ifstream ifs(F, std::ios::binary);
+    CompactNetworkHeader header;
+    if (!ReadHeader(ifs, header) || !CheckHeader(F, header))
+        return false;
+
+    // Decode in place: network fields and used layers are read directly
+    // into net, the remaining layers are cleared
+    std::size_t size = NETWORK_HEADER_SIZE +
+                       header.num_layers * sizeof(sTIDL_Layer_t);
+    char* p = reinterpret_cast<char *>(net);
+    ifs.read(p, size);
+    if (!ifs.good())
+    {
+        std::cout << "ERROR: Truncated network binary " << F << std::endl;
+        return false;
+    }
+    memset(p + size, 0, sizeof(sTIDL_Network_t) - size);
+
+    if (HashBytes(p, size) != header.network_checksum ||
+        net->numLayers != (int32_t) header.num_layers)
+    {
+        std::cout << "ERROR: Checksum mismatch in network binary " << F
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::size_t tidl::GetCompactParamsSize(const std::string& F)
+{
+    std::ifstream ifs(F, std::ios::binary);
+    CompactNetworkHeader header;
+    if (!ReadHeader(ifs, header) || !CheckHeader(F, header) ||
+        !(header.flags & CompactNetworkHeader::HAS_PARAMS))
+        return 0;
+
+    return header.params_size;
+}
+
+bool tidl::ReadCompactParams(const std::string& F, char* buffer,
+                             std::size_t size)
+{
+    std::ifstream ifs(F, std::ios::binary);
+    CompactNetworkHeader header;
+    if (!ReadHeader(ifs, header) || !CheckHeader(F, header) ||
+        !(header.flags & CompactNetworkHeader::HAS_PARAMS) ||
+        header.params_size != size)
+        return false;
+
+    // Validate params_stored before allocating: the parameters follow the
+    // layers and are only stored compressed if that makes them smaller
+    std::size_t offset = sizeof(header) + NETWORK_HEADER_SIZE +
+                         header.num_layers * sizeof(sTIDL_Layer_t);
+    ifs.seekg(0, std::ios::end);
+    std::streamoff file_size = ifs.tellg();
+    bool lz4 = header.flags & CompactNetworkHeader::PARAMS_LZ4;
+    if (file_size < (std::streamoff) offset ||
+        header.params_stored > (uint64_t) (file_size - offset) ||
+        (lz4 ? header.params_stored >= size : header.params_stored != size))
+    {
+        std::cout << "ERROR: Truncated or corrupt parameters in " << F
+                  << std::endl;
+        return false;
+    }
+    ifs.seekg(offset);
+
+    // Uncompressed parameters are read directly into buffer
+    std::vector<char> stored;
+    char* dst = buffer;
+    if (lz4)
+    {
+        stored.resize(header.params_stored);
+        dst = stored.data();
+    }
+
+    ifs.read(dst, header.params_stored);
+    if (!ifs.good() ||
+        HashBytes(dst, header.params_stored) != header.params_checksum)
+    {
+        std::cout << "ERROR: Checksum mismatch in parameters of " << F
+                  << std::endl;
+        return false;
+    }
+
+    if (lz4)
+    {
+        long n = LZ4Decompress(stored.data(), stored.size(), buffer, size);
+        if (n != (long) size)
+        {
+            std::cout << "ERROR: Corrupt compressed parameters in " << F
+                      << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool tidl::WriteCompactNetwork(const std::string& F,
+                               const sTIDL_Network_t* net,
+                               const char* params, std::size_t params_size,
+                               bool compress)
+{
+    if (net->numLayers < 0 || net->numLayers > TIDL_NUM_MAX_LAYERS)
+        return false;
+
+    CompactNetworkHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPACT_MAGIC, sizeof(COMPACT_MAGIC));
+    header.version    = COMPACT_VERSION;
+    header.layer_size = sizeof(sTIDL_Layer_t);
+    header.num_layers = net->numLayers;
+
+    std::size_t net_size = NETWORK_HEADER_SIZE +
+                           header.num_layers * sizeof(sTIDL_Layer_t);
+    header.network_checksum = HashBytes(net, net_size);
+
+    std::vector<char> compressed;
+    const char* stored = params;
+    if (params_size > 0)
+    {
+        header.flags       = CompactNetworkHeader::HAS_PARAMS;
+        header.params_size = params_size;
+        header.params_stored = params_size;
+
+        if (compress)
+            compressed = LZ4Compress(params, params_size);
+        if (!compressed.empty() && compressed.size() < params_size)
+        {
+            header.flags        |= CompactNetworkHeader::PARAMS_LZ4;
+            header.params_stored = compressed.size();
+            stored               = compressed.data();
+        }
+        header.params_checksum = HashBytes(stored, header.params_stored);
+    }
+
+    std::ofstream ofs(F, std::ios::binary);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(net), net_size);
+    if (params_size > 0)
+        ofs.write(stored, header.params_stored);
+    ofs.close();
+
+    return ofs.good();
+}
+
+// LZ4 block format: sequences of a token (literal length, match length),
+// literals, a 16 bit little endian match offset and match length
+// extensions. The last sequence has literals only.
+namespace {
+const std::size_t LZ4_MIN_MATCH   = 4;
+const std::size_t LZ4_MAX_OFFSET  = 65535;
+const std::size_t LZ4_LAST_LITERALS = 5;   // Block ends with literals
+const std::size_t LZ4_MF_LIMIT    = 12;    // No match starts after this
+const int         LZ4_HASH_LOG    = 16;
+
+uint32_t Read32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void WriteLength(std::vector<char>& out, std::size_t len)
+{
+    for (; len >= 255; len -= 255)
+        out.push_back((char) 255);
+    out.push_back((char) len);
+}
+
+void WriteSequence(std::vector<char>& out, const char* literals,
+                   std::size_t num_literals, std::size_t offset,
+                   std::size_t match_len)
+{
+    std::size_t ml = (match_len > 0) ? match_len - LZ4_MIN_MATCH : 0;
+    uint8_t token = ((num_literals < 15 ? num_literals : 15) << 4) |
+                     (ml < 15 ? ml : 15);
+    out.push_back((char) token);
+    if (num_literals >= 15)
+        WriteLength(out, num_literals - 15);
+    out.insert(out.end(), literals, literals + num_literals);
+
+    if (match_len == 0)
+        return;
+
+    out.push_back((char) (offset & 0xff));
+    out.push_back((char) (offset >> 8));
+    if (ml >= 15)
+        WriteLength(out, ml - 15);
+}
+}
+
+// Greedy compressor, positions of 4 byte sequences are hashed to find
+// match candidates
+std::vector<char> tidl::LZ4Compress(const char* src, std::size_t size)
+{
+    std::vector<char> out;
+    out.reserve(size / 2 + 16);
+
+    std::size_t anchor = 0;
+    if (size > LZ4_MF_LIMIT)
+    {
+        const std::size_t NONE = ~(std::size_t)0;
+        std::vector<std::size_t> table(1 << LZ4_HASH_LOG, NONE);
+
+        std::size_t mf_limit    = size - LZ4_MF_LIMIT;
+        std::size_t match_limit = size - LZ4_LAST_LITERALS;
+
+        std::size_t ip = 0;
+        while (ip < mf_limit)
+        {
+            uint32_t seq = Read32(src + ip);
+            uint32_t h   = (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+            std::size_t ref = table[h];
+            table[h] = ip;
+
+            if (ref == NONE || ip - ref > LZ4_MAX_OFFSET ||
+                Read32(src + ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            std::size_t len = LZ4_MIN_MATCH;
+            while (ip + len < match_limit && src[ref + len] == src[ip + len])
+                len++;
+
+            WriteSequence(out, src + anchor, ip - anchor, ip - ref, len);
+            ip    += len;
+            anchor = ip;
+        }
+    }
+
+    WriteSequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+long tidl::LZ4Decompress(const char* src, std::size_t size,
+                         char* dst, std::size_t capacity)
+{
+    const uint8_t* ip   = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t* iend = ip + size;
+    std::size_t    op   = 0;
+
+    // Read a length extension, false on truncated input
+    auto read_length = [&](std::size_t& len)
+    {
+        uint8_t b;
+        do
+        {
+            if (ip >= iend) return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        std::size_t num_literals = token >> 4;
+        if (num_literals == 15 && !read_length(num_literals))
+            return -1;
+        if (num_literals > (std::size_t)(iend - ip) ||
+            num_literals > capacity - op)
+            return -1;
+        memcpy(dst + op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return -1;
+
+        std::size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(match_len))
+            return -1;
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > capacity - op)
+            return -1;
+
+        // Byte copy, the match may overlap the output
+        for (std::size_t i = 0; i < match_len; i++, op++)
+            dst[op] = dst[op - offset];
+    }
+
+    return op;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file network_binary.h
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "tidl_create_params.h"
+
+namespace tidl {
+
+/*! @brief Compact network binary container.
+ *
+ *  Layout, all fields little endian:
+ *  - CompactNetworkHeader
+ *  - network fields preceding sTIDL_Network_t::TIDLLayers
+ *  - num_layers sTIDL_Layer_t, the layers used by the network
+ *  - optional parameters, raw or as a single LZ4 block
+ *
+ *  The network and the stored parameters are covered by separate
+ *  checksums, so the network can be read and validated without reading
+ *  the parameters. A container with parameters can be used as both the
+ *  network and the parameter binary of a Configuration.
+ */
+struct CompactNetworkHeader
+{
+    enum Flags : uint32_t { HAS_PARAMS = 1, PARAMS_LZ4 = 2 };
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t layer_size;       // sizeof(sTIDL_Layer_t) of the writer
+    uint32_t num_layers;
+    uint64_t params_size;      // Uncompressed
+    uint64_t params_stored;    // Bytes following the layers
+    uint64_t network_checksum;
+    uint64_t params_checksum;
+};
+
+//! @return true if F starts with the compact container magic
+bool        IsCompactNetworkBinary(const std::string& F);
+
+//! Read the network from a compact container into net. Unused layers are
+//! zeroed.
+bool        ReadCompactNetwork    (const std::string& F, sTIDL_Network_t* net);
+
+//! @return Uncompressed size of the parameters in a compact container, 0
+//! if it has none or can't be read
+std::size_t GetCompactParamsSize  (const std::string& F);
+
+//! Read (and decompress) the parameters of a compact container into
+//! buffer, which must be GetCompactParamsSize bytes
+bool        ReadCompactParams     (const std::string& F, char* buffer,
+                                   std::size_t size);
+
+//! Write net and, if params_size > 0, its parameters to a compact
+//! container. Parameters are stored LZ4 compressed if compress is set and
+//! compression reduces their size.
+bool        WriteCompactNetwork   (const std::string& F,
+                                   const sTIDL_Network_t* net,
+                                   const char* params,
+                                   std::size_t params_size,
+                                   bool compress);
+
+//! LZ4 block format. Compress returns the compressed block, Decompress
+//! returns the number of bytes written to dst or -1 if src is malformed
+//! or does not fit dst.
+std::vector<char> LZ4Compress  (const char* src, std::size_t size);
+long              LZ4Decompress(const char* src, std::size_t size,
+                                char* dst, std::size_t capacity);
+
+} // namespace tidl
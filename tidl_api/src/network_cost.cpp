@@ -0,0 +1,314 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file network_cost.cpp */
+
+#include <algorithm>
+#include "network_cost.h"
+
+using namespace tidl;
+
+// Padding around each plane of a device buffer, OCL_TIDL_MAX_PAD_SIZE.
+// Kept here so that host tools can be built without the OpenCL headers.
+static const std::size_t PLANE_PAD = 4;
+
+// Headroom over the estimated heap sizes, for device scratch buffers and
+// alignment
+static const double HEAP_MARGIN = 1.25;
+
+static std::size_t RoundUpToMB(double bytes)
+{
+    const std::size_t MB = 1 << 20;
+    return (((std::size_t) bytes + MB - 1) / MB) * MB;
+}
+
+// Size in bytes of the parameters of a layer in the parameter binary. The
+// import tool writes weights, followed by bias and PReLU slopes, for each
+// layer in layer order, with element sizes given by the network.
+std::size_t tidl::GetParamSize(const sTIDL_Network_t& net,
+                               const sTIDL_Layer_t& l)
+{
+    const sTIDL_LayerParams_t& p = l.layerParams;
+    std::size_t w = net.weightsElementSize;
+    std::size_t b = net.biasElementSize;
+    std::size_t s = net.slopeElementSize;
+
+    // PReLU slopes are stored whenever the reluType is PReLU
+    auto slope = [s](const sTIDL_ReLUParams_t& relu, std::size_t channels)
+    {
+        return (relu.reluType == TIDL_PRelU) ? channels * s : 0;
+    };
+
+    switch (l.layerType)
+    {
+        case TIDL_ConvolutionLayer:
+        case TIDL_Deconv2DLayer:
+        {
+            const sTIDL_ConvParams_t& c = p.convParams;
+            if (c.numGroups <= 0)  return 0;
+            std::size_t n = (std::size_t) c.kernelW * c.kernelH *
+                            c.numInChannels * c.numOutChannels / c.numGroups;
+            return n * w + (c.enableBias ? c.numOutChannels * b : 0) +
+                   slope(c.reluParams, c.numOutChannels);
+        }
+        case TIDL_InnerProductLayer:
+        {
+            const sTIDL_InnerProductParams_t& ip = p.innerProductParams;
+            return (std::size_t) ip.numInNodes * ip.numOutNodes * w +
+                   ip.numOutNodes * b +
+                   slope(ip.reluParams, ip.numOutNodes);
+        }
+        case TIDL_BatchNormLayer:
+        {
+            const sTIDL_BatchNormParams_t& bn = p.batchNormParams;
+            return bn.numChannels * (w + b) +
+                   slope(bn.reluParams, bn.numChannels);
+        }
+        case TIDL_BiasLayer:
+            return p.biasParams.numChannels * b;
+        case TIDL_PReLULayer:
+            return p.reluParams.numChannels * s;
+        case TIDL_DetectionOutputLayer:
+            return p.detectOutParams.priorBoxSize * sizeof(float32_tidl);
+        default:
+            return 0;
+    }
+}
+
+// Number of elements of a data buffer, dimensions are #roi, #ch, h, w
+static uint64_t NumElements(const sTIDL_DataParams_t& d)
+{
+    return (uint64_t) d.dimValues[0] * d.dimValues[1] *
+           d.dimValues[2] * d.dimValues[3];
+}
+
+uint64_t tidl::GetLayerMacs(const sTIDL_Layer_t& layer)
+{
+    const sTIDL_LayerParams_t& p   = layer.layerParams;
+    const sTIDL_DataParams_t&  in  = layer.inData[0];
+    const sTIDL_DataParams_t&  out = layer.outData[0];
+
+    switch (layer.layerType)
+    {
+        case TIDL_ConvolutionLayer:
+        case TIDL_Deconv2DLayer:
+        {
+            const sTIDL_ConvParams_t& c = p.convParams;
+            if (c.numGroups <= 0)  return 0;
+            // The output of a convolution with fused pooling is pooled,
+            // the convolution is computed before pooling
+            uint64_t pixels = (uint64_t) out.dimValues[0] *
+                              out.dimValues[2] * out.dimValues[3];
+            if (c.enablePooling)
+                pixels *= (uint64_t) c.poolParams.strideW *
+                          c.poolParams.strideH;
+            return pixels * c.numOutChannels * c.kernelW * c.kernelH *
+                   (c.numInChannels / c.numGroups);
+        }
+        case TIDL_InnerProductLayer:
+            return (uint64_t) p.innerProductParams.numInNodes *
+                   p.innerProductParams.numOutNodes;
+        case TIDL_PoolingLayer:
+        {
+            // Global pooling has no kernel size, it covers the input plane
+            uint64_t window = (uint64_t) p.poolParams.kernelW *
+                              p.poolParams.kernelH;
+            if (window == 0)
+                window = (uint64_t) in.dimValues[2] * in.dimValues[3];
+            return NumElements(out) * window;
+        }
+        case TIDL_EltWiseLayer:
+            return NumElements(out) * layer.numInBufs;
+        case TIDL_ReLULayer:
+        case TIDL_PReLULayer:
+        case TIDL_BatchNormLayer:
+        case TIDL_BiasLayer:
+        case TIDL_ScaleLayer:
+        case TIDL_SoftMaxLayer:
+        case TIDL_ArgMaxLayer:
+            return NumElements(in);
+        default:
+            return 0;
+    }
+}
+
+std::size_t tidl::GetDataSize(const sTIDL_DataParams_t& data)
+{
+    return NumElements(data);
+}
+
+std::size_t tidl::GetPaddedDataSize(const sTIDL_DataParams_t& data)
+{
+    return (std::size_t) data.dimValues[0] * data.dimValues[1] *
+           (data.dimValues[2] + 2 * PLANE_PAD) *
+           (data.dimValues[3] + 2 * PLANE_PAD);
+}
+
+NetworkCost::NetworkCost(const sTIDL_Network_t& net)
+{
+    // Producer and padded size of each data buffer, and the last layer of
+    // each layer group reading it
+    std::map<int, const sTIDL_DataParams_t*> data;
+    std::map<int, int>                       producer_group;
+    std::map<std::pair<int, int>, int>       last_use;
+    std::map<int, int>                       final_use;
+
+    for (int i = 0; i < net.numLayers; i++)
+    {
+        const sTIDL_Layer_t& l = net.TIDLLayers[i];
+        int group = (l.layerType == TIDL_DataLayer) ? -1 : l.layersGroupId;
+
+        for (int j = 0; j < l.numOutBufs; j++)
+        {
+            data[l.outData[j].dataId]           = &l.outData[j];
+            producer_group[l.outData[j].dataId] = group;
+        }
+        if (group < 0)  continue;
+
+        for (int j = 0; j < l.numInBufs; j++)
+        {
+            last_use[{group, l.inData[j].dataId}] = i;
+            final_use[l.inData[j].dataId]         = i;
+        }
+
+        layers_m.push_back({i, l.layerType, group, GetLayerMacs(l),
+                            GetDataSize(l.outData[0]),
+                            GetParamSize(net, l)});
+    }
+
+    for (const Layer& layer : layers_m)
+    {
+        LayersGroup& g = groups_m[layer.layersGroupId];
+        g.numLayers  += 1;
+        g.macs       += layer.macs;
+        g.paramBytes += layer.paramBytes;
+    }
+
+    // Walk the layers of each group in order. Inputs from other groups are
+    // live from the start of the group, outputs from their layer until
+    // their last use in the group, or the end of the group if read by
+    // others.
+    for (auto& item : groups_m)
+    {
+        const int    group = item.first;
+        LayersGroup& g     = item.second;
+        std::map<int, std::size_t> live;  // dataId -> padded bytes
+        std::size_t  live_bytes = 0;
+
+        for (const auto& use : last_use)
+        {
+            int id = use.first.second;
+            if (use.first.first != group || producer_group[id] == group)
+                continue;
+            live[id]           = GetPaddedDataSize(*data[id]);
+            live_bytes        += live[id];
+            g.activationBytes += live[id];
+        }
+        g.peakActivationBytes = live_bytes;
+
+        for (const Layer& layer : layers_m)
+        {
+            if (layer.layersGroupId != group)  continue;
+            const sTIDL_Layer_t& l = net.TIDLLayers[layer.index];
+
+            for (int j = 0; j < l.numOutBufs; j++)
+            {
+                std::size_t bytes = GetPaddedDataSize(l.outData[j]);
+                live[l.outData[j].dataId] = bytes;
+                live_bytes        += bytes;
+                g.activationBytes += bytes;
+            }
+            g.peakActivationBytes = std::max(g.peakActivationBytes,
+                                             live_bytes);
+
+            // Release inputs whose last use in the group is this layer,
+            // unless a later group reads them
+            for (int j = 0; j < l.numInBufs; j++)
+            {
+                int id = l.inData[j].dataId;
+                if (final_use[id] > layer.index || live.count(id) == 0)
+                    continue;
+                live_bytes -= live[id];
+                live.erase(id);
+            }
+        }
+
+        g.networkHeapSize = RoundUpToMB(g.activationBytes * HEAP_MARGIN);
+        g.paramHeapSize   = RoundUpToMB(g.paramBytes * HEAP_MARGIN);
+    }
+}
+
+void NetworkCost::GetPartitionMacs(int partition_layer, uint64_t& eve_macs,
+                                   uint64_t& dsp_macs) const
+{
+    eve_macs = 0;
+    dsp_macs = 0;
+    for (const Layer& layer : layers_m)
+    {
+        if (layer.layersGroupId == 1 && layer.index < partition_layer)
+            eve_macs += layer.macs;
+        else if (layer.layersGroupId == 1 || layer.layersGroupId == 2)
+            dsp_macs += layer.macs;
+    }
+}
+
+int NetworkCost::GetBalancedPartition(uint32_t num_eves,
+                                      uint32_t num_dsps) const
+{
+    if (num_eves == 0 || num_dsps == 0 ||
+        groups_m.count(1) == 0 || groups_m.count(2) == 0)
+        return -1;
+
+    // Candidates range from keeping a single layer on EVE to the split
+    // produced by the import tool, as in PartitionTuner
+    int first_eve_layer = -1;
+    int last_eve_layer  = -1;
+    for (const Layer& layer : layers_m)
+        if (layer.layersGroupId == 1)
+        {
+            if (first_eve_layer < 0)  first_eve_layer = layer.index;
+            last_eve_layer = layer.index;
+        }
+
+    int    best      = -1;
+    double best_cost = 0;
+    for (int p = first_eve_layer + 1; p <= last_eve_layer + 1; p++)
+    {
+        uint64_t eve_macs, dsp_macs;
+        GetPartitionMacs(p, eve_macs, dsp_macs);
+        double cost = std::max((double) eve_macs / num_eves,
+                               (double) dsp_macs / num_dsps);
+        if (best < 0 || cost < best_cost)
+        {
+            best      = p;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file network_cost.h
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "tidl_create_params.h"
+
+namespace tidl {
+
+//! Bytes of parameters of a layer in the parameter binary
+std::size_t GetParamSize(const sTIDL_Network_t& net, const sTIDL_Layer_t& l);
+
+//! Multiply-accumulates performed by a layer for one frame. Layers without
+//! weights count one operation per element (per input for eltwise, per
+//! window element for pooling).
+uint64_t    GetLayerMacs(const sTIDL_Layer_t& layer);
+
+//! Bytes of a data buffer, unpadded
+std::size_t GetDataSize(const sTIDL_DataParams_t& data);
+
+//! Bytes of a data buffer in the padded plane layout of the device
+std::size_t GetPaddedDataSize(const sTIDL_DataParams_t& data);
+
+/*! @class NetworkCost
+    @brief Static cost of a network, computed from the network binary
+           without running it
+
+    Computes the MACs, output and parameter sizes of each layer, sums them
+    per layersGroupId and derives starting values for NETWORK_HEAP_SIZE
+    and PARAM_HEAP_SIZE. The heap sizes are estimates: the device reuses
+    activation buffers and adds scratch memory of its own, use
+    showHeapStats or autoSizeHeaps to confirm them.
+*/
+class NetworkCost
+{
+    public:
+        struct Layer
+        {
+            int         index;
+            int         layerType;
+            int         layersGroupId;
+            uint64_t    macs;
+            std::size_t outputBytes;
+            std::size_t paramBytes;
+        };
+
+        struct LayersGroup
+        {
+            uint32_t    numLayers;
+            uint64_t    macs;
+            std::size_t paramBytes;
+            //! Padded outputs of the layers and inputs from other groups
+            std::size_t activationBytes;
+            //! Largest padded size of the buffers live at the same time
+            std::size_t peakActivationBytes;
+            //! Recommended heap sizes for the layer group
+            std::size_t networkHeapSize;
+            std::size_t paramHeapSize;
+        };
+
+        //! Data layers are not included, they only describe the input
+        explicit NetworkCost(const sTIDL_Network_t& net);
+
+        const std::vector<Layer>& GetLayers() const { return layers_m; }
+        const std::map<int, LayersGroup>& GetLayersGroups() const
+                                                    { return groups_m; }
+
+        //! @brief First layer to move from layersGroupId 1 (EVE) to
+        //! layersGroupId 2 (DSP) so that the MACs per core of the two
+        //! stages are balanced, assuming equal MAC rates per core. The
+        //! candidates are those of PartitionTuner, which refines the split
+        //! by measurement.
+        //! @return -1 if the network does not have layers in both groups
+        int GetBalancedPartition(uint32_t num_eves, uint32_t num_dsps) const;
+
+        //! MACs in layersGroupId 1 and 2 for a partition layer
+        void GetPartitionMacs(int partition_layer, uint64_t& eve_macs,
+                              uint64_t& dsp_macs) const;
+
+    private:
+        std::vector<Layer>         layers_m;
+        std::map<int, LayersGroup> groups_m;
+};
+
+} // namespace tidl
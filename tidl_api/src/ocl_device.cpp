@@ -29,6 +29,8 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <condition_variable>
+#include <atomic>
 using std::size_t;
 
 #include <iostream>
@@ -36,14 +38,15 @@ using std::size_t;
 #include "ocl_device.h"
 #include "ocl_util.h"
 #include "trace.h"
+#include "alloc_check.h"
 
 using namespace tidl;
 
 static const char* error2string(cl_int err);
-static void        errorCheck(cl_int ret, int line);
+static void        errorCheck(cl_int ret, const char* func, int line);
 
-Device::Device(cl_device_type t, const DeviceIds& ids, const char* name):
-                device_type_m(t), device_ids_m(ids)
+Device::Device(cl_device_type t, const char* name):
+                num_cl_devices_m(0), device_type_m(t), warned_copy_m(false)
 {
     TRACE::print("\tOCL Device: %s created\n",
                  device_type_m == CL_DEVICE_TYPE_CUSTOM ? name : "Unknown");
@@ -53,14 +56,12 @@ Device::Device(cl_device_type t, const DeviceIds& ids, const char* name):
 
 }
 
-DspDevice::DspDevice(const DeviceIds& ids, const std::string &kernel_names):
-              Device(CL_DEVICE_TYPE_CUSTOM, ids, "DSP")
+DspDevice::DspDevice(const std::string &kernel_names):
+              Device(CL_DEVICE_TYPE_CUSTOM, "DSP")
 {
     cl_int       errcode;
     cl_device_id device_ids[MAX_DEVICES];
-    cl_device_id out_device_ids[MAX_DEVICES];
     cl_uint      num_compute_units;
-    cl_uint      num_out_devices;
 
     if (! GetDevices(DeviceType::DSP, device_ids, nullptr, &num_compute_units))
         throw Exception("OpenCL DSP device not found",
@@ -68,8 +69,8 @@ DspDevice::DspDevice(const DeviceIds& ids, const std::string &kernel_names):
 
     if (num_compute_units == 1)
     {
-        num_out_devices   = 1;
-        out_device_ids[0] = device_ids[0];
+        num_cl_devices_m   = 1;
+        cl_device_ids_m[0] = device_ids[0];
     }
     else
     {
@@ -83,44 +84,31 @@ DspDevice::DspDevice(const DeviceIds& ids, const std::string &kernel_names):
                                      properties,         // properties
                                      0,                  // num_devices
                                      NULL,               // out_devices
-                                     &num_out_devices);  // num_devices_ret
-        errorCheck(errcode, __LINE__);
+                                     &num_cl_devices_m); // num_devices_ret
+        errorCheck(errcode, __FUNCTION__, __LINE__);
 
-        assert(num_out_devices == NUM_SUB_DEVICES);
+        assert(num_cl_devices_m == NUM_SUB_DEVICES);
 
         // Create the sub-devices
         errcode = clCreateSubDevices(device_ids[0],        // in_device
                                      properties,           // properties
-                                     num_out_devices,      // num_devices
-                                     out_device_ids,       // out_devices
+                                     num_cl_devices_m,     // num_devices
+                                     cl_device_ids_m,      // out_devices
                                      nullptr);             // num_devices_ret
-        errorCheck(errcode, __LINE__);
+        errorCheck(errcode, __FUNCTION__, __LINE__);
     }
 
     // Create a context containing the out-devices
     context_m = clCreateContext(NULL,               // properties
-                                num_out_devices,    // num_devices
-                                out_device_ids,     // devices
+                                num_cl_devices_m,   // num_devices
+                                cl_device_ids_m,    // devices
                                 NULL,               // pfn_notify
                                 NULL,               // user_data
                                 &errcode);          // errcode_ret
-    errorCheck(errcode, __LINE__);
-
-    // Create queues to each out device
-    for (auto id : device_ids_m)
-    {
-        cl_uint index = static_cast<cl_uint>(id);
-        assert(index < num_out_devices);
-        queue_m[index] = clCreateCommandQueue(context_m,
-                                        out_device_ids[index],
-                                        CL_QUEUE_PROFILING_ENABLE|
-                                        CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
-                                        &errcode);
-        errorCheck(errcode, __LINE__);
-    }
+    errorCheck(errcode, __FUNCTION__, __LINE__);
 
     // Build kernel program
-    BuildBuiltInProgram(kernel_names, out_device_ids, num_out_devices);
+    BuildBuiltInProgram(kernel_names);
 
     // Query device frequency
     errcode = clGetDeviceInfo(device_ids[0],
@@ -128,138 +116,163 @@ DspDevice::DspDevice(const DeviceIds& ids, const std::string &kernel_names):
                               sizeof(freq_in_mhz_m),
                               &freq_in_mhz_m,
                               nullptr);
-    errorCheck(errcode, __LINE__);
+    errorCheck(errcode, __FUNCTION__, __LINE__);
 }
 
 
-EveDevice::EveDevice(const DeviceIds& ids, const std::string &kernel_names):
-            Device(CL_DEVICE_TYPE_CUSTOM, ids, "EVE")
+EveDevice::EveDevice(const std::string &kernel_names):
+            Device(CL_DEVICE_TYPE_CUSTOM, "EVE")
 {
     cl_int       errcode;
-    cl_device_id all_device_ids[MAX_DEVICES];
-    cl_uint      num_devices;
-    if (! GetDevices(DeviceType::EVE, all_device_ids, &num_devices, nullptr))
+    if (! GetDevices(DeviceType::EVE, cl_device_ids_m, &num_cl_devices_m,
+                     nullptr))
         throw Exception("OpenCL EVE device not found",
                         __FILE__, __FUNCTION__, __LINE__);
 
-    assert (num_devices >= device_ids_m.size());
-
     context_m = clCreateContextFromType(0,              // properties
                                         device_type_m,  // device_type
                                         0,              // pfn_notify
                                         0,              // user_data
                                         &errcode);
-    errorCheck(errcode, __LINE__);
-
-    // Create command queues to OpenCL devices specified by the
-    // device_ids_m set.
-    for (auto id : device_ids_m)
-    {
-        int index = static_cast<int>(id);
-        queue_m[index] = clCreateCommandQueue(context_m,
-                                      all_device_ids[index],
-                                      CL_QUEUE_PROFILING_ENABLE|
-                                      CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
-                                      &errcode);
-        errorCheck(errcode, __LINE__);
-    }
+    errorCheck(errcode, __FUNCTION__, __LINE__);
 
-    BuildBuiltInProgram(kernel_names, all_device_ids, device_ids_m.size());
+    BuildBuiltInProgram(kernel_names);
 
-    errcode = clGetDeviceInfo(all_device_ids[0],
+    errcode = clGetDeviceInfo(cl_device_ids_m[0],
                                 CL_DEVICE_MAX_CLOCK_FREQUENCY,
                                 sizeof(freq_in_mhz_m),
                                 &freq_in_mhz_m,
                                 nullptr);
-    errorCheck(errcode, __LINE__);
+    errorCheck(errcode, __FUNCTION__, __LINE__);
 }
 
-bool DspDevice::BuildBuiltInProgram(const std::string& kernel_names,
-                                    cl_device_id device_ids[],
-                                    int num_devices)
+// The program is built for every device in the context, so that Executors
+// created later on other DeviceIds can share it
+void Device::BuildBuiltInProgram(const std::string& kernel_names)
 {
     cl_int err;
     program_m = clCreateProgramWithBuiltInKernels(context_m,
-                                          num_devices,
-                                          device_ids,  // device_list
+                                          num_cl_devices_m,
+                                          cl_device_ids_m,  // device_list
                                           kernel_names.c_str(),
                                           &err);
-    errorCheck(err, __LINE__);
+    errorCheck(err, __FUNCTION__, __LINE__);
 
-    return true;
+    kernel_names_m = kernel_names;
 }
 
-bool EveDevice::BuildBuiltInProgram(const std::string& kernel_names,
-                                    cl_device_id device_ids[],
-                                    int num_devices)
+void Device::CreateQueues(const DeviceIds& ids)
 {
-    cl_int err;
-    cl_device_id executor_device_ids[MAX_DEVICES];
+    for (auto id : ids)
+    {
+        cl_uint index = static_cast<cl_uint>(id);
+        if (index >= num_cl_devices_m)
+            throw Exception("OpenCL device " + std::to_string(index) +
+                            " not available on " + GetDeviceName(),
+                            __FILE__, __FUNCTION__, __LINE__);
 
-    int i = 0;
-    for (auto id : device_ids_m)
-        executor_device_ids[i++] = device_ids[static_cast<int>(id)];
+        if (queue_m[index] != nullptr)
+            continue;
 
-    program_m = clCreateProgramWithBuiltInKernels(context_m,
-                                          num_devices,
-                                          executor_device_ids,  // device_list
-                                          kernel_names.c_str(),
-                                          &err);
-    errorCheck(err, __LINE__);
-
-    return true;
+        cl_int errcode;
+        queue_m[index] = clCreateCommandQueue(context_m,
+                                        cl_device_ids_m[index],
+                                        CL_QUEUE_PROFILING_ENABLE|
+                                        CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
+                                        &errcode);
+        errorCheck(errcode, __FUNCTION__, __LINE__);
+        device_ids_m.insert(id);
+    }
 }
 
+struct Kernel::Callback
+{
+    Callback(): busy(false), owned(false) {}
+
+    std::function<void()> function;
+    // Registered with an event whose callback is pending
+    std::atomic<bool>     busy;
+    // Allocated for one event, the context's callback being busy
+    bool                  owned;
+};
+
 Kernel::Kernel(Device* device, const std::string& name,
-               const KernelArgs& args, uint8_t device_index):
-           name_m(name), device_m(device), device_index_m(device_index)
+               const KernelArgs& args, uint8_t device_index,
+               uint32_t num_contexts):
+           kernel_m(num_contexts, nullptr), event_m(num_contexts, nullptr),
+           callbacks_m(new Callback[num_contexts]), name_m(name),
+           device_m(device), device_index_m(device_index),
+           spin_m(0)
 {
     TRACE::print("Creating kernel %s\n", name.c_str());
     cl_int err;
-    kernel_m = clCreateKernel(device_m->program_m, name_m.c_str(), &err);
-    errorCheck(err, __LINE__);
-
-    for (int i=0; i < tidl::internal::NUM_CONTEXTS; i++)
-        event_m[i] = nullptr;
 
-    int arg_index = 0;
-    for (const auto& arg : args)
+    // The destructor does not run if the constructor throws, release the
+    // kernels and buffers created so far
+    try
     {
-        if (!arg.isLocal())
+        // One cl_kernel per context. Arguments of a cl_kernel cannot be
+        // updated safely while other threads enqueue it, so each context
+        // gets its own copy with its own scalar arguments. Buffers are
+        // shared.
+        for (auto& k : kernel_m)
         {
-            if (arg.kind() == DeviceArgInfo::Kind::BUFFER)
-            {
-                cl_mem buffer = device_m->CreateBuffer(arg);
+            k = clCreateKernel(device_m->program_m, name_m.c_str(), &err);
+            errorCheck(err, __FUNCTION__, __LINE__);
+        }
 
-                clSetKernelArg(kernel_m, arg_index, sizeof(cl_mem), &buffer);
-                TRACE::print("  Arg[%d]: %p\n", arg_index, buffer);
+        // Reserved so that recording a buffer once created cannot throw
+        buffers_m.reserve(args.size());
 
-                if (buffer)
-                    buffers_m.push_back(buffer);
-            }
-            else if (arg.kind() == DeviceArgInfo::Kind::SCALAR)
+        int arg_index = 0;
+        for (const auto& arg : args)
+        {
+            if (!arg.isLocal())
             {
-                clSetKernelArg(kernel_m, arg_index, arg.size(), arg.ptr());
-                TRACE::print("  Arg[%d]: %p\n", arg_index, arg.ptr());
+                if (arg.kind() == DeviceArgInfo::Kind::BUFFER)
+                {
+                    cl_mem buffer = device_m->CreateBuffer(arg);
+
+                    if (buffer)
+                        buffers_m.push_back(buffer);
+
+                    for (auto k : kernel_m)
+                        clSetKernelArg(k, arg_index, sizeof(cl_mem),
+                                       &buffer);
+                    TRACE::print("  Arg[%d]: %p\n", arg_index, buffer);
+                }
+                else if (arg.kind() == DeviceArgInfo::Kind::SCALAR)
+                {
+                    for (auto k : kernel_m)
+                        clSetKernelArg(k, arg_index, arg.size(), arg.ptr());
+                    TRACE::print("  Arg[%d]: %p\n", arg_index, arg.ptr());
+                }
+                else
+                {
+                    assert ("DeviceArgInfo kind not supported");
+                }
             }
             else
             {
-                assert ("DeviceArgInfo kind not supported");
+                for (auto k : kernel_m)
+                    clSetKernelArg(k, arg_index, arg.size(), NULL);
+                TRACE::print("  Arg[%d]: local, %d\n", arg_index,
+                             arg.size());
             }
+            arg_index++;
         }
-        else
-        {
-            clSetKernelArg(kernel_m, arg_index, arg.size(), NULL);
-            TRACE::print("  Arg[%d]: local, %d\n", arg_index, arg.size());
-        }
-        arg_index++;
-
+    }
+    catch (...)
+    {
+        Release();
+        throw;
     }
 }
 
-bool Kernel::UpdateScalarArg(uint32_t index, size_t size, const void *value)
+bool Kernel::UpdateScalarArg(uint32_t index, size_t size, const void *value,
+                             uint32_t context_idx)
 {
-    cl_int ret = clSetKernelArg(kernel_m, index, size, value);
+    cl_int ret = clSetKernelArg(kernel_m[context_idx], index, size, value);
     return ret == CL_SUCCESS;
 }
 
@@ -269,9 +282,16 @@ Kernel& Kernel::RunAsync(uint32_t context_idx)
     TRACE::print("\tKernel: %s device %d executing %s, context %d\n",
                  device_m->GetDeviceName().c_str(),
                  device_index_m, name_m.c_str(), context_idx);
-    cl_int ret = clEnqueueTask(device_m->queue_m[device_index_m],
-                               kernel_m, 0, 0, &event_m[context_idx]);
-    errorCheck(ret, __LINE__);
+    cl_int ret;
+    {
+        AllocCheck::Exclude opencl;
+        ret = clEnqueueTask(device_m->queue_m[device_index_m],
+                            kernel_m[context_idx], 0, 0,
+                            &event_m[context_idx]);
+    }
+    if (ret != CL_SUCCESS)
+        event_m[context_idx] = nullptr;
+    errorCheck(ret, __FUNCTION__, __LINE__);
 
     return *this;
 }
@@ -283,42 +303,172 @@ bool Kernel::Wait(uint32_t context_idx)
         return false;
 
     TRACE::print("\tKernel: waiting context %d...\n", context_idx);
-    cl_int ret = clWaitForEvents(1, &event_m[context_idx]);
-    errorCheck(ret, __LINE__);
 
-    ret = clReleaseEvent(event_m[context_idx]);
-    errorCheck(ret, __LINE__);
+    // Polling the event status avoids the wake-up latency of a blocking
+    // wait, clWaitForEvents returns immediately once the kernel is done
+    if (spin_m > spin_m.zero())
+    {
+        auto deadline = std::chrono::steady_clock::now() + spin_m;
+        while (!IsComplete(context_idx) &&
+               std::chrono::steady_clock::now() < deadline)
+            ;
+    }
+
+    cl_int ret, release_ret;
+    {
+        AllocCheck::Exclude opencl;
+        ret = clWaitForEvents(1, &event_m[context_idx]);
+
+        // Retire the kernel even if it failed, the context can be reused
+        release_ret = clReleaseEvent(event_m[context_idx]);
+    }
     event_m[context_idx] = nullptr;
+    errorCheck(ret, __FUNCTION__, __LINE__);
+    errorCheck(release_ret, __FUNCTION__, __LINE__);
 
     TRACE::print("\tKernel: finished execution\n");
 
     return true;
 }
 
-extern void CallbackWrapper(void *user_data) __attribute__((weak));
+void Kernel::Abandon(uint32_t context_idx)
+{
+    if (event_m[context_idx] == nullptr)
+        return;
+
+    clWaitForEvents(1, &event_m[context_idx]);
+    clReleaseEvent(event_m[context_idx]);
+    event_m[context_idx] = nullptr;
+}
 
+bool Kernel::IsComplete(uint32_t context_idx)
+{
+    if (event_m[context_idx] == nullptr)
+        return true;
+
+    cl_int status;
+    cl_int ret;
+    {
+        AllocCheck::Exclude opencl;
+        ret = clGetEventInfo(event_m[context_idx],
+                             CL_EVENT_COMMAND_EXECUTION_STATUS,
+                             sizeof(status), &status, nullptr);
+    }
+    errorCheck(ret, __FUNCTION__, __LINE__);
+
+    // A negative status indicates the kernel terminated with an error
+    return status <= CL_COMPLETE;
+}
+
+bool Kernel::WaitForCompletion(std::chrono::microseconds timeout,
+                               uint32_t context_idx)
+{
+    if (IsComplete(context_idx) || timeout <= timeout.zero())
+        return IsComplete(context_idx);
+
+    // Signalled from the event callback. Shared with the callback, which
+    // may run after this call has timed out.
+    struct Completion
+    {
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    done = false;
+    };
+    auto c = std::make_shared<Completion>();
+
+    bool registered = AddCallback([c]()
+                                  {
+                                      std::lock_guard<std::mutex> l(c->mutex);
+                                      c->done = true;
+                                      c->cv.notify_all();
+                                  }, context_idx);
+    if (!registered)
+        return IsComplete(context_idx);
+
+    std::unique_lock<std::mutex> lock(c->mutex);
+    return c->cv.wait_for(lock, timeout, [&c] { return c->done; });
+}
+
+// Trampoline from the OpenCL event callback to the callback registered via
+// Kernel::AddCallback. The callback is invoked even if the kernel failed,
+// the failure is reported when the callback waits on the kernel.
 static
 void EventCallback(cl_event event, cl_int exec_status, void *user_data)
 {
-    if (exec_status != CL_SUCCESS || user_data == nullptr)  return;
-    if (CallbackWrapper)  CallbackWrapper(user_data);
+    // Free the context's callback before invoking it, the callback may
+    // start the next frame in the context
+    Kernel::Callback* c = static_cast<Kernel::Callback *>(user_data);
+    std::function<void()> callback = std::move(c->function);
+    c->function = nullptr;
+    if (c->owned)
+        delete c;
+    else
+        c->busy = false;
+
+    // Exceptions cannot propagate into the OpenCL runtime thread
+    try
+    {
+        if (callback)  callback();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
 }
 
-bool Kernel::AddCallback(void *user_data, uint32_t context_idx)
+bool Kernel::AddCallback(std::function<void()> callback, uint32_t context_idx)
 {
     if (event_m[context_idx] == nullptr)
         return false;
 
-    return clSetEventCallback(event_m[context_idx], CL_COMPLETE, EventCallback,
-                              user_data) == CL_SUCCESS;
+    // A second callback on the event, e.g. WaitForCompletion while the
+    // frame's callback is pending, gets its own
+    Callback* c = &callbacks_m[context_idx];
+    std::unique_ptr<Callback> owned;
+    bool idle = false;
+    if (!c->busy.compare_exchange_strong(idle, true))
+    {
+        owned.reset(new Callback);
+        owned->owned = true;
+        c = owned.get();
+    }
+    c->function = std::move(callback);
+
+    cl_int ret;
+    {
+        AllocCheck::Exclude opencl;
+        ret = clSetEventCallback(event_m[context_idx], CL_COMPLETE,
+                                 EventCallback, c);
+    }
+    if (ret != CL_SUCCESS)
+    {
+        c->function = nullptr;
+        if (!owned)  c->busy = false;
+        return false;
+    }
+
+    // Owned by EventCallback from here on
+    owned.release();
+    return true;
 }
 
 Kernel::~Kernel()
+{
+    Release();
+}
+
+void Kernel::Release()
 {
     for (auto b : buffers_m)
         device_m->ReleaseBuffer(b);
+    buffers_m.clear();
 
-    clReleaseKernel(kernel_m);
+    for (auto& k : kernel_m)
+        if (k != nullptr)
+        {
+            clReleaseKernel(k);
+            k = nullptr;
+        }
 }
 
 cl_mem Device::CreateBuffer(const DeviceArgInfo &Arg)
@@ -334,6 +484,30 @@ cl_mem Device::CreateBuffer(const DeviceArgInfo &Arg)
 
     bool hostPtrInCMEM = __is_in_malloced_region(host_ptr);
 
+    std::lock_guard<std::mutex> guard(buffers_mutex_m);
+
+    // A CMEM buffer is used in place, share its cl_mem
+    auto key = std::make_pair(host_ptr, size);
+    if (hostPtrInCMEM)
+    {
+        auto it = shared_buffers_m.find(key);
+        if (it != shared_buffers_m.end())
+        {
+            it->second.refcount++;
+            TRACE::print("\tOCL Share B:%p, refcount %u\n",
+                         it->second.buffer, it->second.refcount);
+            return it->second.buffer;
+        }
+    }
+    else if (!warned_copy_m)
+    {
+        // Device gets a snapshot of the buffer taken at kernel creation
+        std::cerr << "TIDL API Warning: kernel argument " << host_ptr
+                  << " (" << size << " bytes) is not in CMEM and is copied. "
+                     "Allocate it with __malloc_ddr." << std::endl;
+        warned_copy_m = true;
+    }
+
     // Conservative till we have sufficient information.
     cl_mem_flags flag = CL_MEM_READ_WRITE;
 
@@ -346,15 +520,35 @@ cl_mem Device::CreateBuffer(const DeviceArgInfo &Arg)
                                    size,
                                    host_ptr,
                                    &errcode);
-    errorCheck(errcode, __LINE__);
+    errorCheck(errcode, __FUNCTION__, __LINE__);
 
     TRACE::print("\tOCL Create B:%p\n", buffer);
 
+    if (hostPtrInCMEM)
+        shared_buffers_m[key] = { buffer, 1 };
+
     return buffer;
 }
 
 void Device::ReleaseBuffer(cl_mem M)
 {
+    std::lock_guard<std::mutex> guard(buffers_mutex_m);
+
+    for (auto it = shared_buffers_m.begin(); it != shared_buffers_m.end(); ++it)
+    {
+        if (it->second.buffer != M)  continue;
+
+        if (--it->second.refcount > 0)
+        {
+            TRACE::print("\tOCL Unshare B:%p, refcount %u\n",
+                         M, it->second.refcount);
+            return;
+        }
+
+        shared_buffers_m.erase(it);
+        break;
+    }
+
     TRACE::print("\tOCL Release B:%p\n", M);
     clReleaseMemObject(M);
 }
@@ -363,23 +557,24 @@ void Device::ReleaseBuffer(cl_mem M)
 Device::~Device()
 {
     TRACE::print("\tOCL Device: deleted\n");
-    for (unsigned int i = 0; i < device_ids_m.size(); i++)
+    for (auto id : device_ids_m)
     {
-        clFinish(queue_m[i]);
-        clReleaseCommandQueue (queue_m[i]);
+        cl_command_queue q = queue_m[static_cast<int>(id)];
+        clFinish(q);
+        clReleaseCommandQueue (q);
     }
 
     clReleaseProgram      (program_m);
     clReleaseContext      (context_m);
 }
 
-void errorCheck(cl_int ret, int line)
+// OpenCL failures are reported as exceptions, the application decides
+// whether to recover (e.g. via Executor::ResetExecutionObject) or exit
+void errorCheck(cl_int ret, const char* func, int line)
 {
     if (ret != CL_SUCCESS)
-    {
-        std::cerr << "ERROR: [ Line: " << line << "] " << error2string(ret) << std::endl;
-        exit(ret);
-    }
+        throw Exception(std::string("OpenCL: ") + error2string(ret),
+                        __FILE__, func, line);
 }
 
 /// Convert OpenCL error codes to a string
@@ -439,15 +634,35 @@ const char* error2string(cl_int err)
     }
 }
 
+// Devices alive in this process, one per core type. Executors hold the
+// references, the Device is released with the last Executor using it.
+static std::mutex                                  devices_mutex;
+static std::map<DeviceType, std::weak_ptr<Device>> devices;
+
 Device::Ptr Device::Create(DeviceType core_type, const DeviceIds& ids,
                            const std::string& name)
 {
-    Device::Ptr p(nullptr);
-    if (core_type == DeviceType::DSP)
-        p.reset(new DspDevice(ids, name));
-    else if (core_type == DeviceType::EVE)
-        p.reset(new EveDevice(ids, name));
+    std::lock_guard<std::mutex> guard(devices_mutex);
+
+    Device::Ptr p = devices[core_type].lock();
+    if (!p)
+    {
+        if (core_type == DeviceType::DSP)
+            p.reset(new DspDevice(name));
+        else if (core_type == DeviceType::EVE)
+            p.reset(new EveDevice(name));
+        else
+            return p;
+
+        devices[core_type] = p;
+    }
+
+    if (p->kernel_names_m != name)
+        throw Exception("OpenCL device already created with kernels " +
+                        p->kernel_names_m,
+                        __FILE__, __FUNCTION__, __LINE__);
 
+    p->CreateQueues(ids);
     return p;
 }
 
@@ -37,6 +37,10 @@
 #include <CL/cl_ext.h>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <chrono>
 #include "executor.h"
 #include "device_arginfo.h"
 #include "parameters.h"
@@ -51,18 +55,21 @@ class Kernel;
 /*! \brief Manages OpenCL context, device and command queues
  *
  *  Inititalizes an OpenCL context, creates devices and command queues to
- *  each device.
+ *  each device. One Device per core type is shared by all Executors: the
+ *  context and program cover every device of that type, and a command
+ *  queue is created the first time an Executor asks for a DeviceId.
  */
 class Device
 {
 
     public:
-        typedef std::unique_ptr<Device> Ptr;
+        typedef std::shared_ptr<Device> Ptr;
 
-        Device(cl_device_type t, const DeviceIds& ids, const char *name);
+        Device(cl_device_type t, const char *name);
         virtual ~Device();
 
-
+        //! Returns the Device for core_type, creating it if no Executor
+        //! holds one, with command queues to each device in ids
         static Ptr Create(DeviceType core_type, const DeviceIds& ids,
                           const std::string& name);
 
@@ -80,6 +87,10 @@ class Device
     protected:
 
         static const int MAX_DEVICES = 5;  // max: 1 DSP device + 4 EVE devices
+
+        // Buffers in CMEM are registered by host pointer and size, so that
+        // kernels on this device passed the same allocation share one
+        // reference counted cl_mem
         cl_mem CreateBuffer(const DeviceArgInfo &Arg);
         void   ReleaseBuffer(cl_mem M);
         static bool GetDevices(DeviceType device_type,
@@ -87,20 +98,39 @@ class Device
                                cl_uint *p_num_devices,
                                cl_uint *p_num_compute_units);
 
+        // Build the kernel program for all devices in the context
+        void   BuildBuiltInProgram(const std::string &kernel_names);
+        // Create command queues to the devices in ids that have none yet
+        void   CreateQueues(const DeviceIds& ids);
+
               cl_context        context_m;
               cl_program        program_m;
               cl_command_queue  queue_m[MAX_DEVICES];
+              cl_device_id      cl_device_ids_m[MAX_DEVICES];
+              cl_uint           num_cl_devices_m;
         const cl_device_type    device_type_m;
-        const DeviceIds         device_ids_m;
+              DeviceIds         device_ids_m;
+              std::string       kernel_names_m;
               cl_uint           freq_in_mhz_m;
 
+    private:
+        struct SharedBuffer
+        {
+            cl_mem   buffer;
+            uint32_t refcount;
+        };
+
+        std::mutex                                      buffers_mutex_m;
+        std::map<std::pair<void*, size_t>, SharedBuffer> shared_buffers_m;
+        bool                                            warned_copy_m;
+
         friend Kernel;
 };
 
 class DspDevice: public Device
 {
     public:
-        DspDevice(const DeviceIds& ids, const std::string &kernel_names);
+        DspDevice(const std::string &kernel_names);
         virtual ~DspDevice() {}
 
         DspDevice()                            = delete;
@@ -108,17 +138,12 @@ class DspDevice: public Device
         DspDevice& operator=(const DspDevice&) = delete;
 
         virtual std::string GetDeviceName() { return "DSP"; }
-
-    protected:
-        bool BuildBuiltInProgram(const std::string &kernel_names,
-                                 cl_device_id device_ids[],
-                                 int num_devices);
 };
 
 class EveDevice : public Device
 {
     public:
-        EveDevice(const DeviceIds& ids, const std::string &kernel_names);
+        EveDevice(const std::string &kernel_names);
         virtual ~EveDevice() {}
 
         EveDevice()                            = delete;
@@ -126,11 +151,6 @@ class EveDevice : public Device
         EveDevice& operator=(const EveDevice&) = delete;
 
         virtual std::string GetDeviceName() { return "EVE"; }
-
-    protected:
-        bool BuildBuiltInProgram(const std::string &kernel_names,
-                                 cl_device_id device_ids[],
-                                 int num_devices);
 };
 
 
@@ -142,22 +162,50 @@ class Kernel
 {
     public:
         Kernel(Device *device, const std::string &Name,
-               const KernelArgs &args, uint8_t device_index);
+               const KernelArgs &args, uint8_t device_index,
+               uint32_t num_contexts = 1);
         ~Kernel();
 
-        bool UpdateScalarArg(uint32_t index, size_t size, const void *value);
+        bool UpdateScalarArg(uint32_t index, size_t size, const void *value,
+                             uint32_t context_idx = 0);
         Kernel& RunAsync(uint32_t context_idx = 0);
         bool Wait(uint32_t context_idx = 0);
-        bool AddCallback(void *user_data, uint32_t context_idx = 0);
+        // Poll for completion for up to spin in Wait before blocking
+        void SetSpinWait(std::chrono::microseconds spin) { spin_m = spin; }
+        // Wait for the kernel enqueued for context_idx and release its
+        // event without checking its status, e.g. to recover after a
+        // device error
+        void Abandon(uint32_t context_idx = 0);
+        // Returns true if the kernel enqueued for context_idx has completed
+        // (or failed, reported by Wait), or if none is enqueued
+        bool IsComplete(uint32_t context_idx = 0);
+        // Block until IsComplete or timeout expires, returns IsComplete.
+        // Does not release the event, call Wait to retire the kernel.
+        bool WaitForCompletion(std::chrono::microseconds timeout,
+                               uint32_t context_idx = 0);
+        // Invoke callback on an OpenCL runtime thread when the kernel
+        // enqueued for context_idx completes
+        bool AddCallback(std::function<void()> callback,
+                         uint32_t context_idx = 0);
+
+        // Callback registered with the OpenCL runtime, see AddCallback
+        struct Callback;
 
     private:
-        cl_kernel           kernel_m;
-        cl_event            event_m[tidl::internal::NUM_CONTEXTS];
-        std::vector<cl_mem> buffers_m;
-        const std::string   name_m;
-
-        Device*             device_m;
-        uint8_t             device_index_m;
+        // Release the cl_kernels and buffers, used by the destructor and
+        // if the constructor fails
+        void Release();
+
+        std::vector<cl_kernel> kernel_m;
+        std::vector<cl_event>  event_m;
+        // One per context, reused by the callback of every frame
+        std::unique_ptr<Callback[]> callbacks_m;
+        std::vector<cl_mem>    buffers_m;
+        const std::string      name_m;
+
+        Device*                device_m;
+        uint8_t                device_index_m;
+        std::chrono::microseconds spin_m;
 };
 
 
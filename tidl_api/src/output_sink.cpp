@@ -0,0 +1,268 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file output_sink.cpp */
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+
+#include "output_sink.h"
+#include "trace.h"
+
+using namespace tidl;
+
+// Copy of a submitted frame. Staged frames are returned to the free list
+// once consumed, their buffers are re-used by subsequent frames.
+struct StagedFrame
+{
+    int                            frame_idx;
+    std::vector<std::vector<char>> data;
+    std::vector<ArgInfo>           buffers;
+};
+
+class OutputSink::Impl
+{
+    public:
+        Impl(SinkFunction sink, uint32_t queue_depth, uint32_t num_workers,
+             Policy policy);
+        ~Impl();
+
+        bool Submit(int frame_idx, const std::vector<ArgInfo>& buffers);
+        bool Flush();
+
+        void WorkerLoop();
+
+        SinkFunction        sink_m;
+        uint32_t            queue_depth_m;
+        Policy              policy_m;
+
+        std::deque<std::unique_ptr<StagedFrame>>  queue_m;
+        std::vector<std::unique_ptr<StagedFrame>> free_m;
+
+        // Frames claimed by Submit and being copied, counted against
+        // queue_depth_m
+        uint32_t            num_staging_m;
+        // Frames being consumed by a worker
+        uint32_t            num_busy_m;
+        bool                stop_m;
+        Stats               stats_m;
+
+        // Guards everything above
+        mutable std::mutex      mutex_m;
+        std::condition_variable cv_work_m;
+        std::condition_variable cv_space_m;
+        std::condition_variable cv_idle_m;
+
+        std::vector<std::thread> workers_m;
+};
+
+OutputSink::OutputSink(SinkFunction sink, uint32_t queue_depth,
+                       uint32_t num_workers, Policy policy):
+    pimpl_m(new Impl(std::move(sink), queue_depth, num_workers, policy))
+{}
+
+OutputSink::~OutputSink() = default;
+
+bool OutputSink::Submit(int frame_idx, const std::vector<ArgInfo>& buffers)
+{
+    return pimpl_m->Submit(frame_idx, buffers);
+}
+
+bool OutputSink::Submit(const ExecutionObjectInternalInterface& eo)
+{
+    return pimpl_m->Submit(eo.GetFrameIndex(),
+                    { ArgInfo(eo.GetInputBufferPtr(),
+                              eo.GetInputBufferSizeInBytes()),
+                      ArgInfo(eo.GetOutputBufferPtr(),
+                              eo.GetOutputBufferSizeInBytes()) });
+}
+
+bool OutputSink::Flush()
+{
+    return pimpl_m->Flush();
+}
+
+OutputSink::Stats OutputSink::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    Stats stats      = pimpl_m->stats_m;
+    stats.queueDepth = pimpl_m->queue_m.size();
+    return stats;
+}
+
+
+OutputSink::Impl::Impl(SinkFunction sink, uint32_t queue_depth,
+                       uint32_t num_workers, Policy policy):
+    sink_m(std::move(sink)), queue_depth_m(queue_depth), policy_m(policy),
+    num_staging_m(0), num_busy_m(0), stop_m(false), stats_m()
+{
+    if (!sink_m)
+        throw Exception("OutputSink requires a function",
+                        __FILE__, __FUNCTION__, __LINE__);
+    if (queue_depth == 0 || num_workers == 0)
+        throw Exception("OutputSink requires a queue and a worker",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < num_workers; i++)
+        workers_m.emplace_back(&OutputSink::Impl::WorkerLoop, this);
+}
+
+// Queued frames are consumed before the workers exit
+OutputSink::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_work_m.notify_all();
+
+    for (auto& t : workers_m)
+        t.join();
+}
+
+bool OutputSink::Impl::Submit(int frame_idx,
+                              const std::vector<ArgInfo>& buffers)
+{
+    // Claim a slot in the queue, or drop the frame rather than hold back
+    // the caller if the workers have fallen behind
+    std::unique_ptr<StagedFrame> frame;
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        stats_m.framesSubmitted++;
+
+        auto has_space = [this]
+                    { return queue_m.size() + num_staging_m < queue_depth_m; };
+        if (!has_space())
+        {
+            if (policy_m == Policy::DROP)
+            {
+                stats_m.framesDropped++;
+                return false;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            cv_space_m.wait(lock, has_space);
+            std::chrono::duration<float, std::milli> blocked =
+                                    std::chrono::steady_clock::now() - start;
+            stats_m.blockedMs += blocked.count();
+        }
+        num_staging_m++;
+
+        if (!free_m.empty())
+        {
+            frame = std::move(free_m.back());
+            free_m.pop_back();
+        }
+    }
+
+    if (!frame)
+        frame.reset(new StagedFrame);
+
+    frame->frame_idx = frame_idx;
+    frame->data.resize(buffers.size());
+    frame->buffers.clear();
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        const ArgInfo&     b    = buffers[i];
+        std::vector<char>& data = frame->data[i];
+        const char*        p    = static_cast<const char *>(b.ptr());
+        if (p != nullptr)
+            data.assign(p, p + b.size());
+        else
+            data.clear();
+
+        if (b.format() != ArgInfo::OutputFormat::RAW)
+            frame->buffers.emplace_back(data.data(), data.size(), b.format());
+        else
+            frame->buffers.emplace_back(data.data(), data.size(), b.layout(),
+                                        b.pitch());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        num_staging_m--;
+        queue_m.push_back(std::move(frame));
+        if (queue_m.size() > stats_m.maxQueueDepth)
+            stats_m.maxQueueDepth = queue_m.size();
+    }
+    cv_work_m.notify_one();
+
+    return true;
+}
+
+bool OutputSink::Impl::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_idle_m.wait(lock, [this]
+                   { return queue_m.empty() && num_staging_m == 0 &&
+                            num_busy_m == 0; });
+    return stats_m.framesFailed == 0;
+}
+
+//
+// Run the sink function on queued frames. Runs on each of workers_m.
+//
+void OutputSink::Impl::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (true)
+    {
+        cv_work_m.wait(lock, [this]{ return stop_m || !queue_m.empty(); });
+        if (queue_m.empty())
+            break;
+
+        std::unique_ptr<StagedFrame> frame = std::move(queue_m.front());
+        queue_m.pop_front();
+        num_busy_m++;
+        lock.unlock();
+        cv_space_m.notify_one();
+
+        bool status = false;
+        try
+        {
+            status = sink_m(SinkFrame(frame->frame_idx, frame->buffers));
+        }
+        catch (const std::exception& e)
+        {
+            TRACE::print("OutputSink: frame %d failed: %s\n",
+                         frame->frame_idx, e.what());
+        }
+
+        lock.lock();
+        num_busy_m--;
+        if (status)  stats_m.framesCompleted++;
+        else         stats_m.framesFailed++;
+        free_m.push_back(std::move(frame));
+        cv_idle_m.notify_all();
+    }
+}
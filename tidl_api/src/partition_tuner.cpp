@@ -0,0 +1,259 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file partition_tuner.cpp */
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+#include "partition_tuner.h"
+#include "executor.h"
+#include "execution_object.h"
+#include "binary_cache.h"
+#include "parameters.h"
+#include "trace.h"
+
+using namespace tidl;
+
+class PartitionTuner::Impl
+{
+    public:
+        Impl(const Configuration& configuration, uint32_t num_eves,
+             uint32_t num_dsps, uint32_t num_frames);
+
+        bool Run();
+
+        // Cost of a split: the slower of the two pipeline stages
+        double Cost(const StageTimes& t) const
+        {
+            return std::max(t.eve_ms / num_eves_m, t.dsp_ms / num_dsps_m);
+        }
+
+        std::map<int, int> Overrides(int partition_layer) const;
+        const StageTimes&  Profile(int partition_layer);
+
+        Configuration             configuration_m;
+        uint32_t                  num_eves_m;
+        uint32_t                  num_dsps_m;
+        uint32_t                  num_frames_m;
+
+        // layersGroupId assigned by the import tool, -1 for data layers
+        std::vector<int>          groups_m;
+        int                       partition_layer_m;
+        std::map<int, StageTimes> times_m;
+};
+
+PartitionTuner::PartitionTuner(const Configuration& configuration,
+                               uint32_t num_eves, uint32_t num_dsps,
+                               uint32_t num_frames)
+{
+    if (num_eves == 0 || num_dsps == 0 || num_frames == 0)
+        throw Exception("PartitionTuner requires EVEs, DSPs and frames",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    pimpl_m = std::unique_ptr<Impl>
+              { new Impl(configuration, num_eves, num_dsps, num_frames) };
+}
+
+PartitionTuner::~PartitionTuner() = default;
+
+bool PartitionTuner::Run()
+{
+    return pimpl_m->Run();
+}
+
+int PartitionTuner::GetPartitionLayer() const
+{
+    return pimpl_m->partition_layer_m;
+}
+
+const std::map<int, PartitionTuner::StageTimes>&
+PartitionTuner::GetStageTimes() const
+{
+    return pimpl_m->times_m;
+}
+
+const Configuration& PartitionTuner::GetConfiguration() const
+{
+    return pimpl_m->configuration_m;
+}
+
+void PartitionTuner::WriteConfiguration(std::ostream& os) const
+{
+    const Configuration& c = pimpl_m->configuration_m;
+
+    os << "# Partition layer " << pimpl_m->partition_layer_m
+       << " for " << pimpl_m->num_eves_m << " EVE(s), "
+       << pimpl_m->num_dsps_m << " DSP(s)\n";
+    os << "layerIndex2LayerGroupId = {";
+    bool first = true;
+    for (const auto& item : c.layerIndex2LayerGroupId)
+    {
+        os << (first ? " " : ", ") << "{" << item.first << ", "
+           << item.second << "}";
+        first = false;
+    }
+    os << " }" << std::endl;
+}
+
+
+PartitionTuner::Impl::Impl(const Configuration& configuration,
+                           uint32_t num_eves, uint32_t num_dsps,
+                           uint32_t num_frames):
+    configuration_m(configuration), num_eves_m(num_eves),
+    num_dsps_m(num_dsps), num_frames_m(num_frames), partition_layer_m(-1)
+{
+    configuration_m.runFullNet = false;
+    configuration_m.layerIndex2LayerGroupId.clear();
+
+    BinaryCache::NetworkPtr net =
+                            BinaryCache::GetNetwork(configuration.netBinFile);
+    if (net == nullptr)
+        throw Exception("Failed to read network binary " +
+                        configuration.netBinFile,
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    for (int i = 0; i < net->numLayers; i++)
+        groups_m.push_back(net->TIDLLayers[i].layerType == TIDL_DataLayer ?
+                           -1 : net->TIDLLayers[i].layersGroupId);
+}
+
+// Move layers in layersGroupId 1 at or above partition_layer to
+// layersGroupId 2
+std::map<int, int> PartitionTuner::Impl::Overrides(int partition_layer) const
+{
+    std::map<int, int> overrides;
+    for (int i = partition_layer; i < (int) groups_m.size(); i++)
+        if (groups_m[i] == 1)
+            overrides[i] = 2;
+
+    return overrides;
+}
+
+// Run num_frames_m frames through the EVE and DSP stages of a split and
+// record the average time of each stage. The first frame is not timed.
+const PartitionTuner::StageTimes&
+PartitionTuner::Impl::Profile(int partition_layer)
+{
+    auto it = times_m.find(partition_layer);
+    if (it != times_m.end())  return it->second;
+
+    Configuration c = configuration_m;
+    c.layerIndex2LayerGroupId = Overrides(partition_layer);
+
+    DeviceIds ids = {DeviceId::ID0};
+    auto f_eve = Executor::CreateAsync(DeviceType::EVE, ids, c, 1);
+    auto f_dsp = Executor::CreateAsync(DeviceType::DSP, ids, c, 2);
+    std::unique_ptr<Executor> e_eve = f_eve.get();
+    std::unique_ptr<Executor> e_dsp = f_dsp.get();
+
+    ExecutionObject* eo1 = (*e_eve)[0];
+    ExecutionObject* eo2 = (*e_dsp)[0];
+
+    std::vector<char> in (eo1->GetInputBufferSizeInBytes(), 0);
+    std::vector<char> mid(eo1->GetOutputBufferSizeInBytes(), 0);
+    std::vector<char> out(eo2->GetOutputBufferSizeInBytes(), 0);
+    eo1->SetInputOutputBuffer(ArgInfo(in.data(),  in.size()),
+                              ArgInfo(mid.data(), mid.size()));
+    eo2->SetInputOutputBuffer(ArgInfo(mid.data(), mid.size()),
+                              ArgInfo(out.data(), out.size()));
+
+    typedef std::chrono::steady_clock clock;
+    std::chrono::duration<double, std::milli> eve_ms(0), dsp_ms(0);
+    for (uint32_t i = 0; i <= num_frames_m; i++)
+    {
+        auto t0 = clock::now();
+        eo1->ProcessFrameStartAsync();
+        eo1->ProcessFrameWait();
+        auto t1 = clock::now();
+        eo2->ProcessFrameStartAsync();
+        eo2->ProcessFrameWait();
+        auto t2 = clock::now();
+
+        if (i == 0)  continue;
+        eve_ms += t1 - t0;
+        dsp_ms += t2 - t1;
+    }
+
+    StageTimes& t = times_m[partition_layer];
+    t.eve_ms = eve_ms.count() / num_frames_m;
+    t.dsp_ms = dsp_ms.count() / num_frames_m;
+
+    TRACE::print("PartitionTuner: layer %d, EVE %.3f ms, DSP %.3f ms\n",
+                 partition_layer, t.eve_ms, t.dsp_ms);
+
+    return t;
+}
+
+bool PartitionTuner::Impl::Run()
+{
+    // Candidates range from keeping a single layer on EVE to the split
+    // produced by the import tool. Only layers are moved from EVE to DSP,
+    // the DSP supports all layer types.
+    int first_eve_layer = -1;
+    int last_eve_layer  = -1;
+    bool has_dsp_layers = false;
+    for (int i = 0; i < (int) groups_m.size(); i++)
+    {
+        if (groups_m[i] == 1)
+        {
+            if (first_eve_layer < 0)  first_eve_layer = i;
+            last_eve_layer = i;
+        }
+        else if (groups_m[i] == 2)
+            has_dsp_layers = true;
+    }
+
+    if (first_eve_layer < 0 || !has_dsp_layers)
+        return false;
+
+    int lo = first_eve_layer + 1;
+    int hi = last_eve_layer  + 1;
+
+    // The EVE stage gets slower and the DSP stage faster as the partition
+    // layer increases. Find the first candidate where the EVE stage is the
+    // bottleneck; the balanced split is that or the previous candidate.
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        const StageTimes& t = Profile(mid);
+        if (t.eve_ms / num_eves_m >= t.dsp_ms / num_dsps_m)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    partition_layer_m = lo;
+    if (lo > first_eve_layer + 1 &&
+        Cost(Profile(lo - 1)) < Cost(Profile(lo)))
+        partition_layer_m = lo - 1;
+
+    configuration_m.layerIndex2LayerGroupId = Overrides(partition_layer_m);
+    return true;
+}
@@ -0,0 +1,265 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file pipeline_depth_controller.cpp */
+
+#include <chrono>
+#include <algorithm>
+
+#include "pipeline_depth_controller.h"
+#include "metrics.h"
+#include "executor.h"
+
+using namespace tidl;
+
+// A level is kept if it raises the throughput by this fraction
+static const float GAIN           = 0.05f;
+
+// Busy percentage at which adding frames in flight cannot help
+static const float BUSY_SATURATED = 95.0f;
+
+// Intervals to stay at a depth after a move was reverted
+static const uint32_t HOLD_INTERVALS = 10;
+
+class PipelineDepthController::Impl
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        enum class Move { NONE, UP, DOWN };
+
+        Impl(const std::vector<ExecutionObjectPipeline*>& eops,
+             uint32_t eops_per_level, Goal goal, float min_fps,
+             uint32_t interval_ms);
+
+        bool     Update();
+        uint32_t Decide();
+        uint32_t DecideMaxThroughput();
+        uint32_t DecideMinLatency();
+        void     Collect(uint64_t& completed, float& busy) const;
+
+        std::vector<ExecutionObjectPipeline*> eops_m;
+        const uint32_t                 eops_per_level_m;
+        const uint32_t                 max_depth_m;
+        const Goal                     goal_m;
+        const float                    min_fps_m;
+        const Clock::duration          interval_m;
+
+        uint32_t                       depth_m;
+        Clock::time_point              start_m;
+        uint64_t                       start_completed_m;
+        bool                           settling_m;
+        float                          fps_m;
+        float                          busy_m;
+
+        // Throughput last measured at each depth
+        std::vector<float>             depth_fps_m;
+        Move                           last_move_m;
+        uint32_t                       hold_m;
+};
+
+PipelineDepthController::PipelineDepthController(
+                        const std::vector<ExecutionObjectPipeline*>& eops,
+                        uint32_t eops_per_level, Goal goal,
+                        float min_fps, uint32_t interval_ms):
+    pimpl_m(new Impl(eops, eops_per_level, goal, min_fps, interval_ms))
+{
+}
+
+PipelineDepthController::~PipelineDepthController() = default;
+
+PipelineDepthController::Impl::Impl(
+                        const std::vector<ExecutionObjectPipeline*>& eops,
+                        uint32_t eops_per_level, Goal goal, float min_fps,
+                        uint32_t interval_ms):
+    eops_m(eops), eops_per_level_m(eops_per_level),
+    max_depth_m(eops_per_level == 0 ? 0 : eops.size() / eops_per_level),
+    goal_m(goal), min_fps_m(min_fps),
+    interval_m(std::chrono::milliseconds(interval_ms)),
+    depth_m(max_depth_m), start_m(Clock::now()), start_completed_m(0),
+    settling_m(true), fps_m(0), busy_m(0),
+    depth_fps_m(max_depth_m + 2, 0), last_move_m(Move::NONE), hold_m(0)
+{
+    if (max_depth_m == 0 || eops.size() % eops_per_level != 0)
+        throw Exception("Number of EOPs must be a non-zero multiple of "
+                        "eops_per_level", __FILE__, __FUNCTION__, __LINE__);
+}
+
+void PipelineDepthController::Impl::Collect(uint64_t& completed,
+                                            float& busy) const
+{
+    completed = 0;
+    busy      = 0;
+    for (uint32_t i = 0; i < eops_m.size(); i++)
+    {
+        Metrics m = eops_m[i]->GetMetrics();
+        completed += m.framesCompleted;
+        if (i < depth_m * eops_per_level_m)
+            busy = std::max(busy, m.deviceBusyPercent);
+    }
+}
+
+bool PipelineDepthController::Impl::Update()
+{
+    Clock::time_point now = Clock::now();
+    if (now - start_m < interval_m)
+        return false;
+
+    uint64_t completed;
+    float    busy;
+    Collect(completed, busy);
+
+    // The interval after a move includes frames started at the previous
+    // depth, it is not measured
+    if (settling_m)
+    {
+        settling_m        = false;
+        start_m           = now;
+        start_completed_m = completed;
+        return false;
+    }
+
+    // Wait for a frame per enabled EOP to measure the depth
+    uint64_t frames = completed - start_completed_m;
+    if (frames < depth_m * eops_per_level_m)
+        return false;
+
+    std::chrono::duration<float> elapsed = now - start_m;
+    fps_m             = frames / elapsed.count();
+    busy_m            = busy;
+    start_m           = now;
+    start_completed_m = completed;
+
+    uint32_t depth = Decide();
+    if (depth == depth_m)
+        return false;
+
+    depth_m    = depth;
+    settling_m = true;
+    return true;
+}
+
+uint32_t PipelineDepthController::Impl::Decide()
+{
+    depth_fps_m[depth_m] = fps_m;
+    return goal_m == Goal::MAX_THROUGHPUT ? DecideMaxThroughput() :
+                                            DecideMinLatency();
+}
+
+uint32_t PipelineDepthController::Impl::DecideMaxThroughput()
+{
+    Move last   = last_move_m;
+    last_move_m = Move::NONE;
+
+    // Revert a level that did not pay off, keep a parked level parked if
+    // the throughput held
+    if (last == Move::UP && fps_m < depth_fps_m[depth_m - 1] * (1 + GAIN))
+    {
+        hold_m = HOLD_INTERVALS;
+        return depth_m - 1;
+    }
+    if (last == Move::DOWN)
+    {
+        hold_m = HOLD_INTERVALS;
+        if (fps_m < depth_fps_m[depth_m + 1] * (1 - GAIN))
+            return depth_m + 1;
+        return depth_m;
+    }
+
+    if (hold_m > 0)
+    {
+        hold_m--;
+        return depth_m;
+    }
+
+    // Probe a level up while the devices have spare cycles, else probe
+    // whether the last level still contributes
+    if (depth_m < max_depth_m && busy_m < BUSY_SATURATED)
+    {
+        last_move_m = Move::UP;
+        return depth_m + 1;
+    }
+    if (depth_m > 1)
+    {
+        last_move_m = Move::DOWN;
+        return depth_m - 1;
+    }
+    return depth_m;
+}
+
+uint32_t PipelineDepthController::Impl::DecideMinLatency()
+{
+    Move last   = last_move_m;
+    last_move_m = Move::NONE;
+
+    if (fps_m < min_fps_m)
+    {
+        // Hold at the restored depth if parking a level missed the target
+        if (last == Move::DOWN)
+            hold_m = HOLD_INTERVALS;
+        return std::min(depth_m + 1, max_depth_m);
+    }
+
+    if (hold_m > 0)
+    {
+        hold_m--;
+        return depth_m;
+    }
+
+    if (depth_m > 1)
+    {
+        last_move_m = Move::DOWN;
+        return depth_m - 1;
+    }
+    return depth_m;
+}
+
+bool PipelineDepthController::Update()
+{
+    return pimpl_m->Update();
+}
+
+bool PipelineDepthController::IsEnabled(uint32_t index) const
+{
+    return index < pimpl_m->depth_m * pimpl_m->eops_per_level_m;
+}
+
+uint32_t PipelineDepthController::GetDepth() const
+{
+    return pimpl_m->depth_m;
+}
+
+uint32_t PipelineDepthController::GetMaxDepth() const
+{
+    return pimpl_m->max_depth_m;
+}
+
+float PipelineDepthController::GetFps() const
+{
+    return pimpl_m->fps_m;
+}
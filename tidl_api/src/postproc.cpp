@@ -0,0 +1,421 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file postproc.cpp */
+
+#include <algorithm>
+#include <cmath>
+#include "postproc.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TIDL_POSTPROC_NEON
+#endif
+
+using namespace tidl;
+using namespace tidl::postproc;
+
+// Widen 16 values at a time to 32 bits, convert and scale. The scale is
+// computed once, the loop has no division.
+void postproc::Dequantize(const void *data, int size, int dataQ,
+                          bool is_signed, float *out)
+{
+    const float scale = dataQ != 0 ? 256.0f / dataQ : 0.0f;
+    int i = 0;
+
+    if (is_signed)
+    {
+        const int8_t *in = (const int8_t *) data;
+#ifdef TIDL_POSTPROC_NEON
+        for (; i + 16 <= size; i += 16)
+        {
+            int8x16_t v  = vld1q_s8(in + i);
+            int16x8_t lo = vmovl_s8(vget_low_s8(v));
+            int16x8_t hi = vmovl_s8(vget_high_s8(v));
+            int32x4_t w[4] = { vmovl_s16(vget_low_s16(lo)),
+                               vmovl_s16(vget_high_s16(lo)),
+                               vmovl_s16(vget_low_s16(hi)),
+                               vmovl_s16(vget_high_s16(hi)) };
+            for (int j = 0; j < 4; j++)
+                vst1q_f32(out + i + 4 * j,
+                          vmulq_n_f32(vcvtq_f32_s32(w[j]), scale));
+        }
+#endif
+        for (; i < size; i++)
+            out[i] = in[i] * scale;
+        return;
+    }
+
+    const uint8_t *in = (const uint8_t *) data;
+#ifdef TIDL_POSTPROC_NEON
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v  = vld1q_u8(in + i);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        uint32x4_t w[4] = { vmovl_u16(vget_low_u16(lo)),
+                            vmovl_u16(vget_high_u16(lo)),
+                            vmovl_u16(vget_low_u16(hi)),
+                            vmovl_u16(vget_high_u16(hi)) };
+        for (int j = 0; j < 4; j++)
+            vst1q_f32(out + i + 4 * j,
+                      vmulq_n_f32(vcvtq_f32_u32(w[j]), scale));
+    }
+#endif
+    for (; i < size; i++)
+        out[i] = in[i] * scale;
+}
+
+// The k-th largest score is found from a histogram of the scores, a
+// vectorized pass then only visits blocks with a candidate. Only the
+// candidates are sorted.
+void postproc::TopK(const uint8_t *scores, int size, int k,
+                    std::vector<ScoreIndex>& sorted)
+{
+    sorted.clear();
+    if (size <= 0 || k <= 0)  return;
+    k = std::min(k, size);
+
+    int histogram[256] = { 0 };
+    for (int i = 0; i < size; i++)
+        histogram[scores[i]]++;
+
+    int threshold = 255;
+    int count     = histogram[threshold];
+    while (count < k)
+        count += histogram[--threshold];
+
+    // All scores above the threshold are in the top k, scores equal to it
+    // are taken in index order
+    int num_equal = k - (count - histogram[threshold]);
+    sorted.reserve(k);
+    auto collect = [&](int i)
+    {
+        if (scores[i] > threshold)
+            sorted.emplace_back(scores[i], i);
+        else if (scores[i] == threshold && num_equal > 0)
+        {
+            sorted.emplace_back(scores[i], i);
+            num_equal--;
+        }
+    };
+
+    int i = 0;
+#ifdef TIDL_POSTPROC_NEON
+    uint8x16_t t = vdupq_n_u8(threshold);
+    for (; i + 16 <= size; i += 16)
+    {
+        uint64x2_t ge = vreinterpretq_u64_u8(vcgeq_u8(vld1q_u8(scores + i),
+                                                      t));
+        if ((vgetq_lane_u64(ge, 0) | vgetq_lane_u64(ge, 1)) == 0)
+            continue;
+
+        for (int j = i; j < i + 16; j++)
+            collect(j);
+    }
+#endif
+    for (; i < size; i++)
+        collect(i);
+
+    std::sort(sorted.begin(), sorted.end(),
+              [](const ScoreIndex& a, const ScoreIndex& b)
+              { return a.first < b.first ||
+                       (a.first == b.first && a.second > b.second); });
+}
+
+void postproc::DecodeBoxes(const float *out, int num_floats, int width,
+                           int height, float confidence_value,
+                           std::vector<DetectedObject>& objects)
+{
+    objects.clear();
+    for (int i = 0; i < num_floats / 7; i++)
+    {
+        const float *o = out + i * 7;
+        if (o[0] < 0)  break;
+
+        float score = o[2];
+        if (score * 100 < confidence_value)  continue;
+
+        DetectedObject object;
+        object.label = (int)  o[1];
+        object.score = score;
+        object.xmin  = (int) (o[3] * width);
+        object.ymin  = (int) (o[4] * height);
+        object.xmax  = (int) (o[5] * width);
+        object.ymax  = (int) (o[6] * height);
+        objects.push_back(object);
+    }
+}
+
+// Boxes are compared in structure of arrays form, 4 at a time with NEON.
+// An overlap is tested as intersection > max_iou * union, without a division.
+void postproc::SuppressOverlaps(std::vector<DetectedObject>& objects,
+                                float max_iou)
+{
+    std::stable_sort(objects.begin(), objects.end(),
+                     [](const DetectedObject& a, const DetectedObject& b)
+                     { return a.score > b.score; });
+
+    int n = objects.size();
+    std::vector<float>   x0(n), y0(n), x1(n), y1(n), area(n);
+    std::vector<int32_t> label(n);
+    std::vector<uint8_t> keep(n, 1);
+    for (int i = 0; i < n; i++)
+    {
+        const DetectedObject& o = objects[i];
+        x0[i]    = o.xmin;
+        y0[i]    = o.ymin;
+        x1[i]    = o.xmax;
+        y1[i]    = o.ymax;
+        area[i]  = std::max(0, o.xmax - o.xmin) *
+                   std::max(0, o.ymax - o.ymin);
+        label[i] = o.label;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (!keep[i])  continue;
+
+        int j = i + 1;
+#ifdef TIDL_POSTPROC_NEON
+        float32x4_t ix0 = vdupq_n_f32(x0[i]), iy0 = vdupq_n_f32(y0[i]);
+        float32x4_t ix1 = vdupq_n_f32(x1[i]), iy1 = vdupq_n_f32(y1[i]);
+        float32x4_t iarea = vdupq_n_f32(area[i]);
+        float32x4_t iou   = vdupq_n_f32(max_iou);
+        float32x4_t zero  = vdupq_n_f32(0);
+        int32x4_t   ilabel = vdupq_n_s32(label[i]);
+        for (; j + 4 <= n; j += 4)
+        {
+            float32x4_t w = vsubq_f32(vminq_f32(ix1, vld1q_f32(&x1[j])),
+                                      vmaxq_f32(ix0, vld1q_f32(&x0[j])));
+            float32x4_t h = vsubq_f32(vminq_f32(iy1, vld1q_f32(&y1[j])),
+                                      vmaxq_f32(iy0, vld1q_f32(&y0[j])));
+            float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero),
+                                          vmaxq_f32(h, zero));
+            float32x4_t uni   = vsubq_f32(vaddq_f32(iarea,
+                                                    vld1q_f32(&area[j])),
+                                          inter);
+            uint32x4_t  mask  = vandq_u32(
+                                    vcgtq_f32(inter, vmulq_f32(iou, uni)),
+                                    vceqq_s32(ilabel,
+                                              vld1q_s32(&label[j])));
+            uint32_t suppress[4];
+            vst1q_u32(suppress, mask);
+            for (int l = 0; l < 4; l++)
+                if (suppress[l])  keep[j + l] = 0;
+        }
+#endif
+        for (; j < n; j++)
+        {
+            float w = std::min(x1[i], x1[j]) - std::max(x0[i], x0[j]);
+            float h = std::min(y1[i], y1[j]) - std::max(y0[i], y0[j]);
+            float inter = std::max(w, 0.0f) * std::max(h, 0.0f);
+            float uni   = area[i] + area[j] - inter;
+            if (label[i] == label[j] && inter > max_iou * uni)
+                keep[j] = 0;
+        }
+    }
+
+    int num_kept = 0;
+    for (int i = 0; i < n; i++)
+        if (keep[i])  objects[num_kept++] = objects[i];
+    objects.resize(num_kept);
+}
+
+// Up to 32 colors, a NEON table lookup maps 8 pixels per channel at once
+void postproc::ColorizeClasses(const uint8_t *classes, int size,
+                               const std::vector<Color>& colors,
+                               Color unknown, uint8_t *blue, uint8_t *green,
+                               uint8_t *red)
+{
+    uint8_t lut[3][256];
+    for (int c = 0; c < 256; c++)
+    {
+        const Color& color = c < (int) colors.size() ? colors[c] : unknown;
+        lut[0][c] = color.blue;
+        lut[1][c] = color.green;
+        lut[2][c] = color.red;
+    }
+
+    int i = 0;
+#ifdef TIDL_POSTPROC_NEON
+    if (colors.size() <= 32)
+    {
+        uint8x8x4_t tb, tg, tr;
+        for (int t = 0; t < 4; t++)
+        {
+            tb.val[t] = vld1_u8(&lut[0][t * 8]);
+            tg.val[t] = vld1_u8(&lut[1][t * 8]);
+            tr.val[t] = vld1_u8(&lut[2][t * 8]);
+        }
+        uint8x8_t num = vdup_n_u8(colors.size());
+        uint8x8_t ub  = vdup_n_u8(unknown.blue);
+        uint8x8_t ug  = vdup_n_u8(unknown.green);
+        uint8x8_t ur  = vdup_n_u8(unknown.red);
+        for (; i + 8 <= size; i += 8)
+        {
+            uint8x8_t c     = vld1_u8(classes + i);
+            uint8x8_t known = vclt_u8(c, num);
+            vst1_u8(blue  + i, vbsl_u8(known, vtbl4_u8(tb, c), ub));
+            vst1_u8(green + i, vbsl_u8(known, vtbl4_u8(tg, c), ug));
+            vst1_u8(red   + i, vbsl_u8(known, vtbl4_u8(tr, c), ur));
+        }
+    }
+#endif
+    for (; i < size; i++)
+    {
+        blue[i]  = lut[0][classes[i]];
+        green[i] = lut[1][classes[i]];
+        red[i]   = lut[2][classes[i]];
+    }
+}
+
+// Class colors and blend weights shared by the rows of BlendClasses
+struct Overlay
+{
+    uint8_t  lut[3][256];
+    uint16_t weight;        // of the class colors, out of 255
+    uint16_t inverse;       // of the image, 255 - weight
+    int      num_colors;
+};
+
+// Rounded x / 255, for x up to 255 * 255
+static inline uint8_t DivideBy255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Blend a row of n pixels. The image row is interleaved BGR, or three
+// planes plane_size apart. Up to 32 colors are looked up with vtbl4.
+template<bool Interleaved>
+static void BlendRow(const uint8_t *classes, const uint8_t *image,
+                     int plane_size, int n, const Overlay& o, uint8_t *out)
+{
+    int i = 0;
+#ifdef TIDL_POSTPROC_NEON
+    if (o.num_colors <= 32)
+    {
+        uint8x8x4_t table[3];
+        uint8x8_t   unknown[3];
+        for (int k = 0; k < 3; k++)
+        {
+            for (int t = 0; t < 4; t++)
+                table[k].val[t] = vld1_u8(&o.lut[k][t * 8]);
+            unknown[k] = vdup_n_u8(o.lut[k][o.num_colors]);
+        }
+        uint8x8_t  num     = vdup_n_u8(o.num_colors);
+        uint8x8_t  weight  = vdup_n_u8(o.weight);
+        uint8x8_t  inverse = vdup_n_u8(o.inverse);
+        uint16x8_t half    = vdupq_n_u16(128);
+        for (; i + 8 <= n; i += 8)
+        {
+            uint8x8_t c     = vld1_u8(classes + i);
+            uint8x8_t known = vclt_u8(c, num);
+
+            uint8x8x3_t px;
+            if (Interleaved)
+                px = vld3_u8(image + 3 * i);
+            else
+                for (int k = 0; k < 3; k++)
+                    px.val[k] = vld1_u8(image + k * plane_size + i);
+
+            uint8x8x3_t blend;
+            for (int k = 0; k < 3; k++)
+            {
+                uint8x8_t color = vbsl_u8(known, vtbl4_u8(table[k], c),
+                                          unknown[k]);
+                uint16x8_t s = vmull_u8(px.val[k], inverse);
+                s = vaddq_u16(vmlal_u8(s, color, weight), half);
+                blend.val[k] = vshrn_n_u16(vsraq_n_u16(s, s, 8), 8);
+            }
+            vst3_u8(out + 3 * i, blend);
+        }
+    }
+#endif
+    for (; i < n; i++)
+        for (int k = 0; k < 3; k++)
+        {
+            uint8_t p = Interleaved ? image[3 * i + k]
+                                    : image[k * plane_size + i];
+            out[3 * i + k] = DivideBy255(p * o.inverse +
+                                         o.lut[k][classes[i]] * o.weight);
+        }
+}
+
+// At full resolution the image is blended in place. Downscaled, each
+// output row is first gathered from the sampled pixels.
+void postproc::BlendClasses(const uint8_t *classes, int width, int height,
+                            const uint8_t *image, bool planar,
+                            const std::vector<Color>& colors, Color unknown,
+                            float alpha, int factor, uint8_t *out)
+{
+    if (width <= 0 || height <= 0 || factor < 1)  return;
+
+    Overlay o;
+    for (int c = 0; c < 256; c++)
+    {
+        const Color& color = c < (int) colors.size() ? colors[c] : unknown;
+        o.lut[0][c] = color.blue;
+        o.lut[1][c] = color.green;
+        o.lut[2][c] = color.red;
+    }
+    alpha        = std::min(1.0f, std::max(0.0f, alpha));
+    o.weight     = std::lround(alpha * 255);
+    o.inverse    = 255 - o.weight;
+    o.num_colors = std::min((int) colors.size(), 256);
+
+    int plane_size = width * height;
+    if (factor == 1)
+    {
+        if (planar)
+            BlendRow<false>(classes, image, plane_size, plane_size, o, out);
+        else
+            BlendRow<true>(classes, image, 0, plane_size, o, out);
+        return;
+    }
+
+    int out_width  = width  / factor;
+    int out_height = height / factor;
+    std::vector<uint8_t> row_classes(out_width);
+    std::vector<uint8_t> row_planes(3 * out_width);
+    for (int y = 0; y < out_height; y++)
+    {
+        for (int x = 0; x < out_width; x++)
+        {
+            int idx = (y * width + x) * factor;
+            row_classes[x] = classes[idx];
+            for (int k = 0; k < 3; k++)
+                row_planes[k * out_width + x] =
+                         planar ? image[k * plane_size + idx]
+                                : image[3 * idx + k];
+        }
+        BlendRow<false>(row_classes.data(), row_planes.data(), out_width,
+                        out_width, o, out + 3 * y * out_width);
+    }
+}
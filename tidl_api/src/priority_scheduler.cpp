@@ -0,0 +1,273 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file priority_scheduler.cpp */
+
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "priority_scheduler.h"
+#include "run_frame.h"
+#include "trace.h"
+
+using namespace tidl;
+
+// Network added to the scheduler: its ExecutionObjects, keyed by device
+struct ScheduledNetwork
+{
+    int                                     priority;
+    PriorityScheduler::CompletionCallback   on_complete;
+    std::map<std::string, ExecutionObject*> eos;
+};
+
+// Frame waiting for a device
+struct PendingFrame
+{
+    int                                  network;
+    FrameDescriptor                      frame;
+    PriorityScheduler::Clock::time_point deadline;
+    uint64_t                             seq;
+};
+
+class PriorityScheduler::Impl
+{
+    public:
+        Impl(bool drop_expired);
+        ~Impl();
+
+        int  AddNetwork(const std::vector<ExecutionObject*>& eos,
+                        int priority, CompletionCallback on_complete);
+        void Submit(int network, const FrameDescriptor& frame,
+                    Clock::time_point deadline);
+        void Drain();
+
+        void WorkerLoop(std::string device);
+
+        bool Precedes(const PendingFrame& a, const PendingFrame& b) const;
+        int  SelectFrame(const std::string& device) const;
+
+        bool                          drop_expired_m;
+
+        std::vector<ScheduledNetwork> networks_m;
+        std::vector<PendingFrame>     pending_m;
+        uint64_t                      next_seq_m;
+        uint32_t                      num_submitted_m;
+        uint32_t                      num_completed_m;
+        uint32_t                      num_failed_m;
+        uint32_t                      num_expired_m;
+        bool                          stop_m;
+
+        // Guards networks_m, pending_m, the counters and stop_m
+        mutable std::mutex          mutex_m;
+        std::condition_variable     cv_work_m;   // frame submitted or stop
+        std::condition_variable     cv_done_m;   // frame completed
+
+        // One worker per device. A worker starts the next frame on its
+        // device as soon as the previous frame has completed.
+        std::map<std::string, std::thread> workers_m;
+};
+
+
+PriorityScheduler::PriorityScheduler(bool drop_expired):
+    pimpl_m(new Impl(drop_expired))
+{}
+
+PriorityScheduler::~PriorityScheduler() = default;
+
+int PriorityScheduler::AddNetwork(const std::vector<ExecutionObject*>& eos,
+                                  int priority, CompletionCallback on_complete)
+{
+    return pimpl_m->AddNetwork(eos, priority, on_complete);
+}
+
+void PriorityScheduler::Submit(int network, const FrameDescriptor& frame,
+                               Clock::time_point deadline)
+{
+    pimpl_m->Submit(network, frame, deadline);
+}
+
+void PriorityScheduler::Drain()
+{
+    pimpl_m->Drain();
+}
+
+uint32_t PriorityScheduler::GetNumFramesCompleted() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_completed_m;
+}
+
+uint32_t PriorityScheduler::GetNumFramesFailed() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_failed_m;
+}
+
+uint32_t PriorityScheduler::GetNumFramesExpired() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_expired_m;
+}
+
+
+PriorityScheduler::Impl::Impl(bool drop_expired):
+    drop_expired_m(drop_expired), next_seq_m(0),
+    num_submitted_m(0), num_completed_m(0), num_failed_m(0),
+    num_expired_m(0), stop_m(false)
+{}
+
+PriorityScheduler::Impl::~Impl()
+{
+    Drain();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_work_m.notify_all();
+
+    for (auto& w : workers_m)
+        w.second.join();
+}
+
+int PriorityScheduler::Impl::AddNetwork(
+                                    const std::vector<ExecutionObject*>& eos,
+                                    int priority,
+                                    CompletionCallback on_complete)
+{
+    if (eos.empty())
+        throw Exception("PriorityScheduler network requires at least one "
+                        "ExecutionObject", __FILE__, __FUNCTION__, __LINE__);
+
+    ScheduledNetwork n;
+    n.priority    = priority;
+    n.on_complete = on_complete;
+    for (auto eo : eos)
+        if (!n.eos.emplace(eo->GetDeviceName(), eo).second)
+            throw Exception("PriorityScheduler network has multiple "
+                            "ExecutionObjects on " + eo->GetDeviceName(),
+                            __FILE__, __FUNCTION__, __LINE__);
+
+    std::lock_guard<std::mutex> lock(mutex_m);
+    networks_m.push_back(n);
+
+    // Start a worker for each device not used by a previous network
+    for (const auto& item : n.eos)
+        if (workers_m.find(item.first) == workers_m.end())
+            workers_m.emplace(item.first,
+                              std::thread(&PriorityScheduler::Impl::WorkerLoop,
+                                          this, item.first));
+
+    return networks_m.size() - 1;
+}
+
+void PriorityScheduler::Impl::Submit(int network, const FrameDescriptor& frame,
+                                     Clock::time_point deadline)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (network < 0 || network >= (int) networks_m.size())
+            throw Exception("Invalid PriorityScheduler network",
+                            __FILE__, __FUNCTION__, __LINE__);
+
+        pending_m.push_back(PendingFrame{network, frame, deadline,
+                                         next_seq_m++});
+        num_submitted_m++;
+    }
+    cv_work_m.notify_all();
+}
+
+void PriorityScheduler::Impl::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_done_m.wait(lock, [this]{ return num_completed_m == num_submitted_m; });
+}
+
+// Higher priority first, then earliest deadline, then submission order
+bool PriorityScheduler::Impl::Precedes(const PendingFrame& a,
+                                       const PendingFrame& b) const
+{
+    int pa = networks_m[a.network].priority;
+    int pb = networks_m[b.network].priority;
+    if (pa != pb)  return pa > pb;
+    if (a.deadline != b.deadline)  return a.deadline < b.deadline;
+    return a.seq < b.seq;
+}
+
+// Index of the pending frame to run next on device, -1 if none
+int PriorityScheduler::Impl::SelectFrame(const std::string& device) const
+{
+    int best = -1;
+    for (int i = 0; i < (int) pending_m.size(); i++)
+    {
+        const ScheduledNetwork& n = networks_m[pending_m[i].network];
+        if (n.eos.find(device) == n.eos.end())
+            continue;
+        if (best < 0 || Precedes(pending_m[i], pending_m[best]))
+            best = i;
+    }
+
+    return best;
+}
+
+void PriorityScheduler::Impl::WorkerLoop(std::string device)
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        int i;
+        cv_work_m.wait(lock, [this, &device, &i]
+                       { i = SelectFrame(device); return stop_m || i >= 0; });
+        if (i < 0)
+            break;
+
+        PendingFrame p = pending_m[i];
+        pending_m.erase(pending_m.begin() + i);
+        ExecutionObject*   eo          = networks_m[p.network].eos[device];
+        CompletionCallback on_complete = networks_m[p.network].on_complete;
+        lock.unlock();
+
+        const FrameDescriptor& frame = p.frame;
+        bool status  = false;
+        bool expired = drop_expired_m && Clock::now() > p.deadline;
+        if (!expired)
+            status = RunFrame(*eo, frame, "PriorityScheduler");
+
+        NotifyFrame(on_complete, frame, *eo, status, "PriorityScheduler");
+
+        lock.lock();
+        num_completed_m++;
+        if (expired)       num_expired_m++;
+        else if (!status)  num_failed_m++;
+        lock.unlock();
+        cv_done_m.notify_all();
+    }
+}
@@ -50,3 +50,21 @@ using namespace pybind11;
 void init_configuration(module &m);
 void init_eo(module &m);
 void init_eop(module &m);
+
+void SetInputOutputArrays(EO* eo, buffer in, buffer out);
+void SetInputOutputArrays(EO* eo, buffer in, list out);
+void SetInputOutputArrays(EOP* eop, buffer in, buffer out, object slot_idx);
+object ProcessFrame(EO* eo, object loop);
+object ProcessFrame(EOP* eop, object loop);
+
+// A traced layer output and a NumPy view of it, see get_layer_outputs
+struct LayerOutputArray
+{
+    LayerOutputView view;
+    object          array;
+};
+
+list   GetLayerOutputArrays(const ExecutionObjectInternalInterface& eo,
+                            object owner);
+object GetOutputArray(const EO& last_eo, char* out, uint32_t buffer_idx,
+                      object owner);
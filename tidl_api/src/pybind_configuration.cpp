@@ -45,6 +45,18 @@ void init_configuration(module &m)
         .def_readwrite("pre_proc_type", &Configuration::preProcType,
             "Pre-processing type applied to the input frame")
 
+        .def_readwrite("pre_proc_mean", &Configuration::preProcMean,
+            "Values subtracted from each channel of the input frame.\n"
+            "Empty uses the mean of pre_proc_type")
+
+        .def_readwrite("pre_proc_scale", &Configuration::preProcScale,
+            "Factors the mean-subtracted channels are multiplied by")
+
+        .def_readwrite("pre_proc_crop_factor",
+                       &Configuration::preProcCropFactor,
+            "Fraction of the frame kept by the center crop before resizing.\n"
+            "0 uses the crop of pre_proc_type")
+
         .def_readwrite("run_full_net", &Configuration::runFullNet,
             "Force to run all layers, regardless of layersGroupId partitioning")
 
@@ -54,6 +66,12 @@ void init_configuration(module &m)
         .def_readwrite("parameter_binary", &Configuration::paramsBinFile,
             "Path to the TIDL parameter binary file")
 
+        .def_readwrite("param_heap_cache_file",
+                       &Configuration::paramHeapCacheFile,
+            "Path to a parameter heap snapshot file. If set, the populated\n"
+            "parameter heap is saved after setup and restored by subsequent\n"
+            "Executors to skip the setup step on the device")
+
         .def_readwrite("network_heap_size", &Configuration::NETWORK_HEAP_SIZE,
             "Size of the device side network heap\n"
             "This heap is used for allocating memory required to"
@@ -64,6 +82,15 @@ void init_configuration(module &m)
             "The size depends on the size of the parameter binary file.\n"
             "There is one parameter heap for each instance of Executor\n")
 
+        .def_readwrite("num_contexts", &Configuration::numContexts,
+            "Number of frames that can be in flight on an ExecutionObject.\n"
+            "Valid values are 1 to 4, default is 2")
+
+        .def_readwrite("wait_spin_us", &Configuration::waitSpinUs,
+            "Time in microseconds a wait for a frame polls the device\n"
+            "before blocking. Reduces the latency of small networks,\n"
+            "default is 0")
+
         .def_readwrite("enable_api_trace", &Configuration::enableApiTrace,
             "Debug - Set to True to generate a trace of host/device\n"
             "function calls")
@@ -71,10 +98,30 @@ void init_configuration(module &m)
         .def_readwrite("enable_layer_dump", &Configuration::enableOutputTrace,
             "Debug - Enable dump of output buffers associated with each layer")
 
+        .def_readwrite("output_trace_layers",
+                       &Configuration::outputTraceLayers,
+            "Indices of layers to trace when enable_layer_dump is set.\n"
+            "If empty, all layers are traced. Otherwise only the specified\n"
+            "layers are traced and external memory optimization is retained")
+
         .def_readwrite("show_heap_stats", &Configuration::showHeapStats,
             "Debug - Shows total size of PARAM and NETWORK heaps. Also \n"
             "shows bytes free after all allocations. Used to adjust heap sizes")
 
+        .def_readwrite("enable_work_counters",
+                       &Configuration::enableWorkCounters,
+            "Debug - Report the MACs and bytes of the layer group with the\n"
+            "timing of each frame")
+
+        .def_readwrite("auto_size_heaps", &Configuration::autoSizeHeaps,
+            "Measure the heap requirements with a setup pass and allocate\n"
+            "the PARAM and NETWORK heaps at the measured sizes")
+
+        .def_readwrite("load_group_params_only",
+                       &Configuration::loadGroupParamsOnly,
+            "Read only the parameters of layers in the layer group of the\n"
+            "Executor from the parameter binary")
+
         .def_readwrite("layer_index_to_layer_group_id",
                        &Configuration::layerIndex2LayerGroupId,
             "Map of layer index to layer group id. Used to override \n"
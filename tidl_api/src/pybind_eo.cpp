@@ -26,6 +26,7 @@
  *  THE POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
 
+#include <pybind11/chrono.h>
 #include "pybind_common.h"
 
 
@@ -34,6 +35,75 @@ PYBIND11_MAKE_OPAQUE(EO);
 // Class, method names follow PEP8, Style Guide for Python Code (Reference #3)
 void init_eo(module &m)
 {
+    class_<Metrics>(m, "Metrics")
+        .def_readonly("fps", &Metrics::fps)
+        .def_readonly("latency_p50_ms", &Metrics::latencyP50Ms)
+        .def_readonly("latency_p95_ms", &Metrics::latencyP95Ms)
+        .def_readonly("latency_p99_ms", &Metrics::latencyP99Ms)
+        .def_readonly("device_busy_percent", &Metrics::deviceBusyPercent)
+        .def_readonly("frames_in_flight", &Metrics::framesInFlight)
+        .def_readonly("max_frames_in_flight", &Metrics::maxFramesInFlight)
+        .def_readonly("frames_completed", &Metrics::framesCompleted)
+        .def_readonly("frames_failed", &Metrics::framesFailed)
+        .def_readonly("frames_dropped", &Metrics::framesDropped);
+
+    class_<StageTiming>(m, "StageTiming")
+        .def_readonly("layers_group_id", &StageTiming::layersGroupId)
+        .def_readonly("queue_wait_ms", &StageTiming::queueWaitMs,
+                      "Waiting for a free context of the ExecutionObject")
+        .def_readonly("copy_in_ms", &StageTiming::copyInMs,
+                      "Copying the input to device buffers")
+        .def_readonly("device_ms", &StageTiming::deviceMs,
+                      "Processing the network on the device")
+        .def_readonly("device_cycles", &StageTiming::deviceCycles,
+                      "Cycles reported by the device for the process call")
+        .def_readonly("copy_out_ms", &StageTiming::copyOutMs,
+                      "Copying the output from device buffers")
+        .def_readonly("macs", &StageTiming::macs,
+                      "MACs of the layer group, with enable_work_counters")
+        .def_readonly("param_bytes", &StageTiming::paramBytes,
+                      "Parameter bytes read, with enable_work_counters")
+        .def_readonly("activation_bytes", &StageTiming::activationBytes,
+                      "Activation bytes written, with enable_work_counters")
+        .def("__repr__",
+             [](const StageTiming& t)
+             {
+                std::stringstream ss;
+                ss << "<StageTiming: layers_group_id= " << t.layersGroupId
+                   << " queue_wait_ms= " << t.queueWaitMs
+                   << " copy_in_ms= " << t.copyInMs
+                   << " device_ms= " << t.deviceMs
+                   << " copy_out_ms= " << t.copyOutMs << ">";
+                return ss.str();
+             });
+
+    class_<LayerOutputArray>(m, "LayerOutput")
+        .def_property_readonly("layer_index",
+             [](const LayerOutputArray& o) { return o.view.LayerIndex(); })
+        .def_property_readonly("output_index",
+             [](const LayerOutputArray& o) { return o.view.OutputIndex(); })
+        .def_property_readonly("buffer_id",
+             [](const LayerOutputArray& o) { return o.view.BufferId(); })
+        .def_property_readonly("data_q",
+             [](const LayerOutputArray& o) { return o.view.DataQ(); })
+        .def_property_readonly("min_value",
+             [](const LayerOutputArray& o) { return o.view.MinValue(); })
+        .def_property_readonly("max_value",
+             [](const LayerOutputArray& o) { return o.view.MaxValue(); })
+        .def_readonly("array", &LayerOutputArray::array,
+                      "Read-only int8 NumPy view of the output in device\n"
+                      "memory, channels x height x width")
+        .def("__repr__",
+             [](const LayerOutputArray& o)
+             {
+                std::stringstream ss;
+                ss << "<LayerOutput: layer_index= " << o.view.LayerIndex()
+                   << " output_index= " << o.view.OutputIndex()
+                   << " shape= " << o.view.NumberOfChannels() << "x"
+                   << o.view.Height() << "x" << o.view.Width() << ">";
+                return ss.str();
+             });
+
     class_<EO>(m, "ExecutionObject")
         .def("get_input_buffer",
               [](const EO &eo)
@@ -57,20 +127,97 @@ void init_eo(module &m)
               "a Python object using the buffer protocol. This object can\n"
               "be specified as an argument to the write method")
 
+        .def("set_input_output_buffer",
+             (void (*)(EO*, buffer, buffer)) &SetInputOutputArrays,
+             "Use caller-owned buffers, e.g. NumPy arrays, as input and\n"
+             "output without copying. Buffers must be C-contiguous and at\n"
+             "least get_input_buffer_size()/get_output_buffer_size() bytes.\n"
+             "Buffers allocated with allocate_array are accessed by the\n"
+             "device in place. The buffers are referenced until replaced\n"
+             "or until free_memory is called",
+             arg("input"), arg("output"))
+
+        .def("set_input_output_buffers",
+             (void (*)(EO*, buffer, list)) &SetInputOutputArrays,
+             "Use caller-owned buffers as input and as each network output\n"
+             "buffer, without copying. Outputs whose buffer is None are not\n"
+             "copied. Output buffer i holds at least get_output_size(i)\n"
+             "bytes",
+             arg("input"), arg("outputs"))
+
+        .def("get_num_outputs", &EO::GetNumNetOutputs,
+             "Returns the number of network output buffers")
+
+        .def("get_output_size", &EO::GetNetOutputSizeInBytes,
+             "Returns the size of a network output buffer in bytes",
+             arg("buffer_idx"))
+
+        .def("set_output_mask", &EO::SetOutputMask,
+             "Select the network output buffers copied when a frame\n"
+             "completes, bit i for output buffer i")
+
+        .def("get_output_mask", &EO::GetOutputMask)
+
+        .def("get_input_buffer_size", &EO::GetInputBufferSizeInBytes,
+             "Returns the size of the input buffer in bytes")
+
+        .def("get_output_buffer_size", &EO::GetOutputBufferSizeInBytes,
+             "Returns the size of the output buffer in bytes")
+
+        .def("get_output_data_q", &EO::GetOutputDataQ,
+             "Returns the Q factor of an output buffer of the last frame.\n"
+             "float = value * 256 / Q. 0 if not known",
+             arg("buffer_idx")=0)
+
         .def("set_frame_index", &EO::SetFrameIndex,
              "Set the frame index of the frame currently processed.\n"
              "Used for trace/debug messages")
 
         .def("get_frame_index", &EO::GetFrameIndex)
 
-        .def("process_frame_start_async", &EO::ProcessFrameStartAsync,
+        .def("set_network_index", &EO::SetNetworkIndex,
+             "Select the network run by frames started on the\n"
+             "ExecutionObject, see Executor.add_network")
+
+        .def("get_network_index", &EO::GetNetworkIndex)
+
+        .def("get_num_networks", &EO::GetNumNetworks)
+
+        .def("process_frame_start_async",
+             (bool (EO::*)()) &EO::ProcessFrameStartAsync,
+             call_guard<gil_scoped_release>(),
              "Start processing a frame. The call is asynchronous and\n"
              "returns immediately")
 
         .def("process_frame_wait", &EO::ProcessFrameWait,
+             call_guard<gil_scoped_release>(),
              "Wait for the executor pipeline to complete processing a frame\n"
              "returns false if process_frame_wait() was called without a\n"
-             " corresponding call to process_frame_start_async")
+             " corresponding call to process_frame_start_async.\n"
+             "The GIL is released while waiting")
+
+        .def("process_frame_wait_for", &EO::ProcessFrameWaitFor,
+             call_guard<gil_scoped_release>(),
+             "Wait at most timeout (seconds or a timedelta) for the frame\n"
+             "to complete. Returns WaitStatus.PENDING if it has not, the\n"
+             "frame stays in flight. The GIL is released while waiting",
+             arg("timeout"))
+
+        .def("try_process_frame_wait", &EO::TryProcessFrameWait,
+             "Retire the frame if it has completed, without blocking")
+
+        .def("get_completion_fd", &EO::GetCompletionFd,
+             "Returns an eventfd readable when a frame completes, e.g. to\n"
+             "register with selectors or asyncio. Do not close it")
+
+        .def("process_frame",
+             (object (*)(EO*, object)) &ProcessFrame,
+             "Start processing a frame and return an asyncio future that\n"
+             "completes with True once the frame has been processed, or\n"
+             "False if it failed. Uses the current event loop unless loop\n"
+             "is specified. Do not mix with process_frame_start_async\n"
+             "and process_frame_wait while frames are in flight",
+             arg("loop")=none())
 
         .def("get_device_name", &EO::GetDeviceName)
 
@@ -78,9 +225,35 @@ void init_eo(module &m)
              &EO::GetProcessTimeInMilliSeconds,
              "Milliseconds taken on the device to process a frame")
 
+        .def("get_frame_timing", &EO::GetFrameTiming,
+             "Returns the StageTiming of the most recently completed frame")
+
+        .def("get_metrics", &EO::GetMetrics,
+             "Returns a snapshot of the runtime metrics")
+
         .def("write_layer_outputs_to_file",
              &EO::WriteLayerOutputsToFile,
              "Write the output buffer for each layer to a file\n"
              "<filename_prefix>_<ID>_HxW.bin",
-             arg("filename_prefix")="trace_dump_");
+             arg("filename_prefix")="trace_dump_")
+
+        .def("get_layer_outputs",
+             [](object self)
+             { return GetLayerOutputArrays(self.cast<const EO&>(), self); },
+             "Returns a LayerOutput for each traced layer. The arrays view\n"
+             "device memory without copying and are overwritten by the\n"
+             "next frame, copy() them to keep the data")
+
+        .def("get_output_array",
+             [](object self, uint32_t buffer_idx)
+             {
+                const EO& eo = self.cast<const EO&>();
+                return GetOutputArray(eo, eo.GetOutputBufferPtr(),
+                                      buffer_idx, self);
+             },
+             "Returns an int8 NumPy view, channels x height x width, of\n"
+             "network output buffer buffer_idx in the output buffer,\n"
+             "without copying. Valid until the output buffer is replaced\n"
+             "or free_memory is called",
+             arg("buffer_idx")=0);
 }
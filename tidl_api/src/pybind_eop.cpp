@@ -26,6 +26,7 @@
  *  THE POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
 
+#include <pybind11/chrono.h>
 #include "pybind_common.h"
 
 // Note: Overloaded methods must be disambiguated by casting them to
@@ -34,7 +35,11 @@
 void init_eop(module &m)
 {
     class_<EOP>(m, "ExecutionObjectPipeline")
-        .def(init<std::vector<ExecutionObject *>>())
+        .def(init<std::vector<ExecutionObject *>, uint32_t>(),
+             arg("eos"), arg("num_frames_in_flight")=1, keep_alive<1, 2>())
+
+        .def("get_num_frames_in_flight", &EOP::GetNumFramesInFlight,
+             "Returns the number of frames that can be in flight")
 
         .def("get_input_buffer",
               [](const EOP &eo)
@@ -58,21 +63,100 @@ void init_eop(module &m)
               "a Python object using the buffer protocol. This object can\n"
               "be specified as an argument to the write method")
 
+        .def("set_input_output_buffer",
+             (void (*)(EOP*, buffer, buffer, object)) &SetInputOutputArrays,
+             "Use caller-owned buffers, e.g. NumPy arrays, as input and\n"
+             "output of the current slot, or of slot slot_idx, without\n"
+             "copying. Buffers must be C-contiguous and at least\n"
+             "get_input_buffer_size()/get_output_buffer_size() bytes.\n"
+             "Buffers allocated with allocate_array are accessed by the\n"
+             "device in place. The buffers are referenced until replaced\n"
+             "or until free_memory is called",
+             arg("input"), arg("output"), arg("slot_idx")=none())
+
+        .def("get_input_buffer_size", &EOP::GetInputBufferSizeInBytes,
+             "Returns the size of the input buffer in bytes")
+
+        .def("get_output_buffer_size", &EOP::GetOutputBufferSizeInBytes,
+             "Returns the size of the output buffer in bytes")
+
+        .def("get_output_data_q", &EOP::GetOutputDataQ,
+             "Returns the Q factor of an output buffer of the last frame.\n"
+             "float = value * 256 / Q. 0 if not known",
+             arg("buffer_idx")=0)
+
         .def("set_frame_index", &EOP::SetFrameIndex,
              "Set the frame index of the frame currently processed.\n"
              "Used for trace/debug messages")
 
         .def("get_frame_index", &EOP::GetFrameIndex)
 
-        .def("process_frame_start_async", &EOP::ProcessFrameStartAsync,
+        .def("process_frame_start_async",
+             (bool (EOP::*)()) &EOP::ProcessFrameStartAsync,
+             call_guard<gil_scoped_release>(),
              "Start processing a frame. The call is asynchronous and\n"
              "returns immediately")
 
         .def("process_frame_wait", &EOP::ProcessFrameWait,
+             call_guard<gil_scoped_release>(),
              "Wait for the executor pipeline to complete processing a frame\n"
              "returns false if process_frame_wait() was called without a\n"
-             " corresponding call to process_frame_start_async")
+             " corresponding call to process_frame_start_async.\n"
+             "The GIL is released while waiting")
+
+        .def("process_frame_wait_for", &EOP::ProcessFrameWaitFor,
+             call_guard<gil_scoped_release>(),
+             "Wait at most timeout (seconds or a timedelta) for the frame\n"
+             "to complete. Returns WaitStatus.PENDING if it has not, the\n"
+             "frame stays in flight. The GIL is released while waiting",
+             arg("timeout"))
+
+        .def("try_process_frame_wait", &EOP::TryProcessFrameWait,
+             "Retire the frame if it has completed, without blocking")
+
+        .def("get_completion_fd", &EOP::GetCompletionFd,
+             "Returns an eventfd readable when a frame completes, e.g. to\n"
+             "register with selectors or asyncio. Do not close it")
+
+        .def("get_frame_timing", &EOP::GetFrameTiming,
+             "Returns a StageTiming per ExecutionObject for the frame\n"
+             "completed by process_frame_wait")
+
+        .def("get_metrics", &EOP::GetMetrics,
+             "Returns a snapshot of the runtime metrics")
+
+        .def("process_frame",
+             (object (*)(EOP*, object)) &ProcessFrame,
+             "Start processing a frame and return an asyncio future that\n"
+             "completes with True once the frame has been processed, or\n"
+             "False if it failed. Uses the current event loop unless loop\n"
+             "is specified. Do not mix with process_frame_start_async\n"
+             "and process_frame_wait while frames are in flight",
+             arg("loop")=none())
 
         .def("get_device_name", &EOP::GetDeviceName,
-             "Returns the combined device names used by the pipeline");
+             "Returns the combined device names used by the pipeline")
+
+        .def("get_layer_outputs",
+             [](object self)
+             { return GetLayerOutputArrays(self.cast<const EOP&>(), self); },
+             "Returns a LayerOutput for each traced layer of all\n"
+             "ExecutionObjects in the pipeline. The arrays view device\n"
+             "memory without copying and are overwritten by the next\n"
+             "frame, copy() them to keep the data")
+
+        .def("get_output_array",
+             [](object self, uint32_t buffer_idx)
+             {
+                const EOP& eop = self.cast<const EOP&>();
+                const EO*  last = eop.GetExecutionObject(
+                                        eop.GetNumExecutionObjects() - 1);
+                return GetOutputArray(*last, eop.GetOutputBufferPtr(),
+                                      buffer_idx, self);
+             },
+             "Returns an int8 NumPy view, channels x height x width, of\n"
+             "network output buffer buffer_idx in the output buffer of\n"
+             "the current slot, without copying. Valid until the output\n"
+             "buffer is replaced or free_memory is called",
+             arg("buffer_idx")=0);
 }
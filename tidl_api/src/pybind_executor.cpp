@@ -34,12 +34,15 @@
 // 2. https://pybind11.readthedocs.io/en/stable/advanced/pycpp/numpy.html#buffer-protocol
 // 3. https://www.python.org/dev/peps/pep-0008/
 
+#include <pybind11/numpy.h>
 #include "pybind_common.h"
+#include "host_threads.h"
 
 void AllocateMemory(const vector<ExecutionObject *>& eos);
 void AllocateMemory(const vector<ExecutionObjectPipeline *>& eos);
 void FreeMemory(const vector<ExecutionObject *>& eos);
 void FreeMemory(const vector<ExecutionObjectPipeline *>& eos);
+array AllocateArray(const std::vector<ssize_t>& shape, object dt);
 
 #define STRING(S)  XSTRING(S)
 #define XSTRING(S) #S
@@ -64,10 +67,52 @@ PYBIND11_MODULE(tidl, m)
         .value("ID2", DeviceId::ID2)
         .value("ID3", DeviceId::ID3);
 
+    enum_<TimeStampFormat>(m, "TimeStampFormat")
+        .value("CSV", TimeStampFormat::CSV)
+        .value("CHROME_TRACE", TimeStampFormat::CHROME_TRACE);
+
+    enum_<WaitStatus>(m, "WaitStatus")
+        .value("COMPLETED", WaitStatus::COMPLETED)
+        .value("FAILED", WaitStatus::FAILED)
+        .value("PENDING", WaitStatus::PENDING)
+        .value("NO_FRAME", WaitStatus::NO_FRAME);
+
+    class_<HostThreads>(m, "HostThreads")
+        .def_static("start_workers", &HostThreads::StartWorkers,
+             "Run the host side work of completing frames on worker\n"
+             "threads pinned to cpus, with a SCHED_FIFO priority if > 0",
+             arg("num_workers"), arg("cpus")=std::set<int>(),
+             arg("priority")=0,
+             call_guard<gil_scoped_release>())
+        .def_static("stop_workers", &HostThreads::StopWorkers,
+             call_guard<gil_scoped_release>())
+        .def_static("get_num_workers", &HostThreads::GetNumWorkers)
+        .def_static("set_current_thread", &HostThreads::SetCurrentThread,
+             "Pin the calling thread to cpus and set its priority",
+             arg("cpus"), arg("priority")=0);
+
     init_configuration(m);
     init_eo(m);
     init_eop(m);
 
+    class_<HeapUsage>(m, "HeapUsage")
+        .def_readonly("param_heap_size", &HeapUsage::paramHeapSize)
+        .def_readonly("param_heap_requested", &HeapUsage::paramHeapRequested)
+        .def_readonly("network_heap_size", &HeapUsage::networkHeapSize)
+        .def_readonly("network_heap_requested",
+                      &HeapUsage::networkHeapRequested);
+
+    class_<StartupTiming>(m, "StartupTiming")
+        .def_readonly("device_create_ms", &StartupTiming::deviceCreateMs)
+        .def_readonly("config_ms", &StartupTiming::configMs)
+        .def_readonly("auto_size_heaps_ms", &StartupTiming::autoSizeHeapsMs)
+        .def_readonly("read_network_ms", &StartupTiming::readNetworkMs)
+        .def_readonly("read_params_ms", &StartupTiming::readParamsMs)
+        .def_readonly("setup_kernel_ms", &StartupTiming::setupKernelMs)
+        .def_readonly("create_eos_ms", &StartupTiming::createEosMs)
+        .def_readonly("init_kernel_ms", &StartupTiming::initKernelMs)
+        .def_readonly("total_ms", &StartupTiming::totalMs);
+
     // For an explanation of return_value_policy, see Reference #1
 	class_<Executor>(m, "Executor")
         .def(init<DeviceType, std::set<DeviceId>, Configuration, int>())
@@ -81,8 +126,43 @@ PYBIND11_MODULE(tidl, m)
 
         .def_static("get_api_version", &Executor::GetAPIVersion)
 
-        .def("at", &Executor::operator[], return_value_policy::reference,
-            "Returns the ExecutionObject at the specified index");
+        .def("at", &Executor::operator[],
+             return_value_policy::reference_internal,
+            "Returns the ExecutionObject at the specified index")
+
+        .def("get_metrics", &Executor::GetMetrics,
+             "Returns a snapshot of the runtime metrics of each\n"
+             "ExecutionObject")
+
+        .def("get_heap_usage", &Executor::GetHeapUsage,
+             "Returns device heap sizes and bytes requested from the heaps")
+
+        .def("get_startup_timing", &Executor::GetStartupTiming,
+             "Returns the time spent in each phase of creating the Executor")
+
+        .def("reload", &Executor::Reload,
+             "Switch to the network in the configuration. Frames in flight\n"
+             "complete with the current network",
+             call_guard<gil_scoped_release>())
+
+        .def("save_quantization_state", &Executor::SaveQuantizationState,
+             "Save the quantization range history of each ExecutionObject",
+             call_guard<gil_scoped_release>())
+
+        .def("load_quantization_state", &Executor::LoadQuantizationState,
+             "Restore the quantization range history saved by\n"
+             "save_quantization_state. Returns False if it does not match",
+             call_guard<gil_scoped_release>())
+
+        .def("add_network", &Executor::AddNetwork,
+             "Initialize an additional network on the ExecutionObjects.\n"
+             "Returns its index, see ExecutionObject.set_network_index",
+             call_guard<gil_scoped_release>())
+
+        .def("reset_execution_object", &Executor::ResetExecutionObject,
+             "Recover the ExecutionObject at index after a device error,\n"
+             "the other ExecutionObjects keep running",
+             call_guard<gil_scoped_release>());
 
     // Used to expose the EO's internal input and output buffers to the
     // python application using the Python buffer protocol (Reference #2)
@@ -125,8 +205,22 @@ PYBIND11_MODULE(tidl, m)
            (void (*)(const vector<EOP *>&)) &FreeMemory,
           "Free input and output buffers of all ExecutionObjectPipelines");
 
+    m.def("allocate_array", &AllocateArray,
+          "Allocate a NumPy array in CMEM. Bound via\n"
+          "set_input_output_buffer, it is accessed by the device without\n"
+          "a copy. dtype defaults to numpy.uint8",
+          arg("shape"), arg("dtype")=none());
+
+    m.def("allocate_array",
+          [](ssize_t size, object dt)
+          { return AllocateArray(std::vector<ssize_t>(1, size), dt); },
+          "Allocate a one-dimensional NumPy array of size elements in CMEM",
+          arg("size"), arg("dtype")=none());
+
     m.def("enable_time_stamps",
            &EnableTimeStamps,
-          "Enable timestamp generation for API events");
+          "Enable timestamp generation for API events",
+          arg("file")="timestamp.log", arg("num_frames")=32,
+          arg("format")=TimeStampFormat::CSV);
 }
 
@@ -1,21 +1,41 @@
+#include <map>
+#include <atomic>
+#include <pybind11/numpy.h>
+
 #include "pybind_common.h"
+#include "buffer_pool.h"
+
+// Input and output buffers are allocated in CMEM, from a pool shared by
+// all EOs and EOPs created from Python
+static BufferPool& GetBufferPool()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+// Arrays bound via set_input_output_buffer, indexed by EO/EOP and slot.
+// The references keep the arrays alive while the device accesses them.
+// Accessed with the GIL held. Never destroyed: releasing the references
+// during static destruction would run after the interpreter has finalized.
+typedef std::pair<const void*, uint32_t> BoundSlot;
+static std::map<BoundSlot, std::pair<object, object>>& GetBoundArrays()
+{
+    static auto* arrays = new std::map<BoundSlot, std::pair<object, object>>;
+    return *arrays;
+}
+
+// Drop the references to the arrays bound to a slot
+// Returns false if no arrays are bound to the slot
+static bool UnbindArrays(const void* eo, uint32_t slot_idx)
+{
+    return GetBoundArrays().erase(BoundSlot(eo, slot_idx)) > 0;
+}
 
 template<typename T>
 void AllocateMemoryT(const vector<T *>& eos)
 {
-    // Allocate input and output buffers for each execution object
     for (auto eo : eos)
-    {
-        size_t in_size  = eo->GetInputBufferSizeInBytes();
-        size_t out_size = eo->GetOutputBufferSizeInBytes();
-        void*  in_ptr   = malloc(in_size);
-        void*  out_ptr  = malloc(out_size);
-        assert(in_ptr != nullptr && out_ptr != nullptr);
-
-        ArgInfo in  = { ArgInfo(in_ptr,  in_size)};
-        ArgInfo out = { ArgInfo(out_ptr, out_size)};
-        eo->SetInputOutputBuffer(in, out);
-    }
+        GetBufferPool().AllocateBuffers(eo);
 }
 
 // Allocate input and output memory for each EO
@@ -24,7 +44,7 @@ void AllocateMemory(const vector<ExecutionObject *>& eos)
     AllocateMemoryT<ExecutionObject>(eos);
 }
 
-// Allocate input and output memory for each EO
+// Allocate input and output memory for each slot of each EOP
 void AllocateMemory(const vector<ExecutionObjectPipeline *>& eos)
 {
     AllocateMemoryT<ExecutionObjectPipeline>(eos);
@@ -32,26 +52,293 @@ void AllocateMemory(const vector<ExecutionObjectPipeline *>& eos)
 
 
 
-// Free the input and output memory associated with each EO
-template<typename T>
-void FreeMemoryT(const vector<T *>& eos)
+// Free the input and output memory associated with each EO. Buffers bound
+// via set_input_output_buffer are owned by the caller, only the references
+// to them are dropped.
+void FreeMemory(const vector<ExecutionObject *>& eos)
 {
     for (auto eo : eos)
+        if (!UnbindArrays(eo, 0))
+            GetBufferPool().ReleaseBuffers(eo);
+    GetBufferPool().Trim();
+}
+
+
+// Free the input and output memory associated with each slot of each EOP
+void FreeMemory(const vector<ExecutionObjectPipeline *>& eos)
+{
+    for (auto eop : eos)
+        for (uint32_t i = 0; i < eop->GetNumFramesInFlight(); i++)
+        {
+            if (UnbindArrays(eop, i))
+                continue;
+
+            if (eop->GetInputBufferPtr(i))
+                GetBufferPool().Release(eop->GetInputBufferPtr(i));
+            if (eop->GetOutputBufferPtr(i))
+                GetBufferPool().Release(eop->GetOutputBufferPtr(i));
+        }
+    GetBufferPool().Trim();
+}
+
+
+// Allocate a NumPy array in CMEM. The device accesses it in place when
+// it is bound as an input or output buffer. The memory is returned to the
+// pool when the array (and all views of it) are garbage collected.
+array AllocateArray(const std::vector<ssize_t>& shape, object dt)
+{
+    pybind11::dtype type = dt.is_none() ? pybind11::dtype::of<uint8_t>()
+                                        : pybind11::dtype::from_args(dt);
+
+    size_t size = type.itemsize();
+    for (auto n : shape)
     {
-        free(eo->GetInputBufferPtr());
-        free(eo->GetOutputBufferPtr());
+        if (n < 0)
+            throw Exception("Array dimensions must be non-negative",
+                            __FILE__, __FUNCTION__, __LINE__);
+        size *= n;
     }
+
+    char* ptr = GetBufferPool().Acquire(size);
+    capsule owner(ptr, [](void* p) { GetBufferPool().Release(p); });
+    return array(type, shape, ptr, owner);
 }
 
-void FreeMemory(const vector<ExecutionObject *>& eos)
+
+// Get the memory of a buffer bound as input or output. The device accesses
+// the memory as bytes, the buffer must be C-contiguous and hold at least
+// min_size bytes.
+static ArgInfo GetBoundArgInfo(buffer b, size_t min_size, bool writable,
+                               const std::string& name)
 {
-    FreeMemoryT<ExecutionObject>(eos);
+    buffer_info info = b.request(writable);
+
+    ssize_t stride = info.itemsize;
+    for (ssize_t i = info.ndim - 1; i >= 0; i--)
+    {
+        if (info.shape[i] > 1 && info.strides[i] != stride)
+            throw Exception(name + " buffer is not C-contiguous",
+                            __FILE__, __FUNCTION__, __LINE__);
+        stride *= info.shape[i];
+    }
+
+    size_t size = info.size * info.itemsize;
+    if (size < min_size)
+        throw Exception(name + " buffer is too small, requires " +
+                        std::to_string(min_size) + " bytes",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    return ArgInfo(info.ptr, size);
 }
 
+// Use caller-owned buffers as input and output of an EO, without copying
+void SetInputOutputArrays(EO* eo, buffer in, buffer out)
+{
+    ArgInfo in_ai  = GetBoundArgInfo(in, eo->GetInputBufferSizeInBytes(),
+                                     false, "Input");
+    ArgInfo out_ai = GetBoundArgInfo(out, eo->GetOutputBufferSizeInBytes(),
+                                     true, "Output");
 
-// Free the input and output memory associated with each EO
-void FreeMemory(const vector<ExecutionObjectPipeline *>& eos)
+    eo->SetInputOutputBuffer(in_ai, out_ai);
+    GetBoundArrays()[BoundSlot(eo, 0)] = std::make_pair(in, out);
+}
+
+// Use caller-owned buffers as input and as the network output buffers of
+// an EO. Outputs whose buffer is None are not copied.
+void SetInputOutputArrays(EO* eo, buffer in, list out)
+{
+    ArgInfo in_ai  = GetBoundArgInfo(in, eo->GetInputBufferSizeInBytes(),
+                                     false, "Input");
+
+    std::vector<ArgInfo> out_ai;
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        if (out[i].is_none())
+        {
+            out_ai.emplace_back(nullptr, 0);
+            continue;
+        }
+        size_t size = i < eo->GetNumNetOutputs() ?
+                      eo->GetNetOutputSizeInBytes(i) : 0;
+        out_ai.push_back(GetBoundArgInfo(out[i].cast<buffer>(), size, true,
+                                         "Output " + std::to_string(i)));
+    }
+
+    eo->SetInputOutputBuffers(in_ai, out_ai);
+    GetBoundArrays()[BoundSlot(eo, 0)] = std::make_pair(in, tuple(out));
+}
+
+// Use caller-owned buffers as input and output of the current slot of an
+// EOP, or of slot slot_idx if specified
+void SetInputOutputArrays(EOP* eop, buffer in, buffer out, object slot_idx)
+{
+    ArgInfo in_ai  = GetBoundArgInfo(in, eop->GetInputBufferSizeInBytes(),
+                                     false, "Input");
+    ArgInfo out_ai = GetBoundArgInfo(out, eop->GetOutputBufferSizeInBytes(),
+                                     true, "Output");
+
+    if (!slot_idx.is_none())
+    {
+        uint32_t slot = slot_idx.cast<uint32_t>();
+        eop->SetInputOutputBuffer(in_ai, out_ai, slot);
+        GetBoundArrays()[BoundSlot(eop, slot)] = std::make_pair(in, out);
+        return;
+    }
+
+    // The current slot is not exposed. It is one of the slots that now
+    // use these buffers; any such slot accesses the memory of in and out,
+    // so the references are recorded for each of them.
+    eop->SetInputOutputBuffer(in_ai, out_ai);
+    for (uint32_t i = 0; i < eop->GetNumFramesInFlight(); i++)
+        if (eop->GetInputBufferPtr(i)  == in_ai.ptr() &&
+            eop->GetOutputBufferPtr(i) == out_ai.ptr())
+            GetBoundArrays()[BoundSlot(eop, i)] = std::make_pair(in, out);
+}
+
+
+// Completion of a frame started with process_frame. Holds the event loop
+// and the future awaited by the caller. The last reference may be dropped
+// on an OpenCL runtime thread, the GIL is acquired to release the objects.
+struct PendingFrame
+{
+    object            loop;
+    object            future;
+    std::atomic<bool> done{false};
+
+    ~PendingFrame()
+    {
+        gil_scoped_acquire gil;
+        loop   = object();
+        future = object();
+    }
+
+    // Resolve the future with the frame status on the event loop thread.
+    // Called on an OpenCL runtime thread, or on the calling thread if the
+    // frame could not be started asynchronously.
+    void Complete(bool status)
+    {
+        if (done.exchange(true))
+            return;
+
+        gil_scoped_acquire gil;
+        object f = future;
+        cpp_function resolve([f, status]()
+                             {
+                                 if (!f.attr("done")().cast<bool>())
+                                     f.attr("set_result")(status);
+                             });
+        try
+        {
+            loop.attr("call_soon_threadsafe")(resolve);
+        }
+        catch (error_already_set&)
+        {
+            // The event loop is closed, nothing awaits the frame
+        }
+    }
+};
+
+// NumPy view of the padded planes of a device buffer without copying:
+// channels x height x width, preceded by ROIs if there is more than one.
+// The strides step over the padding. base keeps the memory alive.
+static array PlanesArray(const DeviceBufferView& b, handle base)
 {
-    FreeMemoryT<ExecutionObjectPipeline>(eos);
+    std::vector<ssize_t> shape   = { b.NumberOfChannels(),
+                                     (ssize_t) b.Height(),
+                                     (ssize_t) b.Width() };
+    std::vector<ssize_t> strides = { (ssize_t) b.ChannelStride(),
+                                     (ssize_t) b.Pitch(), 1 };
+    if (b.NumberOfROIs() > 1)
+    {
+        shape.insert(shape.begin(), b.NumberOfROIs());
+        strides.insert(strides.begin(), (ssize_t) b.ROIStride());
+    }
+
+    return array(pybind11::dtype::of<int8_t>(), shape, strides, b.Data(),
+                 base);
 }
 
+// Read-only views of the outputs of all traced layers of eo, in device
+// memory. The views reference owner, the Python object of eo, so the EO
+// outlives them. Each frame overwrites the data.
+list GetLayerOutputArrays(const ExecutionObjectInternalInterface& eo,
+                          object owner)
+{
+    LayerOutputViews views;
+    eo.GetLayerOutputViews(views);
+
+    list outputs;
+    for (const LayerOutputView& v : views)
+    {
+        array a = PlanesArray(v.Buffer(), owner);
+        a.attr("setflags")(arg("write") = false);
+        outputs.append(LayerOutputArray{v, a});
+    }
+
+    return outputs;
+}
+
+// View of network output buffer buffer_idx in the host output buffer out,
+// which holds the outputs of last_eo packed one after the other
+object GetOutputArray(const EO& last_eo, char* out, uint32_t buffer_idx,
+                      object owner)
+{
+    if (out == nullptr)
+        throw Exception("Output buffer is not set, or is set per output",
+                        __FILE__, __FUNCTION__, __LINE__);
+    if (buffer_idx >= last_eo.GetNumNetOutputs())
+        throw Exception("Invalid output buffer " +
+                        std::to_string(buffer_idx),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < buffer_idx; i++)
+        offset += last_eo.GetNetOutputSizeInBytes(i);
+
+    DeviceBufferView b = last_eo.GetDeviceOutputBuffers()[buffer_idx];
+    std::vector<ssize_t> shape = { b.NumberOfChannels(),
+                                   (ssize_t) b.Height(),
+                                   (ssize_t) b.Width() };
+    if (b.NumberOfROIs() > 1)
+        shape.insert(shape.begin(), b.NumberOfROIs());
+
+    return array(pybind11::dtype::of<int8_t>(), shape, out + offset, owner);
+}
+
+// Start processing a frame with the buffers and frame index set on eo.
+// Returns an asyncio future that completes with the frame status once the
+// frame is done, without blocking a thread while the frame is processed.
+template<typename T>
+object ProcessFrameT(T* eo, object loop)
+{
+    if (loop.is_none())
+        loop = module::import("asyncio").attr("get_event_loop")();
+
+    auto pending    = std::make_shared<PendingFrame>();
+    pending->loop   = loop;
+    pending->future = loop.attr("create_future")();
+    object future   = pending->future;
+
+    bool started;
+    {
+        gil_scoped_release release;
+        started = eo->ProcessFrameStartAsync(
+                        [pending](FrameResult& result)
+                        { pending->Complete(result.GetStatus()); });
+    }
+
+    if (!started)
+        pending->Complete(false);
+
+    return future;
+}
+
+object ProcessFrame(EO* eo, object loop)
+{
+    return ProcessFrameT<EO>(eo, loop);
+}
+
+object ProcessFrame(EOP* eop, object loop)
+{
+    return ProcessFrameT<EOP>(eop, loop);
+}
@@ -0,0 +1,248 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file reorder_buffer.cpp */
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "reorder_buffer.h"
+
+using namespace tidl;
+
+class ReorderBuffer::Impl
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        Impl(DeliverCallback deliver, uint32_t window,
+             std::chrono::milliseconds skip_timeout, int first_frame_idx);
+        ~Impl();
+
+        void Complete(const FrameDescriptor& frame, bool status);
+        void Flush();
+
+        // Deliver held frames in order, skipping missing frames if the
+        // window is full, the skip timeout expired or on Flush. Only one
+        // thread delivers at a time, the others return immediately.
+        void DeliverReady(std::unique_lock<std::mutex>& lock);
+        void TimerLoop();
+
+        struct HeldFrame
+        {
+            FrameDescriptor frame;
+            bool            status;
+        };
+
+        DeliverCallback                 deliver_m;
+        uint32_t                        window_m;
+        std::chrono::milliseconds       skip_timeout_m;
+
+        // Completed frames waiting for a frame with a lower index
+        std::map<int, HeldFrame>        held_m;
+        int                             next_m;
+        // Since when next_m is waited for, while frames are held
+        Clock::time_point               waiting_since_m;
+        uint32_t                        num_skipped_m;
+        uint32_t                        num_late_m;
+        bool                            delivering_m;
+        bool                            flushing_m;
+        bool                            stop_m;
+
+        // Guards all of the above
+        mutable std::mutex              mutex_m;
+        std::condition_variable         cv_m;
+
+        // Skips frames once the skip timeout expires, if one is set
+        std::thread                     timer_m;
+};
+
+ReorderBuffer::ReorderBuffer(DeliverCallback deliver, uint32_t window,
+                             std::chrono::milliseconds skip_timeout,
+                             int first_frame_idx):
+    pimpl_m(new Impl(deliver, window, skip_timeout, first_frame_idx))
+{}
+
+// Pointer to implementation idiom: https://herbsutter.com/gotw/_100/:
+// Both unique_ptr and shared_ptr can be instantiated with an incomplete type
+// unique_ptr's destructor requires a complete type in order to invoke delete
+ReorderBuffer::~ReorderBuffer() = default;
+
+void ReorderBuffer::Complete(const FrameDescriptor& frame, bool status)
+{
+    pimpl_m->Complete(frame, status);
+}
+
+void ReorderBuffer::Flush()
+{
+    pimpl_m->Flush();
+}
+
+int ReorderBuffer::GetNextFrameIndex() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->next_m;
+}
+
+uint32_t ReorderBuffer::GetNumFramesSkipped() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_skipped_m;
+}
+
+uint32_t ReorderBuffer::GetNumFramesLate() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->num_late_m;
+}
+
+
+ReorderBuffer::Impl::Impl(DeliverCallback deliver, uint32_t window,
+                          std::chrono::milliseconds skip_timeout,
+                          int first_frame_idx):
+    deliver_m(deliver), window_m(window), skip_timeout_m(skip_timeout),
+    next_m(first_frame_idx), num_skipped_m(0), num_late_m(0),
+    delivering_m(false), flushing_m(false), stop_m(false)
+{
+    if (window_m == 0 || !deliver_m)
+        throw Exception("ReorderBuffer requires a window and a callback",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    if (skip_timeout_m > skip_timeout_m.zero())
+        timer_m = std::thread(&ReorderBuffer::Impl::TimerLoop, this);
+}
+
+ReorderBuffer::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_m.notify_all();
+
+    if (timer_m.joinable())
+        timer_m.join();
+}
+
+void ReorderBuffer::Impl::Complete(const FrameDescriptor& frame, bool status)
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+
+    int idx = frame.GetFrameIndex();
+    if (idx < next_m || held_m.count(idx) != 0)
+    {
+        num_late_m++;
+        return;
+    }
+
+    if (held_m.empty())
+        waiting_since_m = Clock::now();
+    held_m.insert(std::make_pair(idx, HeldFrame{frame, status}));
+
+    DeliverReady(lock);
+    cv_m.notify_all();
+}
+
+void ReorderBuffer::Impl::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+
+    // A thread delivering when the flush starts skips the missing frames
+    flushing_m = true;
+    DeliverReady(lock);
+    cv_m.wait(lock, [this]{ return held_m.empty() && !delivering_m; });
+    flushing_m = false;
+}
+
+void ReorderBuffer::Impl::DeliverReady(std::unique_lock<std::mutex>& lock)
+{
+    if (delivering_m)
+        return;
+    delivering_m = true;
+
+    while (!held_m.empty())
+    {
+        int oldest = held_m.begin()->first;
+        if (oldest != next_m)
+        {
+            bool timed_out = skip_timeout_m > skip_timeout_m.zero() &&
+                             Clock::now() - waiting_since_m >= skip_timeout_m;
+            if (!flushing_m && !timed_out && held_m.size() <= window_m)
+                break;
+
+            num_skipped_m += oldest - next_m;
+            next_m         = oldest;
+        }
+
+        HeldFrame held = held_m.begin()->second;
+        held_m.erase(held_m.begin());
+        next_m++;
+        waiting_since_m = Clock::now();
+
+        lock.unlock();
+        try
+        {
+            deliver_m(held.frame, held.status);
+        }
+        catch (...)
+        {
+            lock.lock();
+            delivering_m = false;
+            cv_m.notify_all();
+            throw;
+        }
+        lock.lock();
+    }
+
+    delivering_m = false;
+    cv_m.notify_all();
+}
+
+void ReorderBuffer::Impl::TimerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (!stop_m)
+    {
+        if (held_m.empty() || delivering_m)
+        {
+            cv_m.wait(lock);
+            continue;
+        }
+
+        Clock::time_point deadline = waiting_since_m + skip_timeout_m;
+        if (Clock::now() < deadline)
+        {
+            cv_m.wait_until(lock, deadline);
+            continue;
+        }
+
+        DeliverReady(lock);
+    }
+}
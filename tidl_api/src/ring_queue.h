@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+//! @file ring_queue.h
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace tidl {
+
+/*! @class RingQueue
+    @brief FIFO queue on a ring of slots, for the queues on the frame path
+
+    Unlike std::deque, which allocates and frees a block as the queue
+    moves through memory, the ring only allocates when it grows beyond
+    its largest size so far. Popped slots are reset to T(), releasing
+    what they hold. Not thread safe.
+*/
+template <typename T>
+class RingQueue
+{
+    public:
+        RingQueue(): head_m(0), size_m(0) {}
+
+        bool   empty() const { return size_m == 0; }
+        size_t size()  const { return size_m; }
+
+        T& front() { return slots_m[head_m]; }
+
+        void push_back(T value)
+        {
+            if (size_m == slots_m.size())
+                Grow();
+            slots_m[(head_m + size_m) % slots_m.size()] = std::move(value);
+            size_m++;
+        }
+
+        void pop_front()
+        {
+            slots_m[head_m] = T();
+            head_m = (head_m + 1) % slots_m.size();
+            size_m--;
+        }
+
+    private:
+        void Grow()
+        {
+            std::vector<T> slots(slots_m.empty() ? 8 : 2 * slots_m.size());
+            for (size_t i = 0; i < size_m; i++)
+                slots[i] = std::move(slots_m[(head_m + i) % slots_m.size()]);
+            slots_m.swap(slots);
+            head_m = 0;
+        }
+
+        std::vector<T> slots_m;
+        size_t         head_m;
+        size_t         size_m;
+};
+
+} // namespace tidl
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <exception>
+#include <iostream>
+#include "run_frame.h"
+#include "trace.h"
+
+using namespace tidl;
+
+bool tidl::RunFrame(ExecutionObjectInternalInterface& eo,
+                    const FrameDescriptor& frame, const char* caller)
+{
+    bool status = false;
+    try
+    {
+        eo.SetInputOutputBuffer(frame.GetInput(), frame.GetOutput());
+        eo.SetFrameIndex(frame.GetFrameIndex());
+        status = eo.ProcessFrameStartAsync();
+        status = eo.ProcessFrameWait() && status;
+    }
+    catch (const Exception& e)
+    {
+        TRACE::print("%s: frame %d failed on %s: %s\n", caller,
+                     frame.GetFrameIndex(), eo.GetDeviceName().c_str(),
+                     e.what());
+    }
+
+    return status;
+}
+
+void tidl::NotifyFrame(const FrameCompletionFn& on_complete,
+                       const FrameDescriptor& frame,
+                       ExecutionObjectInternalInterface& eo, bool status,
+                       const char* caller)
+{
+    if (!on_complete)
+        return;
+
+    try
+    {
+        on_complete(frame, eo, status);
+    }
+    catch (...)
+    {
+        ReportCallbackError(caller, frame.GetFrameIndex());
+    }
+}
+
+void tidl::ReportCallbackError(const char* caller, int frame_idx)
+{
+    std::cout << "ERROR: " << caller << ": callback of frame " << frame_idx
+              << " threw";
+    try
+    {
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << ": " << e.what();
+    }
+    catch (...)
+    {
+    }
+    std::cout << std::endl;
+}
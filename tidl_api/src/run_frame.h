@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include "executor.h"
+#include "execution_object.h"
+
+namespace tidl {
+
+// Frame processing shared by the worker threads of Dispatcher,
+// PriorityScheduler and StreamMultiplexer. caller names the worker in
+// trace messages.
+
+//! Same type as the CompletionCallback of the workers
+typedef std::function<void(const FrameDescriptor& frame,
+                           ExecutionObjectInternalInterface& eo,
+                           bool status)> FrameCompletionFn;
+
+//! Process frame on eo and wait for it: bind the buffers and frame index
+//! of frame, start the frame and wait for it. Errors are traced.
+//! @return false if the frame failed
+bool RunFrame(ExecutionObjectInternalInterface& eo,
+              const FrameDescriptor& frame, const char* caller);
+
+//! Invoke on_complete, if set. An exception thrown by the callback is
+//! reported and dropped, it would otherwise terminate the worker thread.
+void NotifyFrame(const FrameCompletionFn& on_complete,
+                 const FrameDescriptor& frame,
+                 ExecutionObjectInternalInterface& eo, bool status,
+                 const char* caller);
+
+//! Report the exception being handled, thrown by the callback of frame
+//! frame_idx, and drop it. Call from a catch handler. Callbacks run on
+//! worker and OpenCL runtime threads, which an exception must not leave.
+void ReportCallbackError(const char* caller, int frame_idx);
+
+} // namespace tidl
@@ -0,0 +1,198 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file runtime.cpp */
+
+#include <algorithm>
+#include <future>
+#include <string>
+#include <iostream>
+
+#include "runtime.h"
+#include "executor.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "host_threads.h"
+
+using namespace tidl;
+
+class Runtime::Impl
+{
+    public:
+        explicit Impl(const Configuration& configuration);
+        ~Impl();
+
+        // Declared first, the pipelines are destroyed before their EOs
+        std::vector<std::unique_ptr<Executor>>                executors_m;
+        std::vector<std::unique_ptr<ExecutionObjectPipeline>> owned_eops_m;
+        std::vector<ExecutionObjectPipeline*>                 eops_m;
+        bool                                                  workers_m;
+
+    private:
+        void CreatePipelines(bool pipelined, uint32_t depth);
+        void AddPipeline(const std::vector<ExecutionObject*>& eos);
+};
+
+Runtime::Runtime(const Configuration& configuration) :
+    pimpl_m(new Impl(configuration))
+{}
+
+// Impl is complete here, see Executor::~Executor
+Runtime::~Runtime() = default;
+
+// Frames completing while the pipelines are destroyed run their host side
+// work on the OpenCL runtime threads
+Runtime::Impl::~Impl()
+{
+    if (workers_m)
+        HostThreads::StopWorkers();
+}
+
+const std::vector<ExecutionObjectPipeline*>&
+                        Runtime::GetExecutionObjectPipelines() const
+{
+    return pimpl_m->eops_m;
+}
+
+uint32_t Runtime::GetNumExecutors() const
+{
+    return pimpl_m->executors_m.size();
+}
+
+Executor* Runtime::GetExecutor(uint32_t index) const
+{
+    if (index >= pimpl_m->executors_m.size())
+        throw Exception("Executor index out of range",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    return pimpl_m->executors_m[index].get();
+}
+
+static DeviceType GetDeviceType(const std::string& core_type)
+{
+    return core_type == "EVE" ? DeviceType::EVE : DeviceType::DSP;
+}
+
+// All Executors are started before waiting for any, so that their setup
+// and initialization on the devices overlap
+Runtime::Impl::Impl(const Configuration& configuration) : workers_m(false)
+{
+    Configuration c = configuration;
+
+    std::vector<Configuration::TopologyExecutor> topology =
+                                                        c.topologyExecutors;
+    bool pipelined = c.topologyPipelined;
+
+    // Without a topology, every core runs the full network
+    if (topology.empty())
+    {
+        topology  = { { "EVE", 0, OCL_TIDL_DEFAULT_LAYERS_GROUP_ID },
+                      { "DSP", 0, OCL_TIDL_DEFAULT_LAYERS_GROUP_ID } };
+        pipelined = false;
+        c.runFullNet = true;
+    }
+
+    std::vector<std::future<std::unique_ptr<Executor>>> pending;
+    for (const auto& t : topology)
+    {
+        DeviceType type      = GetDeviceType(t.coreType);
+        uint32_t   available = Executor::GetNumDevices(type);
+        uint32_t   num       = t.numCores > 0 ? t.numCores : available;
+
+        if (num > available)
+            throw Exception(std::to_string(num) + " " + t.coreType +
+                            " cores requested, " + std::to_string(available) +
+                            " available", __FILE__, __FUNCTION__, __LINE__);
+
+        // A pipeline stage requires a core, other Executors are optional
+        if (num == 0 && pipelined)
+            throw Exception("No " + t.coreType + " core available for "
+                            "layers group " + std::to_string(t.layersGroupId),
+                            __FILE__, __FUNCTION__, __LINE__);
+        if (num == 0)
+            continue;
+
+        DeviceIds ids;
+        for (uint32_t i = 0; i < num; i++)
+            ids.insert(static_cast<DeviceId>(i));
+        pending.push_back(Executor::CreateAsync(type, ids, c,
+                                                t.layersGroupId));
+    }
+
+    if (pending.empty())
+        throw Exception("No EVE or DSP core available",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    // Exceptions from initialization are rethrown by get(). Executors
+    // still pending are completed and destroyed with their futures.
+    for (auto& f : pending)
+        executors_m.push_back(f.get());
+
+    CreatePipelines(pipelined, c.topologyDepth);
+
+    if (c.hostWorkers > 0)
+    {
+        if (!HostThreads::StartWorkers(c.hostWorkers, c.hostWorkerCpus,
+                                       c.hostWorkerPriority))
+            std::cerr << "Host workers run without the requested affinity "
+                         "or priority" << std::endl;
+        workers_m = true;
+    }
+}
+
+void Runtime::Impl::CreatePipelines(bool pipelined, uint32_t depth)
+{
+    if (!pipelined)
+    {
+        for (uint32_t j = 0; j < depth; j++)
+            for (const auto& e : executors_m)
+                for (uint32_t i = 0; i < e->GetNumExecutionObjects(); i++)
+                    AddPipeline({ (*e)[i] });
+        return;
+    }
+
+    // Stages with fewer cores are shared by several pipelines
+    uint32_t num_sets = 0;
+    for (const auto& e : executors_m)
+        num_sets = std::max(num_sets, e->GetNumExecutionObjects());
+
+    for (uint32_t j = 0; j < depth; j++)
+        for (uint32_t i = 0; i < num_sets; i++)
+        {
+            std::vector<ExecutionObject*> eos;
+            for (const auto& e : executors_m)
+                eos.push_back((*e)[i % e->GetNumExecutionObjects()]);
+            AddPipeline(eos);
+        }
+}
+
+void Runtime::Impl::AddPipeline(const std::vector<ExecutionObject*>& eos)
+{
+    owned_eops_m.emplace_back(new ExecutionObjectPipeline(eos));
+    eops_m.push_back(owned_eops_m.back().get());
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file shared_buffer.cpp */
+
+#include <string>
+#include <ti/cmem.h>
+
+#include "shared_buffer.h"
+
+using namespace tidl;
+
+class SharedBuffer::Impl
+{
+    public:
+        Impl(size_t size);
+        Impl(const SharedBufferHandle& handle);
+        ~Impl();
+
+        void*    ptr_m;
+        size_t   size_m;
+        uint64_t phys_m;
+        bool     owner_m;
+};
+
+// CMEM_init and CMEM_exit are reference counted by the CMEM library
+SharedBuffer::Impl::Impl(size_t size):
+    ptr_m(nullptr), size_m(size), phys_m(0), owner_m(true)
+{
+    if (CMEM_init() < 0)
+        throw Exception("Cannot open the CMEM driver",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    ptr_m = __malloc_ddr(size);
+    if (ptr_m != nullptr)
+        phys_m = CMEM_getPhys(ptr_m);
+
+    if (ptr_m == nullptr || phys_m == 0)
+    {
+        if (ptr_m != nullptr)  __free_ddr(ptr_m);
+        CMEM_exit();
+        throw Exception("Cannot allocate shared buffer of " +
+                        std::to_string(size) + " bytes",
+                        __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+SharedBuffer::Impl::Impl(const SharedBufferHandle& handle):
+    ptr_m(nullptr), size_m(handle.size), phys_m(handle.physAddr),
+    owner_m(false)
+{
+    if (CMEM_init() < 0)
+        throw Exception("Cannot open the CMEM driver",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    ptr_m = CMEM_map((off_t) phys_m, size_m);
+    if (ptr_m == nullptr)
+    {
+        CMEM_exit();
+        throw Exception("Cannot map shared buffer of " +
+                        std::to_string(size_m) + " bytes",
+                        __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+SharedBuffer::Impl::~Impl()
+{
+    if (owner_m)
+        __free_ddr(ptr_m);
+    else
+        CMEM_unmap(ptr_m, size_m);
+
+    CMEM_exit();
+}
+
+
+SharedBuffer::SharedBuffer(size_t size):
+    pimpl_m(new Impl(size))
+{
+}
+
+SharedBuffer::SharedBuffer(const SharedBufferHandle& handle):
+    pimpl_m(new Impl(handle))
+{
+}
+
+SharedBuffer::~SharedBuffer()
+{
+}
+
+void* SharedBuffer::ptr() const
+{
+    return pimpl_m->ptr_m;
+}
+
+size_t SharedBuffer::size() const
+{
+    return pimpl_m->size_m;
+}
+
+SharedBufferHandle SharedBuffer::GetHandle() const
+{
+    return { pimpl_m->phys_m, pimpl_m->size_m };
+}
+
+ArgInfo SharedBuffer::GetArgInfo() const
+{
+    return ArgInfo(pimpl_m->ptr_m, pimpl_m->size_m);
+}
+
+bool SharedBuffer::IsOwner() const
+{
+    return pimpl_m->owner_m;
+}
@@ -0,0 +1,352 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+/*! \file stream_multiplexer.cpp */
+
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "stream_multiplexer.h"
+#include "metrics_recorder.h"
+#include "run_frame.h"
+#include "util.h"
+#include "trace.h"
+
+using namespace tidl;
+
+// Returns the device time of the most recently completed frame, in ms
+typedef std::function<float()> DeviceTimeFn;
+
+// Pass advanced by a frame of a stream with weight 1. Streams with larger
+// weights advance by proportionally less per frame (stride scheduling).
+static const uint64_t STRIDE = 1 << 20;
+
+struct QueuedFrame
+{
+    FrameDescriptor frame;
+    uint64_t        submit_us;
+};
+
+struct Stream
+{
+    StreamMultiplexer::CompletionCallback on_complete;
+    uint64_t                stride;
+    uint32_t                queue_depth;
+
+    // Frames waiting for the pool, and frames being processed
+    std::deque<QueuedFrame> queue;
+    uint32_t                running = 0;
+
+    // Virtual time of the stream: the stream with the smallest pass and a
+    // queued frame is served next
+    uint64_t                pass    = 0;
+
+    MetricsRecorder         metrics;
+};
+
+class StreamMultiplexer::Impl
+{
+    public:
+        Impl(const std::vector<ExecutionObjectInternalInterface*>& eos,
+             const std::vector<DeviceTimeFn>& device_time);
+        ~Impl();
+
+        int  AddStream(CompletionCallback on_complete, uint32_t weight,
+                       uint32_t queue_depth);
+        bool Submit(int stream, const FrameDescriptor& frame, bool block);
+        void Drain();
+
+        // Called with mutex_m held
+        Stream& GetStream(int stream) const;
+        Stream* SelectStream() const;
+
+        void WorkerLoop(ExecutionObjectInternalInterface* eo,
+                        DeviceTimeFn device_time);
+
+        uint32_t                num_eos_m;
+
+        // Streams are never removed, and a Stream does not move once
+        // added: workers use it without holding the lock
+        std::vector<std::unique_ptr<Stream>> streams_m;
+
+        // Pass of the most recently served stream. A stream whose queue
+        // was empty resumes from here rather than from its own, older pass.
+        uint64_t                vtime_m;
+
+        uint32_t                num_queued_m;
+        uint32_t                num_submitted_m;
+        uint32_t                num_completed_m;
+        bool                    stop_m;
+
+        // Guards streams_m and the queues, passes and counters of the
+        // streams, vtime_m, the counters and stop_m
+        mutable std::mutex      mutex_m;
+        std::condition_variable cv_work_m;   // frame queued or stop
+        std::condition_variable cv_space_m;  // frame dequeued
+        std::condition_variable cv_done_m;   // frame completed
+
+        // One worker per ExecutionObject/Pipeline of the pool
+        std::vector<std::thread> workers_m;
+};
+
+template<typename T>
+static std::vector<ExecutionObjectInternalInterface*>
+ToInterfaces(const std::vector<T*>& v)
+{
+    return std::vector<ExecutionObjectInternalInterface*>(v.begin(), v.end());
+}
+
+static std::vector<DeviceTimeFn>
+DeviceTimes(const std::vector<ExecutionObject*>& eos)
+{
+    std::vector<DeviceTimeFn> v;
+    for (auto eo : eos)
+        v.push_back([eo]() { return eo->GetFrameTiming().deviceMs; });
+    return v;
+}
+
+static std::vector<DeviceTimeFn>
+DeviceTimes(const std::vector<ExecutionObjectPipeline*>& eops)
+{
+    std::vector<DeviceTimeFn> v;
+    for (auto eop : eops)
+        v.push_back([eop]()
+                    {
+                        float ms = 0;
+                        for (const auto& stage : eop->GetFrameTiming())
+                            ms += stage.deviceMs;
+                        return ms;
+                    });
+    return v;
+}
+
+StreamMultiplexer::StreamMultiplexer(const std::vector<ExecutionObject*>& eos):
+    pimpl_m(new Impl(ToInterfaces(eos), DeviceTimes(eos)))
+{}
+
+StreamMultiplexer::StreamMultiplexer(
+                    const std::vector<ExecutionObjectPipeline*>& eops):
+    pimpl_m(new Impl(ToInterfaces(eops), DeviceTimes(eops)))
+{}
+
+StreamMultiplexer::~StreamMultiplexer() = default;
+
+int StreamMultiplexer::AddStream(CompletionCallback on_complete,
+                                 uint32_t weight, uint32_t queue_depth)
+{
+    return pimpl_m->AddStream(on_complete, weight, queue_depth);
+}
+
+void StreamMultiplexer::Submit(int stream, const FrameDescriptor& frame)
+{
+    pimpl_m->Submit(stream, frame, true);
+}
+
+bool StreamMultiplexer::TrySubmit(int stream, const FrameDescriptor& frame)
+{
+    return pimpl_m->Submit(stream, frame, false);
+}
+
+void StreamMultiplexer::Drain()
+{
+    pimpl_m->Drain();
+}
+
+uint32_t StreamMultiplexer::GetNumStreams() const
+{
+    std::lock_guard<std::mutex> lock(pimpl_m->mutex_m);
+    return pimpl_m->streams_m.size();
+}
+
+Metrics StreamMultiplexer::GetStreamMetrics(int stream) const
+{
+    std::unique_lock<std::mutex> lock(pimpl_m->mutex_m);
+    Stream& s = pimpl_m->GetStream(stream);
+    uint32_t in_flight     = s.queue.size() + s.running;
+    uint32_t max_in_flight = s.queue_depth + pimpl_m->num_eos_m;
+    lock.unlock();
+
+    Metrics m = s.metrics.GetSnapshot();
+    m.framesInFlight    = in_flight;
+    m.maxFramesInFlight = max_in_flight;
+    return m;
+}
+
+
+StreamMultiplexer::Impl::Impl(
+                    const std::vector<ExecutionObjectInternalInterface*>& eos,
+                    const std::vector<DeviceTimeFn>& device_time):
+    num_eos_m(eos.size()), vtime_m(0),
+    num_queued_m(0), num_submitted_m(0), num_completed_m(0), stop_m(false)
+{
+    if (eos.empty())
+        throw Exception("StreamMultiplexer requires at least one "
+                        "ExecutionObject", __FILE__, __FUNCTION__, __LINE__);
+
+    for (uint32_t i = 0; i < eos.size(); i++)
+        workers_m.emplace_back(&StreamMultiplexer::Impl::WorkerLoop, this,
+                               eos[i], device_time[i]);
+}
+
+StreamMultiplexer::Impl::~Impl()
+{
+    Drain();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m = true;
+    }
+    cv_work_m.notify_all();
+
+    for (auto& t : workers_m)
+        t.join();
+}
+
+int StreamMultiplexer::Impl::AddStream(CompletionCallback on_complete,
+                                       uint32_t weight, uint32_t queue_depth)
+{
+    if (weight == 0)
+        throw Exception("StreamMultiplexer stream weight must be at least 1",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    std::unique_ptr<Stream> s(new Stream);
+    s->on_complete = on_complete;
+    s->stride      = STRIDE / weight;
+    s->queue_depth = queue_depth != 0 ? queue_depth : num_eos_m;
+
+    std::lock_guard<std::mutex> lock(mutex_m);
+    s->pass = vtime_m;
+    streams_m.push_back(std::move(s));
+    return streams_m.size() - 1;
+}
+
+Stream& StreamMultiplexer::Impl::GetStream(int stream) const
+{
+    if (stream < 0 || stream >= (int) streams_m.size())
+        throw Exception("Invalid StreamMultiplexer stream " +
+                        std::to_string(stream),
+                        __FILE__, __FUNCTION__, __LINE__);
+    return *streams_m[stream];
+}
+
+bool StreamMultiplexer::Impl::Submit(int stream, const FrameDescriptor& frame,
+                                     bool block)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        Stream& s = GetStream(stream);
+        if (s.queue.size() >= s.queue_depth)
+        {
+            if (!block)
+            {
+                lock.unlock();
+                s.metrics.FrameDropped();
+                return false;
+            }
+            cv_space_m.wait(lock,
+                            [&s]{ return s.queue.size() < s.queue_depth; });
+        }
+
+        // Do not let a stream bank the share it did not use while idle
+        if (s.queue.empty())
+            s.pass = std::max(s.pass, vtime_m);
+
+        s.queue.push_back(QueuedFrame{frame, TimeStampNow()});
+        num_queued_m++;
+        num_submitted_m++;
+    }
+    cv_work_m.notify_one();
+
+    return true;
+}
+
+void StreamMultiplexer::Impl::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    cv_done_m.wait(lock, [this]{ return num_completed_m == num_submitted_m; });
+}
+
+// Stream with a queued frame and the smallest pass. Ties go to the stream
+// whose next frame was submitted first.
+Stream* StreamMultiplexer::Impl::SelectStream() const
+{
+    Stream* best = nullptr;
+    for (const auto& s : streams_m)
+    {
+        if (s->queue.empty())
+            continue;
+        if (best == nullptr || s->pass < best->pass ||
+            (s->pass == best->pass &&
+             s->queue.front().submit_us < best->queue.front().submit_us))
+            best = s.get();
+    }
+
+    return best;
+}
+
+void StreamMultiplexer::Impl::WorkerLoop(ExecutionObjectInternalInterface* eo,
+                                         DeviceTimeFn device_time)
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        cv_work_m.wait(lock, [this]{ return stop_m || num_queued_m > 0; });
+        if (num_queued_m == 0)
+            break;
+
+        Stream& s = *SelectStream();
+        QueuedFrame q = s.queue.front();
+        s.queue.pop_front();
+        num_queued_m--;
+        vtime_m = s.pass;
+        s.pass += s.stride;
+        s.running++;
+        lock.unlock();
+        cv_space_m.notify_all();
+
+        const FrameDescriptor& frame = q.frame;
+        bool status = RunFrame(*eo, frame, "StreamMultiplexer");
+
+        if (status)
+            s.metrics.FrameCompleted(TimeStampNow() - q.submit_us,
+                                     device_time() * 1000);
+        else
+            s.metrics.FrameFailed();
+
+        NotifyFrame(s.on_complete, frame, *eo, status, "StreamMultiplexer");
+
+        lock.lock();
+        s.running--;
+        num_completed_m++;
+        lock.unlock();
+        cv_done_m.notify_all();
+    }
+}
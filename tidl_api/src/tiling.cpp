@@ -0,0 +1,276 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file tiling.cpp */
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include "tiling.h"
+
+using namespace tidl;
+using namespace tidl::tiling;
+
+// Boxes within this many pixels of a tile edge are cut by the tile
+static const int   EDGE_MARGIN = 2;
+
+// A cut box covered this much by another box of the same label is a part
+// of that object
+static const float CONTAINED   = 0.8f;
+
+// Offsets of the tiles along one dimension, the first at 0 and the last
+// at the end of the frame
+static std::vector<int> TileOffsets(int frame, int tile, int min_overlap)
+{
+    if (frame <= tile)
+        return {0};
+
+    int stride = std::max(1, tile - min_overlap);
+    int n      = 1 + (frame - tile + stride - 1) / stride;
+
+    std::vector<int> offsets(n);
+    for (int i = 0; i < n; i++)
+        offsets[i] = (int) ((int64_t) i * (frame - tile) / (n - 1));
+    return offsets;
+}
+
+std::vector<Tile> tiling::ComputeTiles(int frame_width, int frame_height,
+                                       int tile_width, int tile_height,
+                                       int min_overlap)
+{
+    if (frame_width <= 0 || frame_height <= 0 ||
+        tile_width <= 0 || tile_height <= 0)
+        throw Exception("Invalid frame or tile size",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    std::vector<int> xs = TileOffsets(frame_width, tile_width, min_overlap);
+    std::vector<int> ys = TileOffsets(frame_height, tile_height,
+                                      min_overlap);
+
+    std::vector<Tile> tiles;
+    for (int y : ys)
+        for (int x : xs)
+            tiles.push_back({x, y, std::min(tile_width, frame_width),
+                             std::min(tile_height, frame_height)});
+    return tiles;
+}
+
+bool tiling::ProcessTiles(
+                const std::vector<ExecutionObjectInternalInterface*>& eos,
+                uint32_t num_tiles, FillTile fill, CollectTile collect)
+{
+    if (eos.empty())  return false;
+
+    const uint32_t n = eos.size();
+    std::vector<bool> pending(n, false);
+    bool status = true;
+
+    // One tile in flight per EO/EOP, the tile to start on eos[k] waits for
+    // the previous tile on eos[k]. The last n iterations drain.
+    for (uint32_t i = 0; i < num_tiles + n; i++)
+    {
+        uint32_t k = i % n;
+        ExecutionObjectInternalInterface& eo = *eos[k];
+
+        if (pending[k])
+        {
+            pending[k] = false;
+            if (eo.ProcessFrameWait())
+                collect(eo.GetFrameIndex(), eo);
+            else
+                status = false;
+        }
+
+        if (i >= num_tiles || !fill(i, eo))
+            continue;
+
+        eo.SetFrameIndex(i);
+        if (eo.ProcessFrameStartAsync())
+            pending[k] = true;
+        else
+            status = false;
+    }
+
+    return status;
+}
+
+namespace {
+struct Candidate
+{
+    postproc::DetectedObject object;
+    uint32_t                 tile;
+    bool                     cut;
+};
+
+int Area(const postproc::DetectedObject& o)
+{
+    return std::max(0, o.xmax - o.xmin) * std::max(0, o.ymax - o.ymin);
+}
+
+int Intersection(const postproc::DetectedObject& a,
+                 const postproc::DetectedObject& b)
+{
+    int w = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
+    int h = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+    return (w > 0 && h > 0) ? w * h : 0;
+}
+}
+
+void tiling::MergeDetections(
+            const std::vector<std::vector<postproc::DetectedObject>>& objects,
+            const std::vector<Tile>& tiles, float max_iou,
+            std::vector<postproc::DetectedObject>& merged)
+{
+    int frame_width = 0, frame_height = 0;
+    for (const Tile& t : tiles)
+    {
+        frame_width  = std::max(frame_width,  t.x + t.width);
+        frame_height = std::max(frame_height, t.y + t.height);
+    }
+
+    // Move the boxes to frame coordinates, noting boxes cut by an edge of
+    // their tile inside the frame
+    std::vector<Candidate> c;
+    for (uint32_t t = 0; t < objects.size() && t < tiles.size(); t++)
+    {
+        const Tile& tile = tiles[t];
+        for (postproc::DetectedObject o : objects[t])
+        {
+            bool cut = (tile.x > 0 && o.xmin <= EDGE_MARGIN) ||
+                       (tile.y > 0 && o.ymin <= EDGE_MARGIN) ||
+                       (tile.x + tile.width < frame_width &&
+                        o.xmax >= tile.width - EDGE_MARGIN) ||
+                       (tile.y + tile.height < frame_height &&
+                        o.ymax >= tile.height - EDGE_MARGIN);
+            o.xmin += tile.x;  o.xmax += tile.x;
+            o.ymin += tile.y;  o.ymax += tile.y;
+            c.push_back({o, t, cut});
+        }
+    }
+
+    std::stable_sort(c.begin(), c.end(),
+                     [](const Candidate& a, const Candidate& b)
+                     { return a.object.score > b.object.score; });
+
+    // Greedy by score: drop duplicates from overlapping tiles, drop parts
+    // of an object cut by a tile edge, and join the parts of an object
+    // larger than the overlap that no tile sees whole
+    std::vector<bool> keep(c.size(), true);
+    for (size_t i = 0; i < c.size(); i++)
+    {
+        if (!keep[i])  continue;
+
+        for (size_t j = i + 1; j < c.size(); j++)
+        {
+            if (!keep[j] || c[j].object.label != c[i].object.label)
+                continue;
+
+            postproc::DetectedObject& a = c[i].object;
+            const postproc::DetectedObject& b = c[j].object;
+            int inter = Intersection(a, b);
+            if (inter == 0)  continue;
+
+            int  area_a    = Area(a), area_b = Area(b);
+            bool duplicate = inter > max_iou * (area_a + area_b - inter);
+            if (duplicate && !(c[i].cut && !c[j].cut))
+                keep[j] = false;
+            else if (c[j].cut && inter > CONTAINED * area_b)
+                keep[j] = false;
+            else if (duplicate || (c[i].cut && inter > CONTAINED * area_a))
+            {
+                // Keep the score, take the box of the whole object
+                a.xmin = b.xmin;  a.ymin = b.ymin;
+                a.xmax = b.xmax;  a.ymax = b.ymax;
+                c[i].cut = c[j].cut;
+                keep[j]  = false;
+            }
+            else if (c[i].cut && c[j].cut && c[i].tile != c[j].tile)
+            {
+                a.xmin = std::min(a.xmin, b.xmin);
+                a.ymin = std::min(a.ymin, b.ymin);
+                a.xmax = std::max(a.xmax, b.xmax);
+                a.ymax = std::max(a.ymax, b.ymax);
+                keep[j] = false;
+            }
+        }
+    }
+
+    merged.clear();
+    for (size_t i = 0; i < c.size(); i++)
+        if (keep[i])
+            merged.push_back(c[i].object);
+}
+
+// Start of the range of the frame taken from each tile along one
+// dimension, with the midpoint of each overlap as the boundary
+static std::vector<int> SeamOffsets(const std::vector<int>& offsets,
+                                    int tile, int frame)
+{
+    std::vector<int> starts(offsets.size() + 1);
+    starts[0] = 0;
+    for (size_t i = 1; i < offsets.size(); i++)
+        starts[i] = (offsets[i] + offsets[i - 1] + tile) / 2;
+    starts[offsets.size()] = frame;
+    return starts;
+}
+
+void tiling::StitchClasses(const std::vector<const uint8_t*>& classes,
+                           const std::vector<Tile>& tiles,
+                           int frame_width, int frame_height, uint8_t* out)
+{
+    if (tiles.empty() || classes.size() < tiles.size())
+        throw Exception("A class output is required for each tile",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    // Tiles are a row-major grid of equally sized tiles, see ComputeTiles
+    std::vector<int> xs, ys;
+    for (const Tile& t : tiles)
+    {
+        if (t.y == tiles[0].y)  xs.push_back(t.x);
+        if (t.x == tiles[0].x)  ys.push_back(t.y);
+    }
+    if (xs.size() * ys.size() != tiles.size())
+        throw Exception("Tiles are not a grid",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    const int tw = tiles[0].width, th = tiles[0].height;
+    std::vector<int> x_starts = SeamOffsets(xs, tw, frame_width);
+    std::vector<int> y_starts = SeamOffsets(ys, th, frame_height);
+
+    for (size_t r = 0; r < ys.size(); r++)
+        for (int y = y_starts[r]; y < y_starts[r + 1]; y++)
+            for (size_t k = 0; k < xs.size(); k++)
+            {
+                const uint8_t* src = classes[r * xs.size() + k] +
+                                     (size_t) (y - ys[r]) * tw +
+                                     (x_starts[k] - xs[k]);
+                memcpy(out + (size_t) y * frame_width + x_starts[k], src,
+                       x_starts[k + 1] - x_starts[k]);
+            }
+}
@@ -27,23 +27,305 @@
  *****************************************************************************/
 
 
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 #include "trace.h"
 #include "custom.h"
 
 using namespace tidl;
 
-bool TRACE::enabled = false;
+std::atomic<bool> TRACE::enabled(false);
 
-void TRACE::print(const char *fmt, ...)
+namespace {
+
+const size_t TRACE_CAPACITY     = 2048;  // Power of two
+const size_t TRACE_STRING_BYTES = 96;
+
+struct TraceRecord
+{
+    const char* fmt;
+    int         num_args;
+    TraceArg    args[TRACE::MAX_ARGS];
+    char        strings[TRACE_STRING_BYTES];
+};
+
+// Bounded multi-producer ring buffer. A slot is free for position pos when
+// its sequence is pos, and holds a record when its sequence is pos + 1.
+// Messages are dropped when the buffer is full.
+struct TraceSlot
+{
+    std::atomic<size_t> seq;
+    TraceRecord         record;
+};
+
+// Format one conversion of a format string from the captured argument.
+// The argument is converted to the type expected by the conversion.
+void FormatArg(std::string& out, const std::string& spec,
+               const TraceArg& arg, const char* strings)
+{
+    char   buf[128];
+    char   conv = spec.back();
+    bool   is_long      = spec.find('l') != std::string::npos;
+    bool   is_long_long = spec.find("ll") != std::string::npos;
+    bool   is_size      = spec.find('z') != std::string::npos;
+    long long          i = arg.kind == TraceArg::Kind::DOUBLE ?
+                               (long long) arg.d : arg.i;
+    unsigned long long u = (unsigned long long) i;
+    double             d = arg.kind == TraceArg::Kind::DOUBLE ? arg.d :
+                           arg.kind == TraceArg::Kind::UINT ? (double) arg.u :
+                                                              (double) arg.i;
+
+    switch (conv)
+    {
+        case 'd': case 'i': case 'c':
+            if (is_long_long)  snprintf(buf, sizeof(buf), spec.c_str(), i);
+            else if (is_long)  snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (long) i);
+            else if (is_size)  snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (ssize_t) i);
+            else               snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (int) i);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            if (is_long_long)  snprintf(buf, sizeof(buf), spec.c_str(), u);
+            else if (is_long)  snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (unsigned long) u);
+            else if (is_size)  snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (size_t) u);
+            else               snprintf(buf, sizeof(buf), spec.c_str(),
+                                        (unsigned) u);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            snprintf(buf, sizeof(buf), spec.c_str(), d);
+            break;
+        case 'p':
+            snprintf(buf, sizeof(buf), spec.c_str(),
+                     arg.kind == TraceArg::Kind::PTR ? arg.p
+                                                     : (const void *) u);
+            break;
+        case 's':
+            snprintf(buf, sizeof(buf), spec.c_str(),
+                     arg.kind == TraceArg::Kind::STR ? strings + arg.u
+                                                     : "(?)");
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "%s", spec.c_str());
+            break;
+    }
+    out += buf;
+}
+
+void Format(std::string& out, const TraceRecord& r)
+{
+    const char* conversions = "diouxXeEfFgGcsp";
+    const char* f = r.fmt;
+    int n = 0;
+    while (*f)
+    {
+        if (*f != '%')
+        {
+            out += *f++;
+            continue;
+        }
+
+        if (f[1] == '%')
+        {
+            out += '%';
+            f += 2;
+            continue;
+        }
+
+        size_t len = 1;
+        while (f[len] && strchr(conversions, f[len]) == nullptr)
+            len++;
+        if (f[len] == '\0')
+        {
+            out += f;
+            break;
+        }
+
+        std::string spec(f, len + 1);
+        if (n < r.num_args)
+            FormatArg(out, spec, r.args[n++], r.strings);
+        else
+            out += spec;
+        f += len + 1;
+    }
+}
+
+class TraceLog
+{
+    public:
+        TraceLog();
+        ~TraceLog();
+
+        void Record(const char* fmt, const TraceArg* args, int num_args);
+        void Start();
+        void Flush();
+
+    private:
+        void FlushLoop();
+
+        std::unique_ptr<TraceSlot[]> slots_m;
+        std::atomic<size_t>          head_m;
+        size_t                       tail_m;
+        std::atomic<uint64_t>        dropped_m;
+
+        std::mutex                   mutex_m;  // Consumer side
+        std::mutex                   flush_mutex_m;
+        std::condition_variable      cv_m;
+        bool                         stop_m;
+        std::thread                  flush_thread_m;
+};
+
+TraceLog::TraceLog(): slots_m(new TraceSlot[TRACE_CAPACITY]), head_m(0),
+                      tail_m(0), dropped_m(0), stop_m(false)
+{
+    for (size_t i = 0; i < TRACE_CAPACITY; i++)
+        slots_m[i].seq.store(i, std::memory_order_relaxed);
+}
+
+TraceLog::~TraceLog()
+{
+    TRACE::enabled = false;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_m);
+        stop_m = true;
+    }
+    cv_m.notify_all();
+    if (flush_thread_m.joinable())
+        flush_thread_m.join();
+
+    Flush();
+}
+
+void TraceLog::Start()
 {
-    if (!enabled)
-        return;
+    std::lock_guard<std::mutex> lock(flush_mutex_m);
+    if (!flush_thread_m.joinable() && !stop_m)
+        flush_thread_m = std::thread(&TraceLog::FlushLoop, this);
+}
+
+void TraceLog::Record(const char* fmt, const TraceArg* args, int num_args)
+{
+    size_t     pos  = head_m.load(std::memory_order_relaxed);
+    TraceSlot* slot = nullptr;
+    while (true)
+    {
+        slot = &slots_m[pos & (TRACE_CAPACITY - 1)];
+        size_t   seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+        if (dif == 0)
+        {
+            if (head_m.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            dropped_m++;
+            return;
+        }
+        else
+            pos = head_m.load(std::memory_order_relaxed);
+    }
+
+    // Copy string arguments, the record refers to them by offset
+    TraceRecord& r = slot->record;
+    size_t offset  = 0;
+    r.fmt      = fmt;
+    r.num_args = num_args;
+    for (int i = 0; i < num_args; i++)
+    {
+        r.args[i] = args[i];
+        if (args[i].kind != TraceArg::Kind::STR)
+            continue;
+
+        const char* s   = args[i].s ? args[i].s : "(null)";
+        size_t      len = std::min(strlen(s),
+                                   TRACE_STRING_BYTES - 1 - offset);
+        memcpy(r.strings + offset, s, len);
+        r.strings[offset + len] = '\0';
+        r.args[i].u = offset;
+        offset += len + (offset + len < TRACE_STRING_BYTES - 1 ? 1 : 0);
+    }
+
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    // Wake the flush thread early during bursts
+    if ((pos & (TRACE_CAPACITY / 4 - 1)) == 0)
+        cv_m.notify_one();
+}
+
+void TraceLog::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+
+    std::string out;
+    while (true)
+    {
+        TraceSlot& slot = slots_m[tail_m & (TRACE_CAPACITY - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != tail_m + 1)
+            break;
+
+        Format(out, slot.record);
+        slot.seq.store(tail_m + TRACE_CAPACITY, std::memory_order_release);
+        tail_m++;
+    }
+
+    uint64_t dropped = dropped_m.exchange(0);
+    if (dropped != 0)
+        out += "TIDL API Trace: " + std::to_string(dropped) +
+               " messages dropped\n";
+
+    if (!out.empty())
+    {
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+}
 
-    std::va_list ap;
-    va_start(ap, fmt);
-    std::vprintf(fmt, ap);
-    va_end(ap);
-    std::fflush(stdout);
+void TraceLog::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(flush_mutex_m);
+    while (!stop_m)
+    {
+        cv_m.wait_for(lock, std::chrono::milliseconds(100));
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
+
+TraceLog& Log()
+{
+    static TraceLog log;
+    return log;
+}
+
+} // namespace
+
+void TRACE::enable(bool on)
+{
+    if (on)
+        Log().Start();
+    enabled = on;
+}
+
+void TRACE::flush()
+{
+    Log().Flush();
+}
+
+void TRACE::record(const char *fmt, const TraceArg* args, int num_args)
+{
+    Log().Record(fmt, args, num_args);
 }
 
 void tidl::EnableExecutionTrace(const Configuration& config,
@@ -29,20 +29,81 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
 #include "configuration.h"
 
 namespace tidl {
 
-/// Used to emit trace messages from runtime
+//! Argument of a trace message, captured when the message is recorded
+struct TraceArg
+{
+    enum class Kind : uint8_t { NONE, INT, UINT, DOUBLE, PTR, STR };
+
+    TraceArg()                     : kind(Kind::NONE),   u(0) {}
+    TraceArg(int v)                : kind(Kind::INT),    i(v) {}
+    TraceArg(long v)               : kind(Kind::INT),    i(v) {}
+    TraceArg(long long v)          : kind(Kind::INT),    i(v) {}
+    TraceArg(unsigned v)           : kind(Kind::UINT),   u(v) {}
+    TraceArg(unsigned long v)      : kind(Kind::UINT),   u(v) {}
+    TraceArg(unsigned long long v) : kind(Kind::UINT),   u(v) {}
+    TraceArg(double v)             : kind(Kind::DOUBLE), d(v) {}
+    TraceArg(const char* v)        : kind(Kind::STR),    s(v) {}
+    TraceArg(char* v)              : kind(Kind::STR),    s(v) {}
+    TraceArg(std::nullptr_t)       : kind(Kind::PTR),    p(nullptr) {}
+    template <typename T>
+    TraceArg(T* v)                 : kind(Kind::PTR),    p(v) {}
+
+    Kind kind;
+    union
+    {
+        long long          i;
+        unsigned long long u;
+        double             d;
+        const void*        p;
+        const char*        s;
+    };
+};
+
+/// Used to emit trace messages from runtime. Messages are recorded into a
+/// ring buffer and formatted to stdout by a background thread. Define
+/// TIDL_API_NO_TRACE to compile out all trace messages.
 class TRACE
 {
     public:
-        static void print(const char *fmt, ...);
-        static bool enabled;
+        static const int MAX_ARGS = 8;
+
+        //! Record a trace message. fmt must be a string literal, string
+        //! arguments are copied (and may be truncated).
+        template <typename... Args>
+        static void print(const char *fmt, Args... args)
+        {
+#ifndef TIDL_API_NO_TRACE
+            static_assert(sizeof...(Args) <= MAX_ARGS,
+                          "Too many trace arguments");
+            if (!enabled.load(std::memory_order_relaxed))
+                return;
+
+            const TraceArg a[] = { TraceArg(args)..., TraceArg() };
+            record(fmt, a, sizeof...(Args));
+#endif
+        }
+
+        //! Enable or disable recording of trace messages
+        static void enable(bool on);
+
+        //! Format and write all recorded messages
+        static void flush();
+
+        static std::atomic<bool> enabled;
+
+    private:
+        static void record(const char *fmt, const TraceArg* args,
+                           int num_args);
 };
 
 void EnableExecutionTrace(const Configuration& config,
                           uint32_t* enableDeviceTrace);
 
 }
-
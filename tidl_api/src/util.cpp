@@ -27,151 +27,471 @@
  *****************************************************************************/
 
 #include "util.h"
+#include "network_binary.h"
 #include <iostream>
 #include <fstream>
 #include <assert.h>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <set>
+#include <tuple>
 #include <cstring>
 #include <memory>
 
-namespace tidl {
-bool EnableTimeStamps(const std::string& file, size_t num_frames);
-}
-
 using namespace tidl;
 
 using namespace std::chrono;
 
-std::unique_ptr<TimeStamp> tidl_api_timestamps(nullptr);
+typedef TimeStampRecorder::API   API;
+typedef TimeStampRecorder::Phase Phase;
 
-bool tidl::EnableTimeStamps(const std::string& file, size_t num_frames)
+std::unique_ptr<TimeStampRecorder> tidl_api_timestamps(nullptr);
+
+bool tidl::EnableTimeStamps(const std::string& file, size_t num_frames,
+                            TimeStampFormat format)
 {
-    std::mutex m;
+    static std::mutex m;
     std::lock_guard<std::mutex> guard(m);
 
     if (tidl_api_timestamps.get() != nullptr)
         return true;
 
-    tidl_api_timestamps.reset(new TimeStamp(file, num_frames));
+    tidl_api_timestamps.reset(new TimeStampRecorder(file, num_frames,
+                                                    format));
     if (tidl_api_timestamps.get() == nullptr)
         return false;
 
     return true;
 }
 
-TimeStamp::TimeStamp(const std::string& file, int num_entries):
-                        num_entries_m(num_entries), file_m(file)
+uint64_t tidl::TimeStampNow()
 {
-    entries_m = new Entry[num_entries_m];
-    if (entries_m)
-        std::memset(entries_m, 0, sizeof(Entry)*num_entries_m);
+    return duration_cast<microseconds>
+                 (high_resolution_clock::now().time_since_epoch()).count();
 }
 
-void TimeStamp::Update(int frame_idx, EventKind k, int type, int id)
+uint32_t tidl::NewPipelineId()
 {
-    if (!entries_m)
-        return;
+    static std::atomic<uint32_t> next_id(1);
+    return next_id++;
+}
 
-    int idx = frame_idx % num_entries_m;
+bool tidl::TimeStampsEnabled()
+{
+    return tidl_api_timestamps.get() != nullptr;
+}
 
-    entries_m[idx].frame_idx = frame_idx;
-    entries_m[idx].timestamp[k] = duration_cast<microseconds>
-                 (high_resolution_clock::now().time_since_epoch()).count();
+void tidl::RecordEvent(int frame_idx, uint32_t pipeline, int stage,
+                       API api, Phase phase, int eo_type, int eo_id,
+                       int context_idx, uint64_t timestamp)
+{
+    TimeStampRecorder* t = tidl_api_timestamps.get();
+    if (t)
+        t->Record(frame_idx, pipeline, stage, context_idx, api, phase,
+                  timestamp != 0 ? timestamp : TimeStampNow(),
+                  eo_type, eo_id);
+}
 
-    if (k == EO1_PFSA_START)
-    {
-        entries_m[idx].eo1_id   = id;
-        entries_m[idx].eo1_type = type;
-    }
-    else if (k == EO2_PFSA_START)
-    {
-        entries_m[idx].eo2_id   = id;
-        entries_m[idx].eo2_type = type;
-    }
+namespace {
+
+struct Event
+{
+    uint64_t timestamp;
+    int32_t  frame_idx;
+    uint32_t pipeline;
+    int16_t  stage;
+    int16_t  context_idx;
+    API      api;
+    Phase    phase;
+    int8_t   eo_type;
+    int8_t   eo_id;
+};
+
+const char* ApiName(API api)
+{
+    static const char* names[] = { "PFSA", "PFW", "RAN",
+                                   "CopyIn", "CopyOut", "Device",
+                                   "Config", "AutoSizeHeaps", "DeviceCreate",
+                                   "ReadNetwork", "ReadParams", "SetupKernel",
+                                   "CreateEO", "InitKernel" };
+    return names[static_cast<int>(api)];
 }
 
-void TimeStamp::Zero(int frame_idx, EventKind k)
+// Single producer (the recording thread), single consumer (the flush
+// thread) ring buffer. head_m and tail_m increase monotonically and are
+// masked on access.
+class EventBuffer
 {
-    if (!entries_m)
-        return;
+    public:
+        explicit EventBuffer(size_t capacity):
+            events_m(capacity), mask_m(capacity - 1),
+            head_m(0), tail_m(0), orphaned_m(false) {}
 
-    int idx = frame_idx % num_entries_m;
+        bool Push(const Event& e)
+        {
+            size_t head = head_m.load(std::memory_order_relaxed);
+            size_t tail = tail_m.load(std::memory_order_acquire);
+            if (head - tail == events_m.size())
+                return false;
+
+            events_m[head & mask_m] = e;
+            head_m.store(head + 1, std::memory_order_release);
+            return true;
+        }
 
-    entries_m[idx].frame_idx    = frame_idx;
-    entries_m[idx].timestamp[k] = 0;
-}
+        template <typename F>
+        void Drain(F f)
+        {
+            size_t tail = tail_m.load(std::memory_order_relaxed);
+            size_t head = head_m.load(std::memory_order_acquire);
+            for (; tail != head; tail++)
+                f(events_m[tail & mask_m]);
+            tail_m.store(tail, std::memory_order_release);
+        }
+
+        bool IsEmpty() const
+        {
+            return head_m.load(std::memory_order_acquire) ==
+                   tail_m.load(std::memory_order_acquire);
+        }
+
+        void SetOrphaned() { orphaned_m = true; }
+        bool IsOrphaned() const { return orphaned_m; }
+
+    private:
+        std::vector<Event>  events_m;
+        size_t              mask_m;
+        std::atomic<size_t> head_m;
+        std::atomic<size_t> tail_m;
+        std::atomic<bool>   orphaned_m;
+};
+
+// Per-thread handle to the thread's buffer in the current recorder. The
+// buffer is shared with the recorder so that events recorded just before
+// the thread exits are still flushed.
+struct ThreadBuffer
+{
+    ThreadBuffer(): generation(0) {}
+    ~ThreadBuffer() { if (buffer) buffer->SetOrphaned(); }
 
+    std::shared_ptr<EventBuffer> buffer;
+    uint64_t                     generation;
+};
 
-TimeStamp::~TimeStamp()
+thread_local ThreadBuffer thread_buffer;
+
+std::atomic<uint64_t> recorder_generation(0);
+
+// Writes events to the log file. Called only from the flush thread, or
+// from the recorder destructor after the flush thread has stopped.
+class EventWriter
+{
+    public:
+        explicit EventWriter(const std::string& file):
+            ofs_m(file, std::ofstream::out | std::ofstream::trunc) {}
+        virtual ~EventWriter() {}
+
+        virtual void Write(const Event& e) = 0;
+        void Flush() { ofs_m.flush(); }
+
+    protected:
+        std::ofstream ofs_m;
+};
+
+// frame,EOP:PFSA:Start,timestamp,device type,device index,pipeline
+class CsvWriter : public EventWriter
+{
+    public:
+        explicit CsvWriter(const std::string& file): EventWriter(file) {}
+
+        void Write(const Event& e) override
+        {
+            ofs_m << e.frame_idx << ",";
+
+            if (e.stage == TimeStampRecorder::PIPELINE_STAGE)
+                ofs_m << "EOP:";
+            else
+                ofs_m << "EO" << e.stage << ":";
+
+            ofs_m << ApiName(e.api)
+                  << (e.phase == Phase::START ? ":Start" : ":End")
+                  << "," << e.timestamp
+                  << "," << static_cast<int>(e.eo_type)
+                  << "," << static_cast<int>(e.eo_id)
+                  << "," << e.pipeline
+                  << "\n";
+        }
+};
+
+// Chrome trace event format, JSON array of complete ("X") events. A
+// START may be flushed after its END if they were recorded on different
+// threads, so whichever arrives first waits for the other. The closing
+// bracket is written on destruction; viewers also accept a trace
+// without it if the application does not exit cleanly.
+class ChromeTraceWriter : public EventWriter
 {
-    if (!entries_m)
-        return;
+    public:
+        explicit ChromeTraceWriter(const std::string& file):
+            EventWriter(file), num_events_m(0)
+        {
+            ofs_m << "[";
+        }
 
-    std::ofstream ofs;
-    ofs.open(file_m, std::ofstream::out);
+        ~ChromeTraceWriter()
+        {
+            ofs_m << "\n]\n";
+        }
 
-    for (int i=0; i < num_entries_m; i++)
-        for (int j=0; j < EventKind::NUM_EVENTS; j++)
-            if (entries_m[i].timestamp[j] != 0)
+        void Write(const Event& e) override
+        {
+            EventKey key(TrackKey(e.pipeline, e.stage, e.eo_type, e.eo_id,
+                                  e.context_idx), e.api, e.frame_idx);
+
+            PendingEvents& waiting = (e.phase == Phase::START) ? ends_m
+                                                               : starts_m;
+            PendingEvents& pending = (e.phase == Phase::START) ? starts_m
+                                                               : ends_m;
+            auto it = waiting.find(key);
+            if (it == waiting.end())
             {
-                ofs << entries_m[i].frame_idx << ",";
-                switch (j)
-                {
-                    case EOP_PFSA_START: ofs << "EOP:PFSA:Start"; break;
-                    case EOP_PFSA_END:   ofs << "EOP:PFSA:End"; break;
-                    case EOP_PFW_START:  ofs << "EOP:PFW:Start"; break;
-                    case EOP_PFW_END:    ofs << "EOP:PFW:End"; break;
-                    case EOP_RAN_START:  ofs << "EOP:RAN:Start"; break;
-                    case EOP_RAN_END:    ofs << "EOP:RAN:End"; break;
-
-                    case EO1_PFSA_START: ofs << "EO1:PFSA:Start"; break;
-                    case EO1_PFSA_END:   ofs << "EO1:PFSA:End"; break;
-                    case EO1_PFW_START:  ofs << "EO1:PFW:Start"; break;
-                    case EO1_PFW_END:    ofs << "EO1:PFW:End"; break;
-
-                    case EO2_PFSA_START: ofs << "EO2:PFSA:Start"; break;
-                    case EO2_PFSA_END:   ofs << "EO2:PFSA:End"; break;
-                    case EO2_PFW_START:  ofs << "EO2:PFW:Start"; break;
-                    case EO2_PFW_END:    ofs << "EO2:PFW:End"; break;
-
-                    default:             ofs << "UNKNOWN"; break;
-                }
-                ofs << "," << entries_m[i].timestamp[j];
+                pending[key] = e.timestamp;
+                return;
+            }
 
-                if (j == EO1_PFSA_START)
-                {
-                    ofs << "," << entries_m[i].eo1_type
-                        << "," << entries_m[i].eo1_id;
-                }
-                else if (j == EO2_PFSA_START)
-                {
-                    ofs << "," << entries_m[i].eo2_type
-                        << "," << entries_m[i].eo2_id;
-                }
+            uint64_t start = (e.phase == Phase::START) ? e.timestamp
+                                                       : it->second;
+            uint64_t end   = (e.phase == Phase::START) ? it->second
+                                                       : e.timestamp;
+            waiting.erase(it);
+
+            WriteComplete(e, start, end);
+        }
 
+    private:
+        // pipeline, stage, device type, device index, context
+        typedef std::tuple<uint32_t, int, int, int, int> TrackKey;
+        typedef std::tuple<TrackKey, API, int>           EventKey;
+        typedef std::map<EventKey, uint64_t>             PendingEvents;
 
-                ofs << std::endl;
+        void Separator()
+        {
+            ofs_m << (num_events_m++ == 0 ? "\n" : ",\n");
+        }
+
+        int GetTrack(const Event& e)
+        {
+            TrackKey key(e.pipeline, e.stage, e.eo_type, e.eo_id,
+                         e.context_idx);
+            auto it = tracks_m.find(key);
+            if (it != tracks_m.end())
+                return it->second;
+
+            int tid = tracks_m.size() + 1;
+            tracks_m[key] = tid;
+
+            if (pipelines_m.insert(e.pipeline).second)
+            {
+                Separator();
+                ofs_m << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"
+                      << e.pipeline << ",\"args\":{\"name\":\"";
+                if (e.pipeline == 0)
+                    ofs_m << "ExecutionObjects";
+                else
+                    ofs_m << "ExecutionObjectPipeline " << e.pipeline;
+                ofs_m << "\"}}";
             }
 
-    ofs.close();
-    delete [] entries_m;
+            Separator();
+            ofs_m << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+                  << e.pipeline << ",\"tid\":" << tid
+                  << ",\"args\":{\"name\":\"";
+            if (e.stage == TimeStampRecorder::PIPELINE_STAGE)
+                ofs_m << "EOP slot " << e.context_idx;
+            else
+            {
+                ofs_m << "EO" << e.stage << " "
+                      << (e.eo_type == static_cast<int>(DeviceType::EVE) ?
+                          "EVE" : "DSP")
+                      << (e.eo_id + 1);
+
+                // Executor startup phases are not recorded by a context
+                if (e.context_idx < 0)
+                    ofs_m << " startup";
+                else
+                    ofs_m << " context " << e.context_idx;
+            }
+            ofs_m << "\"}}";
+
+            Separator();
+            ofs_m << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":"
+                  << e.pipeline << ",\"tid\":" << tid
+                  << ",\"args\":{\"sort_index\":" << tid << "}}";
+
+            return tid;
+        }
+
+        void WriteComplete(const Event& e, uint64_t start, uint64_t end)
+        {
+            int tid = GetTrack(e);
+
+            Separator();
+            ofs_m << "{\"name\":\"" << ApiName(e.api) << "\",\"cat\":\""
+                  << (e.api == API::DEVICE ? "device" : "host")
+                  << "\",\"ph\":\"X\",\"ts\":" << start
+                  << ",\"dur\":" << (end > start ? end - start : 0)
+                  << ",\"pid\":" << e.pipeline << ",\"tid\":" << tid
+                  << ",\"args\":{\"frame\":" << e.frame_idx << "}}";
+        }
+
+        size_t                  num_events_m;
+        std::map<TrackKey, int> tracks_m;
+        std::set<uint32_t>      pipelines_m;
+        PendingEvents           starts_m;
+        PendingEvents           ends_m;
+};
+
+} // namespace
+
+class TimeStampRecorder::Impl
+{
+    public:
+        Impl(const std::string& file, size_t num_frames,
+             TimeStampFormat format);
+        ~Impl();
+
+        EventBuffer* GetThreadBuffer();
+        void         FlushLoop();
+        void         Flush();
+
+        size_t                                    capacity_m;
+        uint64_t                                  generation_m;
+        std::unique_ptr<EventWriter>              writer_m;
+
+        std::mutex                                mutex_m;
+        std::vector<std::shared_ptr<EventBuffer>> buffers_m;
+
+        std::mutex                                flush_mutex_m;
+        std::condition_variable                   cv_m;
+        bool                                      stop_m;
+        std::thread                               flush_thread_m;
+
+        std::atomic<uint64_t>                     dropped_m;
+};
+
+TimeStampRecorder::Impl::Impl(const std::string& file, size_t num_frames,
+                              TimeStampFormat format):
+    capacity_m(1024), generation_m(++recorder_generation),
+    stop_m(false), dropped_m(0)
+{
+    if (format == TimeStampFormat::CHROME_TRACE)
+        writer_m.reset(new ChromeTraceWriter(file));
+    else
+        writer_m.reset(new CsvWriter(file));
+
+    // Room for 16 events per frame, rounded up to a power of two
+    while (capacity_m < num_frames * 16)
+        capacity_m <<= 1;
+
+    flush_thread_m = std::thread(&Impl::FlushLoop, this);
 }
 
+TimeStampRecorder::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_m);
+        stop_m = true;
+    }
+    cv_m.notify_all();
+    flush_thread_m.join();
+
+    Flush();
+}
 
-void tidl::RecordEvent(int frame_idx, TimeStamp::EventKind k,
-                       int eo_type, int eo_id)
+EventBuffer* TimeStampRecorder::Impl::GetThreadBuffer()
 {
-    TimeStamp* t = tidl_api_timestamps.get();
-    if (t)
-        t->Update(frame_idx, k, eo_type, eo_id);
+    if (thread_buffer.generation != generation_m)
+    {
+        if (thread_buffer.buffer)
+            thread_buffer.buffer->SetOrphaned();
+
+        thread_buffer.buffer = std::make_shared<EventBuffer>(capacity_m);
+        thread_buffer.generation = generation_m;
+
+        std::lock_guard<std::mutex> lock(mutex_m);
+        buffers_m.push_back(thread_buffer.buffer);
+    }
+
+    return thread_buffer.buffer.get();
 }
 
-void tidl::ResetEvent(int frame_idx, TimeStamp::EventKind k)
+void TimeStampRecorder::Impl::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(flush_mutex_m);
+    while (!stop_m)
+    {
+        cv_m.wait_for(lock, milliseconds(100));
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
+
+void TimeStampRecorder::Impl::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+
+    for (auto it = buffers_m.begin(); it != buffers_m.end(); )
+    {
+        // Read the flag before draining: events recorded before the thread
+        // exited are then guaranteed to be drained below
+        bool orphaned = (*it)->IsOrphaned();
+        (*it)->Drain([this](const Event& e) { writer_m->Write(e); });
+
+        if (orphaned && (*it)->IsEmpty())
+            it = buffers_m.erase(it);
+        else
+            ++it;
+    }
+
+    writer_m->Flush();
+}
+
+TimeStampRecorder::TimeStampRecorder(const std::string& file,
+                                     size_t num_frames,
+                                     TimeStampFormat format):
+    pimpl_m(new Impl(file, num_frames, format))
 {
-    TimeStamp* t = tidl_api_timestamps.get();
-    if (t)
-        t->Zero(frame_idx, k);
+}
+
+TimeStampRecorder::~TimeStampRecorder() = default;
+
+void TimeStampRecorder::Record(int frame_idx, uint32_t pipeline, int stage,
+                               int context_idx, API api, Phase phase,
+                               uint64_t timestamp, int eo_type, int eo_id)
+{
+    Event e;
+    e.timestamp   = timestamp;
+    e.frame_idx   = frame_idx;
+    e.pipeline    = pipeline;
+    e.stage       = stage;
+    e.context_idx = context_idx;
+    e.api         = api;
+    e.phase       = phase;
+    e.eo_type     = eo_type;
+    e.eo_id       = eo_id;
+
+    if (!pimpl_m->GetThreadBuffer()->Push(e))
+        pimpl_m->dropped_m++;
+}
+
+uint64_t TimeStampRecorder::GetNumEventsDropped() const
+{
+    return pimpl_m->dropped_m;
 }
 
 std::size_t tidl::GetBinaryFileSize(const std::string &F)
@@ -223,6 +543,10 @@ bool tidl::ReadBinary(const std::string &F, char* buffer, int size)
 
 bool tidl::ReadNetworkBinary(const std::string &F, char *buffer)
 {
+    /* Read compact container, see network_binary.h */
+    if (IsCompactNetworkBinary(F))
+        return ReadCompactNetwork(F, (sTIDL_Network_t *) buffer);
+
     std::size_t fsize = GetBinaryFileSize(F);
 
     /* Read binary network format in the latest TIDL-API (1.3.x or later) */
@@ -259,6 +583,20 @@ void tidl::ConvertFromNetwork_1_2(sTIDL_Network_t *new_net,
     }
 }
 
+// 64-bit FNV-1a. Pass the result of a previous call as the seed to hash
+// multiple buffers.
+uint64_t tidl::HashBytes(const void *data, std::size_t size, uint64_t seed)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = seed;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
 bool tidl::CompareFiles(const std::string &F1, const std::string &F2)
 {
     std::size_t s1 = GetBinaryFileSize(F1);
@@ -30,7 +30,10 @@
 
 #include <string>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include "configuration.h"
+#include "executor.h"
 #include "tidl_create_params.h"
 
 namespace tidl {
@@ -41,48 +44,87 @@ bool        ReadNetworkBinary (const std::string &F, char* buffer);
 void        ConvertFromNetwork_1_2(sTIDL_Network_t *new_net,
                                    sTIDL_1_2_Network_t *old_net);
 bool        CompareFiles      (const std::string &F1, const std::string &F2);
+uint64_t    HashBytes         (const void *data, std::size_t size,
+                               uint64_t seed = 14695981039346656037ULL);
 bool        CompareFrames(const std::string &F1, const std::string &F2,
                          int numFrames, int width, int height);
 
-class TimeStamp
+/*! @class TimeStampRecorder
+ *  @brief Records time stamps of TIDL API events, see EnableTimeStamps.
+ *
+ *  Each thread records into its own lock-free ring buffer, so recording
+ *  does not synchronize the application thread with the OpenCL callback
+ *  threads. A flush thread periodically drains the buffers and appends to
+ *  the log file, so time stamps can be left enabled for long runs. If a
+ *  buffer is full when an event is recorded, the event is dropped.
+ *
+ *  Events are keyed by pipeline, stage, context and API. Stage 0 is the
+ *  ExecutionObjectPipeline, stage n is the EO running layersGroupId n.
+ *  The log is written in the given TimeStampFormat:
+ *  - CSV: frame index, component:API:phase, time stamp (us), device type,
+ *    device index, pipeline. The component is EOP for stage 0 and EO<n>
+ *    for stage n.
+ *  - CHROME_TRACE: one process per pipeline, one track per EOP slot and
+ *    per EO context. START and END events are paired into complete events.
+ */
+class TimeStampRecorder
 {
     public:
-        enum EventKind { EOP_PFSA_START=0, EOP_PFSA_END,
-                         EOP_PFW_START,    EOP_PFW_END,
-                         EOP_RAN_START,    EOP_RAN_END,
-                         EO1_PFSA_START,   EO1_PFSA_END,
-                         EO1_PFW_START,    EO1_PFW_END,
-                         EO2_PFSA_START,   EO2_PFSA_END,
-                         EO2_PFW_START,    EO2_PFW_END,
-                         NUM_EVENTS };
-        struct Entry
-        {
-            unsigned int       eo1_type;
-            unsigned int       eo1_id;
-            unsigned int       eo2_type;
-            unsigned int       eo2_id;
-            unsigned long long frame_idx;
-            unsigned long long timestamp[EventKind::NUM_EVENTS];
-        };
-
-
-        TimeStamp(const std::string& file, int num_entries);
-        ~TimeStamp();
-        void Update(int frame_idx, EventKind k, int type=0, int id=0);
-        void Zero  (int frame_idx, EventKind k);
-
-        TimeStamp(const TimeStamp&)            = delete;
-        TimeStamp& operator=(const TimeStamp&) = delete;
+        enum class API : uint8_t { PFSA=0,   //!< ProcessFrameStartAsync
+                                   PFW,      //!< ProcessFrameWait
+                                   RAN,      //!< EOP RunAsyncNext
+                                   COPY_IN,  //!< Host write of EO input
+                                   COPY_OUT, //!< Host read of EO output
+                                   DEVICE,   //!< Device process cycles
+                                   // Executor startup, see StartupTiming
+                                   CONFIG,        //!< Configuration
+                                   AUTO_SIZE,     //!< autoSizeHeaps pass
+                                   DEVICE_CREATE, //!< Device::Create
+                                   READ_NETWORK,  //!< Network binary
+                                   READ_PARAMS,   //!< Parameter binary
+                                   SETUP_KERNEL,  //!< PARAM heap setup
+                                   CREATE_EO,     //!< ExecutionObject
+                                   INIT_KERNEL,   //!< EO initialization
+                                   NUM_APIS };
+        enum class Phase : uint8_t { START=0, END };
+
+        //! Stage of events recorded by an ExecutionObjectPipeline
+        static const int PIPELINE_STAGE = 0;
+
+        TimeStampRecorder(const std::string& file, size_t num_frames,
+                          TimeStampFormat format);
+        ~TimeStampRecorder();
+
+        void Record(int frame_idx, uint32_t pipeline, int stage,
+                    int context_idx, API api, Phase phase,
+                    uint64_t timestamp, int eo_type, int eo_id);
+
+        //! @return Number of events dropped because a buffer was full
+        uint64_t GetNumEventsDropped() const;
+
+        TimeStampRecorder(const TimeStampRecorder&)            = delete;
+        TimeStampRecorder& operator=(const TimeStampRecorder&) = delete;
 
     private:
-        Entry*            entries_m;
-        const int         num_entries_m;
-        const std::string file_m;
+        class Impl;
+        std::unique_ptr<Impl> pimpl_m;
 };
 
+//! @return Current time stamp in microseconds
+uint64_t TimeStampNow();
+
+//! @return Identifier for a new ExecutionObjectPipeline in the time stamp
+//! log. Standalone ExecutionObjects use pipeline 0.
+uint32_t NewPipelineId();
+
+//! @return true if time stamps are enabled
+bool TimeStampsEnabled();
 
-void RecordEvent(int frame_idx, TimeStamp::EventKind k,
-                 int eo_type=0, int eo_id=0);
+//! Record an event if time stamps are enabled. context_idx is the EO
+//! context or EOP slot. Uses the current time if timestamp is 0.
+void RecordEvent(int frame_idx, uint32_t pipeline, int stage,
+                 TimeStampRecorder::API api, TimeStampRecorder::Phase phase,
+                 int eo_type=0, int eo_id=0, int context_idx=0,
+                 uint64_t timestamp=0);
 
-void ResetEvent(int frame_idx, TimeStamp::EventKind k);
 } // namespace tidl
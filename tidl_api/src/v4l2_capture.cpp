@@ -0,0 +1,249 @@
+/******************************************************************************
+ * Copyright (c) 2018 Texas Instruments Incorporated - http://www.ti.com/
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of Texas Instruments Incorporated nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *  THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/*! \file v4l2_capture.cpp */
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+
+#include "v4l2_capture.h"
+#include "buffer_pool.h"
+
+using namespace tidl;
+
+class V4L2Capture::Impl
+{
+    public:
+        Impl(const std::string& device, uint32_t width, uint32_t height,
+             uint32_t pixel_format, uint32_t num_buffers);
+        ~Impl();
+
+        bool DequeueFrame(ArgInfo& frame);
+        void QueueFrame(const ArgInfo& frame);
+
+        void Open(uint32_t width, uint32_t height, uint32_t pixel_format,
+                  uint32_t num_buffers);
+        void Queue(uint32_t index);
+        void Ioctl(unsigned long request, void* arg, const char* name);
+
+        std::string        device_m;
+        int                fd_m;
+        uint32_t           width_m;
+        uint32_t           height_m;
+        uint32_t           bytes_per_line_m;
+        size_t             frame_size_m;
+
+        // Capture buffers, indexed by V4L2 buffer index. Owned by pool_m,
+        // which is destroyed after streaming has stopped.
+        BufferPool         pool_m;
+        std::vector<char*> buffers_m;
+        size_t             buffer_size_m;
+};
+
+V4L2Capture::V4L2Capture(const std::string& device, uint32_t width,
+                         uint32_t height, uint32_t pixel_format,
+                         uint32_t num_buffers):
+    pimpl_m(new Impl(device, width, height, pixel_format, num_buffers))
+{}
+
+V4L2Capture::~V4L2Capture() = default;
+
+bool V4L2Capture::DequeueFrame(ArgInfo& frame)
+{
+    return pimpl_m->DequeueFrame(frame);
+}
+
+void V4L2Capture::QueueFrame(const ArgInfo& frame)
+{
+    pimpl_m->QueueFrame(frame);
+}
+
+uint32_t V4L2Capture::GetWidth() const
+{
+    return pimpl_m->width_m;
+}
+
+uint32_t V4L2Capture::GetHeight() const
+{
+    return pimpl_m->height_m;
+}
+
+uint32_t V4L2Capture::GetBytesPerLine() const
+{
+    return pimpl_m->bytes_per_line_m;
+}
+
+size_t V4L2Capture::GetFrameSize() const
+{
+    return pimpl_m->frame_size_m;
+}
+
+
+V4L2Capture::Impl::Impl(const std::string& device, uint32_t width,
+                        uint32_t height, uint32_t pixel_format,
+                        uint32_t num_buffers):
+    device_m(device), fd_m(-1), width_m(0), height_m(0),
+    bytes_per_line_m(0), frame_size_m(0), buffer_size_m(0)
+{
+    fd_m = open(device.c_str(), O_RDWR);
+    if (fd_m < 0)
+        throw Exception("Unable to open " + device + ": " + strerror(errno),
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    // The destructor does not run if the constructor throws
+    try
+    {
+        Open(width, height, pixel_format, num_buffers);
+    }
+    catch (...)
+    {
+        close(fd_m);
+        throw;
+    }
+}
+
+V4L2Capture::Impl::~Impl()
+{
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ioctl(fd_m, VIDIOC_STREAMOFF, &type);
+    close(fd_m);
+}
+
+void V4L2Capture::Impl::Ioctl(unsigned long request, void* arg,
+                              const char* name)
+{
+    int status;
+    do
+        status = ioctl(fd_m, request, arg);
+    while (status < 0 && errno == EINTR);
+
+    if (status < 0)
+        throw Exception(device_m + ": " + name + " failed: " +
+                        strerror(errno), __FILE__, __FUNCTION__, __LINE__);
+}
+
+void V4L2Capture::Impl::Open(uint32_t width, uint32_t height,
+                             uint32_t pixel_format, uint32_t num_buffers)
+{
+    v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    Ioctl(VIDIOC_QUERYCAP, &cap, "VIDIOC_QUERYCAP");
+
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ?
+                    cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING))
+        throw Exception(device_m + " is not a streaming capture device",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width       = width;
+    fmt.fmt.pix.height      = height;
+    fmt.fmt.pix.pixelformat = pixel_format;
+    fmt.fmt.pix.field       = V4L2_FIELD_NONE;
+    Ioctl(VIDIOC_S_FMT, &fmt, "VIDIOC_S_FMT");
+
+    if (fmt.fmt.pix.pixelformat != pixel_format)
+        throw Exception(device_m + " does not support the pixel format",
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    width_m          = fmt.fmt.pix.width;
+    height_m         = fmt.fmt.pix.height;
+    bytes_per_line_m = fmt.fmt.pix.bytesperline;
+    frame_size_m     = fmt.fmt.pix.sizeimage;
+
+    // The camera writes into CMEM buffers, rather than into driver
+    // buffers that would be copied
+    v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count  = std::max(1u, num_buffers);
+    req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_USERPTR;
+    if (ioctl(fd_m, VIDIOC_REQBUFS, &req) < 0 || req.count == 0)
+        throw Exception(device_m + " does not support user pointer "
+                        "streaming", __FILE__, __FUNCTION__, __LINE__);
+
+    // Size classes are page multiples, as required for user pointers
+    buffer_size_m = BufferPool::GetSizeClass(frame_size_m);
+    for (uint32_t i = 0; i < req.count; i++)
+    {
+        buffers_m.push_back(pool_m.Acquire(buffer_size_m));
+        Queue(i);
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    Ioctl(VIDIOC_STREAMON, &type, "VIDIOC_STREAMON");
+}
+
+void V4L2Capture::Impl::Queue(uint32_t index)
+{
+    v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type      = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory    = V4L2_MEMORY_USERPTR;
+    buf.index     = index;
+    buf.m.userptr = reinterpret_cast<unsigned long>(buffers_m[index]);
+    buf.length    = buffer_size_m;
+    Ioctl(VIDIOC_QBUF, &buf, "VIDIOC_QBUF");
+}
+
+bool V4L2Capture::Impl::DequeueFrame(ArgInfo& frame)
+{
+    v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_USERPTR;
+
+    int status;
+    do
+        status = ioctl(fd_m, VIDIOC_DQBUF, &buf);
+    while (status < 0 && errno == EINTR);
+
+    if (status < 0 || buf.index >= buffers_m.size())
+        return false;
+
+    frame = ArgInfo(buffers_m[buf.index], frame_size_m);
+    return true;
+}
+
+void V4L2Capture::Impl::QueueFrame(const ArgInfo& frame)
+{
+    auto it = std::find(buffers_m.begin(), buffers_m.end(), frame.ptr());
+    if (it == buffers_m.end())
+        throw Exception("Frame was not captured by " + device_m,
+                        __FILE__, __FUNCTION__, __LINE__);
+
+    Queue(it - buffers_m.begin());
+}
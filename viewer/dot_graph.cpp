@@ -25,6 +25,8 @@
  *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
  *  THE POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
+#include <cstdio>
+#include <algorithm>
 #include "dot_graph.h"
 
 using Edge   =  boost::graph_traits<Graph>::edge_descriptor;
@@ -37,34 +39,39 @@ template<typename T>
 using EdgePropertyMap =
               typename boost::property_map<T, boost::edge_attribute_t>::type;
 
-using LayerIdMap = std::map<uint32_t, Graph*>;
-
 static const char* FILLED = "filled";
 static const char* LABEL  = "label";
 static const char* COLOR  = "color";
 static const char* STYLE  = "style";
 static const char* SHAPE  = "shape";
 static const char* BOLD   = "bold";
+// Heatmap of the profiled time, from light yellow to dark red
+static const char* HEAT_SCHEME = "ylorrd9";
+static const int   HEAT_LEVELS = 9;
 
 static const char* GetVertexColor(uint32_t layer_type);
 static std::string PoolingProperties(const sTIDL_PoolingParams_t& p);
 static std::string BiasProperties(const sTIDL_BiasParams_t& p);
 static std::string ReLUProperties(const sTIDL_ReLUParams_t& p);
+static uint64_t    OutputBytes(const sTIDL_Layer_t& layer);
+static std::string FormatBytes(uint64_t bytes);
+static std::string FormatFixed(float x);
 
 
-DotGraph::DotGraph(const sTIDL_Network_t& net):
-                    graph_m(net.numLayers), net_m(net)
+DotGraph::DotGraph(const sTIDL_Network_t& net, const LayerProfile& profile):
+                    graph_m(net.numLayers), net_m(net), profile_m(profile)
 {
     AddVertices();
     AddEdges();
     AddMetaData();
+    if (!profile_m.empty())
+        AddProfile();
 }
 
 
 void DotGraph::AddVertices()
 {
     // Add a vertex for each layer
-    LayerIdMap layerid_map;
     for (int i = 0 ; i < net_m.numLayers; i++)
     {
         const sTIDL_Layer_t& layer = net_m.TIDLLayers[i];
@@ -87,10 +94,10 @@ void DotGraph::AddVertices()
         // Place all layers with the same ID into a single subgraph
         uint32_t layerGroupId = layer.layersGroupId;
         Graph* sub = nullptr;
-        if (layerid_map.find(layerGroupId) == layerid_map.end())
+        if (groups_m.find(layerGroupId) == groups_m.end())
         {
             sub = &(graph_m.create_subgraph());
-            layerid_map[layerGroupId] = sub;
+            groups_m[layerGroupId] = sub;
             get_property(*sub, graph_name) = std::string("cluster") +
                                              std::to_string(layerGroupId);
             get_property(*sub, graph_graph_attribute)[LABEL] =
@@ -98,7 +105,7 @@ void DotGraph::AddVertices()
             get_property(*sub, graph_graph_attribute)[STYLE] = BOLD;
         }
         else
-            sub = layerid_map[layerGroupId];
+            sub = groups_m[layerGroupId];
 
         auto V = add_vertex(i, *sub);
 
@@ -231,6 +238,119 @@ void DotGraph::AddMetaData()
 }
 
 
+// Color each profiled layer and layer group by its share of the profiled
+// time, annotate layers with their time and output size, and edges between
+// layer groups with the bytes passed from one stage to the next
+void DotGraph::AddProfile()
+{
+    float total_ms = 0;
+    float max_ms   = 0;
+    for (const auto& p : profile_m)
+    {
+        total_ms += p.second.ms;
+        max_ms    = std::max(max_ms, p.second.ms);
+    }
+    if (total_ms <= 0)
+        return;
+
+    VertexPropertyMap<Graph> vpm = boost::get(vertex_attribute, graph_m);
+    for (int i = 0 ; i < net_m.numLayers; i++)
+    {
+        const sTIDL_Layer_t& layer = net_m.TIDLLayers[i];
+        auto it = profile_m.find(i);
+        if (layer.layerType == TIDL_DataLayer || it == profile_m.end())
+            continue;
+
+        float ms = it->second.ms;
+        stage_times_m[layer.layersGroupId] += ms;
+
+        auto V = vertex(i, graph_m);
+        int level = 1 + (int) ((HEAT_LEVELS - 1) * ms / max_ms + 0.5f);
+        vpm[V]["colorscheme"] = HEAT_SCHEME;
+        vpm[V]["fillcolor"]   = std::to_string(level);
+        vpm[V][STYLE]         = std::string(FILLED) + "," + BOLD;
+
+        // The record label ends in '}', annotate inside the record
+        std::string& label = vpm[V][LABEL];
+        label.insert(label.size() - 1,
+                     "|" + FormatFixed(ms) + " ms (" +
+                     FormatFixed(100 * ms / total_ms) + "%)\\n" +
+                     FormatBytes(OutputBytes(layer)) + " out");
+    }
+
+    float max_stage_ms = 0;
+    for (const auto& s : stage_times_m)
+        max_stage_ms = std::max(max_stage_ms, s.second);
+
+    for (const auto& g : groups_m)
+    {
+        float ms = stage_times_m.count(g.first) ? stage_times_m[g.first] : 0;
+        GraphvizAttributes& a = get_property(*g.second,
+                                             graph_graph_attribute);
+        a[LABEL] += ": " + FormatFixed(ms) + " ms (" +
+                    FormatFixed(100 * ms / total_ms) + "%)";
+
+        // Lighter than the layers, which remain readable on top
+        int level = max_stage_ms > 0 ? 1 + (int) (4 * ms / max_stage_ms) : 1;
+        a["colorscheme"] = HEAT_SCHEME;
+        a["bgcolor"]     = std::to_string(level);
+        a[STYLE]         = std::string(FILLED) + "," + BOLD;
+    }
+
+    EdgePropertyMap<Graph> ep = boost::get(boost::edge_attribute, graph_m);
+    auto edges = boost::edges(graph_m);
+    for (auto e = edges.first; e != edges.second; ++e)
+    {
+        const sTIDL_Layer_t& src = net_m.TIDLLayers[source(*e, graph_m)];
+        const sTIDL_Layer_t& dst = net_m.TIDLLayers[target(*e, graph_m)];
+        if (src.layersGroupId == dst.layersGroupId ||
+            src.layerType == TIDL_DataLayer || dst.layerType == TIDL_DataLayer)
+            continue;
+
+        ep[*e][LABEL] += "\\n" + FormatBytes(OutputBytes(src));
+        ep[*e][STYLE]  = BOLD;
+    }
+
+    get_property(graph_m, graph_graph_attribute)[LABEL] =
+                                                StageBalance(stage_times_m);
+    get_property(graph_m, graph_graph_attribute)["labelloc"] = "t";
+}
+
+std::string StageBalance(const StageTimes& times)
+{
+    if (times.empty())
+        return "No profiled layers";
+
+    float total_ms = 0;
+    auto bottleneck = times.begin();
+    std::string s = "Stages:";
+    for (auto it = times.begin(); it != times.end(); ++it)
+    {
+        s += " Group " + std::to_string(it->first) + " " +
+             FormatFixed(it->second) + " ms";
+        total_ms += it->second;
+        if (it->second > bottleneck->second)
+            bottleneck = it;
+    }
+
+    s += ", sequential " + FormatFixed(total_ms) + " ms";
+    if (times.size() > 1 && bottleneck->second > 0)
+    {
+        // Stages of different frames overlap in a pipeline, throughput is
+        // bound by the slowest stage. Balance is the fastest stage over
+        // the slowest one, 100% is perfectly balanced.
+        float min_ms = bottleneck->second;
+        for (const auto& t : times)
+            min_ms = std::min(min_ms, t.second);
+        s += ", bottleneck Group " + std::to_string(bottleneck->first) +
+             ", pipelined " + FormatFixed(1000 / bottleneck->second) +
+             " fps, balance " + FormatFixed(100 * min_ms / bottleneck->second) +
+             "%";
+    }
+
+    return s;
+}
+
 // Generate dot file from boost graph
 void DotGraph::Write(const std::string& filename) const
 {
@@ -276,6 +396,34 @@ std::string BiasProperties(const sTIDL_BiasParams_t& p)
 
 
 
+// Bytes of the 8-bit output buffers of a layer
+uint64_t OutputBytes(const sTIDL_Layer_t& layer)
+{
+    uint64_t bytes = 0;
+    for (int i = 0; i < layer.numOutBufs; i++)
+    {
+        const sTIDL_DataParams_t& d = layer.outData[i];
+        bytes += (uint64_t) d.dimValues[0] * d.dimValues[1] *
+                 d.dimValues[2] * d.dimValues[3];
+    }
+    return bytes;
+}
+
+std::string FormatBytes(uint64_t bytes)
+{
+    if (bytes < 1024)
+        return std::to_string(bytes) + " B";
+    return FormatFixed(bytes / 1024.0f) + " KB";
+}
+
+// Fixed point, one decimal
+std::string FormatFixed(float x)
+{
+    char s[32];
+    snprintf(s, sizeof(s), "%.1f", x);
+    return s;
+}
+
 const char* GetVertexColor(uint32_t layer_type)
 {
     static const char* LayerColors[] =
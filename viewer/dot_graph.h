@@ -80,23 +80,49 @@ using Graph =
 
 using Vertex =  boost::graph_traits<Graph>::vertex_descriptor;
 
+// Device cycles and time of a layer, e.g. measured by tidl::LayerProfiler
+struct LayerCost
+{
+    uint64_t cycles = 0;
+    float    ms     = 0;
+};
+
+// Indexed by layer index. Layers without a cost are not profiled.
+using LayerProfile = std::map<int, LayerCost>;
+
+// Time of each layer group, indexed by layersGroupId
+using StageTimes = std::map<uint32_t, float>;
+
 class DotGraph
 {
   public:
-    DotGraph(const sTIDL_Network_t& net);
+    // With a profile, vertices and layer groups are colored by their share
+    // of the profiled time and annotated with their time and output size
+    DotGraph(const sTIDL_Network_t& net,
+             const LayerProfile& profile = LayerProfile());
     ~DotGraph() {}
 
     void Write(const std::string& filename) const;
 
+    // Profiled time of each layer group, empty without a profile
+    const StageTimes& GetStageTimes() const { return stage_times_m; }
+
   private:
     void AddVertices();
     void AddEdges();
     void AddMetaData();
     void AddVertexProperties(Vertex& V, Graph* g, const sTIDL_Layer_t& layer,
                              int index);
+    void AddProfile();
 
     Graph graph_m;
     const sTIDL_Network_t& net_m;
+    const LayerProfile     profile_m;
+    std::map<uint32_t, Graph*> groups_m;
+    StageTimes             stage_times_m;
 };
 
+// Summary of the stage balance of the layer groups in times
+std::string StageBalance(const StageTimes& times);
+
 extern const char* TIDL_LayerString[];
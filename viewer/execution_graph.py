@@ -42,8 +42,24 @@ USAGE = """
     Display frame execution using trace data generated by the TIDL API.
 """
 
-# Supported TIDL API classes
-COMPONENTS = ('eop', 'eo1', 'eo2')
+# Supported TIDL API classes. 'eo<n>' is the ExecutionObject running
+# layersGroupId n, i.e. stage n of a pipeline.
+KEY_EOP = 'eop'
+
+
+def is_component(component):
+    """Return True for 'eop' and 'eo<n>' components"""
+
+    return component == KEY_EOP or (component.startswith('eo') and
+                                    component[2:].isdigit())
+
+
+def component_order(component):
+    """Sort key: the EOP first, then EOs in stage order"""
+
+    if component == KEY_EOP:
+        return 0
+    return int(component[2:])
 
 # APIs with timestamps
 # ProcessFrameStartAsync, ProcessFrameWait, RunAsyncNext
@@ -55,16 +71,29 @@ KEY_START = 'start'
 KEY_END = 'end'
 
 BARH_COLORS = ('lightgray', 'green', 'blue', 'yellow',
-               'black', 'orange', 'red', 'cyan')
+               'black', 'orange', 'red', 'cyan',
+               'magenta', 'brown', 'olive', 'purple', 'pink', 'navy')
 
 BARH_LEGEND_STR = {'eop' : 'ExecutionObjectPipeline',
-                   'eo1' : 'ExecutionObject 0',
-                   'eo2' : 'ExecutionObject 1',
                    'pfw' : 'Process Frame Wait',
                    'pfsa': 'Process Frame Start Async',
                    'ran' : 'Run Async Next',
                    'total': 'Total frame time'}
 
+
+def legend_str(tag):
+    """Legend for a label tag. eo<n> is numbered from 0, in stage order"""
+
+    if tag in BARH_LEGEND_STR:
+        return BARH_LEGEND_STR[tag]
+    return 'ExecutionObject {}'.format(component_order(tag) - 1)
+
+
+def bar_color(index):
+    """Colors are reused for pipelines with many stages"""
+
+    return BARH_COLORS[index % len(BARH_COLORS)]
+
 class Range:
     """ Defines a range in terms of start and stop timestamps. """
 
@@ -105,16 +134,17 @@ class FrameInfo:
         self.eo_id = {}
 
         self.data = {}
-        for component in COMPONENTS:
-            self.data[component] = {}
 
     def update(self, component, api, phase, val):
         """Update the [c][api][phase] with timestamp"""
 
-        if component not in COMPONENTS:
+        if not is_component(component):
             print('Invalid component: {}'.format(component))
             return
 
+        if component not in self.data:
+            self.data[component] = {}
+
         if api not in self.data[component]:
             self.data[component][api] = Range()
 
@@ -138,9 +168,9 @@ class FrameInfo:
         """
 
         device_list = []
-        for component in ('eo1', 'eo2'):
+        for component in sorted(self.eo_type, key=component_order):
             device = ""
-            if not self.data[component]:
+            if not self.data.get(component):
                 continue
 
             # Corresponds to DeviceType enum in inc/executor.h
@@ -171,7 +201,9 @@ class FrameInfo:
     def get_total(self, component):
         """Return the range for the specified component"""
 
-        if not self.data[component]:
+        if not self.data.get(component) or \
+           KEY_PFSA not in self.data[component] or \
+           KEY_PFW not in self.data[component]:
             print("{} not available".format(component))
             return None
 
@@ -251,12 +283,15 @@ class FrameInfo:
 
         label_range_tuples = []
 
+        stages = sorted([c for c in found if c != KEY_EOP],
+                        key=component_order)
+
         if verbosity == 0:
-            if not found['eo2']:
-                if found['eop']:
-                    component = 'eop'
+            if len(stages) <= 1:
+                if KEY_EOP in found:
+                    component = KEY_EOP
                 else:
-                    component = 'eo1'
+                    component = stages[0]
                 label_range_tuples.append(('total', self.get_max_range()))
                 label_range_tuples.extend(self.get_plot_ranges((component)))
             else:
@@ -264,7 +299,7 @@ class FrameInfo:
 
         elif verbosity == 1:
             label_range_tuples.append(('total', self.get_max_range()))
-            for component in COMPONENTS:
+            for component in sorted(found, key=component_order):
                 label_range_tuples.extend(self.get_plot_ranges(component))
 
         labels = [i[0] for i in label_range_tuples]
@@ -275,10 +310,9 @@ class FrameInfo:
     def __repr__(self):
         string = '<FI:'
 
-        # Sort components based in order in COMPONENTS
+        # Sort components in stage order
         components = list(self.data.keys())
-        components.sort(key=COMPONENTS.index)
-        #components.sort(key=lambda kv: COMPONENTS.index(kv))
+        components.sort(key=component_order)
 
         for component in components:
             if not self.data[component]:
@@ -304,9 +338,8 @@ class Frames:
 
     def __init__(self, v):
         self.trace_data = {}
-        self.found = {}
-        for component in COMPONENTS:
-            self.found[component] = False
+        # Components with events, across all frames
+        self.found = set()
         self.verbosity = v
 
     def update(self, index, key, val):
@@ -320,7 +353,8 @@ class Frames:
 
         self.trace_data[index].update(component, api, phase, val)
 
-        self.found[component] = True
+        if is_component(component):
+            self.found.add(component)
 
     def adjust_to_zero(self):
         """ Adjust timestamp sequence to start at 0"""
@@ -382,10 +416,11 @@ class Frames:
 
 def read_data(args):
     """ Read a sequence of trace data and create a Frames object
-        Each row has the following syntax: frame_index, key, value
+        Each row has the following syntax:
+        frame_index, key, value[, device type, device index[, pipeline]]
         There is a row for each event that is recorded for a frame
         E.g.
-        48,EOP:PFSA:Start,1540246078613202
+        48,EOP:PFSA:Start,1540246078613202,0,0,1
     """
 
     frames = Frames(args.verbosity)
@@ -393,16 +428,20 @@ def read_data(args):
     with open(args.input_file) as lines:
         for line in lines:
             info = line.rstrip().split(',')
-            if (len(info) != 3 and len(info) != 5):
+            if len(info) not in (3, 5, 6):
                 continue
 
             frame_index = int(info[0])
             data_key = info[1].lower()
 
+            # Copy and device events are only shown in the Chrome trace
+            if data_key.split(':')[1] not in ('pfsa', 'pfw', 'ran'):
+                continue
+
             frames.update(index=frame_index, key=data_key, val=int(info[2]))
 
-            if len(info) == 5:
-                component = data_key.split(':')[0]
+            component = data_key.split(':')[0]
+            if len(info) >= 5 and component != 'eop':
                 frames.trace_data[frame_index].update_eo_info(component,
                                                               int(info[3]),
                                                               int(info[4]))
@@ -425,12 +464,12 @@ def insert_legend(labels, axes):
     for label in labels:
         index = labels.index(label)
         # Create rectangles of the appropriate color for each label
-        bars.append(mpatch.Rectangle((0, 0), 1, 1, fc=BARH_COLORS[index]))
+        bars.append(mpatch.Rectangle((0, 0), 1, 1, fc=bar_color(index)))
 
         # Build a legend string from a ':' separated label string
         legend_string = ""
         for tags in label.split(':'):
-            legend_string += BARH_LEGEND_STR[tags] + ' '
+            legend_string += legend_str(tags) + ' '
 
         legend_strings.append(legend_string)
 
@@ -454,7 +493,8 @@ def plot(frames, filename):
         ranges, labels = frame.get_barh_ranges(frames.found, frames.verbosity)
         axes.broken_barh(ranges,
                          (y_index, 5),
-                         facecolors=BARH_COLORS,
+                         facecolors=[bar_color(i)
+                                     for i in range(len(ranges))],
                          alpha=0.8)
 
         if not legend_inserted:
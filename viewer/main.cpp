@@ -33,6 +33,8 @@
 #include <cassert>
 #include <string>
 #include <cstdlib>
+#include <memory>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -40,11 +42,48 @@
 
 
 #include "tidl_viewer.h"
+#include "util.h"
+#include "network_binary.h"
 
 using namespace tidl;
 
+// Split a comma separated list
+static std::vector<std::string> SplitList(const std::string& s)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= s.size())
+    {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > start)
+            items.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+struct AnalyzeOptions
+{
+    bool     enabled  = false;
+    uint32_t num_eves = 1;
+    uint32_t num_dsps = 1;
+};
+
+struct CompactOptions
+{
+    std::string output_file;
+    std::string params_file;
+    bool        compress = false;
+};
+
 static void ProcessArgs(int argc, char *argv[], std::string& network_file,
-                        bool& do_print, std::string& dot_file);
+                        bool& do_print, std::string& dot_file,
+                        std::vector<std::string>& profiles,
+                        AnalyzeOptions& analyze, CompactOptions& compact);
+static bool WriteCompact(const std::string& network_file,
+                         const CompactOptions& compact);
 
 static void DisplayHelp();
 static bool fs_exists(std::string path);
@@ -59,16 +98,38 @@ int main(int argc, char *argv[])
     std::string network_file;
     std::string dot_file;
     bool do_print = false;
-    ProcessArgs(argc, argv, network_file, do_print, dot_file);
+    std::vector<std::string> profiles;
+    AnalyzeOptions analyze;
+    CompactOptions compact;
+    ProcessArgs(argc, argv, network_file, do_print, dot_file, profiles,
+                analyze, compact);
 
     bool status = true;
 
+    // Static cost analysis, does not need a dot file
+    if (analyze.enabled)
+    {
+        status &= util::AnalyzeNetwork(network_file, analyze.num_eves,
+                                       analyze.num_dsps);
+        if (dot_file.empty() && compact.output_file.empty())
+            return status ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Convert to a compact container if requested
+    if (!compact.output_file.empty())
+    {
+        status &= WriteCompact(network_file, compact);
+        if (dot_file.empty())
+            return status ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Dump network to stdout if requested
     if (do_print)
         status &= util::PrintNetwork(network_file);
 
     // Generate a dot file
-    status &= util::GenerateDotGraphForNetwork(network_file, dot_file);
+    status &= util::GenerateDotGraphForNetwork(network_file, dot_file,
+                                               profiles);
 
     // If the dot utility exists, generate a SVG file
     const std::string dot_bin("/usr/bin/dot");
@@ -89,9 +150,11 @@ int main(int argc, char *argv[])
 
 
 void ProcessArgs(int argc, char *argv[], std::string& network_file,
-                 bool& do_print, std::string& dot_file)
+                 bool& do_print, std::string& dot_file,
+                 std::vector<std::string>& profiles,
+                 AnalyzeOptions& analyze, CompactOptions& compact)
 {
-    if (argc < 4)
+    if (argc < 3)
     {
         DisplayHelp();
         exit(EXIT_SUCCESS);
@@ -102,6 +165,11 @@ void ProcessArgs(int argc, char *argv[], std::string& network_file,
         {"help",         no_argument,       0, 'h'},
         {"dot",          required_argument, 0, 'd'},
         {"print",        no_argument,       0, 'p'},
+        {"profile",      required_argument, 0, 'l'},
+        {"analyze",      required_argument, 0, 'a'},
+        {"compact",      required_argument, 0, 'c'},
+        {"params",       required_argument, 0, 'P'},
+        {"lz4",          no_argument,       0, 'z'},
         {0, 0, 0, 0}
     };
 
@@ -110,7 +178,8 @@ void ProcessArgs(int argc, char *argv[], std::string& network_file,
     while (true)
     {
         int this_option_optind = optind ? optind : 1;
-        int c = getopt_long(argc, argv, "-d:ph", long_options, &option_index);
+        int c = getopt_long(argc, argv, "-d:phl:a:c:P:z", long_options,
+                            &option_index);
 
         if (c == -1)
             break;
@@ -126,6 +195,34 @@ void ProcessArgs(int argc, char *argv[], std::string& network_file,
             case 'p': do_print = true;
                       break;
 
+            case 'l': profiles = SplitList(optarg);
+                      break;
+
+            case 'a':
+            {
+                std::vector<std::string> cores = SplitList(optarg);
+                if (cores.size() != 2 || atoi(cores[0].c_str()) <= 0 ||
+                    atoi(cores[1].c_str()) <= 0)
+                {
+                    std::cerr << "ERROR: -a expects <num EVEs>,<num DSPs>"
+                              << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                analyze.enabled  = true;
+                analyze.num_eves = atoi(cores[0].c_str());
+                analyze.num_dsps = atoi(cores[1].c_str());
+                break;
+            }
+
+            case 'c': compact.output_file = optarg;
+                      break;
+
+            case 'P': compact.params_file = optarg;
+                      break;
+
+            case 'z': compact.compress = true;
+                      break;
+
             case 'h': DisplayHelp();
                       exit(EXIT_SUCCESS);
                       break;
@@ -140,7 +237,7 @@ void ProcessArgs(int argc, char *argv[], std::string& network_file,
         }
     }
 
-    if (dot_file.empty())
+    if (dot_file.empty() && compact.output_file.empty() && !analyze.enabled)
     {
         std::cerr << "ERROR: output dot file not specified." << std::endl;
         DisplayHelp();
@@ -157,12 +254,67 @@ void DisplayHelp()
     version += STRING(_BUILD_SHA);
 
     std::cout << "Usage: tidl_viewer -d <dot file name> <network binary file>\n"
+              << "       tidl_viewer -a <eves>,<dsps> <network binary file>\n"
+              << "       tidl_viewer -c <compact file> [-P <parameter file>]"
+                 " [-z] <network binary file>\n"
               << "Version: " << version << std::endl
               << "Options:  \n"
                  " -p              Print network layer info\n"
+                 " -l <csv>[,<csv>] Color and annotate the graph with the\n"
+                 "                 per-layer profile(s) written by\n"
+                 "                 LayerProfiler, and print the stage balance\n"
+                 "                 of the layer groups. Layers missing from a\n"
+                 "                 profile are taken from the next one\n"
+                 " -a <eves>,<dsps> Print the MACs, activation and parameter\n"
+                 "                 sizes of each layer and layer group, the\n"
+                 "                 recommended heap sizes and the EVE/DSP\n"
+                 "                 split balancing MACs across the cores\n"
+                 " -c              Write the network to a compact container\n"
+                 " -P              Include the parameter binary in the"
+                 " container\n"
+                 " -z              LZ4 compress the parameters\n"
                  " -h              Display this help message\n";
 }
 
+bool WriteCompact(const std::string& network_file,
+                  const CompactOptions& compact)
+{
+    std::unique_ptr<sTIDL_Network_t> net(new sTIDL_Network_t);
+    if (!ReadNetworkBinary(network_file, reinterpret_cast<char *>(net.get())))
+    {
+        std::cerr << "ERROR: Invalid network binary: "
+                  << network_file << std::endl;
+        return false;
+    }
+
+    std::vector<char> params;
+    if (!compact.params_file.empty())
+    {
+        params.resize(GetBinaryFileSize(compact.params_file));
+        if (params.empty() ||
+            !ReadBinary(compact.params_file, params.data(), params.size()))
+        {
+            std::cerr << "ERROR: Invalid parameter binary: "
+                      << compact.params_file << std::endl;
+            return false;
+        }
+    }
+
+    if (!WriteCompactNetwork(compact.output_file, net.get(), params.data(),
+                             params.size(), compact.compress))
+    {
+        std::cerr << "ERROR: Failed to write " << compact.output_file
+                  << std::endl;
+        return false;
+    }
+
+    std::cout << compact.output_file << ": " << net->numLayers
+              << " layers, " << params.size() << " bytes of parameters, "
+              << GetBinaryFileSize(compact.output_file) << " bytes"
+              << std::endl;
+    return true;
+}
+
 bool fs_exists(std::string path)
 {
     struct stat statbuf;
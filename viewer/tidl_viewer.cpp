@@ -25,9 +25,16 @@
  *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
  *  THE POSSIBILITY OF SUCH DAMAGE.
  *****************************************************************************/
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <memory>
+
 #include "util.h"
 #include "tidl_viewer.h"
 #include "dot_graph.h"
+#include "network_cost.h"
 
 using namespace tidl::util;
 
@@ -49,10 +56,13 @@ bool tidl::util::PrintNetwork(const std::string& network_binary,
 
     printf("%3s  %-20s  %3s  %3s  %3s "
            " %3s  %3s  %3s  %3s  %3s  %3s  %3s  %3s %3s "
-           " %5s  %5s  %5s  %5s  %5s  %5s  %5s  %5s\n",
+           " %5s  %5s  %5s  %5s  %5s  %5s  %5s  %5s  %8s\n",
             "#", "Name", "gId", "#i", "#o",
             "i0", "i1", "i2", "i3", "i4", "i5", "i6", "i7", "o",
-            "#roi", "#ch", "h", "w", "#roi", "#ch", "h", "w");
+            "#roi", "#ch", "h", "w", "#roi", "#ch", "h", "w", "MMACs");
+
+    std::map<int, uint64_t> group_macs;
+    uint64_t                total_macs = 0;
 
     for (int i = 0 ; i < net.numLayers; i++)
     {
@@ -80,15 +90,113 @@ bool tidl::util::PrintNetwork(const std::string& network_binary,
         {
           printf("%5d ,",net.TIDLLayers[i].outData[0].dimValues[j]);
         }
-        printf("\n");
+        uint64_t macs = GetLayerMacs(net.TIDLLayers[i]);
+        group_macs[net.TIDLLayers[i].layersGroupId] += macs;
+        total_macs += macs;
+        printf("%8.2f\n", macs / 1e6);
+    }
+
+    for (const auto& g : group_macs)
+        printf("layersGroupId %d: %.2f MMACs\n", g.first, g.second / 1e6);
+    printf("Total: %.2f MMACs\n", total_macs / 1e6);
+
+    return true;
+}
+
+
+
+bool tidl::util::AnalyzeNetwork(const std::string& network_binary,
+                                uint32_t num_eves, uint32_t num_dsps)
+{
+    std::unique_ptr<sTIDL_Network_t> net(new sTIDL_Network_t);
+    if (!ReadNetworkBinary(network_binary,
+                           reinterpret_cast<char *>(net.get())))
+    {
+        std::cerr << "ERROR: Invalid network binary: "
+                  << network_binary << std::endl;
+        return false;
+    }
+
+    NetworkCost cost(*net);
+    const double KB = 1024.0, MB = 1024.0 * 1024.0;
+
+    printf("%3s  %-20s  %3s  %9s  %9s  %9s\n",
+           "#", "Name", "gId", "MMACs", "Out KB", "Param KB");
+    for (const NetworkCost::Layer& l : cost.GetLayers())
+        printf("%3d, %-20s, %3d, %9.2f, %9.1f, %9.1f\n", l.index,
+               TIDL_LayerString[l.layerType], l.layersGroupId,
+               l.macs / 1e6, l.outputBytes / KB, l.paramBytes / KB);
+
+    for (const auto& item : cost.GetLayersGroups())
+    {
+        const NetworkCost::LayersGroup& g = item.second;
+        printf("\nlayersGroupId %d: %u layers, %.2f MMACs\n"
+               "  Parameters  %8.2f MB\n"
+               "  Activations %8.2f MB, %.2f MB live at most\n"
+               "  Recommended NETWORK_HEAP_SIZE %zu MB,"
+               " PARAM_HEAP_SIZE %zu MB\n",
+               item.first, g.numLayers, g.macs / 1e6,
+               g.paramBytes / MB, g.activationBytes / MB,
+               g.peakActivationBytes / MB,
+               g.networkHeapSize >> 20, g.paramHeapSize >> 20);
     }
 
+    int partition = cost.GetBalancedPartition(num_eves, num_dsps);
+    if (partition < 0)
+        return true;
+
+    uint64_t eve_macs, dsp_macs;
+    cost.GetPartitionMacs(partition, eve_macs, dsp_macs);
+    printf("\n# Partition layer %d for %u EVE(s), %u DSP(s):"
+           " EVE %.2f MMACs, DSP %.2f MMACs\n",
+           partition, num_eves, num_dsps, eve_macs / 1e6, dsp_macs / 1e6);
+
+    // Same syntax as PartitionTuner::WriteConfiguration
+    printf("layerIndex2LayerGroupId = {");
+    bool first = true;
+    for (const NetworkCost::Layer& l : cost.GetLayers())
+        if (l.layersGroupId == 1 && l.index >= partition)
+        {
+            printf("%s{%d, 2}", first ? " " : ", ", l.index);
+            first = false;
+        }
+    printf(" }\n");
+
     return true;
 }
 
+// Read a per-layer profile: layer index, layer type, cycles, ms. Lines that
+// do not start with a layer index, e.g. the header, are skipped.
+static bool ReadLayerProfile(const std::string& file, LayerProfile& profile)
+{
+    std::ifstream ifs(file);
+    if (!ifs.good())
+        return false;
+
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        int      layer, type;
+        unsigned long long cycles;
+        float    ms;
+        if (sscanf(line.c_str(), "%d,%d,%llu,%f", &layer, &type, &cycles,
+                   &ms) != 4)
+            continue;
+
+        // Earlier profiles take precedence
+        if (profile.count(layer) == 0)
+        {
+            profile[layer].cycles = cycles;
+            profile[layer].ms     = ms;
+        }
+    }
+
+    return true;
+}
 
 bool tidl::util::GenerateDotGraphForNetwork(const std::string& network_binary,
-                                            const std::string& dot_file)
+                                            const std::string& dot_file,
+                                       const std::vector<std::string>& profiles)
 {
     if (network_binary.empty())
         return false;
@@ -104,8 +212,19 @@ bool tidl::util::GenerateDotGraphForNetwork(const std::string& network_binary,
     }
 
 
-    DotGraph g(net);
+    LayerProfile profile;
+    for (const auto& f : profiles)
+        if (!ReadLayerProfile(f, profile))
+        {
+            std::cerr << "ERROR: Cannot read profile: " << f << std::endl;
+            return false;
+        }
+
+    DotGraph g(net, profile);
     g.Write(dot_file);
 
+    if (!profiles.empty())
+        std::cout << StageBalance(g.GetStageTimes()) << std::endl;
+
     return true;
 }
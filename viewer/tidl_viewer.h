@@ -31,12 +31,24 @@
 
 #include <string>
 #include <ostream>
+#include <vector>
+#include <cstdint>
 
 
 namespace tidl { namespace util {
 
 bool PrintNetwork(const std::string& network_binary, std::ostream& os = std::cout);
+// Print the static cost of each layer and layer group, recommended heap
+// sizes and the MAC balanced EVE/DSP split for num_eves and num_dsps
+bool AnalyzeNetwork(const std::string& network_binary,
+                    uint32_t num_eves, uint32_t num_dsps);
+
+// Profiles are CSV files written by tidl::LayerProfiler::WriteCSV. Layers
+// missing from a profile are taken from the next one, e.g. an EVE profile
+// of layersGroupId 1 followed by a DSP profile of the full network.
 bool GenerateDotGraphForNetwork(const std::string& network_binary,
-                                const std::string& dot_file);
+                                const std::string& dot_file,
+                                const std::vector<std::string>& profiles =
+                                                std::vector<std::string>());
 
 }} // namespace tidl::util